@@ -0,0 +1,574 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <ncurses.h>
+#include "../include/game.h"
+#include "../include/story.h"
+#include "../include/storyfile.h"
+#include "../include/engine.h"
+#include "../include/requirements.h"
+#include "../include/savefile.h"
+#include "../include/effect.h"
+#include "../include/snapshot.h"
+
+/**
+ * @file bench.c
+ * @brief Benchmarks of the game's hot paths
+ * @details Times story construction, chapter transitions, requirement
+ *          checks, choice conditions and effects, scene rendering into an off-screen terminal, save and
+ *          load, game snapshots, and headless playthroughs. Each benchmark repeats one operation until it has
+ *          run for the minimum time and reports nanoseconds, allocations and
+ *          bytes written per operation. Allocations and fwrite() output are
+ *          counted by wrapping those functions at link time, so only calls
+ *          made by the game's own code are counted, not those inside libc or
+ *          ncurses; terminal output is measured from the file the off-screen
+ *          terminal writes to.
+ */
+
+#define DEFAULT_MIN_SECONDS 0.5
+#define SAVED_TURNS 64
+#define TERMINAL_LINES "24"
+#define TERMINAL_COLUMNS "80"
+#define EFFECT_BATCH 64
+#define UNDONE_TURNS 32
+
+/**
+ * @struct BenchState
+ * @brief Everything the benchmarks share
+ */
+typedef struct {
+    Story* story;               /**< Compiled story the benchmarks run on */
+    Character player;           /**< Character of game */
+    GameState game;             /**< Game the benchmarks play */
+    int node;                   /**< Node the next rendering benchmark shows */
+    Story* heldChapter;         /**< Chapter kept open so entering it finds it compiled, or NULL */
+    Story* conditionStory;      /**< Story whose choices all have conditions, or NULL */
+    Story* effectStory;         /**< Story with one choice whose effects the effect benchmarks apply, or NULL */
+    int effectItem;             /**< Id of the item effectStory gives and takes */
+    int effectFlag;             /**< Id of the flag effectStory sets and clears */
+    Character batchPlayers[EFFECT_BATCH];  /**< Characters of batchGames */
+    GameState batchGames[EFFECT_BATCH];    /**< Games the batch effect benchmark applies to */
+    GameSnapshot* snapshot;     /**< Snapshot game is at in the snapshot benchmarks, or NULL */
+    unsigned long long rng;     /**< xorshift64 state for random choices */
+    FILE* screenFile;           /**< File the off-screen terminal writes to */
+    char directory[64];         /**< Scratch directory holding the save file */
+} BenchState;
+
+/**
+ * @struct Benchmark
+ * @brief One timed operation
+ */
+typedef struct {
+    const char* name;                          /**< Name shown in the report */
+    int (*setup)(BenchState* state);           /**< Prepares state, or NULL; returns -1 on failure */
+    void (*run)(BenchState* state);            /**< Performs the operation once */
+    long long (*written)(BenchState* state);   /**< Bytes written so far outside fwrite(), or NULL */
+} Benchmark;
+
+static unsigned long long allocations = 0;
+static unsigned long long bytesWritten = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+size_t __real_fwrite(const void* data, size_t size, size_t count, FILE* file);
+
+void* __wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size) {
+    allocations++;
+    return __real_realloc(pointer, size);
+}
+
+size_t __wrap_fwrite(const void* data, size_t size, size_t count, FILE* file) {
+    size_t written = __real_fwrite(data, size, count, file);
+    bytesWritten += written * size;
+    return written;
+}
+
+// Keeps the results of pure operations from being optimized away
+static volatile unsigned long long sink;
+
+static unsigned long long nextRandom(unsigned long long* state) {
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static double elapsedSeconds(const struct timespec* from, const struct timespec* to) {
+    return (double)(to->tv_sec - from->tv_sec) + (double)(to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+static long long fileSize(FILE* file) {
+    struct stat info;
+    fflush(file);
+    return fstat(fileno(file), &info) == 0 ? (long long)info.st_size : 0;
+}
+
+static void newGame(BenchState* state) {
+    initializeCharacter(&state->player, "Bench", (CharacterClass)(nextRandom(&state->rng) & 3));
+    freeGameHistory(&state->game);
+    initializeGameState(&state->game, &state->player, state->story);
+}
+
+/**
+ * @brief Takes a random available choice, starting over when the game cannot go on
+ */
+static void playTurn(BenchState* state) {
+    GameState* game = &state->game;
+    unsigned int available = getAvailableChoices(game);
+
+    if (isGameOver(game) || !available || game->choiceHistoryCount >= PLAYTHROUGH_TURN_LIMIT) {
+        SaveLog* saveLog = game->saveLog;
+        newGame(state);
+        game->saveLog = saveLog;
+        return;
+    }
+
+    int count = __builtin_popcount(available);
+    for (int pick = (int)(nextRandom(&state->rng) % (unsigned long long)count); pick > 0; pick--) {
+        available &= available - 1;
+    }
+    applyChoice(game, __builtin_ctz(available));
+}
+
+/* ---- Story construction ---- */
+
+static void runInitializeStory(BenchState* state) {
+    StoryBuilder builder;
+    initStoryBuilder(&builder);
+    sink = (unsigned long long)(size_t)initializeStory(&builder);
+    cleanupStory(&builder);
+    (void)state;
+}
+
+static void runCompileStory(BenchState* state) {
+    Story* story = compileBuiltinStory();
+    sink = story->imageSize;
+    closeStory(story);
+    (void)state;
+}
+
+/* ---- Chapter transitions ---- */
+
+/**
+ * @brief Finds the first chapter exit of the story; nothing else holds the next chapter
+ */
+static int setupChapterExit(BenchState* state) {
+    closeStory(state->heldChapter);
+    state->heldChapter = NULL;
+    newGame(state);
+    for (uint32_t n = 0; n < state->story->header->nodeCount; n++) {
+        if (state->story->nodes[n].nextChapter) {
+            state->node = (int)n;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Finds the first chapter exit and holds the chapter it leads into
+ */
+static int setupSharedChapter(BenchState* state) {
+    if (setupChapterExit(state) < 0) return -1;
+    state->heldChapter = openBuiltinChapter(state->story->nodes[state->node].nextChapter);
+    return state->heldChapter ? 0 : -1;
+}
+
+static void runEnterChapter(BenchState* state) {
+    state->game.currentScene = state->node;
+    sink = (unsigned long long)enterNextChapter(&state->game);
+    releaseGameChapter(&state->game);
+}
+
+/* ---- Requirement checks ---- */
+
+static void runHasRequiredStats(BenchState* state) {
+    const StoryRecord* node = &state->story->nodes[state->node];
+    unsigned int mask = 0;
+    for (uint32_t i = 0; i < node->numChoices; i++) {
+        const uint8_t* req = node->requirements[i];
+        if (hasRequiredStats(&state->player, req[0], req[1], req[2])) mask |= 1u << i;
+    }
+    sink = mask;
+    state->node = (state->node + 1) % (int)state->story->header->nodeCount;
+}
+
+static void runChoiceMask(BenchState* state) {
+    sink = getChoiceMask(&state->story->nodes[state->node], packStats(&state->player));
+    state->node = (state->node + 1) % (int)state->story->header->nodeCount;
+}
+
+static int setupConditions(BenchState* state) {
+    static const char* conditions[MAX_CHOICES] = {
+        "has rope && str + cha >= 12",
+        "!flag gate_alarm || trait Brave",
+        "class rogue || reputation >= 3",
+        "health > 50 && (int >= 4 || has lamp)",
+    };
+    StoryBuilder builder;
+    initStoryBuilder(&builder);
+
+    StoryNode* gate = createStoryNode(&builder, 1, "A gate.");
+    int failed = !gate;
+    for (int i = 0; !failed && i < MAX_CHOICES; i++) {
+        addChoice(&builder, gate, "Go", NULL, 0, 0, 0);
+        failed = setChoiceCondition(&builder, gate, i, conditions[i], NULL, 0) < 0;
+    }
+    closeStory(state->conditionStory);
+    state->conditionStory = failed ? NULL : compileStory(&builder, gate);
+    cleanupStory(&builder);
+    if (!state->conditionStory) return -1;
+
+    initializeCharacter(&state->player, "Bench", ROGUE);
+    freeGameHistory(&state->game);
+    initializeGameState(&state->game, &state->player, state->conditionStory);
+    return 0;
+}
+
+static void runConditions(BenchState* state) {
+    sink = getAvailableChoices(&state->game);
+}
+
+/* ---- Choice effects ---- */
+
+static int setupEffects(BenchState* state) {
+    // Every change is undone later in the list, so repeating it keeps the state steady
+    static const char* effects = "str +2, cha -1, give rope, set alarm, reputation +1, "
+                                 "take rope, clear alarm, str -2, cha +1, reputation -1";
+    StoryBuilder builder;
+    initStoryBuilder(&builder);
+
+    StoryNode* gate = createStoryNode(&builder, 1, "A gate.");
+    int failed = !gate;
+    if (!failed) {
+        addChoice(&builder, gate, "Go", gate, 0, 0, 0);
+        failed = setChoiceEffects(&builder, gate, 0, effects, NULL, 0) < 0;
+    }
+    closeStory(state->effectStory);
+    state->effectStory = failed ? NULL : compileStory(&builder, gate);
+    cleanupStory(&builder);
+    if (!state->effectStory) return -1;
+
+    // Resolved once, as linking resolves them for the interpreter
+    state->effectItem = findName(NAME_ITEM, "rope");
+    state->effectFlag = findName(NAME_FLAG, "alarm");
+    if (state->effectItem < 0 || state->effectFlag < 0) return -1;
+
+    initializeCharacter(&state->player, "Bench", WARRIOR);
+    freeGameHistory(&state->game);
+    initializeGameState(&state->game, &state->player, state->effectStory);
+    for (int i = 0; i < EFFECT_BATCH; i++) {
+        initializeCharacter(&state->batchPlayers[i], "Bench", (CharacterClass)(i & 3));
+        initializeGameState(&state->batchGames[i], &state->batchPlayers[i], state->effectStory);
+    }
+    return 0;
+}
+
+static void runEffects(BenchState* state) {
+    const Story* story = state->effectStory;
+    applyEffects(getChoiceEffects(story, &story->nodes[0], 0), &state->game);
+}
+
+static void runEffectBatch(BenchState* state) {
+    const Story* story = state->effectStory;
+    applyEffectBatch(getChoiceEffects(story, &story->nodes[0], 0), state->batchGames, EFFECT_BATCH);
+}
+
+/**
+ * @brief The same changes as setupEffects() through direct calls on resolved ids
+ */
+static void runDirectEffects(BenchState* state) {
+    GameState* game = &state->game;
+    Character* player = game->player;
+
+    updateCharacterStats(player, 2, 0, -1);
+    addItem(game, state->effectItem);
+    game->flags |= 1ull << state->effectFlag;
+    game->reputation += 1;
+    removeItem(game, state->effectItem);
+    game->flags &= ~(1ull << state->effectFlag);
+    updateCharacterStats(player, -2, 0, 1);
+    game->reputation -= 1;
+}
+
+/* ---- Rendering ---- */
+
+static int setupScreen(BenchState* state) {
+    newGame(state);
+    state->node = state->story->header->rootNode;
+    return 0;
+}
+
+static long long screenWritten(BenchState* state) {
+    return fileSize(state->screenFile);
+}
+
+static void runDisplayScene(BenchState* state) {
+    state->game.currentScene = state->node;
+    displayCurrentScene(&state->game);
+    state->node = (state->node + 1) % (int)state->story->header->nodeCount;
+}
+
+static void runRedisplayScene(BenchState* state) {
+    displayCurrentScene(&state->game);
+}
+
+/* ---- Saving and loading ---- */
+
+static int setupSave(BenchState* state) {
+    closeSaveLog(state->game.saveLog);
+    unlink(SAVE_GAME_FILE);
+    newGame(state);
+    return 0;
+}
+
+static void runSaveGame(BenchState* state) {
+    playTurn(state);
+    saveGame(&state->game);
+}
+
+static int setupLoad(BenchState* state) {
+    closeSaveLog(state->game.saveLog);
+    unlink(SAVE_GAME_FILE);
+    newGame(state);
+    for (int turn = 0; turn < SAVED_TURNS; turn++) {
+        playTurn(state);
+        if (saveGame(&state->game) < 0) return -1;
+    }
+    closeSaveLog(state->game.saveLog);
+    state->game.saveLog = NULL;
+    return 0;
+}
+
+static void runLoadGame(BenchState* state) {
+    GameState game;
+    Character player;
+    // loadGame() would start the display; read the same file it reads
+    sink = (unsigned long long)readSaveFile(SAVE_GAME_FILE, &game, &player, state->story);
+}
+
+/* ---- Snapshots ---- */
+
+static int setupSnapshots(BenchState* state) {
+    // The effect story loops on one node, so a game goes as deep as its history allows
+    if (setupEffects(state) < 0) return -1;
+    releaseSnapshot(state->snapshot);
+    state->snapshot = takeSnapshot(&state->game, NULL);
+    for (int turn = 0; turn < SAVED_TURNS && state->snapshot; turn++) {
+        applyChoice(&state->game, 0);
+        GameSnapshot* next = takeSnapshot(&state->game, state->snapshot);
+        releaseSnapshot(state->snapshot);
+        state->snapshot = next;
+    }
+    return state->snapshot ? 0 : -1;
+}
+
+static void runTakeSnapshot(BenchState* state) {
+    // The game is one turn past the snapshot before state->snapshot
+    releaseSnapshot(takeSnapshot(&state->game, getEarlierSnapshot(state->snapshot, 1)));
+}
+
+static void undoAndRedo(BenchState* state, int turns) {
+    GameSnapshot* earlier = getEarlierSnapshot(state->snapshot, turns);
+    restoreSnapshot(earlier, &state->game, state->snapshot);
+    restoreSnapshot(state->snapshot, &state->game, earlier);
+}
+
+static void runUndoTurn(BenchState* state) {
+    undoAndRedo(state, 1);
+}
+
+static void runUndoTurns(BenchState* state) {
+    undoAndRedo(state, UNDONE_TURNS);
+}
+
+/**
+ * @brief Restores without saying where the game is, which rewrites all of it
+ */
+static void runRestoreSnapshot(BenchState* state) {
+    restoreSnapshot(state->snapshot, &state->game, NULL);
+}
+
+static void runPreviewChoice(BenchState* state) {
+    ChoicePreview preview;
+    previewChoice(&state->game, state->snapshot, 0, &preview);
+    sink = (unsigned long long)preview.node;
+}
+
+/* ---- Playthroughs ---- */
+
+static void runPlaythrough(BenchState* state) {
+    newGame(state);
+    while (!isGameOver(&state->game) && getAvailableChoices(&state->game) &&
+           state->game.choiceHistoryCount < PLAYTHROUGH_TURN_LIMIT) {
+        playTurn(state);
+    }
+    sink = (unsigned long long)state->game.choiceHistoryCount;
+}
+
+static const Benchmark benchmarks[] = {
+    {"initializeStory", NULL, runInitializeStory, NULL},
+    {"compileBuiltinStory", NULL, runCompileStory, NULL},
+    {"enterNextChapter (cold)", setupChapterExit, runEnterChapter, NULL},
+    {"enterNextChapter (shared)", setupSharedChapter, runEnterChapter, NULL},
+    {"hasRequiredStats (node)", setupScreen, runHasRequiredStats, NULL},
+    {"getChoiceMask (node)", setupScreen, runChoiceMask, NULL},
+    {"getAvailableChoices (conds)", setupConditions, runConditions, NULL},
+    {"applyEffects", setupEffects, runEffects, NULL},
+    {"effects (direct calls)", setupEffects, runDirectEffects, NULL},
+    {"applyEffectBatch (64 games)", setupEffects, runEffectBatch, NULL},
+    {"displayCurrentScene", setupScreen, runDisplayScene, screenWritten},
+    {"displayCurrentScene (same)", setupScreen, runRedisplayScene, screenWritten},
+    {"saveGame (one turn)", setupSave, runSaveGame, NULL},
+    {"loadGame (64 turns)", setupLoad, runLoadGame, NULL},
+    {"takeSnapshot (one turn)", setupSnapshots, runTakeSnapshot, NULL},
+    {"undo and redo (1 turn)", setupSnapshots, runUndoTurn, NULL},
+    {"undo and redo (32 turns)", setupSnapshots, runUndoTurns, NULL},
+    {"restoreSnapshot (64 turns)", setupSnapshots, runRestoreSnapshot, NULL},
+    {"previewChoice (64 turns in)", setupSnapshots, runPreviewChoice, NULL},
+    {"playthrough", NULL, runPlaythrough, NULL},
+};
+
+/**
+ * @brief Runs one benchmark for at least the minimum time and prints its line
+ * @return 0 on success, -1 if its setup failed
+ */
+static int runBenchmark(const Benchmark* benchmark, BenchState* state, double minSeconds) {
+    if (benchmark->setup && benchmark->setup(state) < 0) return -1;
+
+    // Warm up, then double the batch until it runs long enough to time
+    benchmark->run(state);
+    long iterations = 1;
+    for (;;) {
+        long long writtenBefore = (long long)bytesWritten + (benchmark->written ? benchmark->written(state) : 0);
+        unsigned long long allocationsBefore = allocations;
+        struct timespec start, end;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (long i = 0; i < iterations; i++) {
+            benchmark->run(state);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double seconds = elapsedSeconds(&start, &end);
+        if (seconds < minSeconds && iterations < (1L << 40)) {
+            iterations *= seconds > minSeconds / 16 ? 2 : 8;
+            continue;
+        }
+
+        long long writtenAfter = (long long)bytesWritten + (benchmark->written ? benchmark->written(state) : 0);
+        double written = (double)(writtenAfter - writtenBefore);
+        printf("%-28s %12ld %12.1f %12.2f %12.1f\n", benchmark->name, iterations,
+               seconds * 1e9 / (double)iterations, (double)(allocations - allocationsBefore) / (double)iterations,
+               written / (double)iterations);
+        return 0;
+    }
+}
+
+/**
+ * @brief Opens an 80x24 terminal that writes to a scratch file instead of the screen
+ */
+static SCREEN* openScreen(BenchState* state, FILE** input) {
+    state->screenFile = tmpfile();
+    *input = fopen("/dev/null", "r");
+    if (!state->screenFile || !*input) return NULL;
+
+    setenv("LINES", TERMINAL_LINES, 1);
+    setenv("COLUMNS", TERMINAL_COLUMNS, 1);
+    SCREEN* screen = newterm("xterm", state->screenFile, *input);
+    if (!screen) return NULL;
+
+    set_term(screen);
+    if (has_colors()) {
+        initializeColors();
+    }
+    return screen;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-t min-seconds] [-f compiled-story] [name-filter]\n", program);
+}
+
+int main(int argc, char** argv) {
+    double minSeconds = DEFAULT_MIN_SECONDS;
+    const char* storyPath = NULL;
+    const char* filter = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            minSeconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            storyPath = argv[++i];
+        } else if (!filter && argv[i][0] != '-') {
+            filter = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    BenchState state;
+    memset(&state, 0, sizeof(state));
+    state.rng = 0x9E3779B97F4A7C15ULL;
+    state.story = storyPath ? openStoryFile(storyPath) : compileBuiltinStory();
+    if (!state.story) {
+        fprintf(stderr, "Failed to load the story.\n");
+        return 1;
+    }
+    newGame(&state);
+
+    // Saves go to savegame.dat in the working directory, so work in a scratch one
+    strcpy(state.directory, "/tmp/rpg-bench.XXXXXX");
+    if (!mkdtemp(state.directory) || chdir(state.directory) < 0) {
+        perror("bench");
+        return 1;
+    }
+
+    FILE* input = NULL;
+    SCREEN* screen = openScreen(&state, &input);
+    if (!screen) {
+        fprintf(stderr, "Failed to open an off-screen terminal.\n");
+        return 1;
+    }
+
+    printf("%-28s %12s %12s %12s %12s\n", "Benchmark", "Iterations", "ns/op", "allocs/op", "bytes/op");
+    int failures = 0;
+    for (size_t b = 0; b < sizeof(benchmarks) / sizeof(benchmarks[0]); b++) {
+        if (filter && !strstr(benchmarks[b].name, filter)) continue;
+        if (runBenchmark(&benchmarks[b], &state, minSeconds) < 0) {
+            fprintf(stderr, "%s: setup failed\n", benchmarks[b].name);
+            failures++;
+        }
+    }
+
+    endwin();
+    delscreen(screen);
+    fclose(state.screenFile);
+    fclose(input);
+    closeSaveLog(state.game.saveLog);
+    freeGameHistory(&state.game);
+    unlink(SAVE_GAME_FILE);
+    if (chdir("/") == 0) rmdir(state.directory);
+    releaseSnapshot(state.snapshot);
+    closeStory(state.heldChapter);
+    closeStory(state.conditionStory);
+    closeStory(state.effectStory);
+    closeStory(state.story);
+    return failures ? 1 : 0;
+}
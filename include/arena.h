@@ -0,0 +1,61 @@
+/**
+ * @file arena.h
+ * @brief Region allocator
+ * @details Objects are carved from large chunks by bumping a pointer and are
+ *          never freed individually; releasing the arena frees every object at
+ *          once. Chunks grow geometrically, so the number of underlying
+ *          allocations is logarithmic in the total size.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_DEFAULT_CHUNK_SIZE (64 * 1024)  /**< Size of the first chunk */
+#define ARENA_MAX_CHUNK_SIZE (16 * 1024 * 1024)  /**< Chunks stop doubling at this size */
+
+/**
+ * @struct ArenaChunk
+ * @brief One contiguous block of arena memory
+ */
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;    /**< Previously filled chunk */
+    size_t size;                /**< Usable bytes in data */
+    size_t used;                /**< Bytes handed out so far */
+    max_align_t data[];         /**< Object storage */
+} ArenaChunk;
+
+/**
+ * @struct Arena
+ * @brief Region allocator state
+ */
+typedef struct {
+    ArenaChunk* chunks;         /**< Current chunk, linked to older ones */
+    size_t nextChunkSize;       /**< Size of the next chunk to allocate */
+    size_t chunkCount;          /**< Number of chunks allocated */
+    size_t bytesUsed;           /**< Bytes handed out across all chunks */
+} Arena;
+
+/**
+ * @brief Initializes an empty arena; no memory is allocated until first use
+ * @param arena Pointer to the arena to initialize
+ * @param chunkSize Size of the first chunk, or 0 for ARENA_DEFAULT_CHUNK_SIZE
+ */
+void initArena(Arena* arena, size_t chunkSize);
+
+/**
+ * @brief Allocates memory from the arena
+ * @param arena Pointer to the arena
+ * @param size Number of bytes to allocate
+ * @return Pointer to memory aligned for any type, or NULL when out of memory
+ */
+void* arenaAlloc(Arena* arena, size_t size);
+
+/**
+ * @brief Frees every object allocated from the arena
+ * @param arena Pointer to the arena; it is left empty and can be reused
+ */
+void releaseArena(Arena* arena);
+
+#endif
@@ -7,8 +7,11 @@
 #ifndef CHARACTER_H
 #define CHARACTER_H
 
+#include <stdint.h>
+
 #define MAX_NAME_LENGTH 50
 #define MAX_TRAITS 3
+#define STAT_LIMIT 32767          /**< Largest magnitude choice effects take a stat to */
 
 /**
  * @enum CharacterClass
@@ -34,13 +37,27 @@ typedef struct {
     int health;                        /**< Current health points */
     char traits[MAX_TRAITS][MAX_NAME_LENGTH];  /**< Array of character traits */
     int traitCount;                    /**< Number of traits currently assigned */
+    uint64_t traitMask;                /**< Bit i set for each trait with trait id i */
 } Character;
 
 /**
- * @brief Creates a new character with default values
- * @return Pointer to the newly created character
+ * @brief Shows the character creation screen and asks for a name
+ */
+void displayNamePrompt(void);
+
+/**
+ * @brief Shows the class menu and asks for a class
+ * @param character Pointer to the character being created
  */
-Character* createCharacter(void);
+void displayClassMenu(const Character* character);
+
+/**
+ * @brief Initializes a character from parameters without any user interaction
+ * @param character Pointer to the character to initialize
+ * @param name The character's name
+ * @param characterClass The character's class, which sets the starting stats
+ */
+void initializeCharacter(Character* character, const char* name, CharacterClass characterClass);
 
 /**
  * @brief Displays the character's current statistics
@@ -60,9 +77,22 @@ void updateCharacterStats(Character* character, int str, int intel, int cha);
 /**
  * @brief Adds a new trait to the character
  * @param character Pointer to the character
- * @param trait The trait to add
+ * @param trait The trait to add; it is registered as a trait name
+ * @return 0 on success, -1 if the character already has the trait or
+ *         MAX_TRAITS traits, or the name cannot be registered
+ */
+int addTrait(Character* character, const char* trait);
+
+/**
+ * @brief Adds a trait that is already registered
+ * @param character Pointer to the character
+ * @param id Trait id from the name registry
+ * @return 0 on success, -1 if the character already has the trait or
+ *         MAX_TRAITS traits
+ * @details Takes no lock, so choice effects linked to trait ids use it on
+ *          every turn.
  */
-void addTrait(Character* character, const char* trait);
+int addTraitId(Character* character, int id);
 
 /**
  * @brief Checks if character meets required stat thresholds
@@ -0,0 +1,92 @@
+/**
+ * @file compact.h
+ * @brief Compact form of a game at rest
+ * @details A GameState, its Character and its choice history take three
+ *          allocations and most of a kilobyte, nearly all of it fixed-size
+ *          arrays a game rarely fills and history at an int per choice.
+ *          Between turns a game can be packed into one allocation of about a
+ *          hundred bytes: stats narrowed to 16 bits, items and traits kept
+ *          as registry ids, choices as two bits each after the name, the
+ *          scene as a node index and the name stored at its own length. A server packs each
+ *          session after its turn and unpacks it into a scratch state for
+ *          the next, so idle sessions cost only their compact form.
+ *
+ *          Packing is lossless: unpacking gives back the same game, story
+ *          references included, which pass to the compact form and back.
+ */
+
+#ifndef COMPACT_H
+#define COMPACT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "game.h"
+#include "condition.h"
+
+#define COMPACT_HISTORY_BLOCK 16  /**< Bytes the packed history grows by, 64 choices at two bits each */
+
+/**
+ * @struct CompactGame
+ * @brief A game and its character packed into one allocation
+ */
+typedef struct CompactGame {
+    struct Story* story;                    /**< Compiled chapter the game is in */
+    struct Story* startStory;               /**< Story the game started in */
+    struct SaveLog* saveLog;                /**< Save file written by saveGame, or NULL */
+    uint64_t flags;                         /**< Story flags, as in GameState */
+    int32_t currentScene;                   /**< Index of the current scene in story, or STORY_END */
+    uint32_t historyCount;                  /**< Number of choices in history */
+    int16_t stats[CONDITION_STATS];         /**< Stats in ConditionStat order, reputation included */
+    uint8_t currentChapter;                 /**< Current chapter number */
+    uint8_t characterClass;                 /**< CharacterClass of the player */
+    uint8_t isGameOver;                     /**< 1 once the game is over */
+    uint8_t itemCount;                      /**< Number of items held */
+    uint8_t traitCount;                     /**< Number of traits */
+    uint8_t items[MAX_INVENTORY_SIZE];      /**< Item ids held, in id order */
+    uint8_t traits[MAX_TRAITS];             /**< Trait ids, in the order they were gained */
+    char name[];                            /**< NUL-terminated character name, followed by the history: zero-based
+                                                 choices, four to a byte from the low bits up, in whole
+                                                 COMPACT_HISTORY_BLOCKs */
+} CompactGame;
+
+/**
+ * @brief Packs a game and its character
+ * @param game Pointer to the game state; its player must be set
+ * @param packed Earlier packing of the same game to reuse, or NULL
+ * @return Pointer to the packed game, which may have moved from packed, or
+ *         NULL if the game has a stat outside plus or minus STAT_LIMIT, a
+ *         history entry that is not a choice, a trait missing from the
+ *         registry or a chapter above 255, or memory ran out; packed is
+ *         then unchanged
+ * @details Reusing packed only reallocates when the name changed length
+ *          or the history outgrew its last COMPACT_HISTORY_BLOCK, so packing
+ *          after every turn allocates once every 64 turns. The story
+ *          references the game holds pass to the packed form; the caller
+ *          must not also release them through game. Free the result with
+ *          free().
+ */
+CompactGame* packGame(const GameState* game, CompactGame* packed);
+
+/**
+ * @brief Unpacks a game and its character
+ * @param packed Pointer to the packed game
+ * @param game Receives the game state, with player pointing at player; the
+ *        history it holds, if any, is reused, so it must be initialized,
+ *        freed with freeGameHistory() or unpacked into before
+ * @param player Receives the character
+ * @return 0 on success, -1 if the history could not grow; game and player
+ *         are then unchanged
+ * @details The story references pass back to game; packed keeps pointing
+ *          at the same stories but should be repacked or freed rather than
+ *          unpacked again while game is in use.
+ */
+int unpackGame(const CompactGame* packed, GameState* game, Character* player);
+
+/**
+ * @brief Gets the number of bytes a packed game takes
+ * @param packed Pointer to the packed game
+ * @return Size of its allocation as requested from malloc
+ */
+size_t getCompactGameSize(const CompactGame* packed);
+
+#endif
@@ -0,0 +1,196 @@
+/**
+ * @file condition.h
+ * @brief Choice condition expressions
+ * @details A choice can carry a condition on top of its stat minimums: a
+ *          boolean expression over stats, the character's class and traits,
+ *          the items held and the story's flags, such as
+ *          @code
+ *          (str + cha >= 12 || has "Guard's Token") && !flag gate_alarm
+ *          @endcode
+ *
+ *          Grammar, loosest binding first; && and || evaluate both sides:
+ *          @code
+ *          or    := and { "||" and }
+ *          and   := cmp { "&&" cmp }
+ *          cmp   := sum [ (">=" | ">" | "<=" | "<" | "==" | "!=") sum ]
+ *          sum   := unary { ("+" | "-") unary }
+ *          unary := "!" unary | atom
+ *          atom  := number | "true" | "false" | "(" or ")"
+ *                 | "str" | "int" | "cha" | "health" | "reputation"
+ *                 | "class" ("warrior" | "scholar" | "diplomat" | "rogue")
+ *                 | ("has" | "trait" | "flag") name
+ *          name  := word of letters, digits and '_' | "quoted text"
+ *          @endcode
+ *
+ *          Expressions are compiled once, when the story is built, into
+ *          postfix bytecode: one opcode byte followed by at most two operand
+ *          bytes. Compiled images store item, trait and flag operands as
+ *          indices into the image's own name tables; loading an image
+ *          verifies its code and links those operands to registry ids, so
+ *          evaluation is a single pass over a few bytes with no lookups.
+ */
+
+#ifndef CONDITION_H
+#define CONDITION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "game.h"
+#include "names.h"
+#include "storyfile.h"
+
+#define CONDITION_STACK 16          /**< Deepest evaluation stack a condition may need */
+#define MAX_CONDITION_CODE 256      /**< Most bytecode one condition may compile to */
+#define MAX_CONDITION_TEXT 8192     /**< Enough for the text of any condition of MAX_CONDITION_CODE bytes */
+
+/**
+ * @enum ConditionOp
+ * @brief Bytecode instructions; operands follow the opcode byte
+ */
+typedef enum {
+    COND_END,           /**< Ends the condition; the value on the stack is its result */
+    COND_CONST,         /**< Pushes a constant: two bytes, little-endian, signed */
+    COND_STAT,          /**< Pushes a ConditionStat: one byte */
+    COND_CLASS,         /**< Pushes 1 if the character is of a CharacterClass: one byte */
+    COND_ITEM,          /**< Pushes 1 if the item is held: one byte item id */
+    COND_TRAIT,         /**< Pushes 1 if the character has the trait: one byte trait id */
+    COND_FLAG,          /**< Pushes 1 if the story flag is set: one byte flag id */
+    COND_ADD,           /**< Adds the top two values */
+    COND_SUB,           /**< Subtracts the top value from the one below it */
+    COND_LT,            /**< Compares the top two values, pushing 1 or 0 */
+    COND_LE,            /**< As COND_LT, for <= */
+    COND_GT,            /**< As COND_LT, for > */
+    COND_GE,            /**< As COND_LT, for >= */
+    COND_EQ,            /**< As COND_LT, for == */
+    COND_NE,            /**< As COND_LT, for != */
+    COND_AND,           /**< 1 if both top values are non-zero */
+    COND_OR,            /**< 1 if either top value is non-zero */
+    COND_NOT,           /**< 1 if the top value is zero */
+    CONDITION_OPS       /**< Number of opcodes */
+} ConditionOp;
+
+/**
+ * @enum ConditionStat
+ * @brief Numeric values a condition can read
+ */
+typedef enum {
+    STAT_STRENGTH,      /**< Character strength */
+    STAT_INTELLIGENCE,  /**< Character intelligence */
+    STAT_CHARISMA,      /**< Character charisma */
+    STAT_HEALTH,        /**< Character health */
+    STAT_REPUTATION,    /**< Game reputation */
+    CONDITION_STATS     /**< Number of stats */
+} ConditionStat;
+
+/**
+ * @struct ConditionContext
+ * @brief Everything a condition can read, gathered once per evaluation
+ */
+typedef struct {
+    int32_t stats[CONDITION_STATS];     /**< Values by ConditionStat */
+    int32_t characterClass;             /**< CharacterClass of the character */
+    uint64_t traits;                    /**< Trait mask of the character */
+    uint64_t flags;                     /**< Story flags of the game */
+    const uint64_t* inventory;          /**< Inventory bitset of the game */
+} ConditionContext;
+
+/**
+ * @brief Maps a name used in an expression to its operand
+ * @param context Pointer given to compileCondition()
+ * @param kind Kind of the name
+ * @param name NUL-terminated name
+ * @return Operand for the name, 0 to 255, or -1 if it cannot be used
+ */
+typedef int (*ConditionNameResolver)(void* context, NameKind kind, const char* name);
+
+/**
+ * @brief Compiles the text of a condition into bytecode
+ * @param expression NUL-terminated condition text
+ * @param resolve Maps each item, trait and flag name to its operand
+ * @param context Passed to resolve
+ * @param code Receives the bytecode, ending in COND_END
+ * @param capacity Size of code; MAX_CONDITION_CODE is always enough
+ * @param error Receives a message on failure, or NULL
+ * @param errorSize Size of error
+ * @return Number of bytes written, or -1 if the expression is malformed,
+ *         too large or uses a name resolve rejects
+ */
+int compileCondition(const char* expression, ConditionNameResolver resolve, void* context,
+                     uint8_t* code, size_t capacity, char* error, size_t errorSize);
+
+/**
+ * @brief Gets the stat minimums a condition amounts to, if that is all it checks
+ * @param code Bytecode of the condition
+ * @param minimums Receives the strength, intelligence and charisma minimums,
+ *        0 where a stat is not checked
+ * @return 1 if the condition is only a conjunction of "stat >= constant"
+ *         terms over strength, intelligence and charisma with constants from
+ *         0 to 255, 0 otherwise
+ * @details Such conditions are stored as the choice's requirement lanes
+ *          instead, where the vector check covers them for free.
+ */
+int getConditionMinimums(const uint8_t* code, int minimums[3]);
+
+/**
+ * @brief Verifies one condition of an image and links its name operands
+ * @param code Start of the condition; rewritten in place
+ * @param size Bytes available from code
+ * @param names Registry id of each image name, by kind and image index
+ * @param counts Number of image names of each kind
+ * @return Length of the condition in bytes, or -1 if it is malformed, could
+ *         overflow the stack, does not leave exactly one value or names an
+ *         index past counts
+ */
+int linkCondition(uint8_t* code, size_t size, const uint16_t* const names[NAME_KINDS], const uint32_t counts[NAME_KINDS]);
+
+/**
+ * @brief Gets the length of a verified condition
+ * @param code Start of the condition
+ * @return Length in bytes, including COND_END
+ */
+size_t getConditionLength(const uint8_t* code);
+
+/**
+ * @brief Writes a linked condition back as text
+ * @param code Bytecode linked to registry ids
+ * @param text Receives the NUL-terminated text; compiling it gives the same bytecode
+ * @param capacity Size of text; MAX_CONDITION_TEXT is always enough
+ * @return Length of the text, or -1 if it did not fit
+ */
+int formatCondition(const uint8_t* code, char* text, size_t capacity);
+
+/**
+ * @brief Gathers what conditions read from a game state
+ * @param context Receives the values
+ * @param game Pointer to the game state; its player must be set
+ */
+void loadConditionContext(ConditionContext* context, const GameState* game);
+
+/**
+ * @brief Evaluates one linked condition
+ * @param code Bytecode linked to registry ids
+ * @param context Values to evaluate against
+ * @return 1 if the condition holds, 0 otherwise
+ */
+int evaluateCondition(const uint8_t* code, const ConditionContext* context);
+
+/**
+ * @brief Evaluates the conditions of a node's choices
+ * @param story Pointer to the story holding the node
+ * @param node Pointer to the node record
+ * @param context Values to evaluate against
+ * @return Bitmask with bit i set when choice i has no condition or its
+ *         condition holds
+ */
+unsigned int getConditionMask(const Story* story, const StoryRecord* node, const ConditionContext* context);
+
+/**
+ * @brief Finds the condition of one choice
+ * @param story Pointer to the story holding the node
+ * @param node Pointer to the node record
+ * @param choice Zero-based index of the choice
+ * @return Linked bytecode of the condition, or NULL if the choice has none
+ */
+const uint8_t* getChoiceCondition(const Story* story, const StoryRecord* node, int choice);
+
+#endif
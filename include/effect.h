@@ -0,0 +1,129 @@
+/**
+ * @file effect.h
+ * @brief Choice effects
+ * @details A choice can carry effects that are applied when it is taken: a
+ *          comma-separated list such as
+ *          @code
+ *          str +2, health -10, give "Guard's Token", set gate_alarm, chapter 2 40
+ *          @endcode
+ *
+ *          Effects, applied left to right:
+ *          @code
+ *          str|int|cha|health|reputation (+|-)number   change a stat
+ *          give name / take name                       add or remove an item
+ *          trait name                                  add a character trait
+ *          set name / clear name                       set or clear a story flag
+ *          chapter number id                           continue at node id of a built-in chapter; last only
+ *          @endcode
+ *          Names are written as in conditions. Stat changes saturate at
+ *          plus or minus STAT_LIMIT.
+ *
+ *          Like conditions, effects are compiled into bytecode when the story
+ *          is built and linked to registry ids when it is loaded. Effect
+ *          opcodes start at EFFECT_BASE so one code section can hold both
+ *          kinds of program and a loader can tell them apart by their first
+ *          byte.
+ */
+
+#ifndef EFFECT_H
+#define EFFECT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "condition.h"
+
+#define EFFECT_BASE 0x40            /**< First effect opcode; condition opcodes are all below it */
+#define MAX_EFFECT_CODE 256         /**< Most bytecode one effect list may compile to */
+#define MAX_EFFECT_TEXT 4096        /**< Enough for the text of any effect list of MAX_EFFECT_CODE bytes */
+
+/**
+ * @enum EffectOp
+ * @brief Bytecode instructions; operands follow the opcode byte
+ */
+typedef enum {
+    EFFECT_END = 0,                 /**< Ends the effect list */
+    EFFECT_STAT = EFFECT_BASE,      /**< Adds to a ConditionStat: one byte stat, two bytes signed delta */
+    EFFECT_GIVE,                    /**< Adds an item if there is room: one byte item id */
+    EFFECT_TAKE,                    /**< Removes an item: one byte item id */
+    EFFECT_TRAIT,                   /**< Adds a trait if there is room: one byte trait id */
+    EFFECT_SET,                     /**< Sets a story flag: one byte flag id */
+    EFFECT_CLEAR,                   /**< Clears a story flag: one byte flag id */
+    EFFECT_CHAPTER,                 /**< Moves into a chapter: one byte chapter, two bytes node id; always last */
+    EFFECT_LIMIT                    /**< One past the last opcode */
+} EffectOp;
+
+/**
+ * @brief Compiles the text of an effect list into bytecode
+ * @param text NUL-terminated effect list
+ * @param resolve Maps each item, trait and flag name to its operand
+ * @param context Passed to resolve
+ * @param code Receives the bytecode, ending in EFFECT_END
+ * @param capacity Size of code; MAX_EFFECT_CODE is always enough
+ * @param error Receives a message on failure, or NULL
+ * @param errorSize Size of error
+ * @return Number of bytes written, or -1 if the list is empty, malformed or
+ *         too large, has effects after a chapter or uses a name resolve rejects
+ */
+int compileEffects(const char* text, ConditionNameResolver resolve, void* context,
+                   uint8_t* code, size_t capacity, char* error, size_t errorSize);
+
+/**
+ * @brief Verifies one effect list of an image and links its name operands
+ * @param code Start of the list; rewritten in place
+ * @param size Bytes available from code
+ * @param names Registry id of each image name, by kind and image index
+ * @param counts Number of image names of each kind
+ * @return Length of the list in bytes, or -1 if it is empty or malformed,
+ *         has effects after a chapter or names an index past counts
+ */
+int linkEffects(uint8_t* code, size_t size, const uint16_t* const names[NAME_KINDS], const uint32_t counts[NAME_KINDS]);
+
+/**
+ * @brief Gets the length of a verified effect list
+ * @param code Start of the list
+ * @return Length in bytes, including EFFECT_END
+ */
+size_t getEffectsLength(const uint8_t* code);
+
+/**
+ * @brief Writes a linked effect list back as text
+ * @param code Bytecode linked to registry ids
+ * @param text Receives the NUL-terminated text; compiling it gives the same bytecode
+ * @param capacity Size of text; MAX_EFFECT_TEXT is always enough
+ * @return Length of the text, or -1 if it did not fit
+ */
+int formatEffects(const uint8_t* code, char* text, size_t capacity);
+
+/**
+ * @brief Applies a linked effect list to a game
+ * @param code Bytecode linked to registry ids
+ * @param game Pointer to the game state; its player must be set
+ * @return 0 on success, -1 if a chapter effect could not enter its chapter,
+ *         in which case the game is over
+ * @details A chapter effect may release the story code belongs to, so
+ *          nothing reads code after it.
+ */
+int applyEffects(const uint8_t* code, GameState* game);
+
+/**
+ * @brief Applies one linked effect list to many games
+ * @param code Bytecode linked to registry ids
+ * @param games Array of game states; each player must be set
+ * @param count Number of games
+ * @return Number of games a chapter effect could not move, which are then over
+ * @details Each instruction is decoded once and applied to every game
+ *          before the next, so simulations that step a population through
+ *          the same choice pay for dispatch once rather than per game.
+ */
+size_t applyEffectBatch(const uint8_t* code, GameState* games, size_t count);
+
+/**
+ * @brief Finds the effects of one choice
+ * @param story Pointer to the story holding the node
+ * @param node Pointer to the node record
+ * @param choice Zero-based index of the choice
+ * @return Linked bytecode of the effects, or NULL if the choice has none
+ */
+const uint8_t* getChoiceEffects(const Story* story, const StoryRecord* node, int choice);
+
+#endif
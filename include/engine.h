@@ -0,0 +1,173 @@
+/**
+ * @file engine.h
+ * @brief Headless game engine
+ * @details Terminal-independent core of the game: game state setup, choice
+ *          availability and choice application. The ncurses front end is one
+ *          client of this API; simulations and tools are others.
+ *
+ *          applyChoice() only leaves the current chapter through a choice's
+ *          chapter effect: a choice that leads into the next one normally
+ *          stops at the chapter's exit node, which has no choices. Front ends
+ *          then call enterNextChapter() to load the next chapter, while tools
+ *          that study one compiled image treat the exit as the end of that
+ *          image.
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "game.h"
+#include "storyfile.h"
+
+#define PLAYTHROUGH_TURN_LIMIT 100  /**< Turns after which the headless tools cut a playthrough off, since stories can loop */
+
+/**
+ * @enum ChoiceResult
+ * @brief Outcome of applying a choice to a game state
+ */
+typedef enum {
+    CHOICE_APPLIED,     /**< The choice was taken and the scene advanced */
+    CHOICE_INVALID,     /**< The choice index is out of range for the scene */
+    CHOICE_LOCKED,      /**< The player does not meet the choice requirements */
+    CHOICE_GAME_OVER,   /**< There is no active scene to choose from */
+    CHOICE_NO_MEMORY    /**< The choice history could not grow; the game is unchanged */
+} ChoiceResult;
+
+/**
+ * @brief Initializes a game state in place without touching the terminal
+ * @param game Pointer to the game state to initialize
+ * @param player Pointer to the player character (not owned by the engine)
+ * @param story Pointer to the compiled story; the game starts at its root node
+ * @details The game starts with an empty history that owns no memory, so a
+ *          game state that was played before must be passed to
+ *          freeGameHistory() first.
+ */
+void initializeGameState(GameState* game, Character* player, Story* story);
+
+/**
+ * @brief Makes room in a game's choice history
+ * @param game Pointer to the game state
+ * @param count Number of choices the history must have room for
+ * @return 0 on success, -1 if memory ran out; the history is then unchanged
+ * @details The history grows by doubling, so recording a choice per turn
+ *          reallocates only a logarithmic number of times.
+ */
+int reserveChoiceHistory(GameState* game, int count);
+
+/**
+ * @brief Frees a game's choice history
+ * @param game Pointer to the game state; its history is left empty
+ */
+void freeGameHistory(GameState* game);
+
+/**
+ * @brief Lists the choices the player can currently take
+ * @param game Pointer to the current game state
+ * @return Bitmask with bit i set when choice i of the current scene is available
+ * @details A choice is available when the player meets its stat requirements
+ *          and its condition, if it has one, holds.
+ */
+unsigned int getAvailableChoices(const GameState* game);
+
+/**
+ * @brief Applies a choice to the game state
+ * @param game Pointer to the current game state
+ * @param choice Zero-based index of the choice in the current scene
+ * @return Result describing whether the choice was taken
+ * @details The choice is appended to the history, the game moves to the
+ *          choice's target and then applies the choice's effects, if it has
+ *          any; a chapter effect moves it on into that chapter. Every
+ *          applied choice is recorded, however long the game runs.
+ */
+ChoiceResult applyChoice(GameState* game, int choice);
+
+/**
+ * @brief Moves a game that reached a chapter exit into the next chapter
+ * @param game Pointer to the current game state
+ * @return 1 if the game moved into the next chapter, 0 if the current scene
+ *         is not a chapter exit, -1 if the chapter could not be loaded, in
+ *         which case the game is over
+ * @details The game holds a reference to the chapter it moves into and
+ *          releases the one it leaves, so a chapter is freed as soon as no
+ *          game is in it.
+ */
+int enterNextChapter(GameState* game);
+
+/**
+ * @brief Moves a game to a node of a chapter
+ * @param game Pointer to the current game state
+ * @param chapter Chapter number; the chapter of the game's start story is
+ *        used as is, any other is a built-in chapter
+ * @param id Authored identifier of the node
+ * @return 0 on success, -1 if the chapter could not be loaded or has no such
+ *         node; the game is then unchanged
+ */
+int enterChapter(GameState* game, int chapter, int id);
+
+/**
+ * @brief Releases the chapter a game moved into
+ * @param game Pointer to the game state
+ * @details Afterwards the game is back in its start story with no current
+ *          scene. Call before discarding or reinitializing a game that may
+ *          have left its first chapter.
+ */
+void releaseGameChapter(GameState* game);
+
+/**
+ * @brief Moves a game onto another version of the story it started in
+ * @param game Pointer to the current game state
+ * @param story Pointer to the other version, such as a newer compiled image
+ *        of the same chapter
+ * @return 0 if the game now uses story as its start story, -1 if story is
+ *         another chapter or lacks the node the game is in; the game is then
+ *         unchanged
+ * @details A game in its start chapter continues at the node with the same
+ *          authored id; a game in a later chapter only changes the start
+ *          story it goes back to. References are left to the caller.
+ */
+int switchStoryVersion(GameState* game, Story* story);
+
+/**
+ * @brief Fast-forwards through recorded choices without rendering
+ * @param game Pointer to the current game state
+ * @param choices One-based choices, as stored in choiceHistory
+ * @param count Number of choices to apply
+ * @return Number of choices applied; less than count if a choice was out of
+ *         range, locked by its requirements or made after the game ended
+ * @details Chapter exits are crossed as they are reached.
+ */
+int replayChoices(GameState* game, const int* choices, int count);
+
+/**
+ * @brief Adds an item to the player's inventory
+ * @param game Pointer to the current game state
+ * @param item Item id
+ * @return 1 if the item was added, 0 if it was already held, -1 if the
+ *         inventory holds MAX_INVENTORY_SIZE items
+ */
+int addItem(GameState* game, int item);
+
+/**
+ * @brief Removes an item from the player's inventory
+ * @param game Pointer to the current game state
+ * @param item Item id
+ * @return 1 if the item was removed, 0 if it was not held
+ */
+int removeItem(GameState* game, int item);
+
+/**
+ * @brief Checks whether the player holds an item
+ * @param game Pointer to the current game state
+ * @param item Item id
+ * @return 1 if the item is held, 0 otherwise
+ */
+int hasItem(const GameState* game, int item);
+
+/**
+ * @brief Checks whether the game has ended
+ * @param game Pointer to the current game state
+ * @return 1 if the game is over, 0 otherwise
+ */
+int isGameOver(const GameState* game);
+
+#endif
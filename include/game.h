@@ -7,12 +7,14 @@
 #ifndef GAME_H
 #define GAME_H
 
-#include <ncurses.h>
 #include "character.h"
+#include "names.h"
+#include "metrics.h"
 
-#define MAX_INVENTORY_SIZE 10
+#define MAX_INVENTORY_SIZE 10     /**< Most items the player can carry at once */
 #define MAX_CHOICE_TEXT 100
 #define MAX_CHOICES 4
+#define SAVE_GAME_FILE "savegame.dat"
 
 /**
  * @brief Color pair definitions for ncurses display
@@ -25,7 +27,37 @@
 #define COLOR_ERROR_PAIR 6    /**< Color pair for error messages */
 
 // Forward declarations
-struct StoryNode;
+struct Story;
+struct SaveLog;
+struct Session;
+struct SessionOutput;
+
+/**
+ * @struct RenderStats
+ * @brief Counters of what the display sent to the terminal
+ */
+typedef struct {
+    unsigned long frames;                 /**< Frames presented */
+    unsigned long inputs;                 /**< Player inputs answered */
+    unsigned long long bytes;             /**< Bytes written to the terminal by refresh(), including escape sequences */
+    unsigned long long maxInputBytes;     /**< Most bytes written to answer one input */
+    unsigned long layouts;                /**< Scene layouts wrapped for the terminal width */
+} RenderStats;
+
+/**
+ * @struct TurnMetrics
+ * @brief Timings and counters of the turn loop
+ */
+typedef struct {
+    LatencyHistogram render;              /**< Composing and presenting one frame */
+    LatencyHistogram inputToRender;       /**< From reading an input line to showing the first frame it produced */
+    LatencyHistogram save;                /**< One saveGame() call */
+    unsigned long long choicesEntered;    /**< Input lines read while a scene was shown */
+    unsigned long long turns;             /**< Choices applied */
+    unsigned long long invalidChoices;    /**< Choices that were not a listed number */
+    unsigned long long lockedChoices;     /**< Choices whose requirements the player did not meet */
+    unsigned long long saveFailures;      /**< saveGame() calls that failed */
+} TurnMetrics;
 
 /**
  * @struct GameState
@@ -33,21 +65,68 @@ struct StoryNode;
  */
 typedef struct GameState {
     Character* player;                    /**< Pointer to the player character */
-    struct StoryNode* currentScene;       /**< Current story scene */
+    struct Story* story;                  /**< Compiled chapter the game is in */
+    struct Story* startStory;             /**< Story the game started in; when story differs, the game holds a reference to it */
+    int currentScene;                     /**< Index of the current scene in story, or STORY_END */
     int currentChapter;                   /**< Current chapter number */
     int reputation;                       /**< Player's reputation score */
     int isGameOver;                       /**< Flag indicating if game is over */
-    char inventory[MAX_INVENTORY_SIZE][50];  /**< Player's inventory items */
+    uint64_t inventory[INVENTORY_WORDS];  /**< Bit i set while the player holds item id i */
     int inventoryCount;                   /**< Number of items in inventory */
-    int choiceHistory[100];              /**< History of player choices */
+    uint64_t flags;                       /**< Bit i set while the story flag with flag id i is set */
+    int* choiceHistory;                   /**< One-based choices in the order they were made, or NULL before the first; freed with freeGameHistory() */
     int choiceHistoryCount;              /**< Number of choices made */
+    int choiceHistoryCapacity;           /**< Number of choices choiceHistory has room for */
+    struct SaveLog* saveLog;             /**< Save file written by saveGame, or NULL before the first save */
 } GameState;
 
 /**
  * @brief Initializes a new game state
- * @return Pointer to the newly created game state
+ * @param storyPath Path of a compiled story file, or NULL to compile the built-in story
+ * @return Pointer to the newly created game state; its character is created
+ *         by starting a session on it
+ */
+GameState* initializeGame(const char* storyPath);
+
+/**
+ * @brief Starts composing a new frame on top of the one last shown
+ */
+void beginFrame(void);
+
+/**
+ * @brief Shows the composed frame
+ * @details The terminal is only sent the cells that differ from the last
+ *          frame, and the bytes written for them are counted in the render
+ *          statistics.
+ */
+void presentFrame(void);
+
+/**
+ * @brief Makes every frame repaint the whole screen, as a baseline for comparison
+ * @param enabled 1 to repaint every frame in full, 0 to send only changes
  */
-GameState* initializeGame(void);
+void setFullRedraw(int enabled);
+
+/**
+ * @brief Gets the rendering counters
+ * @return Pointer to the counters since the game started
+ */
+const RenderStats* getRenderStats(void);
+
+/**
+ * @brief Gets the turn loop metrics
+ * @return Pointer to the metrics since the game started; only read it from
+ *         the thread running the game
+ */
+const TurnMetrics* getTurnMetrics(void);
+
+/**
+ * @brief Writes the turn loop and rendering metrics in the text exposition format
+ * @param out Stream to write to
+ * @param context Unused; matches MetricsWriter
+ * @details Safe to call from any thread, so it can be given to startMetricsServer.
+ */
+void writeTurnMetrics(FILE* out, void* context);
 
 /**
  * @brief Displays the current scene to the player
@@ -56,16 +135,18 @@ GameState* initializeGame(void);
 void displayCurrentScene(GameState* game);
 
 /**
- * @brief Processes the player's choice in the current scene
- * @param game Pointer to the current game state
+ * @brief Shows the frames a session step produced
+ * @param session Pointer to the session
+ * @param output Frames to show, in order
  */
-void processPlayerChoice(GameState* game);
+void displayFrames(struct Session* session, const struct SessionOutput* output);
 
 /**
- * @brief Updates the game state based on player actions
- * @param game Pointer to the current game state
+ * @brief Reads one line of input from the player and feeds it to the session
+ * @param session Pointer to the session
+ * @param output Receives the frames to show
  */
-void updateGameState(GameState* game);
+void processPlayerInput(struct Session* session, struct SessionOutput* output);
 
 /**
  * @brief Cleans up and frees all game resources
@@ -74,30 +155,46 @@ void updateGameState(GameState* game);
 void cleanupGame(GameState* game);
 
 /**
- * @brief Saves the current game state to a file
+ * @brief Saves the current game state to SAVE_GAME_FILE
  * @param game Pointer to the game state to save
+ * @return 0 on success, -1 on failure
+ * @details Saves after the first only append what changed, so saving every
+ *          turn is cheap.
+ */
+int saveGame(GameState* game);
+
+/**
+ * @brief Loads the game saved in SAVE_GAME_FILE
+ * @param storyPath Path of a compiled story file, or NULL to compile the built-in story
+ * @return Pointer to the loaded game state, or NULL if there is no usable save
  */
-void saveGame(GameState* game);
+GameState* loadGame(const char* storyPath);
 
 /**
- * @brief Loads a saved game state from a file
- * @return Pointer to the loaded game state
+ * @brief Starts a game from a replay token
+ * @param storyPath Path of a compiled story file, or NULL to compile the built-in story
+ * @param token Token printed when an earlier game ended
+ * @return Pointer to the restored game state, or NULL if the token does not
+ *         replay in the story
  */
-GameState* loadGame(void);
+GameState* replayGame(const char* storyPath, const char* token);
 
 /**
- * @brief Adds an item to the player's inventory
+ * @brief Adds an item to the player's inventory by name
  * @param game Pointer to the current game state
- * @param item Name of the item to add
+ * @param item Name of the item to add; it is registered if no story named it
+ * @return 0 on success, -1 if the name is invalid, the item is already held
+ *         or the inventory is full
  */
-void addToInventory(GameState* game, const char* item);
+int addToInventory(GameState* game, const char* item);
 
 /**
- * @brief Removes an item from the player's inventory
+ * @brief Removes an item from the player's inventory by name
  * @param game Pointer to the current game state
  * @param item Name of the item to remove
+ * @return 0 on success, -1 if the player does not hold the item
  */
-void removeFromInventory(GameState* game, const char* item);
+int removeFromInventory(GameState* game, const char* item);
 
 /**
  * @brief Initializes color pairs for ncurses display
@@ -0,0 +1,123 @@
+/**
+ * @file layout.h
+ * @brief Word-wrapped scene layout
+ * @details Splits scene descriptions and choices into screen lines at word
+ *          boundaries, measuring UTF-8 text in display columns. Layouts are
+ *          built once per node and screen width and cached, so drawing a
+ *          scene copies ready-made lines straight out of the story image.
+ *          Changing the width, which only happens when the terminal is
+ *          resized, drops every cached layout.
+ */
+
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+#include "storyfile.h"
+
+#define LAYOUT_MIN_WIDTH 16     /**< Narrower widths are laid out at this width */
+#define CHOICE_INDENT 3         /**< Columns taken by a choice's "N. " number */
+
+/**
+ * @struct LayoutLine
+ * @brief One screen line of wrapped text
+ */
+typedef struct {
+    const char* text;           /**< Start of the line inside the story image; not NUL-terminated */
+    uint32_t length;            /**< Bytes in the line */
+} LayoutLine;
+
+/**
+ * @struct LabelPart
+ * @brief A span of a requirement label that is colored on its own
+ */
+typedef struct {
+    uint8_t start;              /**< Offset of the span in the label */
+    uint8_t length;             /**< Bytes in the span, or 0 if the label has no such span */
+} LabelPart;
+
+/**
+ * @struct ChoiceLayout
+ * @brief Wrapped lines of one choice
+ * @details The label does not depend on the player, so it is laid out once;
+ *          its parts let each stat and the condition be colored by whether
+ *          the player meets them when the scene is drawn.
+ */
+typedef struct {
+    uint16_t firstLine;         /**< Index of the choice's first line in the scene's lines */
+    uint16_t lineCount;         /**< Number of lines, including one for a wrapped requirement */
+    const char* requirement;    /**< "(Requires: ...)" label, or NULL if the choice is open to all */
+    uint16_t requirementRow;    /**< Line of the choice the label is drawn on */
+    uint16_t requirementColumn; /**< Column of the label relative to the choice text */
+    LabelPart stats[REQUIREMENT_LANES - 1]; /**< "STR 6" term of each required stat, in lane order */
+    LabelPart condition;        /**< "(If: ...)" part of the label */
+} ChoiceLayout;
+
+/**
+ * @struct SceneLayout
+ * @brief Wrapped lines of one node at one width
+ * @details The description's lines come first, followed by each choice's.
+ *          Choice lines are wrapped CHOICE_INDENT columns narrower than the
+ *          description so they fit after their "N. " number.
+ */
+typedef struct {
+    const LayoutLine* lines;            /**< Description lines, then choice lines */
+    uint16_t descriptionLines;          /**< Number of description lines */
+    uint16_t numChoices;                /**< Number of choices */
+    ChoiceLayout choices[MAX_CHOICES];  /**< Layout of each choice */
+} SceneLayout;
+
+/**
+ * @struct LayoutCache
+ * @brief Scene layouts of one story at the current width
+ */
+typedef struct {
+    const Story* story;         /**< Story the layouts belong to */
+    int width;                  /**< Columns the layouts are wrapped to */
+    SceneLayout** scenes;       /**< Layout of each node index, or NULL until first drawn */
+    Arena arena;                /**< Storage of the layouts and their lines */
+    unsigned long builds;       /**< Layouts built since the cache was created */
+} LayoutCache;
+
+/**
+ * @brief Initializes an empty layout cache
+ * @param cache Pointer to the cache to initialize
+ * @param story Pointer to the compiled story to lay out
+ * @param width Columns available for text
+ * @return 0 on success, -1 when out of memory
+ */
+int initLayoutCache(LayoutCache* cache, const Story* story, int width);
+
+/**
+ * @brief Changes the width layouts are wrapped to
+ * @param cache Pointer to the cache
+ * @param width Columns available for text
+ * @details Cached layouts are dropped only if the width actually changes.
+ */
+void setLayoutWidth(LayoutCache* cache, int width);
+
+/**
+ * @brief Gets the layout of a node, building it on first use
+ * @param cache Pointer to the cache
+ * @param node Index of the node
+ * @return Pointer to the layout, valid until the width changes, or NULL when out of memory
+ */
+const SceneLayout* getSceneLayout(LayoutCache* cache, int node);
+
+/**
+ * @brief Frees every layout and the cache's memory
+ * @param cache Pointer to the cache
+ */
+void freeLayoutCache(LayoutCache* cache);
+
+/**
+ * @brief Measures UTF-8 text in display columns
+ * @param text Text to measure
+ * @param length Bytes of text to measure
+ * @return Columns the text takes on screen
+ */
+int textColumns(const char* text, size_t length);
+
+#endif
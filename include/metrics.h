@@ -0,0 +1,103 @@
+/**
+ * @file metrics.h
+ * @brief Latency histograms and a local metrics socket
+ * @details Histograms keep a fixed set of log-linear buckets in the style of
+ *          HdrHistogram: every power of two is split into
+ *          HISTOGRAM_SUB_BUCKETS equal buckets, so recording is a few integer
+ *          operations with no allocation and any percentile is reported
+ *          within about 6% of the true value. Metrics are written in the
+ *          Prometheus text exposition format, either to a stream or to every
+ *          client of a Unix domain socket served from a background thread.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define HISTOGRAM_SUB_BITS 4                                /**< log2 of the buckets per power of two */
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)     /**< Buckets per power of two */
+#define HISTOGRAM_MAGNITUDES 40                             /**< Values up to 2^40 ns (18 minutes) are told apart */
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAGNITUDES - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+/**
+ * @struct LatencyHistogram
+ * @brief Distribution of durations in nanoseconds
+ */
+typedef struct {
+    uint64_t counts[HISTOGRAM_BUCKETS];     /**< Values recorded in each bucket */
+    uint64_t count;                         /**< Values recorded */
+    uint64_t sum;                           /**< Sum of the values recorded */
+    uint64_t min;                           /**< Smallest value recorded, 0 while empty */
+    uint64_t max;                           /**< Largest value recorded */
+} LatencyHistogram;
+
+/**
+ * @brief Writes a snapshot of some metrics
+ * @param out Stream to write the exposition text to
+ * @param context Pointer given to startMetricsServer
+ */
+typedef void (*MetricsWriter)(FILE* out, void* context);
+
+typedef struct MetricsServer MetricsServer;
+
+/**
+ * @brief Reads the monotonic clock
+ * @return Nanoseconds since an arbitrary point, never 0
+ */
+uint64_t monotonicNanoseconds(void);
+
+/**
+ * @brief Records one duration
+ * @param histogram Pointer to a zero-initialized or previously used histogram
+ * @param nanoseconds Duration to record; longer than 2^40 ns counts in the last bucket
+ */
+void recordLatency(LatencyHistogram* histogram, uint64_t nanoseconds);
+
+/**
+ * @brief Gets a percentile of the recorded durations
+ * @param histogram Pointer to the histogram
+ * @param fraction Share of values at or below the result, 0.0 to 1.0
+ * @return Upper bound of the bucket holding the percentile, capped at the
+ *         largest value recorded, or 0 if nothing was recorded
+ */
+uint64_t getLatencyPercentile(const LatencyHistogram* histogram, double fraction);
+
+/**
+ * @brief Writes a histogram in the text exposition format
+ * @param out Stream to write to
+ * @param name Metric name; durations are exposed in seconds
+ * @param help One-line description of the metric
+ * @param histogram Pointer to the histogram
+ * @details Only buckets that hold values are listed, followed by +Inf.
+ */
+void writeHistogram(FILE* out, const char* name, const char* help, const LatencyHistogram* histogram);
+
+/**
+ * @brief Writes a counter in the text exposition format
+ * @param out Stream to write to
+ * @param name Metric name
+ * @param help One-line description of the metric
+ * @param value Current value
+ */
+void writeCounter(FILE* out, const char* name, const char* help, unsigned long long value);
+
+/**
+ * @brief Serves metrics on a Unix domain socket
+ * @param path Path of the socket; a stale socket left at the path is replaced
+ * @param writer Called from the server thread to write a snapshot for each client
+ * @param context Passed to writer
+ * @return Pointer to the running server, or NULL if the socket could not be created
+ * @details Each client that connects is sent one snapshot and disconnected,
+ *          so `nc -U path` prints the current values.
+ */
+MetricsServer* startMetricsServer(const char* path, MetricsWriter writer, void* context);
+
+/**
+ * @brief Stops a metrics server and removes its socket
+ * @param server Pointer to the server, or NULL
+ */
+void stopMetricsServer(MetricsServer* server);
+
+#endif
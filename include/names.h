@@ -0,0 +1,68 @@
+/**
+ * @file names.h
+ * @brief Process-wide registry of item, trait and flag ids
+ * @details Item, trait and story flag names are interned once per process
+ *          into small integer ids, normally while a compiled story is
+ *          loaded, so the game refers to them by id: an inventory is a bitset
+ *          indexed by item id, and a character's traits and a game's flags
+ *          are 64-bit masks. Ids are stable for the life of the process and
+ *          shared by every story and chapter; names are what gets written to
+ *          save files.
+ */
+
+#ifndef NAMES_H
+#define NAMES_H
+
+#include <stdint.h>
+
+#define MAX_ITEMS 256                   /**< Distinct item names one process can intern */
+#define MAX_TRAIT_IDS 64                /**< Distinct trait names; a trait mask has one bit per id */
+#define MAX_FLAGS 64                    /**< Distinct story flag names; a flag mask has one bit per id */
+#define MAX_REGISTERED_NAME 50          /**< Size of any registered name including its terminator */
+#define INVENTORY_WORDS (MAX_ITEMS / 64) /**< 64-bit words in an inventory bitset */
+
+/**
+ * @enum NameKind
+ * @brief Namespaces of the registry; each has its own ids
+ */
+typedef enum {
+    NAME_ITEM,          /**< Inventory items, up to MAX_ITEMS */
+    NAME_TRAIT,         /**< Character traits, up to MAX_TRAIT_IDS */
+    NAME_FLAG,          /**< Story flags, up to MAX_FLAGS */
+    NAME_KINDS          /**< Number of namespaces */
+} NameKind;
+
+/**
+ * @brief Gets the id of a name, registering it on first use
+ * @param kind Namespace of the name
+ * @param name NUL-terminated name, 1 to MAX_REGISTERED_NAME - 1 bytes
+ * @return Id, from 0, or -1 if the name is empty or too long or the
+ *         namespace is full
+ * @details Safe to call from any thread.
+ */
+int internName(NameKind kind, const char* name);
+
+/**
+ * @brief Looks up the id of a name without registering it
+ * @param kind Namespace of the name
+ * @param name NUL-terminated name
+ * @return Id, or -1 if no name of that kind matches
+ */
+int findName(NameKind kind, const char* name);
+
+/**
+ * @brief Gets a registered name
+ * @param kind Namespace of the name
+ * @param id Id returned by internName()
+ * @return NUL-terminated name, valid for the life of the process
+ */
+const char* getName(NameKind kind, int id);
+
+/**
+ * @brief Gets the number of names registered so far in a namespace
+ * @param kind Namespace
+ * @return Number of names; ids below it are valid
+ */
+int getNameCount(NameKind kind);
+
+#endif
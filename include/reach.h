@@ -0,0 +1,112 @@
+/**
+ * @file reach.h
+ * @brief Reachability index of story endings
+ * @details For every node and every ending reachable from it, the index holds
+ *          the Pareto frontier of stats needed to get there: the minimal
+ *          [strength, intelligence, charisma] vectors such that a character
+ *          meeting any one of them can follow some path of choices to the
+ *          ending. The index takes stats as fixed along a path, so a path is
+ *          open exactly when the character meets the lane-wise maximum of the
+ *          requirements along it, and "can this character still reach ending
+ *          X?" becomes a lookup instead of a search. Endings are the nodes
+ *          without choices, chapter exits among them, since the next chapter
+ *          is a separate story, plus STORY_END for choices that end the story.
+ *
+ *          The index is built at load time with one backward pass per ending.
+ *          Each pass starts from the ending and takes candidate points from
+ *          buckets ordered by the sum of their stats, cheapest first. A point
+ *          taken later can never be easier than one already settled, so each
+ *          point is settled once, never removed, and propagated once along
+ *          every choice into its node; going around a cycle only raises a
+ *          point, so cycles need no special handling. A pass walks all
+ *          3 * 255 + 1 buckets, and checking a candidate against a frontier
+ *          scans it, so a pass costs about the number of choices times the
+ *          square of the frontier size, which is bounded by the distinct
+ *          requirement values in use. The whole build costs that times the
+ *          number of endings.
+ *
+ *          Choice conditions and effects are not part of the model: the index
+ *          treats a conditioned choice as open whenever its stat requirements
+ *          are met and stats as fixed, so its frontiers are only exact for
+ *          stories that use neither.
+ */
+
+#ifndef REACH_H
+#define REACH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "requirements.h"
+
+/**
+ * @struct ReachEntry
+ * @brief Frontier of one ending as seen from one node
+ */
+typedef struct {
+    int32_t ending;             /**< Node index of the ending, or STORY_END for choices that end the story */
+    uint32_t first;             /**< Index of the frontier's first point in points */
+    uint32_t count;             /**< Number of points in the frontier */
+} ReachEntry;
+
+/**
+ * @struct ReachIndex
+ * @brief Frontiers of every (node, ending) pair with a path between them
+ */
+typedef struct ReachIndex {
+    const Story* story;         /**< Story the index was built for */
+    int* endings;               /**< Every ending, in ascending order */
+    int endingCount;            /**< Number of endings */
+    uint32_t* nodeEntries;      /**< Entries of node n are nodeEntries[n] to nodeEntries[n + 1] */
+    ReachEntry* entries;        /**< Entries grouped by node, each group sorted by ending */
+    size_t entryCount;          /**< Number of entries */
+    StatVector* points;         /**< Frontier points; the presence lane is always REQUIREMENT_PRESENT */
+    size_t pointCount;          /**< Number of points */
+} ReachIndex;
+
+/**
+ * @brief Builds the reachability index of a story
+ * @param story Pointer to the compiled story
+ * @return Pointer to the index, or NULL when out of memory
+ * @details Endings are the nodes without choices, chapter exits included,
+ *          plus STORY_END if any choice ends the story directly.
+ */
+ReachIndex* buildReachIndex(const Story* story);
+
+/**
+ * @brief Frees a reachability index
+ * @param index Pointer to the index, or NULL
+ */
+void freeReachIndex(ReachIndex* index);
+
+/**
+ * @brief Gets the stats needed to reach an ending from a node
+ * @param index Pointer to the index
+ * @param node Index of the starting node
+ * @param ending Ending as listed in index->endings
+ * @param count Receives the number of points
+ * @return The frontier's points, or NULL if no path leads from node to ending
+ */
+const StatVector* getReachFrontier(const ReachIndex* index, int node, int ending, uint32_t* count);
+
+/**
+ * @brief Checks whether a character can still reach an ending
+ * @param index Pointer to the index
+ * @param node Index of the character's current node
+ * @param ending Ending as listed in index->endings
+ * @param stats Packed stats of the character
+ * @return 1 if some path of choices the character can take leads to the ending, 0 otherwise
+ */
+int canReachEnding(const ReachIndex* index, int node, int ending, StatVector stats);
+
+/**
+ * @brief Lists the endings a character can still reach
+ * @param index Pointer to the index
+ * @param node Index of the character's current node
+ * @param stats Packed stats of the character
+ * @param endings Receives up to maxEndings endings in ascending order
+ * @param maxEndings Size of endings
+ * @return Number of reachable endings, which may exceed maxEndings
+ */
+int listReachableEndings(const ReachIndex* index, int node, StatVector stats, int* endings, int maxEndings);
+
+#endif
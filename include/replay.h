@@ -0,0 +1,95 @@
+/**
+ * @file replay.h
+ * @brief Replay saves
+ * @details A replay records only what the player typed: the character's name
+ *          and class and the choices made. Restoring creates the character
+ *          afresh and fast-forwards through the story with the headless
+ *          engine, checking every choice against its requirements, so the
+ *          result is the same game state the player left. A replay fits in a
+ *          printable token of about a character per three choices that can
+ *          be pasted into a bug report, however long the game ran.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "game.h"
+#include "storyfile.h"
+
+#define REPLAY_TOKEN_VERSION 2    /**< Bumped whenever the token encoding changes */
+
+/**
+ * @struct ReplayLog
+ * @brief Character creation inputs and choices of one playthrough
+ */
+typedef struct {
+    char name[MAX_NAME_LENGTH];             /**< Character name */
+    CharacterClass characterClass;          /**< Character class */
+    uint32_t storyTag;                      /**< Tag of the story the game started in */
+    int* choices;                           /**< One-based choices in the order they were made; freed with freeReplayLog() */
+    int choiceCount;                        /**< Number of recorded choices */
+} ReplayLog;
+
+/**
+ * @brief Computes a tag that tells compiled stories apart
+ * @param story Pointer to the compiled story
+ * @return Hash of the whole image, so stories that differ in any requirement,
+ *         edge, text or program get different tags
+ */
+uint32_t getStoryTag(const Story* story);
+
+/**
+ * @brief Records the replay of a game
+ * @param game Pointer to the game state to record
+ * @param log Pointer to the log to fill
+ * @return 0 on success, -1 if memory ran out
+ */
+int recordReplay(const GameState* game, ReplayLog* log);
+
+/**
+ * @brief Frees the choices of a replay
+ * @param log Pointer to a log filled by recordReplay() or parseReplayToken()
+ */
+void freeReplayLog(ReplayLog* log);
+
+/**
+ * @brief Restores a game by fast-forwarding through a replay
+ * @param log Pointer to the replay
+ * @param game Pointer to the game state to fill; any history it held is not freed
+ * @param player Pointer to the character to fill; game->player points at it
+ * @param story Pointer to the compiled story to replay in; later chapters
+ *        are loaded as the replay reaches them
+ * @return 0 on success, -1 if the replay was made in another story or one of
+ *         its choices is not available; game then holds no history or
+ *         chapter reference
+ */
+int restoreReplay(const ReplayLog* log, GameState* game, Character* player, Story* story);
+
+/**
+ * @brief Gets the buffer size a replay's token needs
+ * @param log Pointer to the replay
+ * @return Size of the token in bytes, including the NUL
+ */
+size_t getReplayTokenSize(const ReplayLog* log);
+
+/**
+ * @brief Encodes a replay as a printable token
+ * @param log Pointer to the replay
+ * @param token Buffer of at least getReplayTokenSize() bytes
+ * @param size Size of token in bytes
+ * @return Length of the token, or -1 if the buffer is too small
+ */
+int formatReplayToken(const ReplayLog* log, char* token, size_t size);
+
+/**
+ * @brief Decodes a token made by formatReplayToken()
+ * @param token NUL-terminated token
+ * @param log Pointer to the log to fill; free it with freeReplayLog() on success
+ * @return 0 on success, -1 if the token is malformed or from another version,
+ *         or memory ran out
+ */
+int parseReplayToken(const char* token, ReplayLog* log);
+
+#endif
@@ -0,0 +1,65 @@
+/**
+ * @file requirements.h
+ * @brief Vectorized choice requirement checks
+ * @details Stats and requirements are compared as byte vectors. A character's
+ *          stats pack into one StatVector, and the requirements of all four
+ *          choices of a node take 16 contiguous bytes, so one unsigned byte
+ *          compare against the broadcast stats yields every choice's
+ *          availability at once. The presence lane is REQUIREMENT_PRESENT for
+ *          the node's choices and REQUIREMENT_ABSENT for unused slots, which
+ *          makes unused slots fail without consulting numChoices; a character
+ *          with a negative stat packs a zero there and meets nothing, as the
+ *          scalar check would have it.
+ */
+
+#ifndef REQUIREMENTS_H
+#define REQUIREMENTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "character.h"
+#include "storyfile.h"
+
+/**
+ * @struct StatVector
+ * @brief Character stats in the lane order of a requirement
+ */
+typedef struct {
+    uint8_t lanes[REQUIREMENT_LANES];   /**< Strength, intelligence, charisma clamped to 0-255, and presence */
+} StatVector;
+
+/**
+ * @brief Packs a character's stats for requirement checks
+ * @param character Pointer to the character
+ * @return The character's stats as a vector
+ */
+StatVector packStats(const Character* character);
+
+/**
+ * @brief Compares every requirement lane of a node against one character
+ * @param node Pointer to the node record
+ * @param stats Packed stats of the character
+ * @return Bitmask with bit (choice * REQUIREMENT_LANES + lane) set when that
+ *         lane of that choice is met
+ */
+unsigned int compareRequirements(const StoryRecord* node, StatVector stats);
+
+/**
+ * @brief Lists the choices of a node a character meets the requirements of
+ * @param node Pointer to the node record
+ * @param stats Packed stats of the character
+ * @return Bitmask with bit i set when choice i is available
+ */
+unsigned int getChoiceMask(const StoryRecord* node, StatVector stats);
+
+/**
+ * @brief Lists the available choices of one node for many characters
+ * @param node Pointer to the node record
+ * @param stats Packed stats of each character
+ * @param count Number of characters
+ * @param masks Receives the getChoiceMask() result of each character
+ * @details Evaluates sixteen characters per step, four to a register.
+ */
+void getChoiceMasks(const StoryRecord* node, const StatVector* stats, size_t count, uint8_t* masks);
+
+#endif
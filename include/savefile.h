@@ -0,0 +1,85 @@
+/**
+ * @file savefile.h
+ * @brief Versioned, incremental save format
+ * @details A save file is a header followed by a log of records. The first
+ *          record is a checkpoint holding the whole game state; each later
+ *          record is a delta carrying only what changed since the previous
+ *          save: new choice history entries, inventory changes, character
+ *          changes, story flags and the current scene. Every value is written
+ *          little-endian at a fixed width and scenes are stored by their
+ *          authored node id, so a save contains no pointers and loads on any
+ *          build. Each record carries a checksum; a record torn by a crash
+ *          ends the log and the state up to the previous record is kept.
+ */
+
+#ifndef SAVEFILE_H
+#define SAVEFILE_H
+
+#include <stdio.h>
+#include "game.h"
+#include "storyfile.h"
+
+#define SAVE_FILE_MAGIC "RPGSAVE"     /**< First eight bytes of every save, including the NUL */
+#define SAVE_FILE_VERSION 4           /**< Bumped whenever the record encoding changes */
+#define SAVE_CHECKPOINT_INTERVAL 32   /**< Deltas appended before the file is rewritten as a checkpoint */
+
+/**
+ * @struct SaveLog
+ * @brief An open save file and the state it last recorded
+ */
+typedef struct SaveLog {
+    char* path;                 /**< Path of the save file */
+    FILE* file;                 /**< Save file opened for appending, or NULL before the first checkpoint */
+    int deltaCount;             /**< Deltas written since the last checkpoint */
+    GameState saved;            /**< Game state as of the last record, with its own copy of the history */
+    Character savedPlayer;      /**< Character as of the last record */
+} SaveLog;
+
+/**
+ * @brief Creates a save log for a file
+ * @param path Path of the save file; nothing is written until the first save
+ * @return Pointer to the new save log, or NULL on allocation failure
+ */
+SaveLog* openSaveLog(const char* path);
+
+/**
+ * @brief Records the game state, as a delta when possible
+ * @param log Pointer to the save log
+ * @param game Pointer to the game state to record
+ * @return 0 on success, -1 on failure
+ * @details The first save and every SAVE_CHECKPOINT_INTERVAL-th one rewrite
+ *          the file as a single checkpoint; the others append a delta and do
+ *          nothing at all if the state has not changed.
+ */
+int appendSave(SaveLog* log, const GameState* game);
+
+/**
+ * @brief Rewrites the save file as a single checkpoint of the game state
+ * @param log Pointer to the save log
+ * @param game Pointer to the game state to record
+ * @return 0 on success, -1 on failure
+ * @details The checkpoint is written beside the file and renamed over it, so
+ *          a crash leaves either the old save or the new one.
+ */
+int writeCheckpoint(SaveLog* log, const GameState* game);
+
+/**
+ * @brief Closes a save log
+ * @param log Pointer to the save log to close
+ */
+void closeSaveLog(SaveLog* log);
+
+/**
+ * @brief Restores a game state from a save file
+ * @param path Path of the save file
+ * @param game Pointer to the game state to fill; any history it held is not freed
+ * @param player Pointer to the character to fill; game->player points at it
+ * @param story Pointer to the compiled story the saved game started in; a
+ *        game saved in a later chapter is moved into that chapter
+ * @return 0 on success, -1 if the file is missing, from another version or
+ *         refers to scenes the story does not have; game then holds no
+ *         history or chapter reference
+ */
+int readSaveFile(const char* path, GameState* game, Character* player, Story* story);
+
+#endif
@@ -0,0 +1,150 @@
+/**
+ * @file session.h
+ * @brief Resumable player session
+ * @details Character creation and the turn loop as an explicit state
+ *          machine. A session is fed one line of player input at a time and
+ *          answers with the frames the front end should show; it never reads
+ *          input or waits itself. The ncurses game drives one session from
+ *          the terminal, the server drives thousands from one thread.
+ *
+ *          When a live story is set, a session checks for a newer version
+ *          after each turn and moves its game onto it, so the scene shown and
+ *          the choice made in it always come from the same version.
+ *
+ *          In a scene, "preview N" shows where choice N leads without taking
+ *          it. When rewinding is enabled, a session also snapshots its game
+ *          after every turn, and "undo" or "undo N" takes back the last
+ *          choice or the last N.
+ */
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "game.h"
+#include "storyfile.h"
+#include "telemetry.h"
+#include "snapshot.h"
+
+#define MAX_SESSION_FRAMES 3    /**< Most frames one input can produce */
+
+/**
+ * @enum SessionPhase
+ * @brief What a session expects its next input line to be
+ */
+typedef enum {
+    SESSION_NAME,       /**< Character name */
+    SESSION_CLASS,      /**< Character class, 1-4 */
+    SESSION_PLAYING,    /**< Choice in the current scene */
+    SESSION_OVER        /**< Nothing; the story ended or the player quit */
+} SessionPhase;
+
+/**
+ * @enum SessionFrame
+ * @brief Something the front end should show the player
+ */
+typedef enum {
+    FRAME_NAME_PROMPT,      /**< Ask for the character's name */
+    FRAME_CLASS_PROMPT,     /**< Ask for the character's class */
+    FRAME_CLASS_INVALID,    /**< The class entered is not 1-4 */
+    FRAME_CHARACTER,        /**< The newly created character */
+    FRAME_SCENE,            /**< The current scene and its choices */
+    FRAME_CHOICE_INVALID,   /**< The choice entered is out of range or could not be recorded */
+    FRAME_CHOICE_LOCKED,    /**< The player does not meet the choice requirements */
+    FRAME_PREVIEW,          /**< Where the previewed choice leads, from SessionOutput::preview */
+    FRAME_UNDO_INVALID,     /**< There are not that many turns to take back */
+    FRAME_ENDING,           /**< The story has ended */
+    FRAME_FAREWELL          /**< The player quit */
+} SessionFrame;
+
+/**
+ * @struct SessionOutput
+ * @brief Frames produced by one step of a session, in display order
+ */
+typedef struct SessionOutput {
+    SessionFrame frames[MAX_SESSION_FRAMES];  /**< Frames to show */
+    int count;                                /**< Number of frames */
+    int applied;                              /**< 1 if the step applied a story choice */
+    int updated;                              /**< 1 if the game moved onto a newer story version */
+    int rewound;                              /**< 1 if the step took back choices */
+    ChoicePreview preview;                    /**< Outcome of the previewed choice, set with FRAME_PREVIEW */
+} SessionOutput;
+
+/**
+ * @struct Session
+ * @brief State machine of one player; the game state itself is owned by the caller
+ */
+typedef struct Session {
+    SessionPhase phase;     /**< Expected input */
+    uint32_t id;            /**< Number of the session in this process, from 1 */
+    GameState* game;        /**< Game the session plays; game->player is its character */
+    unsigned storyVersion;  /**< Version of the live story last checked, 0 before the first check */
+    GameSnapshot* snapshot; /**< Snapshot of the game after its latest turn while rewinding is enabled, or NULL */
+} Session;
+
+/**
+ * @brief Starts a session at character creation
+ * @param session Pointer to the session to start
+ * @param game Pointer to the game state to play in
+ * @param player Pointer to the character to create
+ * @param story Pointer to the compiled story to play
+ * @param output Receives the first frames to show
+ */
+void startSession(Session* session, GameState* game, Character* player, Story* story, SessionOutput* output);
+
+/**
+ * @brief Resumes a session for a game that is already under way
+ * @param session Pointer to the session to resume
+ * @param game Pointer to a loaded or replayed game state
+ * @param output Receives the first frames to show
+ */
+void resumeSession(Session* session, GameState* game, SessionOutput* output);
+
+/**
+ * @brief Advances a session by one line of player input
+ * @param session Pointer to the session
+ * @param line Input line without its line terminator
+ * @param output Receives the frames to show
+ * @details The word "quit" ends the session in any phase.
+ */
+void feedSession(Session* session, const char* line, SessionOutput* output);
+
+/**
+ * @brief Releases what a session keeps besides its game
+ * @param session Pointer to the session
+ * @details Call once the session is done and before its game's stories are
+ *          closed; the game itself is left to the caller.
+ */
+void endSession(Session* session);
+
+/**
+ * @brief Records the choices applied by every session in a telemetry log
+ * @param log Pointer to the open log, or NULL to stop recording
+ */
+void setSessionTelemetry(TelemetryLog* log);
+
+/**
+ * @brief Lets every session follow the published version of a story
+ * @param live Pointer to the live story, or NULL to keep each game on the
+ *        version it started with
+ * @details Sessions started while a live story is set must be given a
+ *          reference acquired from it. The session's game then owns a
+ *          reference to its start story, trading it for a newer version
+ *          between turns; the caller releases game->startStory with
+ *          closeStory() once the session is done. A game whose node was
+ *          removed from the newer version stays on the version it holds.
+ */
+void setSessionStory(LiveStory* live);
+
+/**
+ * @brief Lets players of every session take back choices
+ * @param enabled 1 to snapshot each game after every turn, 0 to keep no
+ *        snapshots
+ * @details A snapshot shares everything the turn did not change with the
+ *          one before, so a turn costs a few dozen bytes more while the
+ *          session lasts. A turn made while rewinding is disabled cannot
+ *          be taken back, nor can any before it, and a session that moves
+ *          onto a newer story version can only undo the turns after that.
+ */
+void setSessionRewind(int enabled);
+
+#endif
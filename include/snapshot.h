@@ -0,0 +1,137 @@
+/**
+ * @file snapshot.h
+ * @brief Copy-on-write snapshots of a game
+ * @details A snapshot is an immutable record of a game and its character at
+ *          one point of a playthrough. Snapshots form a tree: each one is
+ *          taken after an earlier snapshot of the same game and keeps only
+ *          what differs from it. The choices made since the earlier snapshot
+ *          are stored in the new one, and the rest of the game is kept in
+ *          blocks that are shared with the earlier snapshot whenever they did
+ *          not change: the character's name and class in one, stats, items,
+ *          traits, flags and chapter in another. Taking a snapshot after a
+ *          turn costs one small allocation, two when the turn changed a stat
+ *          or an item, however long the game has run.
+ *
+ *          Restoring a snapshot into a game that is at another snapshot of
+ *          the same tree only rewrites the choice history between the two
+ *          and the blocks that differ, so undoing a turn, stepping back many
+ *          turns or trying a choice and going back costs no more than the
+ *          turns involved. Snapshots are reference counted and never change
+ *          once taken, so any number of branches can be forked from one of
+ *          them and snapshots can be shared between threads.
+ *
+ *          A snapshot holds references to the stories its game was in, which
+ *          stay loaded until the last snapshot in them is released.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "game.h"
+#include "engine.h"
+#include "condition.h"
+
+#define MAX_PREVIEW_TEXT 160    /**< Enough for the text of any ChoicePreview */
+
+/**
+ * @struct GameSnapshot
+ * @brief Immutable record of a game and its character; opaque
+ */
+typedef struct GameSnapshot GameSnapshot;
+
+/**
+ * @struct ChoicePreview
+ * @brief What a choice would lead to, as found by previewChoice()
+ */
+typedef struct ChoicePreview {
+    int choice;                         /**< Zero-based index of the choice previewed */
+    int chapter;                        /**< Chapter the choice leads into */
+    int node;                           /**< Authored id of the scene it leads to, or -1 if there is none */
+    int isGameOver;                     /**< 1 if the game would be over */
+    int statChanges[CONDITION_STATS];   /**< Change of each stat in ConditionStat order, reputation included */
+    int itemsGained;                    /**< Number of items the player would gain */
+    int itemsLost;                      /**< Number of items the player would lose */
+} ChoicePreview;
+
+/**
+ * @brief Takes a snapshot of a game
+ * @param game Pointer to the game state; its player must be set
+ * @param previous Earlier snapshot of the same playthrough to share with, or
+ *        NULL for a snapshot that stands alone
+ * @return Pointer to the new snapshot, or NULL if the game has a trait missing
+ *         from the registry, its history is shorter than that of previous, or
+ *         memory ran out; release it with releaseSnapshot()
+ * @details previous must be a snapshot the game went on from, so that its
+ *          choice history is the start of the game's. The new snapshot holds
+ *          a reference to previous, which the caller may then release.
+ */
+GameSnapshot* takeSnapshot(const GameState* game, GameSnapshot* previous);
+
+/**
+ * @brief Acquires another reference to a snapshot
+ * @param snapshot Pointer to the snapshot
+ * @return snapshot; release the new reference with releaseSnapshot()
+ */
+GameSnapshot* retainSnapshot(GameSnapshot* snapshot);
+
+/**
+ * @brief Releases a reference to a snapshot
+ * @param snapshot Pointer to the snapshot, or NULL
+ * @details A snapshot is freed with its last reference, and so are the
+ *          earlier snapshots only it was holding.
+ */
+void releaseSnapshot(GameSnapshot* snapshot);
+
+/**
+ * @brief Gets the snapshot a snapshot was taken after
+ * @param snapshot Pointer to the snapshot
+ * @param steps Number of snapshots to go back, 0 for snapshot itself
+ * @return The earlier snapshot, or NULL if the chain is shorter than steps;
+ *         the caller gets no reference of its own
+ * @details A game snapshotted after every turn goes back steps turns.
+ */
+GameSnapshot* getEarlierSnapshot(GameSnapshot* snapshot, int steps);
+
+/**
+ * @brief Puts a game back to a snapshot
+ * @param snapshot Pointer to the snapshot to restore
+ * @param game Pointer to the game state to rewrite; its player is rewritten too
+ * @param current Snapshot the game is at now, or NULL if it is at none
+ * @return 0 on success, -1 if the snapshot was taken in another start story
+ *         or the history could not grow; the game is then unchanged
+ * @details With current set, only the history past the snapshots' common
+ *          ancestor and the parts of the game that differ between the two
+ *          are written, so the cost depends on how far apart they are rather
+ *          than on how long the game has run. current must match the game
+ *          exactly; a game changed since it was taken should be restored
+ *          with current NULL, which rewrites all of it. The game takes the
+ *          chapter reference it needs, as enterChapter() would. Its save log
+ *          is left alone.
+ */
+int restoreSnapshot(const GameSnapshot* snapshot, GameState* game, const GameSnapshot* current);
+
+/**
+ * @brief Finds out what a choice would lead to without keeping it
+ * @param game Pointer to the game state, which is at current
+ * @param current Snapshot the game is at now
+ * @param choice Zero-based index of the choice in the current scene
+ * @param preview Receives what the choice leads to when it can be taken
+ * @return Result of applying the choice
+ * @details The choice is applied, a chapter exit it reaches is crossed as
+ *          enterNextChapter() would, its outcome read and the game restored
+ *          from current, so the game is as it was on return. Only what the
+ *          choice changed is written back.
+ */
+ChoiceResult previewChoice(GameState* game, const GameSnapshot* current, int choice, ChoicePreview* preview);
+
+/**
+ * @brief Writes what a previewed choice changes as text
+ * @param preview Pointer to the preview
+ * @param game Pointer to the game it was made in
+ * @param text Receives the NUL-terminated text, such as "str +2, gains 1 item"
+ * @param capacity Size of text; MAX_PREVIEW_TEXT is always enough
+ * @return Length of the text, or -1 if it did not fit
+ */
+int formatChoicePreview(const ChoicePreview* preview, const GameState* game, char* text, size_t capacity);
+
+#endif
@@ -8,79 +8,197 @@
 #define STORY_H
 
 #include "game.h"
+#include "arena.h"
+#include "textpool.h"
 
-#define MAX_DESCRIPTION_LENGTH 1000
-#define MAX_CHOICE_TEXT 100
 #define MAX_CHOICES 4
+#define STORY_CHAPTERS 3    /**< Number of built-in chapters */
+#define NO_CONDITION UINT32_MAX     /**< Code offset of a choice without a condition or effects */
+#define MAX_REQUIREMENT 255         /**< Highest stat requirement a choice can have */
 
 /**
  * @struct StoryNode
  * @brief Represents a single node in the branching story structure
+ * @details Fields read during traversal and requirement checks come first and
+ *          fill one 64-byte cache line; text lives in the builder's pool.
  */
 typedef struct StoryNode {
     int id;                                /**< Unique identifier for the node */
-    char description[MAX_DESCRIPTION_LENGTH];  /**< Main story text for this node */
-    char choices[MAX_CHOICES][MAX_CHOICE_TEXT];  /**< Available choices at this node */
     int numChoices;                        /**< Number of available choices */
     struct StoryNode* nextNodes[MAX_CHOICES];  /**< Next story nodes for each choice */
-    int requirements[MAX_CHOICES][3];      /**< Stat requirements for each choice [strength, intelligence, charisma] */
-    void (*consequence)(GameState*);       /**< Function pointer for node-specific effects */
+    int16_t requirements[MAX_CHOICES][3];  /**< Stat requirements for each choice [strength, intelligence, charisma] */
+    TextSpan description;                  /**< Main story text for this node */
+    TextSpan choices[MAX_CHOICES];         /**< Available choices at this node */
+    int nextChapter;                       /**< Chapter entered on reaching this node, or 0 */
+    uint32_t conditions[MAX_CHOICES];      /**< Offset of each choice's condition in the builder's code, or NO_CONDITION */
+    uint32_t effects[MAX_CHOICES];         /**< Offset of each choice's effects in the builder's code, or NO_CONDITION */
 } StoryNode;
 
+/**
+ * @struct StoryBuilder
+ * @brief Storage for an authored story graph
+ */
+typedef struct {
+    Arena nodes;                /**< Arena every node is allocated from */
+    TextPool text;              /**< Interned descriptions and choice texts */
+    int chapter;                /**< Chapter number recorded in compiled images, 1 by default */
+    TextSpan names[NAME_KINDS][MAX_ITEMS];  /**< Item, trait and flag names the chapter uses, by kind and index */
+    int nameCount[NAME_KINDS];  /**< Number of names of each kind */
+    uint8_t* code;              /**< Compiled choice conditions and effects; operands are name indices */
+    size_t codeSize;            /**< Bytes of code used */
+    size_t codeCapacity;        /**< Bytes allocated for code */
+} StoryBuilder;
+
+/**
+ * @brief Initializes an empty story builder
+ * @param builder Pointer to the builder to initialize
+ */
+void initStoryBuilder(StoryBuilder* builder);
+
+/**
+ * @brief Gets the text behind a span of a builder's pool
+ * @param builder Pointer to the builder the span was interned in
+ * @param span Location of the text
+ * @return NUL-terminated text
+ */
+const char* getStoryText(const StoryBuilder* builder, TextSpan span);
+
 /**
  * @brief Creates a new story node
+ * @param builder Builder the node and its text are stored in
  * @param id Unique identifier for the node
  * @param description Main story text for the node
  * @return Pointer to the newly created story node
  */
-StoryNode* createStoryNode(int id, const char* description);
+StoryNode* createStoryNode(StoryBuilder* builder, int id, const char* description);
+
+/**
+ * @brief Creates a node that leads into another chapter
+ * @param builder Builder the node is stored in
+ * @param chapter Chapter the node leads into
+ * @param id Identifier of the node the chapter is entered at
+ * @return Pointer to the new node; it has no choices of its own
+ * @details The other chapter is only built once a player reaches the node,
+ *          so a chapter's builder never needs the nodes of the next one.
+ */
+StoryNode* createChapterExit(StoryBuilder* builder, int chapter, int id);
+
+/**
+ * @brief Declares an item, trait or flag name the story uses
+ * @param builder Builder the name is stored in
+ * @param kind Kind of the name
+ * @param name Name, 1 to MAX_REGISTERED_NAME - 1 bytes
+ * @return Index of the name among the story's names of its kind, the same
+ *         for a name declared twice, or -1 if the name is invalid or the
+ *         story already has as many names of the kind as the registry holds
+ * @details Compiled images list their names; the names are interned to
+ *          process-wide ids when the image is loaded.
+ */
+int addStoryName(StoryBuilder* builder, NameKind kind, const char* name);
 
 /**
  * @brief Adds a choice to a story node
+ * @param builder Builder the choice text is stored in
  * @param node Pointer to the story node
  * @param choiceText Text describing the choice
  * @param nextNode Pointer to the next story node for this choice
  * @param reqStr Required strength for this choice
  * @param reqInt Required intelligence for this choice
  * @param reqCha Required charisma for this choice
+ * @return 0 on success, -1 if a requirement is outside 0 to MAX_REQUIREMENT,
+ *         the node already has MAX_CHOICES choices or the text pool is full;
+ *         the node is then unchanged
  */
-void addChoice(StoryNode* node, const char* choiceText, StoryNode* nextNode, int reqStr, int reqInt, int reqCha);
+int addChoice(StoryBuilder* builder, StoryNode* node, const char* choiceText, StoryNode* nextNode, int reqStr, int reqInt, int reqCha);
 
 /**
- * @brief Displays available choices for the current story node
- * @param node Pointer to the current story node
- * @param game Pointer to the current game state
+ * @brief Sets the condition a choice is only available under
+ * @param builder Builder the condition is compiled into
+ * @param node Pointer to the story node
+ * @param choice Zero-based index of an existing choice
+ * @param expression Condition text, as described in condition.h
+ * @param error Receives a message on failure, or NULL
+ * @param errorSize Size of error
+ * @return 0 on success, -1 if the choice does not exist, already has a
+ *         condition or the expression does not compile
+ * @details Names the expression uses are declared in the builder. A
+ *          condition that only sets stat minimums is merged into the
+ *          choice's requirements instead, where checking it costs nothing.
  */
-void displayChoices(const StoryNode* node, const GameState* game);
+int setChoiceCondition(StoryBuilder* builder, StoryNode* node, int choice, const char* expression, char* error, size_t errorSize);
 
 /**
- * @brief Initializes the complete story structure
+ * @brief Sets the effects a choice applies when it is taken
+ * @param builder Builder the effects are compiled into
+ * @param node Pointer to the story node
+ * @param choice Zero-based index of an existing choice
+ * @param effects Effect list, as described in effect.h
+ * @param error Receives a message on failure, or NULL
+ * @param errorSize Size of error
+ * @return 0 on success, -1 if the choice does not exist, already has
+ *         effects or the list does not compile
+ * @details Names the list uses are declared in the builder.
+ */
+int setChoiceEffects(StoryBuilder* builder, StoryNode* node, int choice, const char* effects, char* error, size_t errorSize);
+
+/**
+ * @brief Initializes the story structure of the first chapter
+ * @param builder Builder every node of the chapter is stored in
  * @return Pointer to the root story node
+ * @details Later chapters are reached through chapter exits and built on
+ *          demand with createChapter().
+ */
+StoryNode* initializeStory(StoryBuilder* builder);
+
+/**
+ * @brief Creates the story content of one built-in chapter
+ * @param builder Builder the chapter's nodes are stored in; its chapter number is set
+ * @param chapter Chapter number, 1 to STORY_CHAPTERS
+ * @return Pointer to the first node of the chapter, or NULL if there is no such chapter
  */
-StoryNode* initializeStory(void);
+StoryNode* createChapter(StoryBuilder* builder, int chapter);
 
 /**
  * @brief Cleans up and frees all story resources
- * @param root Pointer to the root story node
+ * @param builder Builder the story was built in; every node is freed at once
  */
-void cleanupStory(StoryNode* root);
+void cleanupStory(StoryBuilder* builder);
 
 /**
  * @brief Creates the story content for chapter one
+ * @param builder Builder the chapter's nodes are stored in
  * @return Pointer to the first node of chapter one
  */
-extern StoryNode* createChapterOne(void);
+extern StoryNode* createChapterOne(StoryBuilder* builder);
 
 /**
  * @brief Creates the story content for chapter two
+ * @param builder Builder the chapter's nodes are stored in
  * @return Pointer to the first node of chapter two
  */
-extern StoryNode* createChapterTwo(void);
+extern StoryNode* createChapterTwo(StoryBuilder* builder);
 
 /**
  * @brief Creates the story content for chapter three
+ * @param builder Builder the chapter's nodes are stored in
  * @return Pointer to the first node of chapter three
  */
-extern StoryNode* createChapterThree(void);
+extern StoryNode* createChapterThree(StoryBuilder* builder);
+
+/**
+ * @brief Creates the side quests of the Lantern Ward
+ * @param builder Builder the quests' nodes are stored in
+ * @param ward Hub the quests start from; it gets one choice per quest
+ * @param council Node every finished quest leads to
+ */
+extern void createSideQuests(StoryBuilder* builder, StoryNode* ward, StoryNode* council);
+
+/**
+ * @brief Creates the Shadowmancer's tower and observatory
+ * @param builder Builder the path's nodes are stored in
+ * @param crownChamber Node the path's revelations lead to
+ * @return Pointer to the Shadowmancer's study, the first node of the path
+ */
+extern StoryNode* createShadowmancerPath(StoryBuilder* builder, StoryNode* crownChamber);
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,260 @@
+/**
+ * @file storyfile.h
+ * @brief Compiled story format
+ * @details A compiled story is a single position-independent image: a header,
+ *          a table of fixed-size node records, a table of text spans, the
+ *          bytecode of choice conditions and effects and a deduplicated pool
+ *          of NUL-terminated text. The same bytes are
+ *          produced in memory by compileStory() and stored on disk by
+ *          writeStoryFile(); openStoryFile() maps a file, validates it and
+ *          the game reads it in place without any parsing.
+ *
+ *          Each image holds one chapter. A node with a nextChapter leads into
+ *          another chapter: the built-in chapter of that number is compiled
+ *          on demand by openBuiltinChapter() and shared by every game in it
+ *          until the last one leaves, so only the chapters being played are
+ *          kept in memory.
+ *
+ *          Images are never modified once built and are reference counted.
+ *          A LiveStory publishes the current version
+ *          of a story that can be replaced while games are running: games
+ *          compare their version with the published one using a single
+ *          atomic load, and move to a newer one by node id between turns,
+ *          while a version is freed once the last game has left it.
+ */
+
+#ifndef STORYFILE_H
+#define STORYFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "story.h"
+#include "names.h"
+
+#define STORY_FILE_MAGIC "RPGSTORY"   /**< First eight bytes of every compiled story */
+#define STORY_FILE_VERSION 6          /**< Bumped whenever the layout changes */
+#define STORY_BYTE_ORDER 0x01020304u  /**< Written natively to detect foreign byte order */
+#define STORY_END (-1)                /**< Node index meaning the story has ended */
+#define REQUIREMENT_LANES 4           /**< Bytes per requirement: strength, intelligence, charisma, presence */
+#define REQUIREMENT_PRESENT 1         /**< Presence lane of a choice the node has */
+#define REQUIREMENT_ABSENT 0xFF       /**< Presence lane of an unused choice slot; no character meets it */
+
+/**
+ * @struct StoryFileHeader
+ * @brief Header at offset zero of a compiled story
+ */
+typedef struct {
+    char magic[8];              /**< STORY_FILE_MAGIC, not NUL-terminated */
+    uint32_t version;           /**< STORY_FILE_VERSION of the writer */
+    uint32_t byteOrder;         /**< STORY_BYTE_ORDER in the writer's byte order */
+    uint32_t fileSize;          /**< Total size of the image in bytes */
+    uint32_t nodeCount;         /**< Number of node records */
+    uint32_t textCount;         /**< Number of text spans */
+    uint32_t poolSize;          /**< Size of the text pool in bytes */
+    uint32_t nodesOffset;       /**< Offset of the node records */
+    uint32_t textsOffset;       /**< Offset of the text spans */
+    uint32_t poolOffset;        /**< Offset of the text pool */
+    int32_t rootNode;           /**< Index of the node the story starts at */
+    int32_t chapter;            /**< Chapter number of the image */
+    uint32_t nameCount[NAME_KINDS];     /**< Number of item, trait and flag names the image uses */
+    uint32_t nameText[NAME_KINDS];      /**< Span of the first name of each kind; name i uses span nameText[kind] + i */
+    uint32_t codeOffset;        /**< Offset of the condition and effect bytecode */
+    uint32_t codeSize;          /**< Size of the bytecode in bytes */
+} StoryFileHeader;
+
+/**
+ * @struct StoryRecord
+ * @brief Compiled story node; all references are indices into the image
+ */
+typedef struct {
+    int32_t id;                                 /**< Authored node identifier */
+    uint8_t numChoices;                         /**< Number of choices */
+    uint8_t conditioned;                        /**< Bit i set when choice i has a condition */
+    uint8_t effected;                           /**< Bit i set when choice i has effects */
+    uint8_t nextChapter;                        /**< Chapter the node leads into, or 0; its id then names the node entered there */
+    int32_t nextNodes[MAX_CHOICES];             /**< Node index for each choice, or STORY_END */
+    uint8_t requirements[MAX_CHOICES][REQUIREMENT_LANES];  /**< Stat requirements for each choice [strength, intelligence, charisma, presence] */
+    uint32_t text;                              /**< Span of the description; choice i uses span text + 1 + i */
+    uint32_t code;                              /**< Offset of the node's bytecode in the code section: its conditions, then its effects, each in choice order */
+} StoryRecord;
+
+/**
+ * @struct Story
+ * @brief Read-only view of a compiled story image
+ */
+typedef struct Story {
+    const StoryFileHeader* header;  /**< Image header */
+    const StoryRecord* nodes;       /**< Node records */
+    const TextSpan* texts;          /**< Text spans */
+    const char* pool;               /**< Text pool */
+    const uint16_t* names[NAME_KINDS];  /**< Registry id of each name of the image, by kind and image index */
+    const uint8_t* code;            /**< Condition and effect bytecode, copied from the image and linked to registry ids */
+    void* image;                    /**< Start of the image */
+    size_t imageSize;               /**< Size of the image in bytes */
+    uint32_t tag;                   /**< FNV-1a hash of the whole image, computed when it is loaded */
+    int mapped;                     /**< 1 if the image is a file mapping, 0 if heap memory */
+    int shared;                     /**< 1 if the image is a built-in chapter from openBuiltinChapter() */
+    atomic_int references;          /**< Holders of the image; it is freed when the last one closes it */
+} Story;
+
+/**
+ * @struct LiveStory
+ * @brief Published version of a story that can be replaced at run time
+ */
+typedef struct {
+    _Atomic(Story*) current;        /**< Latest version; the slot holds a reference to it */
+    atomic_uint version;            /**< Number of versions published, from 1 */
+    pthread_mutex_t lock;           /**< Orders publishing against taking a reference to current */
+} LiveStory;
+
+/**
+ * @brief Compiles an authored story graph into an in-memory image
+ * @param builder Builder holding the graph's nodes and text
+ * @param root Pointer to the node the story starts at
+ * @return Pointer to the compiled story, or NULL on failure
+ * @details Only nodes reachable from root are included, along with every
+ *          name declared in the builder and the conditions and effects of
+ *          their choices.
+ */
+Story* compileStory(const StoryBuilder* builder, const StoryNode* root);
+
+/**
+ * @brief Compiles the first built-in chapter into an in-memory image
+ * @return Pointer to the compiled story, or NULL on failure
+ */
+Story* compileBuiltinStory(void);
+
+/**
+ * @brief Compiles one built-in chapter into an in-memory image
+ * @param chapter Chapter number, 1 to STORY_CHAPTERS
+ * @return Pointer to the compiled chapter, or NULL if there is no such
+ *         chapter or compiling failed
+ */
+Story* compileBuiltinChapter(int chapter);
+
+/**
+ * @brief Gets a shared image of a built-in chapter
+ * @param chapter Chapter number, 1 to STORY_CHAPTERS
+ * @return Pointer to the chapter, or NULL if there is no such chapter or
+ *         compiling failed; release it with closeStory()
+ * @details The chapter is compiled on first use and kept while anyone holds
+ *          it; once the last holder closes it the image is freed. Safe to
+ *          call from any thread.
+ */
+Story* openBuiltinChapter(int chapter);
+
+/**
+ * @brief Writes a compiled story image to a file
+ * @param story Pointer to the compiled story
+ * @param path Destination file path
+ * @return 0 on success, -1 on failure
+ * @details The image is written next to path and renamed over it, so a
+ *          process that has the old file mapped keeps reading the old version.
+ */
+int writeStoryFile(const Story* story, const char* path);
+
+/**
+ * @brief Maps a compiled story file for in-place use
+ * @param path Path of the compiled story
+ * @return Pointer to the mapped story, or NULL if the file is missing or
+ *         invalid, its names do not fit in the registry or its bytecode is
+ *         malformed
+ * @details Opening costs O(nodes + spans): every record and text span is
+ *          checked against the image bounds, the bytecode is copied into a
+ *          private buffer and linked, and the whole image is hashed for its
+ *          tag. The text pool itself is read in place and not copied.
+ */
+Story* openStoryFile(const char* path);
+
+/**
+ * @brief Makes a private copy of a compiled story
+ * @param story Pointer to the story to copy
+ * @return Pointer to the copy, or NULL on failure; release it with closeStory()
+ * @details The copy's image is heap memory of its own. Until the copy is
+ *          shared, its holder may rewrite node records in place through
+ *          image, e.g. to try other requirement values, without affecting
+ *          the original or anyone reading it.
+ */
+Story* copyStory(const Story* story);
+
+/**
+ * @brief Adds a holder to a compiled story
+ * @param story Pointer to a story the caller already holds
+ * @return story; release the new reference with closeStory()
+ */
+Story* retainStory(Story* story);
+
+/**
+ * @brief Releases a reference to a compiled story
+ * @param story Pointer to the story to release, or NULL
+ * @details The image is unmapped or freed when its last holder releases it.
+ */
+void closeStory(Story* story);
+
+/**
+ * @brief Initializes a live story with its first version
+ * @param live Pointer to the live story
+ * @param story Pointer to the first version; the caller's reference passes to the slot
+ */
+void initLiveStory(LiveStory* live, Story* story);
+
+/**
+ * @brief Publishes a new version of a live story
+ * @param live Pointer to the live story
+ * @param story Pointer to the new version; the caller's reference passes to the slot
+ * @return Number of the version published
+ * @details Games keep the version they hold until they move off it; the
+ *          previous version is freed once the last of them has.
+ */
+unsigned publishStory(LiveStory* live, Story* story);
+
+/**
+ * @brief Gets the number of the published version of a live story
+ * @param live Pointer to the live story
+ * @return Version number, from 1
+ * @details A single atomic load: cheap enough to call every turn.
+ */
+unsigned getLiveStoryVersion(const LiveStory* live);
+
+/**
+ * @brief Takes a reference to the published version of a live story
+ * @param live Pointer to the live story
+ * @param version Receives the number of the version, or NULL
+ * @return Pointer to the latest version; release it with closeStory()
+ */
+Story* acquireLiveStory(LiveStory* live, unsigned* version);
+
+/**
+ * @brief Releases the published version and destroys a live story
+ * @param live Pointer to the live story
+ */
+void closeLiveStory(LiveStory* live);
+
+/**
+ * @brief Gets the description of a node
+ * @param story Pointer to the compiled story
+ * @param node Index of the node
+ * @return NUL-terminated description inside the image
+ */
+const char* getNodeDescription(const Story* story, int node);
+
+/**
+ * @brief Gets the text of a choice
+ * @param story Pointer to the compiled story
+ * @param node Index of the node
+ * @param choice Zero-based index of the choice
+ * @return NUL-terminated choice text inside the image
+ */
+const char* getChoiceText(const Story* story, int node, int choice);
+
+/**
+ * @brief Finds a node by its authored identifier
+ * @param story Pointer to the compiled story
+ * @param id Authored node identifier
+ * @return Index of the node, or STORY_END if no node has that identifier
+ */
+int findStoryNode(const Story* story, int id);
+
+#endif
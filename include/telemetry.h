@@ -0,0 +1,128 @@
+/**
+ * @file telemetry.h
+ * @brief Choice telemetry log
+ * @details Every applied choice can be recorded as a fixed-size event. Each
+ *          thread that records events gets its own single-producer ring
+ *          buffer; recording copies the event into the ring with no lock,
+ *          no allocation and no system call, and drops it if the ring is
+ *          full rather than wait. A background thread drains every ring
+ *          periodically and appends the events to a binary log file, so the
+ *          threads playing the game never wait for the disk.
+ *
+ *          The log file is a TELEMETRY_HEADER_SIZE-byte header (magic,
+ *          version and record size) followed by TELEMETRY_RECORD_SIZE-byte
+ *          records. Each record holds, little-endian: the timestamp (8 bytes),
+ *          the session (8 bytes, with a random id of the run in the high
+ *          half so sessions of different runs never share an id), the node
+ *          and next node ids (4 bytes each), the choice, class, flags and a
+ *          zero byte, health, strength, intelligence and charisma (2 bytes
+ *          each, signed).
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "game.h"
+
+#define TELEMETRY_FILE_MAGIC "RPGTLOG"    /**< First eight bytes of every log, including the NUL */
+#define TELEMETRY_FILE_VERSION 1          /**< Bumped whenever the record layout changes */
+#define TELEMETRY_HEADER_SIZE 16          /**< Magic, version and record size */
+#define TELEMETRY_RECORD_SIZE 36          /**< Bytes per encoded event */
+#define TELEMETRY_RING_EVENTS 16384       /**< Events each thread can buffer between flushes; a power of two */
+#define TELEMETRY_FLUSH_MS 50             /**< Interval between background flushes */
+
+#define TELEMETRY_FLAG_ENDING 0x01        /**< The choice led to the story's end or a node without choices other than a chapter exit */
+
+/**
+ * @struct ChoiceEvent
+ * @brief One applied choice
+ */
+typedef struct {
+    uint64_t timestamp;         /**< Nanoseconds since the Unix epoch; set when recorded */
+    uint32_t session;           /**< Session that made the choice */
+    int32_t node;               /**< Authored id of the node the choice was made in */
+    int32_t next;               /**< Authored id of the node it led to, or -1 if the story ended */
+    uint8_t choice;             /**< Zero-based choice index */
+    uint8_t characterClass;     /**< Class of the character */
+    uint8_t flags;              /**< TELEMETRY_FLAG_ENDING if the choice led to an ending */
+    int16_t health;             /**< Character health */
+    int16_t strength;           /**< Character strength */
+    int16_t intelligence;       /**< Character intelligence */
+    int16_t charisma;           /**< Character charisma */
+} ChoiceEvent;
+
+/**
+ * @struct TelemetryStats
+ * @brief Event counts of a telemetry log
+ */
+typedef struct {
+    uint64_t recorded;          /**< Events placed in a ring */
+    uint64_t dropped;           /**< Events dropped because their ring was full */
+    uint64_t written;           /**< Events written to the file */
+    int writeFailed;            /**< Set once a write to the file failed; later events are discarded */
+} TelemetryStats;
+
+typedef struct TelemetryLog TelemetryLog;
+
+/**
+ * @brief Opens a telemetry log and starts its flush thread
+ * @param path Path of the log; events are appended to an existing log
+ * @return Pointer to the log, or NULL if the file could not be opened, is
+ *         not a telemetry log of this version, or the thread could not start
+ */
+TelemetryLog* openTelemetryLog(const char* path);
+
+/**
+ * @brief Records one event from the calling thread
+ * @param log Pointer to the log
+ * @param event Event to record; its timestamp is filled in here
+ * @details The first event a thread records allocates its ring; after that
+ *          recording never allocates, locks or blocks.
+ */
+void recordChoiceEvent(TelemetryLog* log, ChoiceEvent* event);
+
+/**
+ * @brief Fills a choice event from the game state after a choice was applied
+ * @param event Event to fill; its session is left unchanged
+ * @param game Pointer to the game state after the choice
+ * @param node Authored id of the node the choice was made in, read before
+ *        the choice was applied, since a chapter effect may have moved the
+ *        game into another story since
+ * @param choice Zero-based index of the choice
+ */
+void describeChoice(ChoiceEvent* event, const GameState* game, int node, int choice);
+
+/**
+ * @brief Gets the event counts of a log
+ * @param log Pointer to the log
+ * @param stats Receives the counts
+ */
+void getTelemetryStats(TelemetryLog* log, TelemetryStats* stats);
+
+/**
+ * @brief Checks the header of a telemetry log
+ * @param header First bytes of the log
+ * @param size Number of bytes available at header
+ * @return 0 if the header is a log of this version, -1 otherwise
+ */
+int checkTelemetryHeader(const uint8_t* header, size_t size);
+
+/**
+ * @brief Decodes one record of a telemetry log
+ * @param record TELEMETRY_RECORD_SIZE bytes of a log
+ * @param event Receives the event; its session is the low half of the logged session
+ * @return The logged session including its run id, unique across runs
+ */
+uint64_t decodeChoiceEvent(const uint8_t* record, ChoiceEvent* event);
+
+/**
+ * @brief Writes every buffered event, stops the flush thread and closes the log
+ * @param log Pointer to the log, or NULL
+ * @return 0 if every recorded event was written, -1 if events were dropped or a write failed
+ * @details No thread may record events into the log once this is called.
+ */
+int closeTelemetryLog(TelemetryLog* log);
+
+#endif
@@ -0,0 +1,65 @@
+/**
+ * @file textpool.h
+ * @brief Interned text storage
+ * @details Strings are stored once each, NUL-terminated and packed back to back
+ *          in a single growable buffer, and referred to by offset and length.
+ *          Interning the same text twice returns the same span.
+ */
+
+#ifndef TEXTPOOL_H
+#define TEXTPOOL_H
+
+#include <stdint.h>
+
+/**
+ * @struct TextSpan
+ * @brief Location of one NUL-terminated string in a pool
+ */
+typedef struct {
+    uint32_t offset;            /**< Offset from the start of the pool */
+    uint32_t length;            /**< Length in bytes, excluding the terminator */
+} TextSpan;
+
+/**
+ * @struct TextPool
+ * @brief Deduplicating string pool
+ */
+typedef struct {
+    char* data;                 /**< Packed NUL-terminated strings */
+    uint32_t size;              /**< Bytes used in data */
+    uint32_t capacity;          /**< Bytes allocated for data */
+    TextSpan* slots;            /**< Open-addressing table of interned spans */
+    uint32_t slotMask;          /**< Table capacity minus one, or 0 before first use */
+    uint32_t count;             /**< Number of distinct strings */
+} TextPool;
+
+/**
+ * @brief Initializes an empty pool; no memory is allocated until first use
+ * @param pool Pointer to the pool to initialize
+ */
+void initTextPool(TextPool* pool);
+
+/**
+ * @brief Stores a string once and returns its location
+ * @param pool Pointer to the pool
+ * @param text NUL-terminated string to intern
+ * @param span Receives the location of the interned string
+ * @return 0 on success, -1 when out of memory
+ */
+int internText(TextPool* pool, const char* text, TextSpan* span);
+
+/**
+ * @brief Gets an interned string
+ * @param pool Pointer to the pool
+ * @param span Location returned by internText()
+ * @return NUL-terminated string inside the pool
+ */
+const char* getPoolText(const TextPool* pool, TextSpan span);
+
+/**
+ * @brief Frees the pool's memory
+ * @param pool Pointer to the pool; it is left empty and can be reused
+ */
+void freeTextPool(TextPool* pool);
+
+#endif
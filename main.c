@@ -5,17 +5,93 @@
 #include "include/game.h"
 #include "include/story.h"
 #include "include/character.h"
+#include "include/replay.h"
+#include "include/session.h"
+#include "include/metrics.h"
+#include "include/telemetry.h"
+
+static void printLatency(const char* label, const LatencyHistogram* histogram) {
+    printf("  %-16s %6llu samples, p50 %8.1f us, p90 %8.1f us, p99 %8.1f us, max %8.1f us\n", label,
+           (unsigned long long)histogram->count, getLatencyPercentile(histogram, 0.50) / 1e3,
+           getLatencyPercentile(histogram, 0.90) / 1e3, getLatencyPercentile(histogram, 0.99) / 1e3,
+           histogram->max / 1e3);
+}
+
+int main(int argc, char** argv) {
+    const char* storyPath = NULL;
+    const char* replayToken = NULL;
+    const char* metricsPath = NULL;
+    const char* telemetryPath = NULL;
+    int resume = 0;
+    int showStats = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--story") == 0 && i + 1 < argc) {
+            storyPath = argv[++i];
+        } else if (strcmp(argv[i], "--continue") == 0) {
+            resume = 1;
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayToken = argv[++i];
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            showStats = 1;
+        } else if (strcmp(argv[i], "--full-redraw") == 0) {
+            setFullRedraw(1);
+        } else if (strcmp(argv[i], "--metrics-socket") == 0 && i + 1 < argc) {
+            metricsPath = argv[++i];
+        } else if (strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc) {
+            telemetryPath = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--story compiled-story-file] [--continue | --replay token] "
+                            "[--stats] [--full-redraw] [--metrics-socket path] [--telemetry log]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Metrics are served before the display starts so a failure can still be reported
+    MetricsServer* metricsServer = NULL;
+    if (metricsPath) {
+        metricsServer = startMetricsServer(metricsPath, writeTurnMetrics, NULL);
+        if (!metricsServer) {
+            fprintf(stderr, "Could not serve metrics on %s.\n", metricsPath);
+            return 1;
+        }
+    }
+
+    // Applied choices are recorded by the session and written by a background thread
+    TelemetryLog* telemetry = NULL;
+    if (telemetryPath) {
+        telemetry = openTelemetryLog(telemetryPath);
+        if (!telemetry) {
+            fprintf(stderr, "Could not open the telemetry log %s.\n", telemetryPath);
+            stopMetricsServer(metricsServer);
+            return 1;
+        }
+        setSessionTelemetry(telemetry);
+    }
 
-int main() {
     // Initialize game systems
-    GameState* game = initializeGame();
-    if (!game) {
-        fprintf(stderr, "Failed to initialize game. Exiting...\n");
-        return 1;
+    GameState* game;
+    if (replayToken) {
+        game = replayGame(storyPath, replayToken);
+        if (!game) {
+            fprintf(stderr, "The replay token does not match this story.\n");
+            closeTelemetryLog(telemetry);
+            stopMetricsServer(metricsServer);
+            return 1;
+        }
+    } else {
+        game = resume ? loadGame(storyPath) : initializeGame(storyPath);
+        if (!game) {
+            fprintf(stderr, resume ? "No usable saved game found in " SAVE_GAME_FILE ".\n"
+                                   : "Failed to initialize game. Exiting...\n");
+            closeTelemetryLog(telemetry);
+            stopMetricsServer(metricsServer);
+            return 1;
+        }
     }
 
     // Display welcome message
-    clear();
+    beginFrame();
     attron(COLOR_PAIR(COLOR_TITLE_PAIR) | A_BOLD);
     mvprintw(LINES/2 - 2, (COLS - 33)/2, "=================================");
     mvprintw(LINES/2 - 1, (COLS - 33)/2, "Welcome to The Chronicles of Destiny");
@@ -27,17 +103,88 @@ int main() {
     mvprintw(LINES/2 + 3, (COLS - 24)/2, "Press any key to begin...");
     attroff(COLOR_PAIR(COLOR_NORMAL_PAIR));
     
-    refresh();
+    presentFrame();
     getch();
 
+    // Every turn is snapshotted so the player can undo it
+    setSessionRewind(1);
+
+    // A new game starts at character creation, a loaded one at its scene
+    Session session;
+    SessionOutput output;
+    if (replayToken || resume) {
+        resumeSession(&session, game, &output);
+    } else {
+        startSession(&session, game, game->player, game->story, &output);
+    }
+    displayFrames(&session, &output);
+
     // Start the game loop
-    while (!game->isGameOver) {
-        displayCurrentScene(game);
-        processPlayerChoice(game);
-        updateGameState(game);
+    while (session.phase != SESSION_OVER) {
+        processPlayerInput(&session, &output);
+
+        // Autosave every turn; only what changed since the last save is written
+        int saveFailed = (output.applied || output.rewound) && saveGame(game) < 0;
+
+        displayFrames(&session, &output);
+        if (saveFailed) {
+            attron(COLOR_PAIR(COLOR_ERROR_PAIR));
+            mvprintw(LINES - 1, 1, "Could not save the game. Press any key to continue...");
+            attroff(COLOR_PAIR(COLOR_ERROR_PAIR));
+            presentFrame();
+            getch();
+        }
+    }
+
+    // The token reproduces this playthrough with --replay
+    ReplayLog log;
+    char* token = NULL;
+    if (game->choiceHistoryCount > 0 && recordReplay(game, &log) == 0) {
+        size_t size = getReplayTokenSize(&log);
+        token = (char*)malloc(size);
+        if (token && formatReplayToken(&log, token, size) < 0) {
+            free(token);
+            token = NULL;
+        }
+        freeReplayLog(&log);
     }
 
     // Clean up
+    setSessionTelemetry(NULL);
+    TelemetryStats telemetryStats = {0};
+    if (telemetry) getTelemetryStats(telemetry, &telemetryStats);
+    int telemetryFailed = closeTelemetryLog(telemetry) < 0;
+    stopMetricsServer(metricsServer);
+    endSession(&session);
     cleanupGame(game);
+    if (token) {
+        printf("Replay token: %s\n", token);
+        free(token);
+    }
+    if (showStats) {
+        const RenderStats* stats = getRenderStats();
+        printf("Rendering: %lu frames for %lu inputs, %llu bytes written "
+               "(%llu per input, max %llu), %lu scene layouts built\n",
+               stats->frames, stats->inputs, stats->bytes,
+               stats->inputs ? stats->bytes / stats->inputs : 0, stats->maxInputBytes, stats->layouts);
+
+        const TurnMetrics* metrics = getTurnMetrics();
+        printf("Latency:\n");
+        printLatency("render", &metrics->render);
+        printLatency("input to render", &metrics->inputToRender);
+        printLatency("save", &metrics->save);
+        unsigned long long rejected = metrics->invalidChoices + metrics->lockedChoices;
+        printf("Choices: %llu entered, %llu applied, %llu invalid and %llu locked (%.1f%% rejected), "
+               "%llu saves failed\n", metrics->choicesEntered, metrics->turns, metrics->invalidChoices,
+               metrics->lockedChoices, metrics->choicesEntered ? 100.0 * rejected / metrics->choicesEntered : 0.0,
+               metrics->saveFailures);
+        if (telemetryPath) {
+            printf("Telemetry: %llu choices recorded, %llu dropped\n",
+                   (unsigned long long)telemetryStats.recorded, (unsigned long long)telemetryStats.dropped);
+        }
+    }
+    if (telemetryFailed) {
+        fprintf(stderr, "Some telemetry events were dropped or could not be written to %s.\n", telemetryPath);
+    }
     return 0;
 } 
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include <stdlib.h>
+#include "../include/arena.h"
+
+#define ARENA_ALIGNMENT (sizeof(max_align_t))
+
+static size_t alignSize(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+void initArena(Arena* arena, size_t chunkSize) {
+    arena->chunks = NULL;
+    arena->nextChunkSize = chunkSize ? chunkSize : ARENA_DEFAULT_CHUNK_SIZE;
+    arena->chunkCount = 0;
+    arena->bytesUsed = 0;
+}
+
+void* arenaAlloc(Arena* arena, size_t size) {
+    ArenaChunk* chunk = arena->chunks;
+    size = alignSize(size ? size : 1);
+
+    if (!chunk || chunk->size - chunk->used < size) {
+        size_t chunkSize = arena->nextChunkSize;
+        while (chunkSize < size) chunkSize *= 2;
+
+        chunk = (ArenaChunk*)malloc(sizeof(ArenaChunk) + chunkSize);
+        if (!chunk) return NULL;
+
+        chunk->next = arena->chunks;
+        chunk->size = chunkSize;
+        chunk->used = 0;
+        arena->chunks = chunk;
+        arena->chunkCount++;
+        if (arena->nextChunkSize < ARENA_MAX_CHUNK_SIZE) {
+            arena->nextChunkSize *= 2;
+        }
+    }
+
+    void* memory = (char*)chunk->data + chunk->used;
+    chunk->used += size;
+    arena->bytesUsed += size;
+    return memory;
+}
+
+void releaseArena(Arena* arena) {
+    ArenaChunk* chunk = arena->chunks;
+    while (chunk) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->chunks = NULL;
+    arena->chunkCount = 0;
+    arena->bytesUsed = 0;
+}
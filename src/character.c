@@ -5,45 +5,10 @@
 #include "../include/character.h"
 #include "../include/game.h"
 
-Character* createCharacter(void) {
-    Character* character = (Character*)malloc(sizeof(Character));
-    if (!character) return NULL;
-
-    clear();
-    attron(COLOR_PAIR(COLOR_HEADER_PAIR) | A_BOLD);
-    mvprintw(1, 1, "=== Character Creation ===");
-    attroff(COLOR_PAIR(COLOR_HEADER_PAIR) | A_BOLD);
-    
-    // Get character name
-    attron(COLOR_PAIR(COLOR_NORMAL_PAIR));
-    mvprintw(3, 1, "Enter your character's name: ");
-    echo();
-    getnstr(character->name, MAX_NAME_LENGTH - 1);
-    noecho();
-    character->name[strcspn(character->name, "\n")] = 0;
-
-    // Choose character class
-    attron(COLOR_PAIR(COLOR_HEADER_PAIR));
-    mvprintw(5, 1, "Choose your class:");
-    attroff(COLOR_PAIR(COLOR_HEADER_PAIR));
-    
-    attron(COLOR_PAIR(COLOR_CHOICE_PAIR));
-    mvprintw(7, 1, "1. Warrior - Excels in combat and feats of strength");
-    mvprintw(8, 1, "2. Scholar - Masters of knowledge and magical arts");
-    mvprintw(9, 1, "3. Diplomat - Skilled in persuasion and leadership");
-    mvprintw(10, 1, "4. Rogue - Specializes in stealth and cunning");
-    attroff(COLOR_PAIR(COLOR_CHOICE_PAIR));
-    
-    int classChoice;
-    do {
-        mvprintw(12, 1, "Enter your choice (1-4): ");
-        refresh();
-        echo();
-        scanw("%d", &classChoice);
-        noecho();
-    } while (classChoice < 1 || classChoice > 4);
-
-    character->class = (CharacterClass)(classChoice - 1);
+void initializeCharacter(Character* character, const char* name, CharacterClass characterClass) {
+    strncpy(character->name, name, MAX_NAME_LENGTH - 1);
+    character->name[MAX_NAME_LENGTH - 1] = '\0';
+    character->class = characterClass;
 
     // Set initial stats based on class
     switch (character->class) {
@@ -71,21 +36,46 @@ Character* createCharacter(void) {
 
     character->health = 100;
     character->traitCount = 0;
+    character->traitMask = 0;
+}
 
-    // Display initial character sheet
-    displayCharacterStats(character);
-    
-    mvprintw(LINES - 1, 1, "Press any key to begin your adventure...");
-    refresh();
-    getch();
+void displayNamePrompt(void) {
+    beginFrame();
+    attron(COLOR_PAIR(COLOR_HEADER_PAIR) | A_BOLD);
+    mvprintw(1, 1, "=== Character Creation ===");
+    attroff(COLOR_PAIR(COLOR_HEADER_PAIR) | A_BOLD);
+
+    attron(COLOR_PAIR(COLOR_NORMAL_PAIR));
+    mvprintw(3, 1, "Enter your character's name: ");
+    attroff(COLOR_PAIR(COLOR_NORMAL_PAIR));
+    presentFrame();
+}
+
+void displayClassMenu(const Character* character) {
+    displayNamePrompt();
+    attron(COLOR_PAIR(COLOR_NORMAL_PAIR));
+    printw("%s", character->name);
+    attroff(COLOR_PAIR(COLOR_NORMAL_PAIR));
+
+    attron(COLOR_PAIR(COLOR_HEADER_PAIR));
+    mvprintw(5, 1, "Choose your class:");
+    attroff(COLOR_PAIR(COLOR_HEADER_PAIR));
     
-    return character;
+    attron(COLOR_PAIR(COLOR_CHOICE_PAIR));
+    mvprintw(7, 1, "1. Warrior - Excels in combat and feats of strength");
+    mvprintw(8, 1, "2. Scholar - Masters of knowledge and magical arts");
+    mvprintw(9, 1, "3. Diplomat - Skilled in persuasion and leadership");
+    mvprintw(10, 1, "4. Rogue - Specializes in stealth and cunning");
+    attroff(COLOR_PAIR(COLOR_CHOICE_PAIR));
+
+    mvprintw(12, 1, "Enter your choice (1-4): ");
+    presentFrame();
 }
 
 void displayCharacterStats(const Character* character) {
     const char* classNames[] = {"Warrior", "Scholar", "Diplomat", "Rogue"};
     
-    clear();
+    beginFrame();
     attron(COLOR_PAIR(COLOR_HEADER_PAIR) | A_BOLD);
     mvprintw(1, 1, "=== Character Sheet ===");
     attroff(COLOR_PAIR(COLOR_HEADER_PAIR) | A_BOLD);
@@ -111,7 +101,7 @@ void displayCharacterStats(const Character* character) {
         attroff(COLOR_PAIR(COLOR_CHOICE_PAIR));
     }
     
-    refresh();
+    presentFrame();
 }
 
 void updateCharacterStats(Character* character, int str, int intel, int cha) {
@@ -120,12 +110,19 @@ void updateCharacterStats(Character* character, int str, int intel, int cha) {
     character->charisma += cha;
 }
 
-void addTrait(Character* character, const char* trait) {
-    if (character->traitCount < MAX_TRAITS) {
-        strncpy(character->traits[character->traitCount], trait, MAX_NAME_LENGTH - 1);
-        character->traits[character->traitCount][MAX_NAME_LENGTH - 1] = '\0';
-        character->traitCount++;
-    }
+int addTrait(Character* character, const char* trait) {
+    int id = internName(NAME_TRAIT, trait);
+    return id < 0 ? -1 : addTraitId(character, id);
+}
+
+int addTraitId(Character* character, int id) {
+    if (character->traitCount >= MAX_TRAITS || (character->traitMask >> id) & 1) return -1;
+
+    strncpy(character->traits[character->traitCount], getName(NAME_TRAIT, id), MAX_NAME_LENGTH - 1);
+    character->traits[character->traitCount][MAX_NAME_LENGTH - 1] = '\0';
+    character->traitCount++;
+    character->traitMask |= 1ull << id;
+    return 0;
 }
 
 int hasRequiredStats(const Character* character, int reqStr, int reqInt, int reqCha) {
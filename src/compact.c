@@ -0,0 +1,135 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/compact.h"
+#include "../include/engine.h"
+#include "../include/names.h"
+
+_Static_assert(MAX_CHOICES <= 4, "a choice must fit in two bits of history");
+_Static_assert(MAX_ITEMS <= 256 && MAX_TRAIT_IDS <= 256, "item and trait ids must fit in a byte");
+
+static int fitsStat(int value) {
+    return value >= -STAT_LIMIT && value <= STAT_LIMIT;
+}
+
+/**
+ * @brief Gets the size of a packed game's allocation
+ */
+static size_t compactSize(size_t nameLength, uint32_t historyCount) {
+    size_t blocks = ((size_t)historyCount + COMPACT_HISTORY_BLOCK * 4 - 1) / (COMPACT_HISTORY_BLOCK * 4);
+    return offsetof(CompactGame, name) + nameLength + 1 + blocks * COMPACT_HISTORY_BLOCK;
+}
+
+CompactGame* packGame(const GameState* game, CompactGame* packed) {
+    const Character* player = game->player;
+    int stats[CONDITION_STATS] = {player->strength, player->intelligence, player->charisma,
+                                  player->health, game->reputation};
+
+    // Everything is checked before packed is touched, so a failure leaves it as it was
+    for (int i = 0; i < CONDITION_STATS; i++) {
+        if (!fitsStat(stats[i])) return NULL;
+    }
+    if (game->currentChapter < 0 || game->currentChapter > UINT8_MAX) return NULL;
+    if (game->choiceHistoryCount < 0) return NULL;
+    for (int i = 0; i < game->choiceHistoryCount; i++) {
+        if (game->choiceHistory[i] < 1 || game->choiceHistory[i] > MAX_CHOICES) return NULL;
+    }
+
+    uint8_t traits[MAX_TRAITS];
+    if (player->traitCount < 0 || player->traitCount > MAX_TRAITS) return NULL;
+    for (int i = 0; i < player->traitCount; i++) {
+        int id = findName(NAME_TRAIT, player->traits[i]);
+        if (id < 0) return NULL;
+        traits[i] = (uint8_t)id;
+    }
+
+    uint8_t items[MAX_INVENTORY_SIZE];
+    int itemCount = 0;
+    for (int word = 0; word < INVENTORY_WORDS; word++) {
+        for (uint64_t bits = game->inventory[word]; bits; bits &= bits - 1) {
+            if (itemCount == MAX_INVENTORY_SIZE) return NULL;
+            items[itemCount++] = (uint8_t)(word * 64 + __builtin_ctzll(bits));
+        }
+    }
+
+    size_t nameLength = strnlen(player->name, MAX_NAME_LENGTH - 1);
+    size_t size = compactSize(nameLength, (uint32_t)game->choiceHistoryCount);
+    if (!packed || getCompactGameSize(packed) != size) {
+        CompactGame* resized = (CompactGame*)realloc(packed, size);
+        if (!resized) return NULL;
+        packed = resized;
+    }
+
+    packed->story = game->story;
+    packed->startStory = game->startStory;
+    packed->saveLog = game->saveLog;
+    packed->flags = game->flags;
+    packed->currentScene = game->currentScene;
+    packed->historyCount = (uint32_t)game->choiceHistoryCount;
+    for (int i = 0; i < CONDITION_STATS; i++) {
+        packed->stats[i] = (int16_t)stats[i];
+    }
+    packed->currentChapter = (uint8_t)game->currentChapter;
+    packed->characterClass = (uint8_t)player->class;
+    packed->isGameOver = game->isGameOver ? 1 : 0;
+    packed->itemCount = (uint8_t)itemCount;
+    packed->traitCount = (uint8_t)player->traitCount;
+    memcpy(packed->items, items, (size_t)itemCount);
+    memcpy(packed->traits, traits, (size_t)player->traitCount);
+
+    memcpy(packed->name, player->name, nameLength);
+    packed->name[nameLength] = '\0';
+
+    uint8_t* history = (uint8_t*)packed->name + nameLength + 1;
+    memset(history, 0, size - (size_t)(history - (uint8_t*)packed));
+    for (int i = 0; i < game->choiceHistoryCount; i++) {
+        history[i / 4] |= (uint8_t)((game->choiceHistory[i] - 1) << (i % 4 * 2));
+    }
+    return packed;
+}
+
+int unpackGame(const CompactGame* packed, GameState* game, Character* player) {
+    if (reserveChoiceHistory(game, (int)packed->historyCount) < 0) return -1;
+    int* history = game->choiceHistory;
+    int capacity = game->choiceHistoryCapacity;
+
+    memset(player, 0, sizeof(Character));
+    memcpy(player->name, packed->name, strlen(packed->name) + 1);
+    player->class = (CharacterClass)packed->characterClass;
+    player->strength = packed->stats[STAT_STRENGTH];
+    player->intelligence = packed->stats[STAT_INTELLIGENCE];
+    player->charisma = packed->stats[STAT_CHARISMA];
+    player->health = packed->stats[STAT_HEALTH];
+    player->traitCount = packed->traitCount;
+    for (int i = 0; i < packed->traitCount; i++) {
+        strcpy(player->traits[i], getName(NAME_TRAIT, packed->traits[i]));
+        player->traitMask |= 1ull << packed->traits[i];
+    }
+
+    memset(game, 0, sizeof(GameState));
+    game->player = player;
+    game->story = packed->story;
+    game->startStory = packed->startStory;
+    game->saveLog = packed->saveLog;
+    game->currentScene = packed->currentScene;
+    game->currentChapter = packed->currentChapter;
+    game->reputation = packed->stats[STAT_REPUTATION];
+    game->isGameOver = packed->isGameOver;
+    game->flags = packed->flags;
+    game->inventoryCount = packed->itemCount;
+    for (int i = 0; i < packed->itemCount; i++) {
+        game->inventory[packed->items[i] / 64] |= 1ull << (packed->items[i] % 64);
+    }
+
+    const uint8_t* packedHistory = (const uint8_t*)packed->name + strlen(packed->name) + 1;
+    game->choiceHistory = history;
+    game->choiceHistoryCount = (int)packed->historyCount;
+    game->choiceHistoryCapacity = capacity;
+    for (int i = 0; i < game->choiceHistoryCount; i++) {
+        game->choiceHistory[i] = ((packedHistory[i / 4] >> (i % 4 * 2)) & 3) + 1;
+    }
+    return 0;
+}
+
+size_t getCompactGameSize(const CompactGame* packed) {
+    return compactSize(strlen(packed->name), packed->historyCount);
+}
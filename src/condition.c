@@ -0,0 +1,567 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "../include/condition.h"
+
+/* Operand bytes after each opcode */
+static const uint8_t operandBytes[CONDITION_OPS] = {
+    [COND_CONST] = 2, [COND_STAT] = 1, [COND_CLASS] = 1,
+    [COND_ITEM] = 1, [COND_TRAIT] = 1, [COND_FLAG] = 1,
+};
+
+static const char* statNames[CONDITION_STATS] = {"str", "int", "cha", "health", "reputation"};
+static const char* classNames[] = {"warrior", "scholar", "diplomat", "rogue"};
+static const char* nameOps[NAME_KINDS] = {"has", "trait", "flag"};
+
+/* ---- Compiling ---- */
+
+/**
+ * @struct ConditionParser
+ * @brief Recursive-descent parser state; bytecode is emitted as it parses
+ */
+typedef struct {
+    const char* text;               /**< Whole expression, for error positions */
+    const char* cursor;             /**< Next character to read */
+    uint8_t* code;                  /**< Output bytecode */
+    size_t size;                    /**< Bytes emitted */
+    size_t capacity;                /**< Size of code */
+    int depth;                      /**< Values on the stack at this point of the program */
+    int nesting;                    /**< Parentheses and negations open around the cursor */
+    ConditionNameResolver resolve;  /**< Maps names to operands */
+    void* context;                  /**< Passed to resolve */
+    char* error;                    /**< Receives the first error, or NULL */
+    size_t errorSize;               /**< Size of error */
+    int failed;                     /**< Set once an error was reported */
+} ConditionParser;
+
+static void fail(ConditionParser* parser, const char* format, ...) {
+    if (parser->failed) return;
+    parser->failed = 1;
+    if (!parser->error || !parser->errorSize) return;
+
+    int written = snprintf(parser->error, parser->errorSize, "column %d: ",
+                           (int)(parser->cursor - parser->text) + 1);
+    if (written < 0 || (size_t)written >= parser->errorSize) return;
+    va_list args;
+    va_start(args, format);
+    vsnprintf(parser->error + written, parser->errorSize - (size_t)written, format, args);
+    va_end(args);
+}
+
+static void skipSpaces(ConditionParser* parser) {
+    while (*parser->cursor == ' ' || *parser->cursor == '\t') parser->cursor++;
+}
+
+static int isWordChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+/**
+ * @brief Consumes a token if it comes next
+ */
+static int match(ConditionParser* parser, const char* token) {
+    skipSpaces(parser);
+    size_t length = strlen(token);
+    if (strncmp(parser->cursor, token, length) != 0) return 0;
+    parser->cursor += length;
+    return 1;
+}
+
+/**
+ * @brief Emits one instruction and tracks the stack depth it leaves
+ * @param effect Values the instruction adds to the stack, negative if it removes them
+ */
+static void emit(ConditionParser* parser, ConditionOp op, int operand, int effect) {
+    if (parser->failed) return;
+    if (parser->size + 1 + operandBytes[op] > parser->capacity) {
+        fail(parser, "condition is too long");
+        return;
+    }
+    parser->depth += effect;
+    if (parser->depth > CONDITION_STACK) {
+        fail(parser, "condition is nested too deeply");
+        return;
+    }
+
+    parser->code[parser->size++] = (uint8_t)op;
+    if (operandBytes[op] == 2) {
+        parser->code[parser->size++] = (uint8_t)(operand & 0xFF);
+        parser->code[parser->size++] = (uint8_t)((operand >> 8) & 0xFF);
+    } else if (operandBytes[op] == 1) {
+        parser->code[parser->size++] = (uint8_t)operand;
+    }
+}
+
+/**
+ * @brief Reads a word of letters, digits and underscores
+ * @return Length of the word, 0 if none comes next
+ */
+static size_t readWord(ConditionParser* parser, char* word, size_t capacity) {
+    skipSpaces(parser);
+    size_t length = 0;
+    while (isWordChar(parser->cursor[length])) length++;
+    if (length == 0 || length >= capacity) return 0;
+    memcpy(word, parser->cursor, length);
+    word[length] = '\0';
+    parser->cursor += length;
+    return length;
+}
+
+static void parseName(ConditionParser* parser, NameKind kind, ConditionOp op) {
+    char name[MAX_REGISTERED_NAME];
+    skipSpaces(parser);
+
+    if (*parser->cursor == '"') {
+        const char* close = strchr(parser->cursor + 1, '"');
+        size_t length = close ? (size_t)(close - parser->cursor - 1) : 0;
+        if (!close || length == 0 || length >= sizeof(name)) {
+            fail(parser, "expected a quoted name of 1 to %d bytes", MAX_REGISTERED_NAME - 1);
+            return;
+        }
+        memcpy(name, parser->cursor + 1, length);
+        name[length] = '\0';
+        parser->cursor = close + 1;
+    } else if (!readWord(parser, name, sizeof(name))) {
+        fail(parser, "expected a name after '%s'", nameOps[kind]);
+        return;
+    }
+
+    int operand = parser->resolve(parser->context, kind, name);
+    if (operand < 0 || operand > 255) {
+        fail(parser, "too many names, or an invalid one: '%s'", name);
+        return;
+    }
+    emit(parser, op, operand, 1);
+}
+
+static void parseOr(ConditionParser* parser);
+
+/**
+ * @brief Bounds the parser's recursion before entering a nested expression
+ * @return 1 if there is room for another level, 0 after reporting an error
+ */
+static int enterNesting(ConditionParser* parser) {
+    if (++parser->nesting <= MAX_CONDITION_CODE) return 1;
+    fail(parser, "condition is nested too deeply");
+    return 0;
+}
+
+static void parseAtom(ConditionParser* parser) {
+    skipSpaces(parser);
+    const char* start = parser->cursor;
+
+    if (match(parser, "(")) {
+        if (!enterNesting(parser)) return;
+        parseOr(parser);
+        if (!match(parser, ")")) fail(parser, "expected ')'");
+        parser->nesting--;
+        return;
+    }
+
+    if ((*start >= '0' && *start <= '9') || (*start == '-' && start[1] >= '0' && start[1] <= '9')) {
+        char* end;
+        long value = strtol(start, &end, 10);
+        if (value < INT16_MIN || value > INT16_MAX) {
+            fail(parser, "number out of range");
+            return;
+        }
+        parser->cursor = end;
+        emit(parser, COND_CONST, (int)value, 1);
+        return;
+    }
+
+    char word[16];
+    if (!readWord(parser, word, sizeof(word))) {
+        fail(parser, "expected a value");
+        return;
+    }
+    if (strcmp(word, "true") == 0 || strcmp(word, "false") == 0) {
+        emit(parser, COND_CONST, word[0] == 't', 1);
+        return;
+    }
+    for (int i = 0; i < CONDITION_STATS; i++) {
+        if (strcmp(word, statNames[i]) == 0) {
+            emit(parser, COND_STAT, i, 1);
+            return;
+        }
+    }
+    for (int kind = 0; kind < NAME_KINDS; kind++) {
+        if (strcmp(word, nameOps[kind]) == 0) {
+            parseName(parser, (NameKind)kind, (ConditionOp)(COND_ITEM + kind));
+            return;
+        }
+    }
+    if (strcmp(word, "class") == 0) {
+        if (readWord(parser, word, sizeof(word))) {
+            for (int i = 0; i < 4; i++) {
+                if (strcmp(word, classNames[i]) == 0) {
+                    emit(parser, COND_CLASS, i, 1);
+                    return;
+                }
+            }
+        }
+        fail(parser, "expected warrior, scholar, diplomat or rogue after 'class'");
+        return;
+    }
+    parser->cursor = start;
+    fail(parser, "unknown word '%s'", word);
+}
+
+static void parseUnary(ConditionParser* parser) {
+    skipSpaces(parser);
+    if (parser->cursor[0] == '!' && parser->cursor[1] != '=') {
+        parser->cursor++;
+        if (!enterNesting(parser)) return;
+        parseUnary(parser);
+        emit(parser, COND_NOT, 0, 0);
+        parser->nesting--;
+    } else {
+        parseAtom(parser);
+    }
+}
+
+static void parseSum(ConditionParser* parser) {
+    parseUnary(parser);
+    while (!parser->failed) {
+        ConditionOp op;
+        if (match(parser, "+")) op = COND_ADD;
+        else if (match(parser, "-")) op = COND_SUB;
+        else break;
+        parseUnary(parser);
+        emit(parser, op, 0, -1);
+    }
+}
+
+static void parseComparison(ConditionParser* parser) {
+    static const char* tokens[] = {">=", "<=", "==", "!=", ">", "<"};
+    static const ConditionOp ops[] = {COND_GE, COND_LE, COND_EQ, COND_NE, COND_GT, COND_LT};
+
+    parseSum(parser);
+    for (int i = 0; i < 6 && !parser->failed; i++) {
+        if (match(parser, tokens[i])) {
+            parseSum(parser);
+            emit(parser, ops[i], 0, -1);
+            break;
+        }
+    }
+}
+
+static void parseAnd(ConditionParser* parser) {
+    parseComparison(parser);
+    while (!parser->failed && match(parser, "&&")) {
+        parseComparison(parser);
+        emit(parser, COND_AND, 0, -1);
+    }
+}
+
+static void parseOr(ConditionParser* parser) {
+    parseAnd(parser);
+    while (!parser->failed && match(parser, "||")) {
+        parseAnd(parser);
+        emit(parser, COND_OR, 0, -1);
+    }
+}
+
+int compileCondition(const char* expression, ConditionNameResolver resolve, void* context,
+                     uint8_t* code, size_t capacity, char* error, size_t errorSize) {
+    ConditionParser parser = {
+        .text = expression, .cursor = expression, .code = code, .capacity = capacity,
+        .resolve = resolve, .context = context, .error = error, .errorSize = errorSize,
+    };
+
+    parseOr(&parser);
+    skipSpaces(&parser);
+    if (*parser.cursor) fail(&parser, "unexpected '%s'", parser.cursor);
+    emit(&parser, COND_END, 0, -1);
+    return parser.failed ? -1 : (int)parser.size;
+}
+
+int getConditionMinimums(const uint8_t* code, int minimums[3]) {
+    minimums[0] = minimums[1] = minimums[2] = 0;
+
+    // "stat >= constant" terms joined by &&: the first term, then term-and pairs
+    size_t pc = 0;
+    for (int term = 0; code[pc] != COND_END; term++) {
+        if (code[pc] != COND_STAT || code[pc + 1] > STAT_CHARISMA || code[pc + 2] != COND_CONST) return 0;
+        int value = (int16_t)(code[pc + 3] | code[pc + 4] << 8);
+        if (code[pc + 5] != COND_GE || value < 0 || value > 255) return 0;
+        if (value > minimums[code[pc + 1]]) minimums[code[pc + 1]] = value;
+        pc += 6;
+        if (term > 0) {
+            if (code[pc] != COND_AND) return 0;
+            pc++;
+        }
+    }
+    return 1;
+}
+
+/* ---- Loading ---- */
+
+int linkCondition(uint8_t* code, size_t size, const uint16_t* const names[NAME_KINDS], const uint32_t counts[NAME_KINDS]) {
+    int depth = 0;
+    size_t pc = 0;
+
+    while (pc < size) {
+        uint8_t op = code[pc];
+        if (op >= CONDITION_OPS || pc + 1 + operandBytes[op] > size) return -1;
+
+        switch (op) {
+            case COND_END:
+                return depth == 1 ? (int)(pc + 1) : -1;
+            case COND_CONST:
+                depth++;
+                break;
+            case COND_STAT:
+                if (code[pc + 1] >= CONDITION_STATS) return -1;
+                depth++;
+                break;
+            case COND_CLASS:
+                if (code[pc + 1] > ROGUE) return -1;
+                depth++;
+                break;
+            case COND_ITEM:
+            case COND_TRAIT:
+            case COND_FLAG: {
+                int kind = op - COND_ITEM;
+                if (code[pc + 1] >= counts[kind]) return -1;
+                code[pc + 1] = (uint8_t)names[kind][code[pc + 1]];
+                depth++;
+                break;
+            }
+            case COND_NOT:
+                if (depth < 1) return -1;
+                break;
+            default:
+                // Every other instruction combines the top two values
+                if (depth < 2) return -1;
+                depth--;
+                break;
+        }
+        if (depth > CONDITION_STACK) return -1;
+        pc += 1 + operandBytes[op];
+    }
+    return -1;
+}
+
+size_t getConditionLength(const uint8_t* code) {
+    size_t pc = 0;
+    while (code[pc] != COND_END) pc += 1 + operandBytes[code[pc]];
+    return pc + 1;
+}
+
+/* ---- Formatting ---- */
+
+/**
+ * @struct ConditionTree
+ * @brief Expression tree rebuilt from postfix bytecode
+ */
+typedef struct {
+    uint8_t op[MAX_CONDITION_CODE];         /**< Instruction of each node */
+    int operand[MAX_CONDITION_CODE];        /**< Operand of each leaf */
+    int left[MAX_CONDITION_CODE];           /**< First operand of each operator */
+    int right[MAX_CONDITION_CODE];          /**< Second or only operand of each operator */
+} ConditionTree;
+
+/**
+ * @struct TextWriter
+ * @brief Bounded output buffer
+ */
+typedef struct {
+    char* text;         /**< Output */
+    size_t length;      /**< Characters written */
+    size_t capacity;    /**< Size of text */
+    int overflow;       /**< Set if the text did not fit */
+} TextWriter;
+
+static void put(TextWriter* out, const char* format, ...) {
+    if (out->overflow) return;
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(out->text + out->length, out->capacity - out->length, format, args);
+    va_end(args);
+    if (written < 0 || (size_t)written >= out->capacity - out->length) {
+        out->overflow = 1;
+    } else {
+        out->length += (size_t)written;
+    }
+}
+
+/**
+ * @brief Binding strength of an instruction; leaves bind tightest
+ */
+static int precedence(uint8_t op) {
+    switch (op) {
+        case COND_OR: return 1;
+        case COND_AND: return 2;
+        case COND_LT: case COND_LE: case COND_GT: case COND_GE: case COND_EQ: case COND_NE: return 3;
+        case COND_ADD: case COND_SUB: return 4;
+        case COND_NOT: return 5;
+        default: return 6;
+    }
+}
+
+static void formatNode(const ConditionTree* tree, int node, int minimum, TextWriter* out) {
+    static const char* symbols[CONDITION_OPS] = {
+        [COND_ADD] = "+", [COND_SUB] = "-", [COND_LT] = "<", [COND_LE] = "<=", [COND_GT] = ">",
+        [COND_GE] = ">=", [COND_EQ] = "==", [COND_NE] = "!=", [COND_AND] = "&&", [COND_OR] = "||",
+    };
+    uint8_t op = tree->op[node];
+    int level = precedence(op);
+    if (level < minimum) put(out, "(");
+
+    switch (op) {
+        case COND_CONST:
+            put(out, "%d", tree->operand[node]);
+            break;
+        case COND_STAT:
+            put(out, "%s", statNames[tree->operand[node]]);
+            break;
+        case COND_CLASS:
+            put(out, "class %s", classNames[tree->operand[node]]);
+            break;
+        case COND_ITEM:
+        case COND_TRAIT:
+        case COND_FLAG: {
+            NameKind kind = (NameKind)(op - COND_ITEM);
+            const char* name = getName(kind, tree->operand[node]);
+            int bare = 1;
+            for (const char* c = name; *c; c++) bare &= isWordChar(*c);
+            put(out, bare ? "%s %s" : "%s \"%s\"", nameOps[kind], name);
+            break;
+        }
+        case COND_NOT:
+            put(out, "!");
+            formatNode(tree, tree->right[node], level, out);
+            break;
+        default:
+            // Chains group to the left, and comparisons do not chain at all
+            formatNode(tree, tree->left[node], level == 3 ? level + 1 : level, out);
+            put(out, " %s ", symbols[op]);
+            formatNode(tree, tree->right[node], level + 1, out);
+            break;
+    }
+
+    if (level < minimum) put(out, ")");
+}
+
+int formatCondition(const uint8_t* code, char* text, size_t capacity) {
+    ConditionTree tree;
+    int stack[CONDITION_STACK];
+    int depth = 0;
+    int count = 0;
+
+    for (size_t pc = 0; code[pc] != COND_END; pc += 1 + operandBytes[code[pc]]) {
+        uint8_t op = code[pc];
+        int node = count++;
+        tree.op[node] = op;
+        if (op == COND_CONST) {
+            tree.operand[node] = (int16_t)(code[pc + 1] | code[pc + 2] << 8);
+        } else if (operandBytes[op]) {
+            tree.operand[node] = code[pc + 1];
+        } else if (op == COND_NOT) {
+            tree.right[node] = stack[--depth];
+        } else {
+            tree.right[node] = stack[--depth];
+            tree.left[node] = stack[--depth];
+        }
+        stack[depth++] = node;
+    }
+
+    TextWriter out = {text, 0, capacity, capacity == 0};
+    if (!out.overflow) text[0] = '\0';
+    formatNode(&tree, stack[0], 0, &out);
+    return out.overflow ? -1 : (int)out.length;
+}
+
+/* ---- Evaluating ---- */
+
+void loadConditionContext(ConditionContext* context, const GameState* game) {
+    const Character* player = game->player;
+    context->stats[STAT_STRENGTH] = player->strength;
+    context->stats[STAT_INTELLIGENCE] = player->intelligence;
+    context->stats[STAT_CHARISMA] = player->charisma;
+    context->stats[STAT_HEALTH] = player->health;
+    context->stats[STAT_REPUTATION] = game->reputation;
+    context->characterClass = (int32_t)player->class;
+    context->traits = player->traitMask;
+    context->flags = game->flags;
+    context->inventory = game->inventory;
+}
+
+/**
+ * @brief Runs one condition
+ * @param end Receives the first byte after it
+ * @details Logical operators combine values that are both already computed,
+ *          so a condition runs straight through without branching on them.
+ */
+static int runCondition(const uint8_t* code, const ConditionContext* context, const uint8_t** end) {
+    int32_t stack[CONDITION_STACK];
+    int32_t* top = stack - 1;
+
+    for (;;) {
+        switch (code[0]) {
+            case COND_END:
+                *end = code + 1;
+                return stack[0] != 0;
+            case COND_CONST:
+                *++top = (int16_t)(code[1] | code[2] << 8);
+                code += 3;
+                continue;
+            case COND_STAT:
+                *++top = context->stats[code[1]];
+                break;
+            case COND_CLASS:
+                *++top = context->characterClass == code[1];
+                break;
+            case COND_ITEM:
+                *++top = (int32_t)(context->inventory[code[1] >> 6] >> (code[1] & 63)) & 1;
+                break;
+            case COND_TRAIT:
+                *++top = (int32_t)(context->traits >> code[1]) & 1;
+                break;
+            case COND_FLAG:
+                *++top = (int32_t)(context->flags >> code[1]) & 1;
+                break;
+            case COND_ADD: top--; top[0] += top[1]; code++; continue;
+            case COND_SUB: top--; top[0] -= top[1]; code++; continue;
+            case COND_LT: top--; top[0] = top[0] < top[1]; code++; continue;
+            case COND_LE: top--; top[0] = top[0] <= top[1]; code++; continue;
+            case COND_GT: top--; top[0] = top[0] > top[1]; code++; continue;
+            case COND_GE: top--; top[0] = top[0] >= top[1]; code++; continue;
+            case COND_EQ: top--; top[0] = top[0] == top[1]; code++; continue;
+            case COND_NE: top--; top[0] = top[0] != top[1]; code++; continue;
+            case COND_AND: top--; top[0] = (top[0] != 0) & (top[1] != 0); code++; continue;
+            case COND_OR: top--; top[0] = (top[0] != 0) | (top[1] != 0); code++; continue;
+            case COND_NOT: top[0] = top[0] == 0; code++; continue;
+        }
+        // Instructions with a one-byte operand
+        code += 2;
+    }
+}
+
+int evaluateCondition(const uint8_t* code, const ConditionContext* context) {
+    const uint8_t* end;
+    return runCondition(code, context, &end);
+}
+
+unsigned int getConditionMask(const Story* story, const StoryRecord* node, const ConditionContext* context) {
+    unsigned int mask = ~(unsigned int)node->conditioned & ((1u << MAX_CHOICES) - 1);
+    const uint8_t* code = story->code + node->code;
+
+    // A node's conditions are stored back to back in choice order
+    for (unsigned int pending = node->conditioned; pending; pending &= pending - 1) {
+        if (runCondition(code, context, &code)) mask |= pending & -pending;
+    }
+    return mask;
+}
+
+const uint8_t* getChoiceCondition(const Story* story, const StoryRecord* node, int choice) {
+    if (!((node->conditioned >> choice) & 1)) return NULL;
+
+    const uint8_t* code = story->code + node->code;
+    for (unsigned int earlier = node->conditioned & ((1u << choice) - 1); earlier; earlier &= earlier - 1) {
+        code += getConditionLength(code);
+    }
+    return code;
+}
@@ -0,0 +1,427 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "../include/effect.h"
+#include "../include/engine.h"
+
+/* Operand bytes after each opcode, indexed from EFFECT_BASE */
+static const uint8_t operandBytes[EFFECT_LIMIT - EFFECT_BASE] = {
+    [EFFECT_STAT - EFFECT_BASE] = 3, [EFFECT_GIVE - EFFECT_BASE] = 1, [EFFECT_TAKE - EFFECT_BASE] = 1,
+    [EFFECT_TRAIT - EFFECT_BASE] = 1, [EFFECT_SET - EFFECT_BASE] = 1, [EFFECT_CLEAR - EFFECT_BASE] = 1,
+    [EFFECT_CHAPTER - EFFECT_BASE] = 3,
+};
+
+static const char* statNames[CONDITION_STATS] = {"str", "int", "cha", "health", "reputation"};
+
+/* Words of the effects that take a name, and the kind of that name */
+static const struct {
+    const char* word;
+    EffectOp op;
+    NameKind kind;
+} nameEffects[] = {
+    {"give", EFFECT_GIVE, NAME_ITEM},
+    {"take", EFFECT_TAKE, NAME_ITEM},
+    {"trait", EFFECT_TRAIT, NAME_TRAIT},
+    {"set", EFFECT_SET, NAME_FLAG},
+    {"clear", EFFECT_CLEAR, NAME_FLAG},
+};
+
+#define NAME_EFFECTS (sizeof(nameEffects) / sizeof(nameEffects[0]))
+
+/* ---- Compiling ---- */
+
+/**
+ * @struct EffectParser
+ * @brief Parser state; bytecode is emitted as it parses
+ */
+typedef struct {
+    const char* text;               /**< Whole list, for error positions */
+    const char* cursor;             /**< Next character to read */
+    uint8_t* code;                  /**< Output bytecode */
+    size_t size;                    /**< Bytes emitted */
+    size_t capacity;                /**< Size of code */
+    char* error;                    /**< Receives the first error, or NULL */
+    size_t errorSize;               /**< Size of error */
+    int failed;                     /**< Set once an error was reported */
+} EffectParser;
+
+static void fail(EffectParser* parser, const char* format, ...) {
+    if (parser->failed) return;
+    parser->failed = 1;
+    if (!parser->error || !parser->errorSize) return;
+
+    int written = snprintf(parser->error, parser->errorSize, "column %d: ",
+                           (int)(parser->cursor - parser->text) + 1);
+    if (written < 0 || (size_t)written >= parser->errorSize) return;
+    va_list args;
+    va_start(args, format);
+    vsnprintf(parser->error + written, parser->errorSize - (size_t)written, format, args);
+    va_end(args);
+}
+
+static void skipSpaces(EffectParser* parser) {
+    while (*parser->cursor == ' ' || *parser->cursor == '\t') parser->cursor++;
+}
+
+static int isWordChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+/**
+ * @brief Emits one instruction with an operand of operandBytes[op] bytes
+ */
+static void emit(EffectParser* parser, EffectOp op, int first, int second) {
+    if (parser->failed) return;
+    size_t operands = op == EFFECT_END ? 0 : operandBytes[op - EFFECT_BASE];
+    if (parser->size + 1 + operands > parser->capacity) {
+        fail(parser, "effect list is too long");
+        return;
+    }
+
+    parser->code[parser->size++] = (uint8_t)op;
+    if (operands >= 1) parser->code[parser->size++] = (uint8_t)first;
+    if (operands == 3) {
+        parser->code[parser->size++] = (uint8_t)(second & 0xFF);
+        parser->code[parser->size++] = (uint8_t)((second >> 8) & 0xFF);
+    }
+}
+
+/**
+ * @brief Reads a word of letters, digits and underscores
+ * @return Length of the word, 0 if none comes next
+ */
+static size_t readWord(EffectParser* parser, char* word, size_t capacity) {
+    skipSpaces(parser);
+    size_t length = 0;
+    while (isWordChar(parser->cursor[length])) length++;
+    if (length == 0 || length >= capacity) return 0;
+    memcpy(word, parser->cursor, length);
+    word[length] = '\0';
+    parser->cursor += length;
+    return length;
+}
+
+/**
+ * @brief Reads a whole number in a range
+ * @return 0 on success, -1 after reporting an error
+ */
+static int readNumber(EffectParser* parser, long minimum, long maximum, const char* what, long* value) {
+    skipSpaces(parser);
+    char* end;
+    *value = strtol(parser->cursor, &end, 10);
+    if (end == parser->cursor || *value < minimum || *value > maximum) {
+        fail(parser, "expected %s from %ld to %ld", what, minimum, maximum);
+        return -1;
+    }
+    parser->cursor = end;
+    return 0;
+}
+
+static void parseName(EffectParser* parser, EffectOp op, NameKind kind,
+                      ConditionNameResolver resolve, void* context, const char* word) {
+    char name[MAX_REGISTERED_NAME];
+    skipSpaces(parser);
+
+    if (*parser->cursor == '"') {
+        const char* close = strchr(parser->cursor + 1, '"');
+        size_t length = close ? (size_t)(close - parser->cursor - 1) : 0;
+        if (!close || length == 0 || length >= sizeof(name)) {
+            fail(parser, "expected a quoted name of 1 to %d bytes", MAX_REGISTERED_NAME - 1);
+            return;
+        }
+        memcpy(name, parser->cursor + 1, length);
+        name[length] = '\0';
+        parser->cursor = close + 1;
+    } else if (!readWord(parser, name, sizeof(name))) {
+        fail(parser, "expected a name after '%s'", word);
+        return;
+    }
+
+    int operand = resolve(context, kind, name);
+    if (operand < 0 || operand > 255) {
+        fail(parser, "too many names, or an invalid one: '%s'", name);
+        return;
+    }
+    emit(parser, op, operand, 0);
+}
+
+/**
+ * @brief Parses one effect
+ * @return 1 if it was a chapter effect, 0 otherwise
+ */
+static int parseEffect(EffectParser* parser, ConditionNameResolver resolve, void* context) {
+    const char* start = parser->cursor;
+    char word[16];
+    if (!readWord(parser, word, sizeof(word))) {
+        fail(parser, "expected an effect");
+        return 0;
+    }
+
+    for (int stat = 0; stat < CONDITION_STATS; stat++) {
+        if (strcmp(word, statNames[stat]) != 0) continue;
+
+        skipSpaces(parser);
+        int sign = *parser->cursor == '-' ? -1 : 1;
+        long delta;
+        if (*parser->cursor != '+' && *parser->cursor != '-') {
+            fail(parser, "expected '+' or '-' after '%s'", word);
+        } else {
+            parser->cursor++;
+            if (readNumber(parser, 0, INT16_MAX, "a change", &delta) == 0) emit(parser, EFFECT_STAT, stat, (int)(sign * delta));
+        }
+        return 0;
+    }
+
+    for (size_t i = 0; i < NAME_EFFECTS; i++) {
+        if (strcmp(word, nameEffects[i].word) == 0) {
+            parseName(parser, nameEffects[i].op, nameEffects[i].kind, resolve, context, word);
+            return 0;
+        }
+    }
+
+    if (strcmp(word, "chapter") == 0) {
+        long chapter, id;
+        if (readNumber(parser, 1, UINT8_MAX, "a chapter", &chapter) == 0 &&
+            readNumber(parser, 0, UINT16_MAX, "a node id", &id) == 0) {
+            emit(parser, EFFECT_CHAPTER, (int)chapter, (int)id);
+        }
+        return 1;
+    }
+
+    parser->cursor = start;
+    fail(parser, "unknown effect '%s'", word);
+    return 0;
+}
+
+int compileEffects(const char* text, ConditionNameResolver resolve, void* context,
+                   uint8_t* code, size_t capacity, char* error, size_t errorSize) {
+    EffectParser parser = {
+        .text = text, .cursor = text, .code = code, .capacity = capacity,
+        .error = error, .errorSize = errorSize,
+    };
+
+    for (;;) {
+        int chapter = parseEffect(&parser, resolve, context);
+        skipSpaces(&parser);
+        if (parser.failed || *parser.cursor != ',') break;
+        if (chapter) fail(&parser, "'chapter' must be the last effect");
+        parser.cursor++;
+    }
+    skipSpaces(&parser);
+    if (*parser.cursor) fail(&parser, "unexpected '%s'", parser.cursor);
+    emit(&parser, EFFECT_END, 0, 0);
+    return parser.failed ? -1 : (int)parser.size;
+}
+
+/* ---- Loading ---- */
+
+int linkEffects(uint8_t* code, size_t size, const uint16_t* const names[NAME_KINDS], const uint32_t counts[NAME_KINDS]) {
+    size_t pc = 0;
+    int chapter = 0;
+
+    while (pc < size) {
+        uint8_t op = code[pc];
+        if (op == EFFECT_END) return pc > 0 ? (int)(pc + 1) : -1;
+        if (chapter || op < EFFECT_BASE || op >= EFFECT_LIMIT) return -1;
+        size_t operands = operandBytes[op - EFFECT_BASE];
+        if (pc + 1 + operands > size) return -1;
+
+        switch (op) {
+            case EFFECT_STAT:
+                if (code[pc + 1] >= CONDITION_STATS) return -1;
+                break;
+            case EFFECT_CHAPTER:
+                if (code[pc + 1] == 0) return -1;
+                chapter = 1;
+                break;
+            default: {
+                NameKind kind = op == EFFECT_TRAIT ? NAME_TRAIT : op == EFFECT_SET || op == EFFECT_CLEAR ? NAME_FLAG : NAME_ITEM;
+                if (code[pc + 1] >= counts[kind]) return -1;
+                code[pc + 1] = (uint8_t)names[kind][code[pc + 1]];
+                break;
+            }
+        }
+        pc += 1 + operands;
+    }
+    return -1;
+}
+
+size_t getEffectsLength(const uint8_t* code) {
+    size_t pc = 0;
+    while (code[pc] != EFFECT_END) pc += 1 + operandBytes[code[pc] - EFFECT_BASE];
+    return pc + 1;
+}
+
+/* ---- Formatting ---- */
+
+int formatEffects(const uint8_t* code, char* text, size_t capacity) {
+    size_t length = 0;
+    if (capacity == 0) return -1;
+    text[0] = '\0';
+
+    for (size_t pc = 0; code[pc] != EFFECT_END; pc += 1 + operandBytes[code[pc] - EFFECT_BASE]) {
+        const char* separator = pc ? ", " : "";
+        uint8_t op = code[pc];
+        int written;
+
+        if (op == EFFECT_STAT) {
+            written = snprintf(text + length, capacity - length, "%s%s %+d", separator,
+                               statNames[code[pc + 1]], (int16_t)(code[pc + 2] | code[pc + 3] << 8));
+        } else if (op == EFFECT_CHAPTER) {
+            written = snprintf(text + length, capacity - length, "%schapter %d %d", separator,
+                               code[pc + 1], code[pc + 2] | code[pc + 3] << 8);
+        } else {
+            size_t i = 0;
+            while (nameEffects[i].op != op) i++;
+            const char* name = getName(nameEffects[i].kind, code[pc + 1]);
+            int bare = 1;
+            for (const char* c = name; *c; c++) bare &= isWordChar(*c);
+            written = snprintf(text + length, capacity - length, bare ? "%s%s %s" : "%s%s \"%s\"",
+                               separator, nameEffects[i].word, name);
+        }
+
+        if (written < 0 || (size_t)written >= capacity - length) return -1;
+        length += (size_t)written;
+    }
+    return (int)length;
+}
+
+/* ---- Applying ---- */
+
+/**
+ * @brief Adds a change to a stat, saturating at plus or minus STAT_LIMIT
+ */
+static int changeStat(int stat, int delta) {
+    // Widened so a stat loaded from a save cannot overflow
+    long long sum = (long long)stat + delta;
+    return sum > STAT_LIMIT ? STAT_LIMIT : sum < -STAT_LIMIT ? -STAT_LIMIT : (int)sum;
+}
+
+/**
+ * @brief Moves a game into a chapter, ending it if that fails
+ */
+static int jumpToChapter(GameState* game, int chapter, int id) {
+    if (enterChapter(game, chapter, id) == 0) return 0;
+    game->isGameOver = 1;
+    return -1;
+}
+
+int applyEffects(const uint8_t* code, GameState* game) {
+    Character* player = game->player;
+    int* stats[CONDITION_STATS] = {&player->strength, &player->intelligence, &player->charisma,
+                                   &player->health, &game->reputation};
+
+    for (;;) {
+        switch (code[0]) {
+            case EFFECT_STAT:
+                *stats[code[1]] = changeStat(*stats[code[1]], (int16_t)(code[2] | code[3] << 8));
+                code += 4;
+                continue;
+            case EFFECT_GIVE:
+                addItem(game, code[1]);
+                break;
+            case EFFECT_TAKE:
+                removeItem(game, code[1]);
+                break;
+            case EFFECT_TRAIT:
+                addTraitId(player, code[1]);
+                break;
+            case EFFECT_SET:
+                game->flags |= 1ull << code[1];
+                break;
+            case EFFECT_CLEAR:
+                game->flags &= ~(1ull << code[1]);
+                break;
+            case EFFECT_CHAPTER:
+                return jumpToChapter(game, code[1], code[2] | code[3] << 8);
+            default:
+                return 0;
+        }
+        code += 2;
+    }
+}
+
+size_t applyEffectBatch(const uint8_t* code, GameState* games, size_t count) {
+    for (;;) {
+        if (code[0] == EFFECT_END) return 0;
+        uint8_t operand = code[1];
+
+        switch (code[0]) {
+            case EFFECT_STAT: {
+                int delta = (int16_t)(code[2] | code[3] << 8);
+                // One loop per stat keeps the store target fixed inside it
+                switch (operand) {
+                    case STAT_STRENGTH:
+                        for (size_t i = 0; i < count; i++) {
+                            Character* player = games[i].player;
+                            player->strength = changeStat(player->strength, delta);
+                        }
+                        break;
+                    case STAT_INTELLIGENCE:
+                        for (size_t i = 0; i < count; i++) {
+                            Character* player = games[i].player;
+                            player->intelligence = changeStat(player->intelligence, delta);
+                        }
+                        break;
+                    case STAT_CHARISMA:
+                        for (size_t i = 0; i < count; i++) {
+                            Character* player = games[i].player;
+                            player->charisma = changeStat(player->charisma, delta);
+                        }
+                        break;
+                    case STAT_HEALTH:
+                        for (size_t i = 0; i < count; i++) {
+                            Character* player = games[i].player;
+                            player->health = changeStat(player->health, delta);
+                        }
+                        break;
+                    default:
+                        for (size_t i = 0; i < count; i++) games[i].reputation = changeStat(games[i].reputation, delta);
+                        break;
+                }
+                code += 4;
+                continue;
+            }
+            case EFFECT_GIVE:
+                for (size_t i = 0; i < count; i++) addItem(&games[i], operand);
+                break;
+            case EFFECT_TAKE:
+                for (size_t i = 0; i < count; i++) removeItem(&games[i], operand);
+                break;
+            case EFFECT_TRAIT:
+                for (size_t i = 0; i < count; i++) addTraitId(games[i].player, operand);
+                break;
+            case EFFECT_SET:
+                for (size_t i = 0; i < count; i++) games[i].flags |= 1ull << operand;
+                break;
+            case EFFECT_CLEAR:
+                for (size_t i = 0; i < count; i++) games[i].flags &= ~(1ull << operand);
+                break;
+            case EFFECT_CHAPTER: {
+                // Entering a chapter can free the story holding code, so read it first
+                int id = code[2] | code[3] << 8;
+                size_t failures = 0;
+                for (size_t i = 0; i < count; i++) failures += jumpToChapter(&games[i], operand, id) < 0;
+                return failures;
+            }
+            default:
+                return 0;
+        }
+        code += 2;
+    }
+}
+
+const uint8_t* getChoiceEffects(const Story* story, const StoryRecord* node, int choice) {
+    if (!((node->effected >> choice) & 1)) return NULL;
+
+    // A node's conditions come first, then its effects, each in choice order
+    const uint8_t* code = story->code + node->code;
+    for (unsigned int conditions = node->conditioned; conditions; conditions &= conditions - 1) {
+        code += getConditionLength(code);
+    }
+    for (unsigned int earlier = node->effected & ((1u << choice) - 1); earlier; earlier &= earlier - 1) {
+        code += getEffectsLength(code);
+    }
+    return code;
+}
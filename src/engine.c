@@ -0,0 +1,179 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/engine.h"
+#include "../include/requirements.h"
+#include "../include/condition.h"
+#include "../include/effect.h"
+
+void initializeGameState(GameState* game, Character* player, Story* story) {
+    game->player = player;
+    game->story = story;
+    game->startStory = story;
+    game->currentScene = story ? story->header->rootNode : STORY_END;
+    game->currentChapter = story ? story->header->chapter : 1;
+    game->reputation = 0;
+    game->isGameOver = (game->currentScene == STORY_END);
+    memset(game->inventory, 0, sizeof(game->inventory));
+    game->inventoryCount = 0;
+    game->flags = 0;
+    game->choiceHistory = NULL;
+    game->choiceHistoryCount = 0;
+    game->choiceHistoryCapacity = 0;
+    game->saveLog = NULL;
+}
+
+int reserveChoiceHistory(GameState* game, int count) {
+    if (count <= game->choiceHistoryCapacity) return 0;
+    if (count > INT_MAX / 2) return -1;
+
+    int capacity = game->choiceHistoryCapacity ? game->choiceHistoryCapacity : 64;
+    while (capacity < count) capacity *= 2;
+    int* history = (int*)realloc(game->choiceHistory, sizeof(int) * (size_t)capacity);
+    if (!history) return -1;
+    game->choiceHistory = history;
+    game->choiceHistoryCapacity = capacity;
+    return 0;
+}
+
+void freeGameHistory(GameState* game) {
+    free(game->choiceHistory);
+    game->choiceHistory = NULL;
+    game->choiceHistoryCount = 0;
+    game->choiceHistoryCapacity = 0;
+}
+
+/**
+ * @brief Gets the choices of a node whose requirements and conditions the player meets
+ */
+static unsigned int getOpenChoices(const GameState* game, const StoryRecord* node) {
+    unsigned int mask = getChoiceMask(node, packStats(game->player));
+
+    // Conditions only run for choices the stats have not already ruled out
+    if (node->conditioned & mask) {
+        ConditionContext context;
+        loadConditionContext(&context, game);
+        mask &= getConditionMask(game->story, node, &context);
+    }
+    return mask;
+}
+
+unsigned int getAvailableChoices(const GameState* game) {
+    if (game->currentScene == STORY_END) return 0;
+    return getOpenChoices(game, &game->story->nodes[game->currentScene]);
+}
+
+ChoiceResult applyChoice(GameState* game, int choice) {
+    if (game->currentScene == STORY_END) return CHOICE_GAME_OVER;
+
+    const StoryRecord* node = &game->story->nodes[game->currentScene];
+    if (choice < 0 || (uint32_t)choice >= node->numChoices) {
+        return CHOICE_INVALID;
+    }
+
+    if (!(getOpenChoices(game, node) & (1u << choice))) {
+        return CHOICE_LOCKED;
+    }
+
+    if (reserveChoiceHistory(game, game->choiceHistoryCount + 1) < 0) {
+        return CHOICE_NO_MEMORY;
+    }
+    game->choiceHistory[game->choiceHistoryCount++] = choice + 1;
+
+    game->currentScene = node->nextNodes[choice];
+    if ((node->effected >> choice) & 1) {
+        applyEffects(getChoiceEffects(game->story, node, choice), game);
+    }
+    if (game->currentScene == STORY_END) {
+        game->isGameOver = 1;
+    }
+    return CHOICE_APPLIED;
+}
+
+int enterChapter(GameState* game, int chapter, int id) {
+    Story* next = chapter == game->startStory->header->chapter ? game->startStory : openBuiltinChapter(chapter);
+    if (!next) return -1;
+
+    int scene = findStoryNode(next, id);
+    if (scene == STORY_END) {
+        if (next != game->startStory) closeStory(next);
+        return -1;
+    }
+
+    releaseGameChapter(game);
+    game->story = next;
+    game->currentScene = scene;
+    game->currentChapter = chapter;
+    return 0;
+}
+
+int enterNextChapter(GameState* game) {
+    if (game->currentScene == STORY_END) return 0;
+
+    const StoryRecord* node = &game->story->nodes[game->currentScene];
+    if (!node->nextChapter) return 0;
+    if (enterChapter(game, node->nextChapter, node->id) < 0) {
+        game->isGameOver = 1;
+        return -1;
+    }
+    return 1;
+}
+
+void releaseGameChapter(GameState* game) {
+    if (game->story == game->startStory) return;
+
+    closeStory(game->story);
+    game->story = game->startStory;
+    game->currentScene = STORY_END;
+}
+
+int switchStoryVersion(GameState* game, Story* story) {
+    if (story->header->chapter != game->startStory->header->chapter) return -1;
+
+    if (game->story == game->startStory) {
+        int scene = game->currentScene;
+        if (scene != STORY_END) {
+            scene = findStoryNode(story, game->story->nodes[scene].id);
+            if (scene == STORY_END) return -1;
+        }
+        game->story = story;
+        game->currentScene = scene;
+    }
+    game->startStory = story;
+    return 0;
+}
+
+int replayChoices(GameState* game, const int* choices, int count) {
+    for (int i = 0; i < count; i++) {
+        if (applyChoice(game, choices[i] - 1) != CHOICE_APPLIED) return i;
+        enterNextChapter(game);
+    }
+    return count;
+}
+
+int addItem(GameState* game, int item) {
+    uint64_t bit = 1ull << (item & 63);
+    uint64_t* word = &game->inventory[item >> 6];
+    if (*word & bit) return 0;
+    if (game->inventoryCount >= MAX_INVENTORY_SIZE) return -1;
+    *word |= bit;
+    game->inventoryCount++;
+    return 1;
+}
+
+int removeItem(GameState* game, int item) {
+    uint64_t bit = 1ull << (item & 63);
+    uint64_t* word = &game->inventory[item >> 6];
+    if (!(*word & bit)) return 0;
+    *word &= ~bit;
+    game->inventoryCount--;
+    return 1;
+}
+
+int hasItem(const GameState* game, int item) {
+    return (int)(game->inventory[item >> 6] >> (item & 63)) & 1;
+}
+
+int isGameOver(const GameState* game) {
+    return game->isGameOver || game->currentScene == STORY_END;
+}
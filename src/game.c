@@ -1,9 +1,35 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <locale.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <ncurses.h>
 #include "../include/game.h"
 #include "../include/story.h"
+#include "../include/storyfile.h"
+#include "../include/engine.h"
+#include "../include/savefile.h"
+#include "../include/replay.h"
+#include "../include/session.h"
+#include "../include/layout.h"
+#include "../include/requirements.h"
+#include "../include/condition.h"
+
+static RenderStats renderStats;
+// The kernel's I/O counters of the thread that draws, read to measure output
+static int threadIo = -1;
+static int fullRedraw = 0;
+static unsigned long long inputMark = 0;
+static LayoutCache sceneLayouts;
+static int haveSceneLayouts = 0;
+
+// Metrics are read by the metrics server thread, so updates take the lock
+static TurnMetrics turnMetrics;
+static pthread_mutex_t metricsLock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t frameStart = 0;
+static uint64_t inputReadAt = 0;
 
 void initializeColors(void) {
     // Start color functionality
@@ -21,7 +47,14 @@ void initializeColors(void) {
     init_pair(COLOR_ERROR_PAIR, COLOR_RED, -1);
 }
 
-GameState* initializeGame(void) {
+static void startDisplay(void) {
+    // Story text is UTF-8; let ncurses measure it in the terminal's encoding
+    setlocale(LC_ALL, "");
+
+    // ncurses writes straight to the terminal's descriptor, so what it sends
+    // is measured by the bytes this thread has written
+    threadIo = open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC);
+
     // Initialize ncurses
     initscr();
     noecho();
@@ -34,103 +67,360 @@ GameState* initializeGame(void) {
     if (has_colors()) {
         initializeColors();
     }
-    
+}
+
+GameState* initializeGame(const char* storyPath) {
+    // Load the story before taking over the terminal so errors stay readable
+    Story* story = storyPath ? openStoryFile(storyPath) : compileBuiltinStory();
+    if (!story) return NULL;
+
+    startDisplay();
+
     GameState* game = (GameState*)malloc(sizeof(GameState));
-    if (!game) return NULL;
+    if (!game) {
+        closeStory(story);
+        return NULL;
+    }
 
-    game->player = createCharacter();
-    if (!game->player) {
+    Character* player = (Character*)malloc(sizeof(Character));
+    if (!player) {
+        closeStory(story);
         free(game);
         return NULL;
     }
 
-    game->currentScene = initializeStory();
-    game->currentChapter = 1;
-    game->reputation = 0;
-    game->isGameOver = 0;
-    game->inventoryCount = 0;
-    game->choiceHistoryCount = 0;
-
+    initializeCharacter(player, "", WARRIOR);
+    initializeGameState(game, player, story);
     return game;
 }
 
-void displayCurrentScene(GameState* game) {
-    clear();
-    
-    // Display chapter title
-    attron(COLOR_PAIR(COLOR_TITLE_PAIR) | A_BOLD);
-    mvprintw(1, 1, "=== Chapter %d ===", game->currentChapter);
-    attroff(COLOR_PAIR(COLOR_TITLE_PAIR) | A_BOLD);
-    
+void setFullRedraw(int enabled) {
+    fullRedraw = enabled;
+}
+
+const RenderStats* getRenderStats(void) {
+    return &renderStats;
+}
+
+const TurnMetrics* getTurnMetrics(void) {
+    return &turnMetrics;
+}
+
+void writeTurnMetrics(FILE* out, void* context) {
+    (void)context;
+
+    // Copy under the lock so the game is never held up by a slow client
+    TurnMetrics metrics;
+    RenderStats render;
+    pthread_mutex_lock(&metricsLock);
+    metrics = turnMetrics;
+    render = renderStats;
+    pthread_mutex_unlock(&metricsLock);
+
+    writeHistogram(out, "rpg_render_seconds", "Time to compose and present one frame", &metrics.render);
+    writeHistogram(out, "rpg_input_to_render_seconds",
+                   "Time from reading an input line to showing the first frame it produced",
+                   &metrics.inputToRender);
+    writeHistogram(out, "rpg_save_seconds", "Time to save the game after a turn", &metrics.save);
+    writeCounter(out, "rpg_choices_entered_total", "Input lines read while a scene was shown",
+                 metrics.choicesEntered);
+    writeCounter(out, "rpg_turns_total", "Choices applied", metrics.turns);
+    writeCounter(out, "rpg_invalid_choices_total", "Choices that were not a listed number",
+                 metrics.invalidChoices);
+    writeCounter(out, "rpg_locked_choices_total", "Choices whose requirements the player did not meet",
+                 metrics.lockedChoices);
+    writeCounter(out, "rpg_save_failures_total", "Saves that failed", metrics.saveFailures);
+    writeCounter(out, "rpg_frames_total", "Frames presented", render.frames);
+    writeCounter(out, "rpg_inputs_total", "Player inputs answered", render.inputs);
+    writeCounter(out, "rpg_render_bytes_total", "Bytes sent to the terminal", render.bytes);
+}
+
+void beginFrame(void) {
+    frameStart = monotonicNanoseconds();
+    if (fullRedraw) {
+        clear();
+    } else {
+        // Keep the last frame as the baseline so refresh() only sends what changed
+        erase();
+    }
+}
+
+/**
+ * @brief Reads how many bytes the drawing thread has written so far
+ * @return Bytes written, or 0 if the kernel does not report them
+ */
+static unsigned long long writtenBytes(void) {
+    char text[512];
+    ssize_t length = pread(threadIo, text, sizeof(text) - 1, 0);
+    if (length <= 0) return 0;
+    text[length] = '\0';
+    const char* field = strstr(text, "wchar:");
+    return field ? strtoull(field + 6, NULL, 10) : 0;
+}
+
+void presentFrame(void) {
+    // Overlays drawn without beginFrame() are timed from here
+    uint64_t start = frameStart ? frameStart : monotonicNanoseconds();
+
+    // refresh() has written every escape sequence and cell it sends by the
+    // time it returns, so the difference is exactly this frame's output
+    unsigned long long written = writtenBytes();
+    refresh();
+    uint64_t end = monotonicNanoseconds();
+    unsigned long long bytes = writtenBytes() - written;
+
+    pthread_mutex_lock(&metricsLock);
+    renderStats.frames++;
+    renderStats.bytes += bytes;
+    recordLatency(&turnMetrics.render, end - start);
+    if (inputReadAt) {
+        recordLatency(&turnMetrics.inputToRender, end - inputReadAt);
+        inputReadAt = 0;
+    }
+    pthread_mutex_unlock(&metricsLock);
+    frameStart = 0;
+}
+
+/**
+ * @brief Gets the wrapped layout of the current scene for the current terminal width
+ */
+static const SceneLayout* layoutCurrentScene(const GameState* game) {
+    if (haveSceneLayouts && sceneLayouts.story != game->story) {
+        freeLayoutCache(&sceneLayouts);
+        haveSceneLayouts = 0;
+    }
+    if (!haveSceneLayouts) {
+        haveSceneLayouts = initLayoutCache(&sceneLayouts, game->story, COLS - 2) == 0;
+        if (!haveSceneLayouts) return NULL;
+    }
+    return getSceneLayout(&sceneLayouts, game->currentScene);
+}
+
+/**
+ * @brief Draws one part of a requirement label green if the player meets it, red if not
+ */
+static void drawLabelPart(int row, int column, const char* label, LabelPart part, int met) {
+    int width = COLS - 1 - column - part.start;
+    if (!part.length || width <= 0) return;
+    attron(COLOR_PAIR(met ? COLOR_HEADER_PAIR : COLOR_ERROR_PAIR));
+    mvaddnstr(row, column + part.start, label + part.start, part.length < width ? part.length : width);
+}
+
+/**
+ * @brief Draws a scene's wrapped description and choices between the title and the prompt
+ */
+static void drawSceneLayout(const GameState* game, const SceneLayout* layout) {
+    // The choices always fit; the description gets whatever rows are left
+    int bottom = LINES - 3;
+    int choiceRows = 0;
+    for (int i = 0; i < layout->numChoices; i++) {
+        choiceRows += layout->choices[i].lineCount;
+    }
+    int descriptionRows = bottom - 3 - choiceRows - 3;
+    if (descriptionRows > layout->descriptionLines) descriptionRows = layout->descriptionLines;
+    if (descriptionRows < 0) descriptionRows = 0;
+
     // Display scene description
+    int row = 3;
     attron(COLOR_PAIR(COLOR_NORMAL_PAIR));
-    mvprintw(3, 1, "%s", game->currentScene->description);
+    for (int i = 0; i < descriptionRows; i++) {
+        mvaddnstr(row++, 1, layout->lines[i].text, (int)layout->lines[i].length);
+    }
     attroff(COLOR_PAIR(COLOR_NORMAL_PAIR));
     
+    // One compare tells which stat of which choice the player meets
+    const StoryRecord* node = &game->story->nodes[game->currentScene];
+    unsigned int met = compareRequirements(node, packStats(game->player));
+    ConditionContext context;
+    loadConditionContext(&context, game);
+
     // Display choices
+    row++;
     attron(COLOR_PAIR(COLOR_CHOICE_PAIR));
-    mvprintw(6, 1, "What will you do?\n\n");
-    for (int i = 0; i < game->currentScene->numChoices; i++) {
-        mvprintw(8 + i, 1, "%d. %s", i + 1, game->currentScene->choices[i]);
-        const int* req = game->currentScene->requirements[i];
-        if (req[0] > 0 || req[1] > 0 || req[2] > 0) {
+    mvprintw(row, 1, "What will you do?");
+    row += 2;
+    for (int i = 0; i < layout->numChoices && row < bottom; i++) {
+        const ChoiceLayout* choice = &layout->choices[i];
+        mvprintw(row, 1, "%d.", i + 1);
+        for (int line = 0; line < choice->lineCount && row + line < bottom; line++) {
+            const LayoutLine* text = &layout->lines[choice->firstLine + line];
+            mvaddnstr(row + line, 1 + CHOICE_INDENT, text->text, (int)text->length);
+        }
+        if (choice->requirement && row + choice->requirementRow < bottom) {
+            int labelRow = row + choice->requirementRow;
+            int column = 1 + CHOICE_INDENT + choice->requirementColumn;
             attron(COLOR_PAIR(COLOR_STAT_PAIR));
-            printw(" (Requires: ");
-            if (req[0] > 0) printw("STR %d ", req[0]);
-            if (req[1] > 0) printw("INT %d ", req[1]);
-            if (req[2] > 0) printw("CHA %d", req[2]);
-            printw(")");
-            attroff(COLOR_PAIR(COLOR_STAT_PAIR));
+            mvaddnstr(labelRow, column, choice->requirement, COLS - 1 - column);
+
+            // Each stat and the condition are colored by whether the player meets them
+            for (int stat = 0; stat < REQUIREMENT_LANES - 1; stat++) {
+                int lane = i * REQUIREMENT_LANES + stat;
+                drawLabelPart(labelRow, column, choice->requirement, choice->stats[stat], met & (1u << lane));
+            }
+            if (choice->condition.length) {
+                const uint8_t* condition = getChoiceCondition(game->story, node, i);
+                drawLabelPart(labelRow, column, choice->requirement, choice->condition,
+                              condition && evaluateCondition(condition, &context));
+            }
+            attron(COLOR_PAIR(COLOR_CHOICE_PAIR));
         }
-        printw("\n");
+        row += choice->lineCount;
     }
     attroff(COLOR_PAIR(COLOR_CHOICE_PAIR));
-    
-    refresh();
 }
 
-void processPlayerChoice(GameState* game) {
-    mvprintw(LINES - 2, 1, "Enter your choice (1-%d): ", game->currentScene->numChoices);
-    refresh();
-    
-    char input[10];
-    echo();
-    getnstr(input, sizeof(input) - 1);
-    noecho();
+void displayCurrentScene(GameState* game) {
+    beginFrame();
     
-    int choice = atoi(input);
+    // Display chapter title
+    attron(COLOR_PAIR(COLOR_TITLE_PAIR) | A_BOLD);
+    mvprintw(1, 1, "=== Chapter %d ===", game->currentChapter);
+    attroff(COLOR_PAIR(COLOR_TITLE_PAIR) | A_BOLD);
 
-    if (choice < 1 || choice > game->currentScene->numChoices) {
-        attron(COLOR_PAIR(COLOR_ERROR_PAIR));
-        mvprintw(LINES - 1, 1, "Invalid choice. Press any key to try again...");
-        attroff(COLOR_PAIR(COLOR_ERROR_PAIR));
-        refresh();
-        getch();
-        return;
+    const SceneLayout* layout = layoutCurrentScene(game);
+    if (layout) {
+        drawSceneLayout(game, layout);
     }
 
-    // Check if player meets the requirements for this choice
-    int* req = game->currentScene->requirements[choice - 1];
-    if (!hasRequiredStats(game->player, req[0], req[1], req[2])) {
-        attron(COLOR_PAIR(COLOR_ERROR_PAIR));
-        mvprintw(LINES - 1, 1, "You don't meet the requirements for this choice. Press any key...");
-        attroff(COLOR_PAIR(COLOR_ERROR_PAIR));
-        refresh();
-        getch();
-        return;
+    // Input is echoed where drawing stopped, so the prompt goes last
+    mvprintw(LINES - 2, 1, "Enter your choice (1-%u): ",
+             game->story->nodes[game->currentScene].numChoices);
+    presentFrame();
+}
+
+static void showMessage(const char* message) {
+    attron(COLOR_PAIR(COLOR_ERROR_PAIR));
+    mvprintw(LINES - 1, 1, "%s", message);
+    attroff(COLOR_PAIR(COLOR_ERROR_PAIR));
+    presentFrame();
+    getch();
+}
+
+static void displayEnding(const GameState* game) {
+    beginFrame();
+    attron(COLOR_PAIR(COLOR_TITLE_PAIR) | A_BOLD);
+    mvprintw(LINES/2 - 1, 1, "Your story has come to an end. Farewell, %s.", game->player->name);
+    attroff(COLOR_PAIR(COLOR_TITLE_PAIR) | A_BOLD);
+    mvprintw(LINES - 1, 1, "Press any key to exit...");
+    presentFrame();
+    getch();
+}
+
+void displayFrames(Session* session, const SessionOutput* output) {
+    GameState* game = session->game;
+
+    for (int i = 0; i < output->count; i++) {
+        switch (output->frames[i]) {
+            case FRAME_NAME_PROMPT:
+                displayNamePrompt();
+                break;
+            case FRAME_CLASS_PROMPT:
+            case FRAME_CLASS_INVALID:
+                displayClassMenu(game->player);
+                break;
+            case FRAME_CHARACTER:
+                displayCharacterStats(game->player);
+                mvprintw(LINES - 1, 1, "Press any key to begin your adventure...");
+                presentFrame();
+                getch();
+                break;
+            case FRAME_SCENE:
+                displayCurrentScene(game);
+                break;
+            case FRAME_CHOICE_INVALID:
+                showMessage("Invalid choice. Press any key to try again...");
+                displayCurrentScene(game);
+                break;
+            case FRAME_CHOICE_LOCKED:
+                showMessage("You don't meet the requirements for this choice. Press any key...");
+                displayCurrentScene(game);
+                break;
+            case FRAME_PREVIEW: {
+                char text[MAX_PREVIEW_TEXT];
+                char message[MAX_PREVIEW_TEXT + 48];
+                formatChoicePreview(&output->preview, game, text, sizeof(text));
+                snprintf(message, sizeof(message), "Choice %d: %s. Press any key...", output->preview.choice + 1, text);
+                showMessage(message);
+                displayCurrentScene(game);
+                break;
+            }
+            case FRAME_UNDO_INVALID:
+                showMessage("There are not that many turns to undo. Press any key...");
+                displayCurrentScene(game);
+                break;
+            case FRAME_ENDING:
+                displayEnding(game);
+                break;
+            case FRAME_FAREWELL:
+                break;
+        }
     }
 
-    game->choiceHistory[game->choiceHistoryCount++] = choice;
+    pthread_mutex_lock(&metricsLock);
+    for (int i = 0; i < output->count; i++) {
+        if (output->frames[i] == FRAME_CHOICE_INVALID) turnMetrics.invalidChoices++;
+        if (output->frames[i] == FRAME_CHOICE_LOCKED) turnMetrics.lockedChoices++;
+    }
+    unsigned long long inputBytes = renderStats.bytes - inputMark;
+    inputMark = renderStats.bytes;
+    renderStats.inputs++;
+    if (inputBytes > renderStats.maxInputBytes) {
+        renderStats.maxInputBytes = inputBytes;
+    }
+    pthread_mutex_unlock(&metricsLock);
+}
+
+/**
+ * @brief Shows the screen the session is waiting on again
+ */
+static void redrawSession(Session* session) {
+    switch (session->phase) {
+        case SESSION_NAME:
+            displayNamePrompt();
+            break;
+        case SESSION_CLASS:
+            displayClassMenu(session->game->player);
+            break;
+        case SESSION_PLAYING:
+            displayCurrentScene(session->game);
+            break;
+        case SESSION_OVER:
+            break;
+    }
+}
 
-    if (game->currentScene->consequence) {
-        game->currentScene->consequence(game);
+void processPlayerInput(Session* session, SessionOutput* output) {
+    char input[MAX_NAME_LENGTH];
+    int result;
+    echo();
+    while ((result = getnstr(input, sizeof(input) - 1)) == KEY_RESIZE) {
+        // The terminal was resized; rewrap for the new width and ask again
+        if (haveSceneLayouts) setLayoutWidth(&sceneLayouts, COLS - 2);
+        redrawSession(session);
     }
+    if (result == ERR) {
+        // The terminal has gone away
+        strcpy(input, "quit");
+    }
+    noecho();
+
+    // Latency is measured from here to the first frame that answers the input
+    inputReadAt = monotonicNanoseconds();
+    int choosing = session->phase == SESSION_PLAYING;
+    feedSession(session, input, output);
 
-    game->currentScene = game->currentScene->nextNodes[choice - 1];
+    pthread_mutex_lock(&metricsLock);
+    if (choosing) turnMetrics.choicesEntered++;
+    if (output->applied) turnMetrics.turns++;
+    pthread_mutex_unlock(&metricsLock);
 }
 
 void cleanupDisplay(void) {
     endwin();
+    if (threadIo >= 0) {
+        close(threadIo);
+        threadIo = -1;
+    }
 }
 
 void cleanupGame(GameState* game) {
@@ -138,52 +428,78 @@ void cleanupGame(GameState* game) {
         if (game->player) {
             free(game->player);
         }
-        cleanupStory(game->currentScene);
+        closeSaveLog(game->saveLog);
+        if (haveSceneLayouts) {
+            renderStats.layouts = sceneLayouts.builds;
+            freeLayoutCache(&sceneLayouts);
+            haveSceneLayouts = 0;
+        }
+        releaseGameChapter(game);
+        closeStory(game->story);
+        freeGameHistory(game);
         free(game);
     }
     cleanupDisplay();
 }
 
-void updateGameState(GameState* game) {
-    if (!game->currentScene) {
-        game->isGameOver = 1;
+int saveGame(GameState* game) {
+    uint64_t start = monotonicNanoseconds();
+    if (!game->saveLog) {
+        game->saveLog = openSaveLog(SAVE_GAME_FILE);
     }
+    int result = game->saveLog ? appendSave(game->saveLog, game) : -1;
+    uint64_t end = monotonicNanoseconds();
+
+    pthread_mutex_lock(&metricsLock);
+    recordLatency(&turnMetrics.save, end - start);
+    if (result < 0) turnMetrics.saveFailures++;
+    pthread_mutex_unlock(&metricsLock);
+    return result;
 }
 
-void saveGame(GameState* game) {
-    FILE* file = fopen("savegame.dat", "wb");
-    if (!file) {
-        printf("Error: Could not save game.\n");
-        return;
+GameState* loadGame(const char* storyPath) {
+    Story* story = storyPath ? openStoryFile(storyPath) : compileBuiltinStory();
+    if (!story) return NULL;
+
+    GameState* game = (GameState*)malloc(sizeof(GameState));
+    Character* player = (Character*)malloc(sizeof(Character));
+    if (!game || !player || readSaveFile(SAVE_GAME_FILE, game, player, story) < 0) {
+        closeStory(story);
+        free(player);
+        free(game);
+        return NULL;
     }
 
-    fwrite(game, sizeof(GameState), 1, file);
-    fclose(file);
-    printf("Game saved successfully!\n");
+    startDisplay();
+    return game;
 }
 
-GameState* loadGame(void) {
-    FILE* file = fopen("savegame.dat", "rb");
-    if (!file) {
-        printf("No saved game found.\n");
-        return NULL;
-    }
+GameState* replayGame(const char* storyPath, const char* token) {
+    ReplayLog log;
+    if (parseReplayToken(token, &log) < 0) return NULL;
 
+    Story* story = storyPath ? openStoryFile(storyPath) : compileBuiltinStory();
     GameState* game = (GameState*)malloc(sizeof(GameState));
-    if (!game) {
-        fclose(file);
+    Character* player = (Character*)malloc(sizeof(Character));
+    if (!story || !game || !player || restoreReplay(&log, game, player, story) < 0) {
+        freeReplayLog(&log);
+        closeStory(story);
+        free(player);
+        free(game);
         return NULL;
     }
+    freeReplayLog(&log);
 
-    fread(game, sizeof(GameState), 1, file);
-    fclose(file);
+    startDisplay();
     return game;
 }
 
-void addToInventory(GameState* game, const char* item) {
-    if (game->inventoryCount < MAX_INVENTORY_SIZE) {
-        strncpy(game->inventory[game->inventoryCount], item, 49);
-        game->inventory[game->inventoryCount][49] = '\0';
-        game->inventoryCount++;
-    }
+int addToInventory(GameState* game, const char* item) {
+    int id = internName(NAME_ITEM, item);
+    return id >= 0 && addItem(game, id) == 1 ? 0 : -1;
+}
+
+int removeFromInventory(GameState* game, const char* item) {
+    int id = findName(NAME_ITEM, item);
+    return id >= 0 && removeItem(game, id) == 1 ? 0 : -1;
 } 
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/layout.h"
+#include "../include/condition.h"
+
+#define REQUIREMENT_LABEL_SIZE 160
+
+/**
+ * @brief Decodes one UTF-8 code point
+ * @param text Start of the code point
+ * @param size Receives the number of bytes it takes
+ * @return The code point; a malformed byte decodes as itself with size 1
+ */
+static uint32_t decodeUtf8(const unsigned char* text, int* size) {
+    uint32_t c = text[0];
+    int length = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 0;
+
+    if (length <= 1) {
+        *size = 1;
+        return c;
+    }
+
+    c &= 0x7F >> length;
+    for (int i = 1; i < length; i++) {
+        if ((text[i] & 0xC0) != 0x80) {
+            *size = 1;
+            return text[0];
+        }
+        c = (c << 6) | (text[i] & 0x3F);
+    }
+    *size = length;
+    return c;
+}
+
+/**
+ * @brief Display columns of a code point: 0 for combining marks, 2 for wide East Asian text
+ */
+static int codePointColumns(uint32_t c) {
+    if (c < 0x300) return 1;
+    if (c <= 0x36F || (c >= 0x200B && c <= 0x200F) || (c >= 0xFE00 && c <= 0xFE0F)) return 0;
+    if ((c >= 0x1100 && c <= 0x115F) || (c >= 0x2E80 && c <= 0xA4CF && c != 0x303F) ||
+        (c >= 0xAC00 && c <= 0xD7A3) || (c >= 0xF900 && c <= 0xFAFF) ||
+        (c >= 0xFE30 && c <= 0xFE4F) || (c >= 0xFF00 && c <= 0xFF60) ||
+        (c >= 0xFFE0 && c <= 0xFFE6) || (c >= 0x1F300 && c <= 0x1F64F) ||
+        (c >= 0x1F900 && c <= 0x1F9FF) || (c >= 0x20000 && c <= 0x3FFFD)) {
+        return 2;
+    }
+    return 1;
+}
+
+int textColumns(const char* text, size_t length) {
+    const unsigned char* at = (const unsigned char*)text;
+    const unsigned char* end = at + length;
+    int columns = 0;
+
+    while (at < end) {
+        int size;
+        columns += codePointColumns(decodeUtf8(at, &size));
+        at += size;
+    }
+    return columns;
+}
+
+/**
+ * @brief Wraps text at word boundaries
+ * @param text NUL-terminated UTF-8 text; newlines force a line break
+ * @param width Columns per line
+ * @param lines Receives up to maxLines lines, or NULL to only count them
+ * @param maxLines Size of lines
+ * @return Number of lines the text needs, which may exceed maxLines
+ * @details A word longer than a whole line is broken between code points.
+ */
+static int wrapText(const char* text, int width, LayoutLine* lines, int maxLines) {
+    const unsigned char* at = (const unsigned char*)text;
+    int count = 0;
+
+    while (*at) {
+        const unsigned char* start = at;
+        const unsigned char* wordEnd = NULL;
+        const unsigned char* end;
+        int columns = 0;
+        int wrapped = 0;
+
+        for (;;) {
+            if (*at == '\0' || *at == '\n') {
+                end = at;
+                if (*at) at++;
+                break;
+            }
+            if (*at == ' ') {
+                // Spaces never overflow a line; they are trimmed where it wraps
+                if (at > start && at[-1] != ' ') wordEnd = at;
+                columns++;
+                at++;
+                continue;
+            }
+
+            int size;
+            int advance = codePointColumns(decodeUtf8(at, &size));
+            if (columns + advance > width && columns > 0) {
+                if (wordEnd) at = wordEnd;
+                end = at;
+                wrapped = 1;
+                break;
+            }
+            columns += advance;
+            at += size;
+        }
+
+        while (end > start && end[-1] == ' ') end--;
+        if (lines && count < maxLines) {
+            lines[count].text = (const char*)start;
+            lines[count].length = (uint32_t)(end - start);
+        }
+        count++;
+
+        if (wrapped) {
+            while (*at == ' ') at++;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Formats the requirement label of a choice: its stat minimums and condition
+ * @param layout Receives where each stat term and the condition are in the label
+ * @return Length of the label, or 0 if the choice has neither
+ */
+static int formatRequirement(const Story* story, const StoryRecord* record, int choice,
+                             ChoiceLayout* layout, char* label, size_t size) {
+    static const char* statNames[] = {"STR", "INT", "CHA"};
+    const uint8_t* requirement = record->requirements[choice];
+    int length = 0;
+
+    memset(layout->stats, 0, sizeof(layout->stats));
+    for (int stat = 0; stat < REQUIREMENT_LANES - 1; stat++) {
+        if (requirement[stat] == 0) continue;
+        length += snprintf(label + length, size - (size_t)length, "%s", length ? " " : "(Requires: ");
+        int written = snprintf(label + length, size - (size_t)length, "%s %d", statNames[stat], requirement[stat]);
+        layout->stats[stat].start = (uint8_t)length;
+        layout->stats[stat].length = (uint8_t)written;
+        length += written;
+    }
+    if (length) length += snprintf(label + length, size - (size_t)length, ")");
+
+    layout->condition.start = 0;
+    layout->condition.length = 0;
+    const uint8_t* condition = getChoiceCondition(story, record, choice);
+    char text[MAX_CONDITION_TEXT];
+    if (condition && formatCondition(condition, text, sizeof(text)) >= 0) {
+        if (length) length += snprintf(label + length, size - (size_t)length, " ");
+
+        // A long condition is cut at the label size; it is drawn on one row anyway
+        int written = snprintf(label + length, size - (size_t)length, "(If: %s)", text);
+        if ((size_t)written >= size - (size_t)length) written = (int)size - 1 - length;
+        layout->condition.start = (uint8_t)length;
+        layout->condition.length = (uint8_t)written;
+        length += written;
+    }
+    label[length] = '\0';
+    return length;
+}
+
+/**
+ * @brief Lays out one node at the cache's width
+ */
+static SceneLayout* buildSceneLayout(LayoutCache* cache, int node) {
+    const Story* story = cache->story;
+    const StoryRecord* record = &story->nodes[node];
+    int descriptionWidth = cache->width;
+    int choiceWidth = cache->width - CHOICE_INDENT;
+    char labels[MAX_CHOICES][REQUIREMENT_LABEL_SIZE];
+    int labelLengths[MAX_CHOICES];
+
+    SceneLayout* layout = (SceneLayout*)arenaAlloc(&cache->arena, sizeof(SceneLayout));
+    if (!layout) return NULL;
+
+    // Count the lines first so they can be stored in one block
+    const char* description = getNodeDescription(story, node);
+    int total = wrapText(description, descriptionWidth, NULL, 0);
+    layout->descriptionLines = (uint16_t)total;
+    layout->numChoices = (uint16_t)record->numChoices;
+
+    for (uint32_t i = 0; i < record->numChoices; i++) {
+        ChoiceLayout* choice = &layout->choices[i];
+        int lineCount = wrapText(getChoiceText(story, node, (int)i), choiceWidth, NULL, 0);
+        if (lineCount == 0) lineCount = 1;
+
+        labelLengths[i] = formatRequirement(story, record, (int)i, choice, labels[i], sizeof(labels[i]));
+        choice->firstLine = (uint16_t)total;
+        choice->lineCount = (uint16_t)lineCount;
+        choice->requirement = NULL;
+        total += lineCount + (labelLengths[i] ? 1 : 0);
+    }
+
+    LayoutLine* lines = (LayoutLine*)arenaAlloc(&cache->arena, sizeof(LayoutLine) * (size_t)(total ? total : 1));
+    if (!lines) return NULL;
+    wrapText(description, descriptionWidth, lines, layout->descriptionLines);
+
+    for (uint32_t i = 0; i < record->numChoices; i++) {
+        ChoiceLayout* choice = &layout->choices[i];
+        LayoutLine* choiceLines = lines + choice->firstLine;
+        choiceLines[0].text = "";
+        choiceLines[0].length = 0;
+        wrapText(getChoiceText(story, node, (int)i), choiceWidth, choiceLines, choice->lineCount);
+
+        if (!labelLengths[i]) continue;
+
+        char* label = (char*)arenaAlloc(&cache->arena, (size_t)labelLengths[i] + 1);
+        if (!label) return NULL;
+        memcpy(label, labels[i], (size_t)labelLengths[i] + 1);
+        choice->requirement = label;
+
+        // The label follows the last line if it fits, otherwise it gets a line of its own
+        const LayoutLine* last = &choiceLines[choice->lineCount - 1];
+        int lastColumns = textColumns(last->text, last->length);
+        if (lastColumns + 1 + labelLengths[i] <= choiceWidth) {
+            choice->requirementRow = (uint16_t)(choice->lineCount - 1);
+            choice->requirementColumn = (uint16_t)(lastColumns ? lastColumns + 1 : 0);
+        } else {
+            choiceLines[choice->lineCount].text = "";
+            choiceLines[choice->lineCount].length = 0;
+            choice->requirementRow = choice->lineCount++;
+            choice->requirementColumn = 0;
+        }
+    }
+
+    layout->lines = lines;
+    cache->builds++;
+    return layout;
+}
+
+int initLayoutCache(LayoutCache* cache, const Story* story, int width) {
+    cache->story = story;
+    cache->width = width < LAYOUT_MIN_WIDTH ? LAYOUT_MIN_WIDTH : width;
+    cache->builds = 0;
+    initArena(&cache->arena, 0);
+    cache->scenes = (SceneLayout**)calloc(story->header->nodeCount ? story->header->nodeCount : 1,
+                                          sizeof(SceneLayout*));
+    return cache->scenes ? 0 : -1;
+}
+
+void setLayoutWidth(LayoutCache* cache, int width) {
+    if (width < LAYOUT_MIN_WIDTH) width = LAYOUT_MIN_WIDTH;
+    if (width == cache->width) return;
+
+    cache->width = width;
+    memset(cache->scenes, 0, sizeof(SceneLayout*) * cache->story->header->nodeCount);
+    releaseArena(&cache->arena);
+}
+
+const SceneLayout* getSceneLayout(LayoutCache* cache, int node) {
+    if (!cache->scenes[node]) {
+        cache->scenes[node] = buildSceneLayout(cache, node);
+    }
+    return cache->scenes[node];
+}
+
+void freeLayoutCache(LayoutCache* cache) {
+    releaseArena(&cache->arena);
+    free(cache->scenes);
+    cache->scenes = NULL;
+}
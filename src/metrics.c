@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "../include/metrics.h"
+
+/* A client that stops reading is dropped after this long */
+#define CLIENT_SEND_TIMEOUT_SECONDS 1
+
+struct MetricsServer {
+    int listenFd;               /* Listening socket */
+    pthread_t thread;           /* Thread accepting clients */
+    char* path;                 /* Socket path, removed when the server stops */
+    MetricsWriter writer;       /* Writes each snapshot */
+    void* context;              /* Passed to writer */
+};
+
+uint64_t monotonicNanoseconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec + 1;
+}
+
+/**
+ * @brief Gets the bucket of a value
+ * @details Values below HISTOGRAM_SUB_BUCKETS have a bucket each; above that,
+ *          the top HISTOGRAM_SUB_BITS + 1 bits of a value pick its bucket
+ *          within its power of two.
+ */
+static int bucketIndex(uint64_t value) {
+    if (value < HISTOGRAM_SUB_BUCKETS) return (int)value;
+
+    int magnitude = 63 - __builtin_clzll(value);
+    if (magnitude >= HISTOGRAM_MAGNITUDES) return HISTOGRAM_BUCKETS - 1;
+    int shift = magnitude - HISTOGRAM_SUB_BITS;
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS + (int)(value >> shift) - HISTOGRAM_SUB_BUCKETS;
+}
+
+/**
+ * @brief Gets the largest value that falls in a bucket
+ */
+static uint64_t bucketUpperBound(int index) {
+    if (index < HISTOGRAM_SUB_BUCKETS) return (uint64_t)index;
+
+    int shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+    uint64_t sub = (uint64_t)(index % HISTOGRAM_SUB_BUCKETS);
+    return ((HISTOGRAM_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+void recordLatency(LatencyHistogram* histogram, uint64_t nanoseconds) {
+    histogram->counts[bucketIndex(nanoseconds)]++;
+    if (histogram->count == 0 || nanoseconds < histogram->min) histogram->min = nanoseconds;
+    if (nanoseconds > histogram->max) histogram->max = nanoseconds;
+    histogram->count++;
+    histogram->sum += nanoseconds;
+}
+
+uint64_t getLatencyPercentile(const LatencyHistogram* histogram, double fraction) {
+    if (histogram->count == 0) return 0;
+
+    // Rank of the value wanted, 1-based
+    uint64_t rank = (uint64_t)(fraction * (double)histogram->count + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > histogram->count) rank = histogram->count;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            uint64_t bound = bucketUpperBound(i);
+            return bound < histogram->max ? bound : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+void writeHistogram(FILE* out, const char* name, const char* help, const LatencyHistogram* histogram) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+
+    uint64_t cumulative = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (!histogram->counts[i]) continue;
+        cumulative += histogram->counts[i];
+        fprintf(out, "%s_bucket{le=\"%.9g\"} %llu\n", name, (double)bucketUpperBound(i) / 1e9,
+                (unsigned long long)cumulative);
+    }
+    fprintf(out, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)histogram->count);
+    fprintf(out, "%s_sum %.9f\n", name, (double)histogram->sum / 1e9);
+    fprintf(out, "%s_count %llu\n", name, (unsigned long long)histogram->count);
+}
+
+void writeCounter(FILE* out, const char* name, const char* help, unsigned long long value) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", name, help, name, name, value);
+}
+
+/**
+ * @brief Sends one snapshot to a client and disconnects it
+ */
+static void serveClient(MetricsServer* server, int client) {
+    char* text = NULL;
+    size_t length = 0;
+    FILE* out = open_memstream(&text, &length);
+    if (out) {
+        server->writer(out, server->context);
+        fclose(out);
+
+        struct timeval timeout = {CLIENT_SEND_TIMEOUT_SECONDS, 0};
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        size_t sent = 0;
+        while (sent < length) {
+            ssize_t written = send(client, text + sent, length - sent, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) break;
+            sent += (size_t)written;
+        }
+    }
+    free(text);
+    close(client);
+}
+
+static void* serverMain(void* argument) {
+    MetricsServer* server = (MetricsServer*)argument;
+    for (;;) {
+        int client = accept(server->listenFd, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            // The listening socket was shut down
+            break;
+        }
+        serveClient(server, client);
+    }
+    return NULL;
+}
+
+MetricsServer* startMetricsServer(const char* path, MetricsWriter writer, void* context) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) return NULL;
+    strcpy(address.sun_path, path);
+
+    MetricsServer* server = (MetricsServer*)malloc(sizeof(MetricsServer));
+    if (!server) return NULL;
+    server->path = strdup(path);
+    server->writer = writer;
+    server->context = context;
+    server->listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (!server->path || server->listenFd < 0) {
+        if (server->listenFd >= 0) close(server->listenFd);
+        free(server->path);
+        free(server);
+        return NULL;
+    }
+
+    // Only a socket left by an earlier run is replaced, never another file
+    struct stat existing;
+    if (lstat(path, &existing) == 0 && S_ISSOCK(existing.st_mode)) {
+        unlink(path);
+    }
+
+    if (bind(server->listenFd, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+        listen(server->listenFd, 8) < 0) {
+        close(server->listenFd);
+        free(server->path);
+        free(server);
+        return NULL;
+    }
+
+    // Signals such as SIGWINCH must keep going to the thread running the display
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    int failed = pthread_create(&server->thread, NULL, serverMain, server);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (failed) {
+        close(server->listenFd);
+        unlink(path);
+        free(server->path);
+        free(server);
+        return NULL;
+    }
+    return server;
+}
+
+void stopMetricsServer(MetricsServer* server) {
+    if (!server) return;
+
+    // Shutting the socket down makes the pending accept() fail
+    shutdown(server->listenFd, SHUT_RDWR);
+    pthread_join(server->thread, NULL);
+    close(server->listenFd);
+    unlink(server->path);
+    free(server->path);
+    free(server);
+}
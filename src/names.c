@@ -0,0 +1,82 @@
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "../include/names.h"
+
+#define NAME_SLOTS (MAX_ITEMS * 2)
+
+/**
+ * @struct Registry
+ * @brief Names of one kind
+ * @details Names are only ever appended, so a name is readable without the
+ *          lock once its id is known.
+ */
+typedef struct {
+    char names[MAX_ITEMS][MAX_REGISTERED_NAME];     /**< Names by id */
+    _Atomic int count;                              /**< Names registered */
+    int16_t slots[NAME_SLOTS];                      /**< Open-addressing table of id + 1, 0 when empty */
+} Registry;
+
+static pthread_mutex_t nameLock = PTHREAD_MUTEX_INITIALIZER;
+static Registry registries[NAME_KINDS];
+static const int capacities[NAME_KINDS] = {MAX_ITEMS, MAX_TRAIT_IDS, MAX_FLAGS};
+
+static uint32_t hashName(const char* name) {
+    uint32_t hash = 2166136261u;
+    for (; *name; name++) {
+        hash ^= (unsigned char)*name;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Finds the slot holding a name, or the empty slot it would go in
+ * @details Call with nameLock held.
+ */
+static int findSlot(const Registry* registry, const char* name) {
+    int slot = (int)(hashName(name) & (NAME_SLOTS - 1));
+    while (registry->slots[slot] && strcmp(registry->names[registry->slots[slot] - 1], name) != 0) {
+        slot = (slot + 1) & (NAME_SLOTS - 1);
+    }
+    return slot;
+}
+
+int internName(NameKind kind, const char* name) {
+    size_t length = strlen(name);
+    if (length == 0 || length >= MAX_REGISTERED_NAME) return -1;
+
+    Registry* registry = &registries[kind];
+    pthread_mutex_lock(&nameLock);
+    int slot = findSlot(registry, name);
+    int id = registry->slots[slot] - 1;
+    if (id < 0) {
+        id = atomic_load_explicit(&registry->count, memory_order_relaxed);
+        if (id < capacities[kind]) {
+            memcpy(registry->names[id], name, length + 1);
+            registry->slots[slot] = (int16_t)(id + 1);
+            atomic_store_explicit(&registry->count, id + 1, memory_order_release);
+        } else {
+            id = -1;
+        }
+    }
+    pthread_mutex_unlock(&nameLock);
+    return id;
+}
+
+int findName(NameKind kind, const char* name) {
+    if (strlen(name) >= MAX_REGISTERED_NAME) return -1;
+
+    pthread_mutex_lock(&nameLock);
+    int id = registries[kind].slots[findSlot(&registries[kind], name)] - 1;
+    pthread_mutex_unlock(&nameLock);
+    return id;
+}
+
+const char* getName(NameKind kind, int id) {
+    return registries[kind].names[id];
+}
+
+int getNameCount(NameKind kind) {
+    return atomic_load_explicit(&registries[kind].count, memory_order_acquire);
+}
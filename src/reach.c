@@ -0,0 +1,415 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/reach.h"
+
+#define LABEL_BUCKETS (3 * 255 + 1)    /**< One bucket per possible sum of three stat lanes */
+
+/**
+ * @struct Frontier
+ * @brief Working frontier of one node during a pass; points live in the builder's pool
+ */
+typedef struct {
+    uint32_t first;             /**< Index of the first point in the pool */
+    uint32_t count;             /**< Number of points */
+    uint32_t capacity;          /**< Points that fit before the frontier must move */
+} Frontier;
+
+/**
+ * @struct Label
+ * @brief Candidate frontier point of a node, waiting in its bucket
+ */
+typedef struct {
+    uint32_t node;              /**< Node the point would belong to */
+    StatVector point;           /**< Stats that reach the ending from the node */
+} Label;
+
+/**
+ * @struct LabelBucket
+ * @brief Candidates sharing one sum of stats
+ */
+typedef struct {
+    Label* labels;
+    size_t count;
+    size_t capacity;
+} LabelBucket;
+
+/**
+ * @struct PendingEntry
+ * @brief Finished frontier waiting to be sorted into the index by node
+ */
+typedef struct {
+    uint32_t node;              /**< Node the frontier belongs to */
+    ReachEntry entry;           /**< The frontier */
+} PendingEntry;
+
+/**
+ * @struct ReachBuilder
+ * @brief Scratch state shared by the passes of one build
+ */
+typedef struct {
+    const Story* story;
+    uint32_t nodeCount;
+    uint32_t* predecessorStart; /**< Choices into node m are predecessors[predecessorStart[m]] onwards */
+    uint32_t* predecessors;     /**< Choice (node << 2 | choice) leading to each node */
+    Frontier* frontiers;        /**< Working frontier of each node */
+    uint32_t* touched;          /**< Nodes given a frontier in the current pass */
+    uint32_t touchedCount;
+    LabelBucket buckets[LABEL_BUCKETS]; /**< Candidate points by the sum of their stats */
+    StatVector* pool;           /**< Points of the working frontiers */
+    size_t poolSize;
+    size_t poolCapacity;
+    PendingEntry* pending;      /**< Finished frontiers of every pass */
+    size_t pendingCount;
+    size_t pendingCapacity;
+    StatVector* points;         /**< Points of the finished frontiers */
+    size_t pointCount;
+    size_t pointCapacity;
+} ReachBuilder;
+
+static int reserve(void** data, size_t* capacity, size_t needed, size_t size) {
+    if (needed <= *capacity) return 0;
+
+    size_t grown = *capacity ? *capacity : 64;
+    while (grown < needed) grown *= 2;
+    void* moved = realloc(*data, grown * size);
+    if (!moved) return -1;
+    *data = moved;
+    *capacity = grown;
+    return 0;
+}
+
+/**
+ * @brief Checks every lane of have against need
+ */
+static int meets(StatVector have, StatVector need) {
+    for (int lane = 0; lane < REQUIREMENT_LANES; lane++) {
+        if (have.lanes[lane] < need.lanes[lane]) return 0;
+    }
+    return 1;
+}
+
+static StatVector maxStats(StatVector a, const uint8_t* b) {
+    for (int lane = 0; lane < REQUIREMENT_LANES; lane++) {
+        if (b[lane] > a.lanes[lane]) a.lanes[lane] = b[lane];
+    }
+    return a;
+}
+
+static int statSum(StatVector point) {
+    return point.lanes[0] + point.lanes[1] + point.lanes[2];
+}
+
+/**
+ * @brief Checks whether a node's frontier already holds a point as easy as the given one
+ */
+static int isDominated(const ReachBuilder* builder, uint32_t node, StatVector point) {
+    const Frontier* frontier = &builder->frontiers[node];
+    const StatVector* points = builder->pool + frontier->first;
+    for (uint32_t i = 0; i < frontier->count; i++) {
+        if (meets(point, points[i])) return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Queues a candidate point for a node unless its frontier already covers it
+ */
+static int pushLabel(ReachBuilder* builder, uint32_t node, StatVector point) {
+    if (isDominated(builder, node, point)) return 0;
+
+    LabelBucket* bucket = &builder->buckets[statSum(point)];
+    if (reserve((void**)&bucket->labels, &bucket->capacity, bucket->count + 1, sizeof(Label)) < 0) return -1;
+    bucket->labels[bucket->count].node = node;
+    bucket->labels[bucket->count].point = point;
+    bucket->count++;
+    return 0;
+}
+
+/**
+ * @brief Adds a point to a node's frontier for good
+ */
+static int settlePoint(ReachBuilder* builder, uint32_t node, StatVector point) {
+    Frontier* frontier = &builder->frontiers[node];
+
+    if (frontier->capacity == 0) {
+        builder->touched[builder->touchedCount++] = node;
+    }
+    if (frontier->count == frontier->capacity) {
+        // Move to the end of the pool with room to grow; the old slots are reclaimed after the pass
+        uint32_t capacity = frontier->capacity ? frontier->capacity * 2 : 2;
+        if (reserve((void**)&builder->pool, &builder->poolCapacity, builder->poolSize + capacity,
+                    sizeof(StatVector)) < 0) {
+            return -1;
+        }
+        memcpy(builder->pool + builder->poolSize, builder->pool + frontier->first,
+               sizeof(StatVector) * frontier->count);
+        frontier->first = (uint32_t)builder->poolSize;
+        frontier->capacity = capacity;
+        builder->poolSize += capacity;
+    }
+    builder->pool[frontier->first + frontier->count++] = point;
+    return 0;
+}
+
+static int buildPredecessors(ReachBuilder* builder) {
+    const Story* story = builder->story;
+    uint32_t nodeCount = builder->nodeCount;
+    size_t total = 0;
+
+    builder->predecessorStart = (uint32_t*)calloc(nodeCount + 1, sizeof(uint32_t));
+    if (!builder->predecessorStart) return -1;
+
+    for (uint32_t n = 0; n < nodeCount; n++) {
+        const StoryRecord* node = &story->nodes[n];
+        for (uint32_t i = 0; i < node->numChoices && i < MAX_CHOICES; i++) {
+            int32_t next = node->nextNodes[i];
+            if (next >= 0 && (uint32_t)next < nodeCount) {
+                builder->predecessorStart[next + 1]++;
+                total++;
+            }
+        }
+    }
+    for (uint32_t n = 0; n < nodeCount; n++) {
+        builder->predecessorStart[n + 1] += builder->predecessorStart[n];
+    }
+
+    builder->predecessors = (uint32_t*)malloc(sizeof(uint32_t) * (total ? total : 1));
+    uint32_t* fill = (uint32_t*)malloc(sizeof(uint32_t) * nodeCount);
+    if (!builder->predecessors || !fill) {
+        free(fill);
+        return -1;
+    }
+    memcpy(fill, builder->predecessorStart, sizeof(uint32_t) * nodeCount);
+
+    for (uint32_t n = 0; n < nodeCount; n++) {
+        const StoryRecord* node = &story->nodes[n];
+        for (uint32_t i = 0; i < node->numChoices && i < MAX_CHOICES; i++) {
+            int32_t next = node->nextNodes[i];
+            if (next >= 0 && (uint32_t)next < nodeCount) {
+                builder->predecessors[fill[next]++] = n << 2 | i;
+            }
+        }
+    }
+    free(fill);
+    return 0;
+}
+
+/**
+ * @brief Computes every node's frontier for one ending and keeps the non-empty ones
+ */
+static int runPass(ReachBuilder* builder, int ending) {
+    const Story* story = builder->story;
+
+    if (ending == STORY_END) {
+        for (uint32_t n = 0; n < builder->nodeCount; n++) {
+            const StoryRecord* node = &story->nodes[n];
+            for (uint32_t i = 0; i < node->numChoices && i < MAX_CHOICES; i++) {
+                if (node->nextNodes[i] != STORY_END) continue;
+                StatVector point = {{0, 0, 0, 0}};
+                if (pushLabel(builder, n, maxStats(point, node->requirements[i])) < 0) return -1;
+            }
+        }
+    } else {
+        StatVector arrived = {{0, 0, 0, REQUIREMENT_PRESENT}};
+        if (pushLabel(builder, (uint32_t)ending, arrived) < 0) return -1;
+    }
+
+    // Candidates are taken cheapest first. A point can only be as easy as
+    // another if its sum is no larger, so nothing taken later can beat one
+    // already settled and every point is settled and propagated once.
+    for (int sum = 0; sum < LABEL_BUCKETS; sum++) {
+        LabelBucket* bucket = &builder->buckets[sum];
+        // Propagating can add to this bucket, so it is walked by index
+        for (size_t l = 0; l < bucket->count; l++) {
+            Label label = bucket->labels[l];
+            if (isDominated(builder, label.node, label.point)) continue;
+            if (settlePoint(builder, label.node, label.point) < 0) return -1;
+
+            for (uint32_t p = builder->predecessorStart[label.node]; p < builder->predecessorStart[label.node + 1]; p++) {
+                uint32_t from = builder->predecessors[p] >> 2;
+                const uint8_t* requirement = story->nodes[from].requirements[builder->predecessors[p] & 3];
+                if (pushLabel(builder, from, maxStats(label.point, requirement)) < 0) return -1;
+            }
+        }
+        bucket->count = 0;
+    }
+
+    // Keep the finished frontiers and reset the working state for the next pass
+    for (uint32_t t = 0; t < builder->touchedCount; t++) {
+        uint32_t node = builder->touched[t];
+        Frontier* frontier = &builder->frontiers[node];
+
+        if (reserve((void**)&builder->pending, &builder->pendingCapacity, builder->pendingCount + 1,
+                    sizeof(PendingEntry)) < 0 ||
+            reserve((void**)&builder->points, &builder->pointCapacity, builder->pointCount + frontier->count,
+                    sizeof(StatVector)) < 0) {
+            return -1;
+        }
+
+        PendingEntry* pending = &builder->pending[builder->pendingCount++];
+        pending->node = node;
+        pending->entry.ending = ending;
+        pending->entry.first = (uint32_t)builder->pointCount;
+        pending->entry.count = frontier->count;
+        memcpy(builder->points + builder->pointCount, builder->pool + frontier->first,
+               sizeof(StatVector) * frontier->count);
+        builder->pointCount += frontier->count;
+
+        frontier->count = 0;
+        frontier->capacity = 0;
+    }
+    builder->touchedCount = 0;
+    builder->poolSize = 0;
+    return 0;
+}
+
+static int findEndings(ReachIndex* index, const Story* story) {
+    uint32_t nodeCount = story->header->nodeCount;
+    int endsDirectly = 0;
+    int count = 0;
+
+    for (uint32_t n = 0; n < nodeCount; n++) {
+        const StoryRecord* node = &story->nodes[n];
+        if (node->numChoices == 0) count++;
+        for (uint32_t i = 0; i < node->numChoices && i < MAX_CHOICES; i++) {
+            if (node->nextNodes[i] == STORY_END) endsDirectly = 1;
+        }
+    }
+
+    index->endings = (int*)malloc(sizeof(int) * (size_t)(count + endsDirectly + 1));
+    if (!index->endings) return -1;
+
+    // STORY_END sorts first, then the terminal nodes in index order
+    if (endsDirectly) index->endings[index->endingCount++] = STORY_END;
+    for (uint32_t n = 0; n < nodeCount; n++) {
+        if (story->nodes[n].numChoices == 0) index->endings[index->endingCount++] = (int)n;
+    }
+    return 0;
+}
+
+static void freeBuilder(ReachBuilder* builder) {
+    free(builder->predecessorStart);
+    free(builder->predecessors);
+    free(builder->frontiers);
+    free(builder->touched);
+    for (int b = 0; b < LABEL_BUCKETS; b++) {
+        free(builder->buckets[b].labels);
+    }
+    free(builder->pool);
+    free(builder->pending);
+    free(builder->points);
+}
+
+ReachIndex* buildReachIndex(const Story* story) {
+    uint32_t nodeCount = story->header->nodeCount;
+    ReachIndex* index = (ReachIndex*)calloc(1, sizeof(ReachIndex));
+    if (!index) return NULL;
+    index->story = story;
+
+    ReachBuilder builder;
+    memset(&builder, 0, sizeof(builder));
+    builder.story = story;
+    builder.nodeCount = nodeCount;
+    builder.frontiers = (Frontier*)calloc(nodeCount ? nodeCount : 1, sizeof(Frontier));
+    builder.touched = (uint32_t*)malloc(sizeof(uint32_t) * (nodeCount ? nodeCount : 1));
+
+    int failed = !builder.frontiers || !builder.touched ||
+                 findEndings(index, story) < 0 || buildPredecessors(&builder) < 0;
+    for (int e = 0; !failed && e < index->endingCount; e++) {
+        failed = runPass(&builder, index->endings[e]) < 0;
+    }
+
+    if (!failed) {
+        // Group the entries by node; passes ran in ending order, so each group stays sorted
+        index->nodeEntries = (uint32_t*)calloc(nodeCount + 1, sizeof(uint32_t));
+        index->entries = (ReachEntry*)malloc(sizeof(ReachEntry) * (builder.pendingCount ? builder.pendingCount : 1));
+        failed = !index->nodeEntries || !index->entries;
+    }
+    if (failed) {
+        freeBuilder(&builder);
+        freeReachIndex(index);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < builder.pendingCount; i++) {
+        index->nodeEntries[builder.pending[i].node + 1]++;
+    }
+    for (uint32_t n = 0; n < nodeCount; n++) {
+        index->nodeEntries[n + 1] += index->nodeEntries[n];
+    }
+    // Fill back to front so each end count walks down to its node's start
+    for (size_t i = builder.pendingCount; i-- > 0;) {
+        const PendingEntry* pending = &builder.pending[i];
+        index->entries[--index->nodeEntries[pending->node + 1]] = pending->entry;
+    }
+    for (uint32_t n = 0; n < nodeCount; n++) {
+        index->nodeEntries[n] = index->nodeEntries[n + 1];
+    }
+    index->nodeEntries[nodeCount] = (uint32_t)builder.pendingCount;
+
+    index->entryCount = builder.pendingCount;
+    index->points = builder.points;
+    index->pointCount = builder.pointCount;
+    builder.points = NULL;
+    freeBuilder(&builder);
+    return index;
+}
+
+void freeReachIndex(ReachIndex* index) {
+    if (!index) return;
+    free(index->endings);
+    free(index->nodeEntries);
+    free(index->entries);
+    free(index->points);
+    free(index);
+}
+
+/**
+ * @brief Finds the entry of an ending among a node's entries
+ */
+static const ReachEntry* findEntry(const ReachIndex* index, int node, int ending) {
+    uint32_t low = index->nodeEntries[node];
+    uint32_t high = index->nodeEntries[node + 1];
+
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (index->entries[middle].ending < ending) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low < index->nodeEntries[node + 1] && index->entries[low].ending == ending) {
+        return &index->entries[low];
+    }
+    return NULL;
+}
+
+static int meetsFrontier(const ReachIndex* index, const ReachEntry* entry, StatVector stats) {
+    for (uint32_t i = 0; i < entry->count; i++) {
+        if (meets(stats, index->points[entry->first + i])) return 1;
+    }
+    return 0;
+}
+
+const StatVector* getReachFrontier(const ReachIndex* index, int node, int ending, uint32_t* count) {
+    const ReachEntry* entry = findEntry(index, node, ending);
+    if (!entry) return NULL;
+    *count = entry->count;
+    return index->points + entry->first;
+}
+
+int canReachEnding(const ReachIndex* index, int node, int ending, StatVector stats) {
+    const ReachEntry* entry = findEntry(index, node, ending);
+    return entry && meetsFrontier(index, entry, stats);
+}
+
+int listReachableEndings(const ReachIndex* index, int node, StatVector stats, int* endings, int maxEndings) {
+    int count = 0;
+    for (uint32_t e = index->nodeEntries[node]; e < index->nodeEntries[node + 1]; e++) {
+        if (!meetsFrontier(index, &index->entries[e], stats)) continue;
+        if (count < maxEndings) endings[count] = index->entries[e].ending;
+        count++;
+    }
+    return count;
+}
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include "../include/replay.h"
+#include "../include/engine.h"
+
+/*
+ * Token layout: "<version>.<class>.<story tag>.<name>.<count>.<choices>"
+ * The name is base64url without padding. Each choice takes two bits and
+ * three choices share one base64url digit.
+ */
+
+static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+static int digitValue(char c) {
+    const char* found = c ? strchr(digits, c) : NULL;
+    return found ? (int)(found - digits) : -1;
+}
+
+uint32_t getStoryTag(const Story* story) {
+    return story->tag;
+}
+
+int recordReplay(const GameState* game, ReplayLog* log) {
+    log->choices = (int*)malloc(sizeof(int) * (size_t)(game->choiceHistoryCount ? game->choiceHistoryCount : 1));
+    if (!log->choices) return -1;
+
+    strncpy(log->name, game->player->name, MAX_NAME_LENGTH - 1);
+    log->name[MAX_NAME_LENGTH - 1] = '\0';
+    log->characterClass = game->player->class;
+    log->storyTag = getStoryTag(game->startStory);
+    log->choiceCount = game->choiceHistoryCount;
+    memcpy(log->choices, game->choiceHistory, sizeof(int) * (size_t)game->choiceHistoryCount);
+    return 0;
+}
+
+void freeReplayLog(ReplayLog* log) {
+    free(log->choices);
+    log->choices = NULL;
+    log->choiceCount = 0;
+}
+
+int restoreReplay(const ReplayLog* log, GameState* game, Character* player, Story* story) {
+    if (log->storyTag != getStoryTag(story)) return -1;
+
+    initializeCharacter(player, log->name, log->characterClass);
+    initializeGameState(game, player, story);
+    if (replayChoices(game, log->choices, log->choiceCount) != log->choiceCount) {
+        releaseGameChapter(game);
+        freeGameHistory(game);
+        return -1;
+    }
+    return 0;
+}
+
+size_t getReplayTokenSize(const ReplayLog* log) {
+    // Version, class and tag, each field's dot, the name, the count and the choices
+    char fields[64];
+    int length = snprintf(fields, sizeof(fields), "%d.%d.%08x..%d.", REPLAY_TOKEN_VERSION,
+                          (int)log->characterClass, (unsigned)log->storyTag, log->choiceCount);
+    size_t name = (strlen(log->name) * 8 + 5) / 6;
+    return (size_t)length + name + ((size_t)log->choiceCount + 2) / 3 + 1;
+}
+
+int formatReplayToken(const ReplayLog* log, char* token, size_t size) {
+    int length = snprintf(token, size, "%d.%d.%08x.", REPLAY_TOKEN_VERSION,
+                          (int)log->characterClass, (unsigned)log->storyTag);
+    if (length < 0 || (size_t)length >= size) return -1;
+
+    // Name bytes, six bits per digit
+    const unsigned char* name = (const unsigned char*)log->name;
+    size_t nameLength = strlen(log->name);
+    size_t used = (size_t)length;
+    for (size_t bit = 0; bit < nameLength * 8; bit += 6) {
+        size_t byte = bit / 8;
+        unsigned value = (unsigned)name[byte] << 8;
+        if (byte + 1 < nameLength) value |= name[byte + 1];
+        if (used + 1 >= size) return -1;
+        token[used++] = digits[(value >> (10 - bit % 8)) & 63];
+    }
+
+    length = snprintf(token + used, size - used, ".%d.", log->choiceCount);
+    if (length < 0 || (size_t)length >= size - used) return -1;
+    used += (size_t)length;
+
+    for (int i = 0; i < log->choiceCount; i += 3) {
+        int value = 0;
+        for (int j = 0; j < 3 && i + j < log->choiceCount; j++) {
+            value |= (log->choices[i + j] - 1) << (2 * j);
+        }
+        if (used + 1 >= size) return -1;
+        token[used++] = digits[value];
+    }
+
+    token[used] = '\0';
+    return (int)used;
+}
+
+/**
+ * @brief Reads a number field followed by a dot
+ * @return Pointer past the dot, or NULL if the field is malformed
+ */
+static const char* parseNumber(const char* text, int base, unsigned long* value) {
+    char* end;
+    if (!*text || *text == '-' || *text == '+') return NULL;
+    *value = strtoul(text, &end, base);
+    return end != text && *end == '.' ? end + 1 : NULL;
+}
+
+int parseReplayToken(const char* token, ReplayLog* log) {
+    unsigned long version, characterClass, storyTag, count;
+
+    const char* text = parseNumber(token, 10, &version);
+    if (!text || version != REPLAY_TOKEN_VERSION) return -1;
+    text = parseNumber(text, 10, &characterClass);
+    if (!text || characterClass > ROGUE) return -1;
+    text = parseNumber(text, 16, &storyTag);
+    if (!text || storyTag > UINT32_MAX) return -1;
+
+    log->characterClass = (CharacterClass)characterClass;
+    log->storyTag = (uint32_t)storyTag;
+
+    // Name digits up to the next dot
+    const char* dot = strchr(text, '.');
+    if (!dot) return -1;
+    size_t nameLength = (size_t)(dot - text) * 6 / 8;
+    if (nameLength >= MAX_NAME_LENGTH) return -1;
+    memset(log->name, 0, sizeof(log->name));
+    for (size_t i = 0; text + i < dot; i++) {
+        int value = digitValue(text[i]);
+        if (value < 0) return -1;
+        size_t bit = i * 6;
+        size_t byte = bit / 8;
+        unsigned shifted = (unsigned)value << (10 - bit % 8);
+        if (byte < nameLength) log->name[byte] |= (char)(shifted >> 8);
+        if (byte + 1 < nameLength) log->name[byte + 1] |= (char)(shifted & 0xFF);
+    }
+
+    text = parseNumber(dot + 1, 10, &count);
+    if (!text || count > INT_MAX || strlen(text) != (count + 2) / 3) return -1;
+
+    log->choices = (int*)malloc(sizeof(int) * (count ? count : 1));
+    if (!log->choices) return -1;
+    log->choiceCount = (int)count;
+    for (int i = 0; i < log->choiceCount; i++) {
+        int value = digitValue(text[i / 3]);
+        if (value < 0) {
+            freeReplayLog(log);
+            return -1;
+        }
+        log->choices[i] = ((value >> (2 * (i % 3))) & 3) + 1;
+    }
+    return 0;
+}
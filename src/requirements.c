@@ -0,0 +1,93 @@
+#include <string.h>
+#include "../include/requirements.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+_Static_assert(MAX_CHOICES * REQUIREMENT_LANES == 16, "a node's requirements must fill one 16-byte vector");
+
+static uint8_t clampStat(int value) {
+    return (uint8_t)(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+StatVector packStats(const Character* character) {
+    StatVector stats;
+    stats.lanes[0] = clampStat(character->strength);
+    stats.lanes[1] = clampStat(character->intelligence);
+    stats.lanes[2] = clampStat(character->charisma);
+    stats.lanes[3] = (character->strength < 0 || character->intelligence < 0 || character->charisma < 0)
+                         ? 0 : REQUIREMENT_PRESENT;
+    return stats;
+}
+
+unsigned int compareRequirements(const StoryRecord* node, StatVector stats) {
+#ifdef __SSE2__
+    uint32_t packed;
+    memcpy(&packed, stats.lanes, sizeof(packed));
+    __m128i have = _mm_set1_epi32((int)packed);
+    __m128i need = _mm_loadu_si128((const __m128i*)node->requirements);
+    // Unsigned have >= need is max(need, have) == have
+    return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(need, have), have));
+#else
+    const uint8_t* need = &node->requirements[0][0];
+    unsigned int met = 0;
+    for (int i = 0; i < MAX_CHOICES * REQUIREMENT_LANES; i++) {
+        if (stats.lanes[i % REQUIREMENT_LANES] >= need[i]) met |= 1u << i;
+    }
+    return met;
+#endif
+}
+
+unsigned int getChoiceMask(const StoryRecord* node, StatVector stats) {
+    unsigned int met = compareRequirements(node, stats);
+
+    // Fold each choice's four lane bits into its lowest, then gather those
+    met &= met >> 1;
+    met &= met >> 2;
+    return (met & 0x1) | ((met >> 3) & 0x2) | ((met >> 6) & 0x4) | ((met >> 9) & 0x8);
+}
+
+#ifdef __SSE2__
+/**
+ * @brief Choice masks of four characters, one per 32-bit lane
+ */
+static __m128i maskFour(const __m128i* need, const __m128i* bits, __m128i have) {
+    __m128i all = _mm_set1_epi32(-1);
+    __m128i mask = _mm_setzero_si128();
+    for (int c = 0; c < MAX_CHOICES; c++) {
+        __m128i met = _mm_cmpeq_epi8(_mm_max_epu8(need[c], have), have);
+        mask = _mm_or_si128(mask, _mm_and_si128(_mm_cmpeq_epi32(met, all), bits[c]));
+    }
+    return mask;
+}
+#endif
+
+void getChoiceMasks(const StoryRecord* node, const StatVector* stats, size_t count, uint8_t* masks) {
+    size_t i = 0;
+
+#ifdef __SSE2__
+    // Each choice's requirement is broadcast so one compare covers four characters
+    __m128i need[MAX_CHOICES];
+    __m128i bits[MAX_CHOICES];
+    for (int c = 0; c < MAX_CHOICES; c++) {
+        uint32_t packed;
+        memcpy(&packed, node->requirements[c], sizeof(packed));
+        need[c] = _mm_set1_epi32((int)packed);
+        bits[c] = _mm_set1_epi32(1 << c);
+    }
+
+    for (; i + 16 <= count; i += 16) {
+        const __m128i* have = (const __m128i*)(stats + i);
+        __m128i low = _mm_packs_epi32(maskFour(need, bits, _mm_loadu_si128(have)),
+                                      maskFour(need, bits, _mm_loadu_si128(have + 1)));
+        __m128i high = _mm_packs_epi32(maskFour(need, bits, _mm_loadu_si128(have + 2)),
+                                       maskFour(need, bits, _mm_loadu_si128(have + 3)));
+        _mm_storeu_si128((__m128i*)(masks + i), _mm_packus_epi16(low, high));
+    }
+#endif
+
+    for (; i < count; i++) {
+        masks[i] = (uint8_t)getChoiceMask(node, stats[i]);
+    }
+}
@@ -0,0 +1,508 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "../include/savefile.h"
+#include "../include/engine.h"
+
+#define SAVE_HEADER_SIZE 12         /* Magic and version */
+#define SAVE_FRAME_SIZE 9           /* Type, payload length and checksum */
+
+#define SAVE_RECORD_CHECKPOINT 1
+#define SAVE_RECORD_DELTA 2
+
+#define SAVE_FIELD_SCENE 0x01
+#define SAVE_FIELD_CHARACTER 0x02
+#define SAVE_FIELD_INVENTORY 0x04
+#define SAVE_FIELD_HISTORY 0x08
+#define SAVE_FIELD_FLAGS 0x10
+#define SAVE_FIELD_ALL 0x1F
+
+#define SAVE_SCENE_ACTIVE 0x01
+#define SAVE_SCENE_GAME_OVER 0x02
+
+/**
+ * @struct SaveBuffer
+ * @brief Record being encoded
+ */
+typedef struct {
+    uint8_t* data;                  /**< Encoded bytes, or NULL before the first; freed by the caller */
+    size_t size;                    /**< Bytes used */
+    size_t capacity;                /**< Bytes data has room for */
+    int overflow;                   /**< Set if memory ran out while writing */
+} SaveBuffer;
+
+/**
+ * @struct SaveReader
+ * @brief Cursor over an encoded record
+ */
+typedef struct {
+    const uint8_t* data;            /**< Encoded bytes */
+    size_t size;                    /**< Number of bytes */
+    size_t position;                /**< Next byte to read */
+    int error;                      /**< Set if a read ran past the end or found a bad value */
+} SaveReader;
+
+static void put8(SaveBuffer* out, uint32_t value) {
+    if (out->overflow) return;
+    if (out->size == out->capacity) {
+        // Records grow with the choice history, so the buffer does too
+        size_t capacity = out->capacity ? out->capacity * 2 : 256;
+        uint8_t* data = (uint8_t*)realloc(out->data, capacity);
+        if (!data) {
+            out->overflow = 1;
+            return;
+        }
+        out->data = data;
+        out->capacity = capacity;
+    }
+    out->data[out->size++] = (uint8_t)value;
+}
+
+static void put32(SaveBuffer* out, uint32_t value) {
+    put8(out, value);
+    put8(out, value >> 8);
+    put8(out, value >> 16);
+    put8(out, value >> 24);
+}
+
+static void putString(SaveBuffer* out, const char* text, size_t capacity) {
+    size_t length = strnlen(text, capacity - 1);
+    put8(out, (uint32_t)length);
+    for (size_t i = 0; i < length; i++) {
+        put8(out, (uint8_t)text[i]);
+    }
+}
+
+static uint32_t get8(SaveReader* in) {
+    if (in->position + 1 > in->size) {
+        in->error = 1;
+        return 0;
+    }
+    return in->data[in->position++];
+}
+
+static uint32_t get32(SaveReader* in) {
+    uint32_t value = get8(in);
+    value |= get8(in) << 8;
+    value |= get8(in) << 16;
+    value |= get8(in) << 24;
+    return value;
+}
+
+static void getString(SaveReader* in, char* text, size_t capacity) {
+    size_t length = get8(in);
+    if (length >= capacity) {
+        in->error = 1;
+        length = 0;
+    }
+    for (size_t i = 0; i < length; i++) {
+        text[i] = (char)get8(in);
+    }
+    text[length] = '\0';
+}
+
+static uint32_t checksum(const uint8_t* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static int sameCharacter(const Character* a, const Character* b) {
+    if (strncmp(a->name, b->name, MAX_NAME_LENGTH) != 0) return 0;
+    if (a->class != b->class || a->strength != b->strength || a->intelligence != b->intelligence) return 0;
+    if (a->charisma != b->charisma || a->health != b->health || a->traitCount != b->traitCount) return 0;
+    for (int i = 0; i < a->traitCount && i < MAX_TRAITS; i++) {
+        if (strncmp(a->traits[i], b->traits[i], MAX_NAME_LENGTH) != 0) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Checks whether a state can be recorded as a delta on top of another
+ * @details Choice history only ever grows, so a shorter or rewritten history
+ *          means a different playthrough that needs a checkpoint.
+ */
+static int canAppendDelta(const GameState* saved, const GameState* game) {
+    if (saved->story != game->story) return 0;
+    if (game->choiceHistoryCount < saved->choiceHistoryCount) return 0;
+    return memcmp(saved->choiceHistory, game->choiceHistory,
+                  sizeof(int) * saved->choiceHistoryCount) == 0;
+}
+
+/**
+ * @brief Encodes a record: everything for a checkpoint, or what changed since saved for a delta
+ * @return Mask of the fields in the record
+ */
+static int encodeRecord(SaveBuffer* out, const GameState* game,
+                        const GameState* saved, const Character* savedPlayer) {
+    int fields = SAVE_FIELD_ALL;
+    int historyStart = 0;
+
+    if (saved) {
+        fields = 0;
+        historyStart = saved->choiceHistoryCount;
+
+        if (game->currentScene != saved->currentScene || game->currentChapter != saved->currentChapter ||
+            game->reputation != saved->reputation || game->isGameOver != saved->isGameOver) {
+            fields |= SAVE_FIELD_SCENE;
+        }
+        if (!sameCharacter(game->player, savedPlayer)) fields |= SAVE_FIELD_CHARACTER;
+        if (memcmp(game->inventory, saved->inventory, sizeof(game->inventory)) != 0) fields |= SAVE_FIELD_INVENTORY;
+        if (historyStart != game->choiceHistoryCount) fields |= SAVE_FIELD_HISTORY;
+        if (game->flags != saved->flags) fields |= SAVE_FIELD_FLAGS;
+        if (!fields) return 0;
+    }
+
+    out->size = 0;
+    out->overflow = 0;
+    put8(out, saved ? SAVE_RECORD_DELTA : SAVE_RECORD_CHECKPOINT);
+    put32(out, 0);  // Payload length, patched below
+    put8(out, (uint32_t)fields);
+
+    if (fields & SAVE_FIELD_SCENE) {
+        int active = game->currentScene != STORY_END;
+        put8(out, (active ? SAVE_SCENE_ACTIVE : 0) | (game->isGameOver ? SAVE_SCENE_GAME_OVER : 0));
+        put32(out, active ? (uint32_t)game->story->nodes[game->currentScene].id : 0);
+        put32(out, (uint32_t)game->currentChapter);
+        put32(out, (uint32_t)game->reputation);
+    }
+
+    if (fields & SAVE_FIELD_CHARACTER) {
+        const Character* player = game->player;
+        putString(out, player->name, MAX_NAME_LENGTH);
+        put8(out, (uint32_t)player->class);
+        put32(out, (uint32_t)player->strength);
+        put32(out, (uint32_t)player->intelligence);
+        put32(out, (uint32_t)player->charisma);
+        put32(out, (uint32_t)player->health);
+        put8(out, (uint32_t)player->traitCount);
+        for (int i = 0; i < player->traitCount && i < MAX_TRAITS; i++) {
+            putString(out, player->traits[i], MAX_NAME_LENGTH);
+        }
+    }
+
+    if (fields & SAVE_FIELD_INVENTORY) {
+        // Item ids are only meaningful in this process, so the whole set is written by name
+        put8(out, (uint32_t)game->inventoryCount);
+        for (int w = 0; w < INVENTORY_WORDS; w++) {
+            for (uint64_t bits = game->inventory[w]; bits; bits &= bits - 1) {
+                putString(out, getName(NAME_ITEM, w * 64 + __builtin_ctzll(bits)), MAX_REGISTERED_NAME);
+            }
+        }
+    }
+
+    if (fields & SAVE_FIELD_FLAGS) {
+        // Like items, flags are written by name
+        put8(out, (uint32_t)__builtin_popcountll(game->flags));
+        for (uint64_t bits = game->flags; bits; bits &= bits - 1) {
+            putString(out, getName(NAME_FLAG, __builtin_ctzll(bits)), MAX_REGISTERED_NAME);
+        }
+    }
+
+    if (fields & SAVE_FIELD_HISTORY) {
+        put32(out, (uint32_t)(game->choiceHistoryCount - historyStart));
+        for (int i = historyStart; i < game->choiceHistoryCount; i++) {
+            put8(out, (uint32_t)game->choiceHistory[i]);
+        }
+    }
+
+    if (out->overflow) return fields;
+    size_t payload = out->size - 5;
+    out->data[1] = (uint8_t)payload;
+    out->data[2] = (uint8_t)(payload >> 8);
+    out->data[3] = (uint8_t)(payload >> 16);
+    out->data[4] = (uint8_t)(payload >> 24);
+    put32(out, checksum(out->data, out->size));
+    return fields;
+}
+
+/**
+ * @brief Applies the payload of a record to a game state
+ * @return 0 on success, -1 if the payload is malformed or does not fit the story
+ */
+static int applyRecord(SaveReader* in, int type, GameState* game, Story* story) {
+    int fields = (int)get8(in);
+    if (type == SAVE_RECORD_CHECKPOINT) {
+        if (fields != SAVE_FIELD_ALL) return -1;
+        freeGameHistory(game);
+        initializeGameState(game, game->player, story);
+    }
+
+    if (fields & SAVE_FIELD_SCENE) {
+        uint32_t flags = get8(in);
+        int id = (int32_t)get32(in);
+        int chapter = (int32_t)get32(in);
+        game->reputation = (int32_t)get32(in);
+        game->isGameOver = (flags & SAVE_SCENE_GAME_OVER) != 0;
+        if (flags & SAVE_SCENE_ACTIVE) {
+            // Saves made in a later chapter load that chapter
+            if (chapter != game->story->header->chapter) {
+                if (enterChapter(game, chapter, id) < 0) return -1;
+            } else {
+                game->currentScene = findStoryNode(game->story, id);
+                if (game->currentScene == STORY_END) return -1;
+            }
+        } else {
+            game->currentScene = STORY_END;
+        }
+        game->currentChapter = chapter;
+    }
+
+    if (fields & SAVE_FIELD_CHARACTER) {
+        Character* player = game->player;
+        getString(in, player->name, MAX_NAME_LENGTH);
+        uint32_t characterClass = get8(in);
+        if (characterClass > ROGUE) return -1;
+        player->class = (CharacterClass)characterClass;
+        player->strength = (int32_t)get32(in);
+        player->intelligence = (int32_t)get32(in);
+        player->charisma = (int32_t)get32(in);
+        player->health = (int32_t)get32(in);
+        player->traitCount = (int)get8(in);
+        if (player->traitCount > MAX_TRAITS) return -1;
+        player->traitMask = 0;
+        for (int i = 0; i < player->traitCount; i++) {
+            getString(in, player->traits[i], MAX_NAME_LENGTH);
+            int trait = internName(NAME_TRAIT, player->traits[i]);
+            if (trait < 0) return -1;
+            player->traitMask |= 1ull << trait;
+        }
+    }
+
+    if (fields & SAVE_FIELD_INVENTORY) {
+        // The whole set of items held, by name
+        int count = (int)get8(in);
+        memset(game->inventory, 0, sizeof(game->inventory));
+        game->inventoryCount = 0;
+        for (int i = 0; i < count; i++) {
+            char name[MAX_REGISTERED_NAME];
+            getString(in, name, MAX_REGISTERED_NAME);
+            int item = internName(NAME_ITEM, name);
+            if (item < 0 || addItem(game, item) < 0) return -1;
+        }
+    }
+
+    if (fields & SAVE_FIELD_FLAGS) {
+        int count = (int)get8(in);
+        game->flags = 0;
+        for (int i = 0; i < count; i++) {
+            char name[MAX_REGISTERED_NAME];
+            getString(in, name, MAX_REGISTERED_NAME);
+            int flag = internName(NAME_FLAG, name);
+            if (flag < 0) return -1;
+            game->flags |= 1ull << flag;
+        }
+    }
+
+    if (fields & SAVE_FIELD_HISTORY) {
+        // Each choice takes a byte, which bounds a count read from a corrupt record
+        uint32_t added = get32(in);
+        if (added > in->size - in->position) return -1;
+        if (reserveChoiceHistory(game, game->choiceHistoryCount + (int)added) < 0) return -1;
+        for (uint32_t i = 0; i < added; i++) {
+            int choice = (int)get8(in);
+            if (choice < 1 || choice > MAX_CHOICES) return -1;
+            game->choiceHistory[game->choiceHistoryCount++] = choice;
+        }
+    }
+
+    return in->error || in->position != in->size ? -1 : 0;
+}
+
+/**
+ * @brief Remembers the state a record was written for
+ * @param historyStart Number of choices already in the remembered history
+ *        that the record did not change
+ * @return 0 on success, -1 if the history could not be copied
+ * @details The log keeps its own copy of the history so that a rewritten
+ *          history, such as one restored from a snapshot, is noticed. Only
+ *          the choices past historyStart are copied.
+ */
+static int rememberSaved(SaveLog* log, const GameState* game, int historyStart) {
+    int* history = log->saved.choiceHistory;
+    int capacity = log->saved.choiceHistoryCapacity;
+
+    log->saved = *game;
+    log->saved.choiceHistory = history;
+    log->saved.choiceHistoryCapacity = capacity;
+    log->savedPlayer = *game->player;
+    if (reserveChoiceHistory(&log->saved, game->choiceHistoryCount) < 0) {
+        log->saved.choiceHistoryCount = 0;
+        return -1;
+    }
+    memcpy(log->saved.choiceHistory + historyStart, game->choiceHistory + historyStart,
+           sizeof(int) * (size_t)(game->choiceHistoryCount - historyStart));
+    return 0;
+}
+
+SaveLog* openSaveLog(const char* path) {
+    SaveLog* log = (SaveLog*)calloc(1, sizeof(SaveLog));
+    if (!log) return NULL;
+
+    log->path = (char*)malloc(strlen(path) + 1);
+    if (!log->path) {
+        free(log);
+        return NULL;
+    }
+    strcpy(log->path, path);
+    return log;
+}
+
+int writeCheckpoint(SaveLog* log, const GameState* game) {
+    SaveBuffer record = {NULL, 0, 0, 0};
+    encodeRecord(&record, game, NULL, NULL);
+
+    size_t pathLength = strlen(log->path);
+    char* temporaryPath = record.overflow ? NULL : (char*)malloc(pathLength + 5);
+    if (!temporaryPath) {
+        free(record.data);
+        return -1;
+    }
+    memcpy(temporaryPath, log->path, pathLength);
+    memcpy(temporaryPath + pathLength, ".tmp", 5);
+
+    if (log->file) {
+        fclose(log->file);
+        log->file = NULL;
+    }
+
+    uint8_t header[SAVE_HEADER_SIZE];
+    memcpy(header, SAVE_FILE_MAGIC, 8);
+    header[8] = SAVE_FILE_VERSION & 0xFF;
+    header[9] = (SAVE_FILE_VERSION >> 8) & 0xFF;
+    header[10] = (SAVE_FILE_VERSION >> 16) & 0xFF;
+    header[11] = (SAVE_FILE_VERSION >> 24) & 0xFF;
+
+    FILE* file = fopen(temporaryPath, "wb");
+    int failed = !file;
+    if (file) {
+        failed = fwrite(header, 1, sizeof(header), file) != sizeof(header);
+        failed |= fwrite(record.data, 1, record.size, file) != record.size;
+        failed |= fclose(file) != 0;
+    }
+    free(record.data);
+    if (!failed) {
+        failed = rename(temporaryPath, log->path) != 0;
+    }
+    if (failed) {
+        remove(temporaryPath);
+        free(temporaryPath);
+        return -1;
+    }
+    free(temporaryPath);
+
+    log->file = fopen(log->path, "ab");
+    if (!log->file) return -1;
+
+    // Without a copy of what was saved, the next save has to be a checkpoint again
+    log->deltaCount = rememberSaved(log, game, 0) < 0 ? SAVE_CHECKPOINT_INTERVAL : 0;
+    return 0;
+}
+
+int appendSave(SaveLog* log, const GameState* game) {
+    if (!log->file || log->deltaCount >= SAVE_CHECKPOINT_INTERVAL || !canAppendDelta(&log->saved, game)) {
+        return writeCheckpoint(log, game);
+    }
+
+    SaveBuffer record = {NULL, 0, 0, 0};
+    if (!encodeRecord(&record, game, &log->saved, &log->savedPlayer)) return 0;
+    int failed = record.overflow || fwrite(record.data, 1, record.size, log->file) != record.size ||
+                 fflush(log->file) != 0;
+    free(record.data);
+
+    if (failed) {
+        // A torn record ends the log, so anything after it would be lost
+        log->deltaCount = SAVE_CHECKPOINT_INTERVAL;
+        return -1;
+    }
+
+    // The delta only appended to the saved history, so only the new choices are copied
+    if (rememberSaved(log, game, log->saved.choiceHistoryCount) < 0) {
+        log->deltaCount = SAVE_CHECKPOINT_INTERVAL;
+    } else {
+        log->deltaCount++;
+    }
+    return 0;
+}
+
+void closeSaveLog(SaveLog* log) {
+    if (!log) return;
+
+    if (log->file) {
+        fclose(log->file);
+    }
+    free(log->path);
+    freeGameHistory(&log->saved);
+    free(log);
+}
+
+/**
+ * @brief Reads a whole file into memory
+ * @return Buffer to free, or NULL on failure
+ */
+static uint8_t* readWholeFile(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    uint8_t* data = NULL;
+    long length = -1;
+    if (fseek(file, 0, SEEK_END) == 0) length = ftell(file);
+    if (length >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+        data = (uint8_t*)malloc(length ? (size_t)length : 1);
+        if (data && fread(data, 1, (size_t)length, file) != (size_t)length) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+
+    *size = (size_t)length;
+    return data;
+}
+
+int readSaveFile(const char* path, GameState* game, Character* player, Story* story) {
+    size_t size;
+    uint8_t* data = readWholeFile(path, &size);
+    if (!data) return -1;
+
+    SaveReader header = {data, size, 0, 0};
+    int failed = size < SAVE_HEADER_SIZE || memcmp(data, SAVE_FILE_MAGIC, 8) != 0;
+    header.position = 8;
+    if (!failed && get32(&header) != SAVE_FILE_VERSION) failed = 1;
+
+    initializeGameState(game, player, story);
+    size_t position = SAVE_HEADER_SIZE;
+    int records = 0;
+
+    while (!failed && size - position >= SAVE_FRAME_SIZE) {
+        SaveReader frame = {data + position, size - position, 0, 0};
+        int type = (int)get8(&frame);
+        uint32_t payload = get32(&frame);
+
+        // A short or corrupt record is a save interrupted mid-write; keep what came before it
+        if (payload > frame.size - SAVE_FRAME_SIZE) break;
+        frame.position = 5 + payload;
+        if (get32(&frame) != checksum(frame.data, 5 + payload)) break;
+
+        if (type != (records == 0 ? SAVE_RECORD_CHECKPOINT : SAVE_RECORD_DELTA)) {
+            failed = 1;
+            break;
+        }
+
+        SaveReader record = {data + position + 5, payload, 0, 0};
+        failed = applyRecord(&record, type, game, story) < 0;
+        position += SAVE_FRAME_SIZE + payload;
+        records++;
+    }
+
+    free(data);
+    if (failed || records == 0) {
+        releaseGameChapter(game);
+        freeGameHistory(game);
+        return -1;
+    }
+    return 0;
+}
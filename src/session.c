@@ -0,0 +1,246 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "../include/session.h"
+#include "../include/engine.h"
+
+static TelemetryLog* sessionTelemetry = NULL;
+static LiveStory* sessionStory = NULL;
+static int sessionRewind = 0;
+static _Atomic uint32_t nextSessionId = 1;
+
+void setSessionTelemetry(TelemetryLog* log) {
+    sessionTelemetry = log;
+}
+
+void setSessionStory(LiveStory* live) {
+    sessionStory = live;
+}
+
+void setSessionRewind(int enabled) {
+    sessionRewind = enabled;
+}
+
+void endSession(Session* session) {
+    releaseSnapshot(session->snapshot);
+    session->snapshot = NULL;
+}
+
+/**
+ * @brief Snapshots a session's game after a turn, sharing what it did not change
+ * @details Without rewinding, or if the snapshot cannot be taken, the session
+ *          lets go of its snapshots, since they no longer lead up to its game.
+ */
+static void snapshotTurn(Session* session) {
+    GameSnapshot* snapshot = sessionRewind ? takeSnapshot(session->game, session->snapshot) : NULL;
+    releaseSnapshot(session->snapshot);
+    session->snapshot = snapshot;
+}
+
+/**
+ * @brief Moves a session's game onto the published story if it is newer
+ * @details Costs one atomic load unless a new version was published since the
+ *          last check, which is then made once per version.
+ */
+static void followStoryUpdate(Session* session, SessionOutput* output) {
+    if (!sessionStory || getLiveStoryVersion(sessionStory) == session->storyVersion) return;
+
+    GameState* game = session->game;
+    Story* previous = game->startStory;
+    Story* latest = acquireLiveStory(sessionStory, &session->storyVersion);
+    if (latest == previous || switchStoryVersion(game, latest) < 0) {
+        closeStory(latest);
+        return;
+    }
+    closeStory(previous);
+    output->updated = 1;
+
+    // Earlier snapshots are in the old version and could not be restored
+    endSession(session);
+}
+
+static void emit(SessionOutput* output, SessionFrame frame) {
+    if (output->count < MAX_SESSION_FRAMES) {
+        output->frames[output->count++] = frame;
+    }
+}
+
+/**
+ * @brief Shows the current scene, or ends the session if there is none
+ */
+static void emitScene(Session* session, SessionOutput* output) {
+    if (isGameOver(session->game)) {
+        session->phase = SESSION_OVER;
+        emit(output, FRAME_ENDING);
+    } else {
+        session->phase = SESSION_PLAYING;
+        emit(output, FRAME_SCENE);
+    }
+}
+
+/**
+ * @brief Shows where a choice leads, leaving the game as it is
+ * @details A session that keeps no snapshots takes one of its game for the
+ *          preview; it costs a copy of the choice history.
+ */
+static void previewSessionChoice(Session* session, int choice, SessionOutput* output) {
+    GameSnapshot* current = session->snapshot ? session->snapshot : takeSnapshot(session->game, NULL);
+    if (!current) {
+        emit(output, FRAME_CHOICE_INVALID);
+        return;
+    }
+
+    switch (previewChoice(session->game, current, choice, &output->preview)) {
+        case CHOICE_APPLIED:
+            emit(output, FRAME_PREVIEW);
+            break;
+        case CHOICE_INVALID:
+        case CHOICE_NO_MEMORY:
+            emit(output, FRAME_CHOICE_INVALID);
+            break;
+        case CHOICE_LOCKED:
+            emit(output, FRAME_CHOICE_LOCKED);
+            break;
+        case CHOICE_GAME_OVER:
+            emitScene(session, output);
+            break;
+    }
+    if (current != session->snapshot) releaseSnapshot(current);
+}
+
+/**
+ * @brief Takes back the last turns of a session's game
+ * @details Only the turns taken back are rewritten, however long the game
+ *          has run.
+ */
+static void undoTurns(Session* session, int turns, SessionOutput* output) {
+    GameSnapshot* earlier = turns > 0 ? getEarlierSnapshot(session->snapshot, turns) : NULL;
+    if (!earlier || restoreSnapshot(earlier, session->game, session->snapshot) < 0) {
+        emit(output, FRAME_UNDO_INVALID);
+        return;
+    }
+    retainSnapshot(earlier);
+    releaseSnapshot(session->snapshot);
+    session->snapshot = earlier;
+    output->rewound = 1;
+    emitScene(session, output);
+}
+
+void startSession(Session* session, GameState* game, Character* player, Story* story, SessionOutput* output) {
+    // The game is valid from the start so a session can be saved or dropped at any point
+    initializeCharacter(player, "", WARRIOR);
+    initializeGameState(game, player, story);
+
+    session->phase = SESSION_NAME;
+    session->id = atomic_fetch_add_explicit(&nextSessionId, 1, memory_order_relaxed);
+    session->game = game;
+    session->storyVersion = 0;
+    session->snapshot = NULL;
+    output->count = 0;
+    output->applied = 0;
+    output->updated = 0;
+    output->rewound = 0;
+    emit(output, FRAME_NAME_PROMPT);
+}
+
+void resumeSession(Session* session, GameState* game, SessionOutput* output) {
+    session->id = atomic_fetch_add_explicit(&nextSessionId, 1, memory_order_relaxed);
+    session->game = game;
+    session->storyVersion = 0;
+    session->snapshot = NULL;
+    output->count = 0;
+    output->applied = 0;
+    output->updated = 0;
+    output->rewound = 0;
+    snapshotTurn(session);
+    emitScene(session, output);
+}
+
+void feedSession(Session* session, const char* line, SessionOutput* output) {
+    GameState* game = session->game;
+    output->count = 0;
+    output->applied = 0;
+    output->updated = 0;
+    output->rewound = 0;
+
+    if (session->phase == SESSION_OVER) {
+        emit(output, FRAME_ENDING);
+        return;
+    }
+
+    if (strcmp(line, "quit") == 0) {
+        session->phase = SESSION_OVER;
+        emit(output, FRAME_FAREWELL);
+        return;
+    }
+
+    switch (session->phase) {
+        case SESSION_NAME:
+            initializeCharacter(game->player, line[0] ? line : "Traveler", WARRIOR);
+            session->phase = SESSION_CLASS;
+            emit(output, FRAME_CLASS_PROMPT);
+            break;
+
+        case SESSION_CLASS: {
+            int choice = atoi(line);
+            if (choice < 1 || choice > 4) {
+                emit(output, FRAME_CLASS_INVALID);
+                break;
+            }
+            // The name is copied out first; initializeCharacter writes over it
+            char name[MAX_NAME_LENGTH];
+            strcpy(name, game->player->name);
+            initializeCharacter(game->player, name, (CharacterClass)(choice - 1));
+            initializeGameState(game, game->player, game->startStory);
+            followStoryUpdate(session, output);
+            snapshotTurn(session);
+            emit(output, FRAME_CHARACTER);
+            emitScene(session, output);
+            break;
+        }
+
+        case SESSION_PLAYING: {
+            if (strncmp(line, "preview ", 8) == 0) {
+                previewSessionChoice(session, atoi(line + 8) - 1, output);
+                break;
+            }
+            if (sessionRewind && strncmp(line, "undo", 4) == 0 && (!line[4] || line[4] == ' ')) {
+                undoTurns(session, line[4] ? atoi(line + 5) : 1, output);
+                break;
+            }
+
+            // Read now: a chapter effect moves the game into another story
+            int node = game->currentScene == STORY_END ? -1 : game->story->nodes[game->currentScene].id;
+            int choice = atoi(line) - 1;
+            switch (applyChoice(game, choice)) {
+                case CHOICE_APPLIED:
+                    output->applied = 1;
+                    if (sessionTelemetry) {
+                        ChoiceEvent event;
+                        event.session = session->id;
+                        describeChoice(&event, game, node, choice);
+                        recordChoiceEvent(sessionTelemetry, &event);
+                    }
+                    enterNextChapter(game);
+                    followStoryUpdate(session, output);
+                    snapshotTurn(session);
+                    emitScene(session, output);
+                    break;
+                case CHOICE_INVALID:
+                case CHOICE_NO_MEMORY:
+                    emit(output, FRAME_CHOICE_INVALID);
+                    break;
+                case CHOICE_LOCKED:
+                    emit(output, FRAME_CHOICE_LOCKED);
+                    break;
+                case CHOICE_GAME_OVER:
+                    emitScene(session, output);
+                    break;
+            }
+            break;
+        }
+
+        case SESSION_OVER:
+            break;
+    }
+}
@@ -0,0 +1,352 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "../include/snapshot.h"
+#include "../include/names.h"
+
+static const char* statNames[CONDITION_STATS] = {"str", "int", "cha", "health", "reputation"};
+
+_Static_assert(MAX_CHOICES <= UINT8_MAX && MAX_TRAIT_IDS <= 256, "choices and trait ids must fit in a byte");
+
+/**
+ * @struct SnapshotState
+ * @brief Stats, items, traits, flags and chapter, shared by the snapshots they did not change between
+ */
+typedef struct {
+    atomic_int references;                  /**< Snapshots sharing the block */
+    Story* story;                           /**< Chapter the game is in; the block holds a reference */
+    Story* startStory;                      /**< Story the game started in; the block holds a reference */
+    int currentChapter;                     /**< Current chapter number */
+    int stats[CONDITION_STATS];             /**< Stats in ConditionStat order, reputation included */
+    uint64_t inventory[INVENTORY_WORDS];    /**< Items held, as in GameState */
+    int inventoryCount;                     /**< Number of items held */
+    uint64_t flags;                         /**< Story flags */
+    uint64_t traitMask;                     /**< Bit i set for each trait with trait id i */
+    int traitCount;                         /**< Number of traits */
+    uint8_t traits[MAX_TRAITS];             /**< Trait ids, in the order they were gained */
+} SnapshotState;
+
+/**
+ * @struct SnapshotIdentity
+ * @brief Name and class of the character, shared by every snapshot of a playthrough
+ */
+typedef struct {
+    atomic_int references;                  /**< Snapshots sharing the block */
+    CharacterClass class;                   /**< Class of the character */
+    char name[];                            /**< NUL-terminated character name */
+} SnapshotIdentity;
+
+struct GameSnapshot {
+    atomic_int references;                  /**< Holders of the snapshot, later snapshots included */
+    GameSnapshot* parent;                   /**< Snapshot this one was taken after, or NULL */
+    SnapshotState* state;                   /**< Stats, items, traits, flags and chapter */
+    SnapshotIdentity* identity;             /**< Name and class */
+    int generation;                         /**< Number of snapshots before this one in its chain */
+    int currentScene;                       /**< Index of the current scene in state->story, or STORY_END */
+    int isGameOver;                         /**< 1 once the game is over */
+    int historyCount;                       /**< Number of choices in the game's history */
+    int choiceCount;                        /**< Number of them made since parent, stored in choices */
+    uint8_t choices[];                      /**< The last choiceCount history entries, one-based */
+};
+
+/**
+ * @brief Fills a state block from a game without allocating
+ * @param previous State of the snapshot taken before, or NULL
+ * @return 0 on success, -1 if a trait is missing from the registry
+ * @details Traits are only ever added, so a trait mask equal to the previous
+ *          one means the same traits in the same order, and the registry is
+ *          only searched after a trait was gained.
+ */
+static int describeState(const GameState* game, const SnapshotState* previous, SnapshotState* state) {
+    const Character* player = game->player;
+
+    // Zeroed first so padding compares equal in sameState()
+    memset(state, 0, sizeof(SnapshotState));
+    state->story = game->story;
+    state->startStory = game->startStory;
+    state->currentChapter = game->currentChapter;
+    state->stats[STAT_STRENGTH] = player->strength;
+    state->stats[STAT_INTELLIGENCE] = player->intelligence;
+    state->stats[STAT_CHARISMA] = player->charisma;
+    state->stats[STAT_HEALTH] = player->health;
+    state->stats[STAT_REPUTATION] = game->reputation;
+    memcpy(state->inventory, game->inventory, sizeof(state->inventory));
+    state->inventoryCount = game->inventoryCount;
+    state->flags = game->flags;
+    state->traitMask = player->traitMask;
+    state->traitCount = player->traitCount;
+
+    if (player->traitCount < 0 || player->traitCount > MAX_TRAITS) return -1;
+    if (previous && previous->traitMask == player->traitMask && previous->traitCount == player->traitCount) {
+        memcpy(state->traits, previous->traits, sizeof(state->traits));
+        return 0;
+    }
+    for (int i = 0; i < player->traitCount; i++) {
+        int id = findName(NAME_TRAIT, player->traits[i]);
+        if (id < 0) return -1;
+        state->traits[i] = (uint8_t)id;
+    }
+    return 0;
+}
+
+static int sameState(const SnapshotState* a, const SnapshotState* b) {
+    size_t start = offsetof(SnapshotState, story);
+    return memcmp((const char*)a + start, (const char*)b + start, sizeof(SnapshotState) - start) == 0;
+}
+
+static SnapshotState* copyState(const SnapshotState* state) {
+    SnapshotState* copy = (SnapshotState*)malloc(sizeof(SnapshotState));
+    if (!copy) return NULL;
+    memcpy(copy, state, sizeof(SnapshotState));
+    atomic_init(&copy->references, 1);
+    retainStory(copy->startStory);
+    if (copy->story != copy->startStory) retainStory(copy->story);
+    return copy;
+}
+
+static void releaseState(SnapshotState* state) {
+    if (atomic_fetch_sub(&state->references, 1) != 1) return;
+    if (state->story != state->startStory) closeStory(state->story);
+    closeStory(state->startStory);
+    free(state);
+}
+
+static SnapshotIdentity* copyIdentity(const Character* player) {
+    size_t length = strnlen(player->name, MAX_NAME_LENGTH - 1);
+    SnapshotIdentity* identity = (SnapshotIdentity*)malloc(offsetof(SnapshotIdentity, name) + length + 1);
+    if (!identity) return NULL;
+    atomic_init(&identity->references, 1);
+    identity->class = player->class;
+    memcpy(identity->name, player->name, length);
+    identity->name[length] = '\0';
+    return identity;
+}
+
+static void releaseIdentity(SnapshotIdentity* identity) {
+    if (atomic_fetch_sub(&identity->references, 1) == 1) free(identity);
+}
+
+GameSnapshot* takeSnapshot(const GameState* game, GameSnapshot* previous) {
+    const Character* player = game->player;
+    int from = previous ? previous->historyCount : 0;
+    int count = game->choiceHistoryCount - from;
+    if (count < 0) return NULL;
+    for (int i = from; i < game->choiceHistoryCount; i++) {
+        if (game->choiceHistory[i] < 1 || game->choiceHistory[i] > MAX_CHOICES) return NULL;
+    }
+
+    SnapshotState state;
+    if (describeState(game, previous ? previous->state : NULL, &state) < 0) return NULL;
+
+    GameSnapshot* snapshot = (GameSnapshot*)malloc(offsetof(GameSnapshot, choices) + (size_t)count);
+    if (!snapshot) return NULL;
+
+    // Blocks the game did not change since previous are shared rather than copied
+    if (previous && sameState(previous->state, &state)) {
+        snapshot->state = previous->state;
+        atomic_fetch_add(&snapshot->state->references, 1);
+    } else {
+        snapshot->state = copyState(&state);
+    }
+    if (previous && previous->identity->class == player->class &&
+        strncmp(previous->identity->name, player->name, MAX_NAME_LENGTH) == 0) {
+        snapshot->identity = previous->identity;
+        atomic_fetch_add(&snapshot->identity->references, 1);
+    } else {
+        snapshot->identity = copyIdentity(player);
+    }
+    if (!snapshot->state || !snapshot->identity) {
+        if (snapshot->state) releaseState(snapshot->state);
+        if (snapshot->identity) releaseIdentity(snapshot->identity);
+        free(snapshot);
+        return NULL;
+    }
+
+    atomic_init(&snapshot->references, 1);
+    snapshot->parent = previous ? retainSnapshot(previous) : NULL;
+    snapshot->generation = previous ? previous->generation + 1 : 0;
+    snapshot->currentScene = game->currentScene;
+    snapshot->isGameOver = game->isGameOver;
+    snapshot->historyCount = game->choiceHistoryCount;
+    snapshot->choiceCount = count;
+    for (int i = 0; i < count; i++) {
+        snapshot->choices[i] = (uint8_t)game->choiceHistory[from + i];
+    }
+    return snapshot;
+}
+
+GameSnapshot* retainSnapshot(GameSnapshot* snapshot) {
+    atomic_fetch_add(&snapshot->references, 1);
+    return snapshot;
+}
+
+void releaseSnapshot(GameSnapshot* snapshot) {
+    // Iterative, so releasing a long chain does not recurse once per turn
+    while (snapshot && atomic_fetch_sub(&snapshot->references, 1) == 1) {
+        GameSnapshot* parent = snapshot->parent;
+        releaseState(snapshot->state);
+        releaseIdentity(snapshot->identity);
+        free(snapshot);
+        snapshot = parent;
+    }
+}
+
+GameSnapshot* getEarlierSnapshot(GameSnapshot* snapshot, int steps) {
+    while (snapshot && steps-- > 0) {
+        snapshot = snapshot->parent;
+    }
+    return snapshot;
+}
+
+/**
+ * @brief Writes a state block into a game and its character
+ * @param full 1 to write the traits whatever the character holds, 0 to
+ *        trust a matching trait mask, which only a game at a snapshot can
+ * @details The game keeps holding a reference to its chapter when it is not
+ *          in its start story, as enterChapter() leaves it.
+ */
+static void writeState(const SnapshotState* state, GameState* game, int full) {
+    Character* player = game->player;
+
+    if (game->story != state->story) {
+        if (state->story != state->startStory) retainStory(state->story);
+        releaseGameChapter(game);
+        game->story = state->story;
+    }
+    game->currentChapter = state->currentChapter;
+    player->strength = state->stats[STAT_STRENGTH];
+    player->intelligence = state->stats[STAT_INTELLIGENCE];
+    player->charisma = state->stats[STAT_CHARISMA];
+    player->health = state->stats[STAT_HEALTH];
+    game->reputation = state->stats[STAT_REPUTATION];
+    memcpy(game->inventory, state->inventory, sizeof(game->inventory));
+    game->inventoryCount = state->inventoryCount;
+    game->flags = state->flags;
+
+    if (full || player->traitMask != state->traitMask || player->traitCount != state->traitCount) {
+        player->traitMask = state->traitMask;
+        player->traitCount = state->traitCount;
+        for (int i = 0; i < state->traitCount; i++) {
+            strcpy(player->traits[i], getName(NAME_TRAIT, state->traits[i]));
+        }
+    }
+}
+
+int restoreSnapshot(const GameSnapshot* snapshot, GameState* game, const GameSnapshot* current) {
+    if (game->startStory != snapshot->state->startStory) return -1;
+    if (reserveChoiceHistory(game, snapshot->historyCount) < 0) return -1;
+
+    // Both sides walk up to their common ancestor; choices on the snapshot's side are written
+    const GameSnapshot* node = snapshot;
+    const GameSnapshot* ancestor = current;
+    while (node != ancestor) {
+        if (node && (!ancestor || node->generation >= ancestor->generation)) {
+            int start = node->historyCount - node->choiceCount;
+            for (int i = 0; i < node->choiceCount; i++) {
+                game->choiceHistory[start + i] = node->choices[i];
+            }
+            node = node->parent;
+        } else {
+            ancestor = ancestor->parent;
+        }
+    }
+    game->choiceHistoryCount = snapshot->historyCount;
+
+    if (!current || current->state != snapshot->state) {
+        writeState(snapshot->state, game, !current);
+    }
+    if (!current || current->identity != snapshot->identity) {
+        Character* player = game->player;
+        player->class = snapshot->identity->class;
+        strcpy(player->name, snapshot->identity->name);
+    }
+    game->currentScene = snapshot->currentScene;
+    game->isGameOver = snapshot->isGameOver;
+    return 0;
+}
+
+ChoiceResult previewChoice(GameState* game, const GameSnapshot* current, int choice, ChoicePreview* preview) {
+    ChoiceResult result = applyChoice(game, choice);
+    if (result != CHOICE_APPLIED) return result;
+
+    // A session crosses a chapter exit right after the choice, so the preview does too
+    enterNextChapter(game);
+
+    const SnapshotState* state = current->state;
+    const Character* player = game->player;
+    int stats[CONDITION_STATS] = {player->strength, player->intelligence, player->charisma,
+                                  player->health, game->reputation};
+    preview->choice = choice;
+    preview->chapter = game->currentChapter;
+    preview->node = game->currentScene == STORY_END ? -1 : game->story->nodes[game->currentScene].id;
+    preview->isGameOver = game->isGameOver;
+    for (int i = 0; i < CONDITION_STATS; i++) {
+        preview->statChanges[i] = stats[i] - state->stats[i];
+    }
+    preview->itemsGained = 0;
+    preview->itemsLost = 0;
+    for (int word = 0; word < INVENTORY_WORDS; word++) {
+        preview->itemsGained += __builtin_popcountll(game->inventory[word] & ~state->inventory[word]);
+        preview->itemsLost += __builtin_popcountll(state->inventory[word] & ~game->inventory[word]);
+    }
+
+    // A choice only appends to the history and cannot rename the character
+    writeState(state, game, 0);
+    game->choiceHistoryCount = current->historyCount;
+    game->currentScene = current->currentScene;
+    game->isGameOver = current->isGameOver;
+    return result;
+}
+
+/**
+ * @brief Appends one part of a preview text after a comma if it is not the first
+ * @return 0 if it fit, -1 otherwise
+ */
+static int appendPart(char* text, size_t capacity, size_t* length, const char* format, ...) {
+    if (*length) {
+        int written = snprintf(text + *length, capacity - *length, ", ");
+        if (written < 0 || (size_t)written >= capacity - *length) return -1;
+        *length += (size_t)written;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(text + *length, capacity - *length, format, args);
+    va_end(args);
+    if (written < 0 || (size_t)written >= capacity - *length) return -1;
+    *length += (size_t)written;
+    return 0;
+}
+
+int formatChoicePreview(const ChoicePreview* preview, const GameState* game, char* text, size_t capacity) {
+    if (!capacity) return -1;
+    text[0] = '\0';
+
+    size_t length = 0;
+    for (int i = 0; i < CONDITION_STATS; i++) {
+        if (preview->statChanges[i] &&
+            appendPart(text, capacity, &length, "%s %+d", statNames[i], preview->statChanges[i]) < 0) {
+            return -1;
+        }
+    }
+    if (preview->itemsGained && appendPart(text, capacity, &length, "gains %d item%s", preview->itemsGained,
+                                           preview->itemsGained == 1 ? "" : "s") < 0) {
+        return -1;
+    }
+    if (preview->itemsLost && appendPart(text, capacity, &length, "loses %d item%s", preview->itemsLost,
+                                         preview->itemsLost == 1 ? "" : "s") < 0) {
+        return -1;
+    }
+    if (preview->chapter != game->currentChapter &&
+        appendPart(text, capacity, &length, "leads into chapter %d", preview->chapter) < 0) {
+        return -1;
+    }
+    if (preview->isGameOver && appendPart(text, capacity, &length, "ends the story") < 0) {
+        return -1;
+    }
+    if (!length && appendPart(text, capacity, &length, "changes nothing") < 0) {
+        return -1;
+    }
+    return (int)length;
+}
@@ -0,0 +1,641 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../include/storyfile.h"
+#include "../include/condition.h"
+#include "../include/effect.h"
+
+#define IMAGE_ALIGNMENT 8
+#define PROGRAM_CONDITION 1     /* Code offset where a condition starts */
+#define PROGRAM_EFFECTS 2       /* Code offset where an effect list starts */
+
+/* Built-in chapters currently held by some game, by chapter number */
+static pthread_mutex_t chapterLock = PTHREAD_MUTEX_INITIALIZER;
+static Story* chapterCache[STORY_CHAPTERS + 1];
+
+/**
+ * @struct NodeTable
+ * @brief Dense numbering of authored nodes, built while compiling
+ */
+typedef struct {
+    const StoryNode** nodes;    /**< Nodes by index, in breadth-first order */
+    int count;                  /**< Number of numbered nodes */
+    int capacity;               /**< Capacity of nodes */
+    const StoryNode** slots;    /**< Open-addressing table keyed by node address */
+    int* slotIndex;             /**< Node index stored with each slot */
+    size_t slotMask;            /**< Table capacity minus one */
+} NodeTable;
+
+static size_t hashPointer(const void* pointer) {
+    uint64_t x = (uint64_t)(uintptr_t)pointer;
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    return (size_t)x;
+}
+
+static int lookupNodeIndex(const NodeTable* table, const StoryNode* node) {
+    size_t slot = hashPointer(node) & table->slotMask;
+    while (table->slots[slot]) {
+        if (table->slots[slot] == node) return table->slotIndex[slot];
+        slot = (slot + 1) & table->slotMask;
+    }
+    return STORY_END;
+}
+
+static void freeNodeTable(NodeTable* table) {
+    free(table->nodes);
+    free(table->slots);
+    free(table->slotIndex);
+}
+
+static int allocNodeTable(NodeTable* table, int capacity) {
+    table->count = 0;
+    table->capacity = capacity;
+    table->slotMask = (size_t)capacity * 2 - 1;
+    table->nodes = (const StoryNode**)malloc(sizeof(StoryNode*) * capacity);
+    table->slots = (const StoryNode**)calloc(table->slotMask + 1, sizeof(StoryNode*));
+    table->slotIndex = (int*)malloc(sizeof(int) * (table->slotMask + 1));
+    if (!table->nodes || !table->slots || !table->slotIndex) {
+        freeNodeTable(table);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Numbers a node if it is new
+ * @return 0 on success, -1 when the table is full
+ */
+static int addNodeIndex(NodeTable* table, const StoryNode* node) {
+    size_t slot = hashPointer(node) & table->slotMask;
+    while (table->slots[slot]) {
+        if (table->slots[slot] == node) return 0;
+        slot = (slot + 1) & table->slotMask;
+    }
+    if (table->count >= table->capacity) return -1;
+    table->slots[slot] = node;
+    table->slotIndex[slot] = table->count;
+    table->nodes[table->count++] = node;
+    return 0;
+}
+
+/**
+ * @brief Numbers every node reachable from root in breadth-first order
+ */
+static int buildNodeTable(NodeTable* table, const StoryNode* root) {
+    for (int capacity = 256; ; capacity *= 2) {
+        if (allocNodeTable(table, capacity) < 0) return -1;
+
+        // The node array doubles as the breadth-first queue
+        int full = addNodeIndex(table, root) < 0;
+        for (int head = 0; !full && head < table->count; head++) {
+            const StoryNode* node = table->nodes[head];
+            for (int i = 0; !full && i < node->numChoices; i++) {
+                if (node->nextNodes[i]) {
+                    full = addNodeIndex(table, node->nextNodes[i]) < 0;
+                }
+            }
+        }
+        if (!full) return 0;
+
+        freeNodeTable(table);
+    }
+}
+
+static size_t alignImage(size_t offset) {
+    return (offset + IMAGE_ALIGNMENT - 1) & ~(size_t)(IMAGE_ALIGNMENT - 1);
+}
+
+/**
+ * @brief Interns the names of a bound image into the registry
+ * @return 0 on success, -1 if a name is malformed or the registry is full
+ */
+static int internStoryNames(Story* story) {
+    const StoryFileHeader* header = story->header;
+    for (int kind = 0; kind < NAME_KINDS; kind++) {
+        story->names[kind] = NULL;
+    }
+
+    for (int kind = 0; kind < NAME_KINDS; kind++) {
+        if (!header->nameCount[kind]) continue;
+
+        uint16_t* ids = (uint16_t*)malloc(sizeof(uint16_t) * header->nameCount[kind]);
+        if (!ids) return -1;
+        story->names[kind] = ids;
+        for (uint32_t i = 0; i < header->nameCount[kind]; i++) {
+            TextSpan span = story->texts[header->nameText[kind] + i];
+            // Names come from the file, so they must end inside the pool
+            int id = -1;
+            if ((uint64_t)span.offset + span.length < header->poolSize && story->pool[span.offset + span.length] == '\0') {
+                id = internName((NameKind)kind, story->pool + span.offset);
+            }
+            if (id < 0) return -1;
+            ids[i] = (uint16_t)id;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Copies the bytecode of a bound image and links it to registry ids
+ * @param programs Receives, for each code offset, PROGRAM_CONDITION or
+ *        PROGRAM_EFFECTS where a program starts and 0 elsewhere
+ * @return 0 on success, -1 if the code is malformed
+ */
+static int linkStoryCode(Story* story, uint8_t* programs) {
+    const StoryFileHeader* header = story->header;
+    story->code = NULL;
+    if (!header->codeSize) return 0;
+
+    uint8_t* code = (uint8_t*)malloc(header->codeSize);
+    if (!code) return -1;
+    memcpy(code, (const char*)story->image + header->codeOffset, header->codeSize);
+    story->code = code;
+
+    // The section is nothing but complete programs back to back; the first
+    // opcode tells an effect list from a condition
+    memset(programs, 0, header->codeSize);
+    for (uint32_t offset = 0; offset < header->codeSize; ) {
+        uint8_t* program = code + offset;
+        size_t size = header->codeSize - offset;
+        int effects = *program >= EFFECT_BASE;
+        int length = effects ? linkEffects(program, size, story->names, header->nameCount)
+                             : linkCondition(program, size, story->names, header->nameCount);
+        if (length < 0) return -1;
+        programs[offset] = effects ? PROGRAM_EFFECTS : PROGRAM_CONDITION;
+        offset += (uint32_t)length;
+    }
+    return 0;
+}
+
+/**
+ * @brief Follows the programs of one node through the code section
+ * @param offset Offset of the node's next program; advanced past those checked
+ * @param kind PROGRAM_CONDITION or PROGRAM_EFFECTS
+ * @param count Number of programs of that kind the node has
+ * @return 0 if each of them starts where a program of that kind starts, -1 otherwise
+ */
+static int checkPrograms(const Story* story, const uint8_t* programs, uint32_t* offset, int kind, int count) {
+    for (int i = 0; i < count; i++) {
+        if (*offset >= story->header->codeSize || programs[*offset] != kind) return -1;
+        const uint8_t* code = story->code + *offset;
+        *offset += (uint32_t)(kind == PROGRAM_EFFECTS ? getEffectsLength(code) : getConditionLength(code));
+    }
+    return 0;
+}
+
+/**
+ * @brief Checks every node record and text span of a bound image
+ * @param programs Program starts found by linkStoryCode()
+ * @return 0 if everything the game reads through the records stays inside
+ *         the image, -1 otherwise
+ * @details The header only vouches for the sections as a whole; a truncated
+ *          or corrupt file can still hold records that point past them.
+ */
+static int validateRecords(const Story* story, const uint8_t* programs) {
+    const StoryFileHeader* header = story->header;
+
+    for (uint32_t i = 0; i < header->textCount; i++) {
+        TextSpan span = story->texts[i];
+        if ((uint64_t)span.offset + span.length >= header->poolSize || story->pool[span.offset + span.length] != '\0') {
+            return -1;
+        }
+    }
+
+    for (uint32_t n = 0; n < header->nodeCount; n++) {
+        const StoryRecord* record = &story->nodes[n];
+        int choices = record->numChoices;
+        if (choices > MAX_CHOICES) return -1;
+        if ((record->conditioned | record->effected) >> choices) return -1;
+        if ((uint64_t)record->text + 1 + (uint64_t)choices > header->textCount) return -1;
+        for (int i = 0; i < MAX_CHOICES; i++) {
+            int32_t next = record->nextNodes[i];
+            if (i < choices && next != STORY_END && (next < 0 || (uint32_t)next >= header->nodeCount)) return -1;
+            if (record->requirements[i][3] != (i < choices ? REQUIREMENT_PRESENT : REQUIREMENT_ABSENT)) return -1;
+        }
+
+        uint32_t offset = record->code;
+        if (checkPrograms(story, programs, &offset, PROGRAM_CONDITION, __builtin_popcount(record->conditioned)) < 0 ||
+            checkPrograms(story, programs, &offset, PROGRAM_EFFECTS, __builtin_popcount(record->effected)) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void freeStoryTables(Story* story) {
+    for (int kind = 0; kind < NAME_KINDS; kind++) {
+        free((void*)story->names[kind]);
+    }
+    free((void*)story->code);
+}
+
+/**
+ * @brief Points a story view at the sections of an image
+ * @return 0 on success, -1 if the image's names could not be interned, its
+ *         conditions could not be linked or a record points outside it
+ */
+/**
+ * @brief Hashes every byte of an image
+ * @details Any change to a requirement, an edge, a text or a program changes
+ *          the hash, so a replay is never fast-forwarded through a story that
+ *          differs from the one it was recorded in.
+ */
+static uint32_t hashImage(const void* image, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)image;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static int bindStory(Story* story, void* image, size_t imageSize, int mapped) {
+    const char* base = (const char*)image;
+    story->header = (const StoryFileHeader*)base;
+    story->nodes = (const StoryRecord*)(base + story->header->nodesOffset);
+    story->texts = (const TextSpan*)(base + story->header->textsOffset);
+    story->pool = base + story->header->poolOffset;
+    story->image = image;
+    story->code = NULL;
+
+    uint8_t* programs = NULL;
+    int failed = internStoryNames(story) < 0;
+    if (!failed) {
+        programs = (uint8_t*)malloc(story->header->codeSize ? story->header->codeSize : 1);
+        failed = !programs || linkStoryCode(story, programs) < 0 || validateRecords(story, programs) < 0;
+    }
+    free(programs);
+    if (failed) {
+        freeStoryTables(story);
+        return -1;
+    }
+    story->imageSize = imageSize;
+    story->tag = hashImage(image, imageSize);
+    story->mapped = mapped;
+    story->shared = 0;
+    atomic_init(&story->references, 1);
+    return 0;
+}
+
+Story* compileStory(const StoryBuilder* builder, const StoryNode* root) {
+    if (!root) return NULL;
+
+    NodeTable table;
+    if (buildNodeTable(&table, root) < 0) return NULL;
+
+    // One span per description and per choice, interned afresh so the image
+    // only carries text that reachable nodes use
+    size_t textCount = 0;
+    size_t codeSize = 0;
+    for (int kind = 0; kind < NAME_KINDS; kind++) {
+        textCount += (size_t)builder->nameCount[kind];
+    }
+    for (int n = 0; n < table.count; n++) {
+        const StoryNode* node = table.nodes[n];
+        textCount += 1 + (size_t)node->numChoices;
+        for (int i = 0; i < node->numChoices; i++) {
+            if (node->conditions[i] != NO_CONDITION) codeSize += getConditionLength(builder->code + node->conditions[i]);
+            if (node->effects[i] != NO_CONDITION) codeSize += getEffectsLength(builder->code + node->effects[i]);
+        }
+    }
+
+    TextPool pool;
+    initTextPool(&pool);
+    TextSpan* spans = (TextSpan*)malloc(sizeof(TextSpan) * textCount);
+    int failed = !spans;
+
+    size_t textUsed = 0;
+    for (int n = 0; !failed && n < table.count; n++) {
+        const StoryNode* node = table.nodes[n];
+        // Records keep the chapter number in a byte
+        failed = node->nextChapter > UINT8_MAX ||
+                 internText(&pool, getStoryText(builder, node->description), &spans[textUsed++]) < 0;
+        for (int i = 0; !failed && i < node->numChoices; i++) {
+            failed = internText(&pool, getStoryText(builder, node->choices[i]), &spans[textUsed++]) < 0;
+        }
+    }
+    size_t nameText[NAME_KINDS];
+    for (int kind = 0; kind < NAME_KINDS; kind++) {
+        nameText[kind] = textUsed;
+        for (int i = 0; !failed && i < builder->nameCount[kind]; i++) {
+            failed = internText(&pool, getStoryText(builder, builder->names[kind][i]), &spans[textUsed++]) < 0;
+        }
+    }
+
+    size_t nodesOffset = alignImage(sizeof(StoryFileHeader));
+    size_t textsOffset = alignImage(nodesOffset + sizeof(StoryRecord) * table.count);
+    size_t codeOffset = alignImage(textsOffset + sizeof(TextSpan) * textCount);
+    size_t poolOffset = alignImage(codeOffset + codeSize);
+    size_t imageSize = alignImage(poolOffset + pool.size);
+
+    Story* story = NULL;
+    char* image = NULL;
+    if (!failed && imageSize <= UINT32_MAX) {
+        story = (Story*)malloc(sizeof(Story));
+        image = (char*)calloc(1, imageSize);
+    }
+    if (!story || !image) {
+        free(story);
+        free(image);
+        free(spans);
+        freeTextPool(&pool);
+        freeNodeTable(&table);
+        return NULL;
+    }
+
+    StoryFileHeader* header = (StoryFileHeader*)image;
+    StoryRecord* records = (StoryRecord*)(image + nodesOffset);
+
+    memcpy(header->magic, STORY_FILE_MAGIC, sizeof(header->magic));
+    header->version = STORY_FILE_VERSION;
+    header->byteOrder = STORY_BYTE_ORDER;
+    header->fileSize = (uint32_t)imageSize;
+    header->nodeCount = (uint32_t)table.count;
+    header->textCount = (uint32_t)textCount;
+    header->poolSize = pool.size;
+    header->nodesOffset = (uint32_t)nodesOffset;
+    header->textsOffset = (uint32_t)textsOffset;
+    header->poolOffset = (uint32_t)poolOffset;
+    header->rootNode = 0;
+    header->chapter = builder->chapter;
+    for (int kind = 0; kind < NAME_KINDS; kind++) {
+        header->nameCount[kind] = (uint32_t)builder->nameCount[kind];
+        header->nameText[kind] = (uint32_t)nameText[kind];
+    }
+    header->codeOffset = (uint32_t)codeOffset;
+    header->codeSize = (uint32_t)codeSize;
+
+    memcpy(image + textsOffset, spans, sizeof(TextSpan) * textCount);
+    memcpy(image + poolOffset, pool.data, pool.size);
+
+    textUsed = 0;
+    size_t codeUsed = 0;
+    for (int n = 0; n < table.count; n++) {
+        const StoryNode* node = table.nodes[n];
+        StoryRecord* record = &records[n];
+
+        record->id = node->id;
+        record->numChoices = (uint8_t)node->numChoices;
+        record->conditioned = 0;
+        record->effected = 0;
+        record->text = (uint32_t)textUsed;
+        record->nextChapter = (uint8_t)node->nextChapter;
+        record->code = (uint32_t)codeUsed;
+        textUsed += 1 + (size_t)node->numChoices;
+
+        for (int i = 0; i < MAX_CHOICES; i++) {
+            record->nextNodes[i] = STORY_END;
+            record->requirements[i][3] = REQUIREMENT_ABSENT;
+        }
+        for (int i = 0; i < node->numChoices; i++) {
+            record->nextNodes[i] = node->nextNodes[i] ? lookupNodeIndex(&table, node->nextNodes[i]) : STORY_END;
+            record->requirements[i][0] = (uint8_t)node->requirements[i][0];
+            record->requirements[i][1] = (uint8_t)node->requirements[i][1];
+            record->requirements[i][2] = (uint8_t)node->requirements[i][2];
+            record->requirements[i][3] = REQUIREMENT_PRESENT;
+            if (node->conditions[i] != NO_CONDITION) {
+                const uint8_t* code = builder->code + node->conditions[i];
+                size_t length = getConditionLength(code);
+                memcpy(image + codeOffset + codeUsed, code, length);
+                codeUsed += length;
+                record->conditioned |= (uint8_t)(1u << i);
+            }
+        }
+        for (int i = 0; i < node->numChoices; i++) {
+            if (node->effects[i] != NO_CONDITION) {
+                const uint8_t* code = builder->code + node->effects[i];
+                size_t length = getEffectsLength(code);
+                memcpy(image + codeOffset + codeUsed, code, length);
+                codeUsed += length;
+                record->effected |= (uint8_t)(1u << i);
+            }
+        }
+    }
+
+    free(spans);
+    freeTextPool(&pool);
+    freeNodeTable(&table);
+    if (bindStory(story, image, imageSize, 0) < 0) {
+        free(story);
+        free(image);
+        return NULL;
+    }
+    return story;
+}
+
+Story* compileBuiltinStory(void) {
+    return compileBuiltinChapter(1);
+}
+
+Story* compileBuiltinChapter(int chapter) {
+    StoryBuilder builder;
+    initStoryBuilder(&builder);
+
+    // The authored graph is only needed until it has been compiled
+    Story* story = compileStory(&builder, createChapter(&builder, chapter));
+    cleanupStory(&builder);
+    return story;
+}
+
+Story* openBuiltinChapter(int chapter) {
+    if (chapter < 1 || chapter > STORY_CHAPTERS) return NULL;
+
+    // Compiling under the lock keeps two games from building the same chapter
+    pthread_mutex_lock(&chapterLock);
+    Story* story = chapterCache[chapter];
+    if (story) {
+        retainStory(story);
+    } else {
+        story = compileBuiltinChapter(chapter);
+        if (story) {
+            story->shared = 1;
+            chapterCache[chapter] = story;
+        }
+    }
+    pthread_mutex_unlock(&chapterLock);
+    return story;
+}
+
+int writeStoryFile(const Story* story, const char* path) {
+    // Truncating a file in place would pull the pages out from under anyone mapping it
+    size_t length = strlen(path);
+    char* temporary = (char*)malloc(length + 5);
+    if (!temporary) return -1;
+    memcpy(temporary, path, length);
+    memcpy(temporary + length, ".new", 5);
+
+    FILE* file = fopen(temporary, "wb");
+    if (!file) {
+        free(temporary);
+        return -1;
+    }
+
+    size_t written = fwrite(story->image, 1, story->imageSize, file);
+    int failed = fclose(file) != 0 || written != story->imageSize || rename(temporary, path) != 0;
+    if (failed) unlink(temporary);
+    free(temporary);
+    return failed ? -1 : 0;
+}
+
+/**
+ * @brief Checks that a header describes a well-formed image of the given size
+ */
+static int validateHeader(const StoryFileHeader* header, size_t size) {
+    if (memcmp(header->magic, STORY_FILE_MAGIC, sizeof(header->magic)) != 0) return 0;
+    if (header->byteOrder != STORY_BYTE_ORDER) return 0;
+    if (header->version != STORY_FILE_VERSION) return 0;
+    if (header->fileSize != size) return 0;
+
+    uint64_t nodesEnd = (uint64_t)header->nodesOffset + (uint64_t)header->nodeCount * sizeof(StoryRecord);
+    uint64_t textsEnd = (uint64_t)header->textsOffset + (uint64_t)header->textCount * sizeof(TextSpan);
+    uint64_t codeEnd = (uint64_t)header->codeOffset + header->codeSize;
+    uint64_t poolEnd = (uint64_t)header->poolOffset + header->poolSize;
+
+    if (header->nodesOffset < sizeof(StoryFileHeader) || nodesEnd > size) return 0;
+    if (header->textsOffset < nodesEnd || textsEnd > size) return 0;
+    if (header->codeOffset < textsEnd || codeEnd > size) return 0;
+    if (header->poolOffset < codeEnd || poolEnd > size) return 0;
+    if (header->nodesOffset % IMAGE_ALIGNMENT || header->textsOffset % IMAGE_ALIGNMENT) return 0;
+    if (header->rootNode < 0 || (uint32_t)header->rootNode >= header->nodeCount) return 0;
+    if (header->chapter < 1) return 0;
+    for (int kind = 0; kind < NAME_KINDS; kind++) {
+        if (header->nameCount[kind] > MAX_ITEMS) return 0;
+        if ((uint64_t)header->nameText[kind] + header->nameCount[kind] > header->textCount) return 0;
+    }
+    return 1;
+}
+
+Story* openStoryFile(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(StoryFileHeader)) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t)info.st_size;
+    void* image = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) return NULL;
+
+    Story* story = (Story*)malloc(sizeof(Story));
+    if (!story || !validateHeader((const StoryFileHeader*)image, size)) {
+        free(story);
+        munmap(image, size);
+        return NULL;
+    }
+
+    if (bindStory(story, image, size, 1) < 0) {
+        free(story);
+        munmap(image, size);
+        return NULL;
+    }
+    return story;
+}
+
+Story* copyStory(const Story* story) {
+    Story* copy = (Story*)malloc(sizeof(Story));
+    void* image = malloc(story->imageSize);
+    if (!copy || !image) {
+        free(copy);
+        free(image);
+        return NULL;
+    }
+
+    // The image keeps its bytecode unlinked, so binding the copy links it afresh
+    memcpy(image, story->image, story->imageSize);
+    if (bindStory(copy, image, story->imageSize, 0) < 0) {
+        free(copy);
+        free(image);
+        return NULL;
+    }
+    return copy;
+}
+
+Story* retainStory(Story* story) {
+    atomic_fetch_add_explicit(&story->references, 1, memory_order_relaxed);
+    return story;
+}
+
+void closeStory(Story* story) {
+    if (!story) return;
+
+    if (story->shared) {
+        // The cache must not hand out a chapter that is being freed
+        pthread_mutex_lock(&chapterLock);
+        int held = atomic_fetch_sub_explicit(&story->references, 1, memory_order_acq_rel) > 1;
+        if (!held) chapterCache[story->header->chapter] = NULL;
+        pthread_mutex_unlock(&chapterLock);
+        if (held) return;
+    } else if (atomic_fetch_sub_explicit(&story->references, 1, memory_order_acq_rel) > 1) {
+        return;
+    }
+
+    if (story->mapped) {
+        munmap(story->image, story->imageSize);
+    } else {
+        free(story->image);
+    }
+    freeStoryTables(story);
+    free(story);
+}
+
+void initLiveStory(LiveStory* live, Story* story) {
+    atomic_init(&live->current, story);
+    atomic_init(&live->version, 1);
+    pthread_mutex_init(&live->lock, NULL);
+}
+
+unsigned publishStory(LiveStory* live, Story* story) {
+    pthread_mutex_lock(&live->lock);
+    Story* previous = atomic_exchange_explicit(&live->current, story, memory_order_acq_rel);
+    unsigned version = atomic_fetch_add_explicit(&live->version, 1, memory_order_release) + 1;
+    pthread_mutex_unlock(&live->lock);
+
+    // Games still on the previous version hold references of their own
+    closeStory(previous);
+    return version;
+}
+
+unsigned getLiveStoryVersion(const LiveStory* live) {
+    return atomic_load_explicit(&live->version, memory_order_acquire);
+}
+
+Story* acquireLiveStory(LiveStory* live, unsigned* version) {
+    // The lock keeps the slot's reference alive between the load and the retain
+    pthread_mutex_lock(&live->lock);
+    Story* story = retainStory(atomic_load_explicit(&live->current, memory_order_acquire));
+    if (version) *version = atomic_load_explicit(&live->version, memory_order_relaxed);
+    pthread_mutex_unlock(&live->lock);
+    return story;
+}
+
+void closeLiveStory(LiveStory* live) {
+    closeStory(atomic_load_explicit(&live->current, memory_order_relaxed));
+    atomic_store_explicit(&live->current, NULL, memory_order_relaxed);
+    pthread_mutex_destroy(&live->lock);
+}
+
+const char* getNodeDescription(const Story* story, int node) {
+    return story->pool + story->texts[story->nodes[node].text].offset;
+}
+
+const char* getChoiceText(const Story* story, int node, int choice) {
+    return story->pool + story->texts[story->nodes[node].text + 1 + choice].offset;
+}
+
+int findStoryNode(const Story* story, int id) {
+    for (uint32_t i = 0; i < story->header->nodeCount; i++) {
+        if (story->nodes[i].id == id) return (int)i;
+    }
+    return STORY_END;
+}
@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../include/telemetry.h"
+#include "../include/engine.h"
+
+#define TELEMETRY_RING_MASK (TELEMETRY_RING_EVENTS - 1)
+#define CACHE_LINE_SIZE 64
+
+/**
+ * @struct TelemetryRing
+ * @brief Single-producer, single-consumer ring of one recording thread
+ * @details The producer only writes head and dropped, the flush thread only
+ *          writes tail; each sits on its own cache line so neither side
+ *          keeps invalidating the other's.
+ */
+typedef struct TelemetryRing {
+    alignas(CACHE_LINE_SIZE) _Atomic uint64_t head;     /**< Events recorded; the next slot to fill */
+    alignas(CACHE_LINE_SIZE) _Atomic uint64_t tail;     /**< Events drained; the next slot to drain */
+    alignas(CACHE_LINE_SIZE) _Atomic uint64_t dropped;  /**< Events dropped because the ring was full */
+    struct TelemetryRing* next;                         /**< Ring attached before this one */
+    ChoiceEvent events[TELEMETRY_RING_EVENTS];          /**< Event slots, indexed modulo the capacity */
+} TelemetryRing;
+
+struct TelemetryLog {
+    FILE* file;                         /* Log file opened for appending */
+    uint64_t runId;                     /* Random id placed in the high half of every session */
+    uint64_t generation;                /* Tells this log's rings from those of a closed one */
+    _Atomic(TelemetryRing*) rings;      /* Every attached ring, newest first */
+    _Atomic uint64_t unattached;        /* Events lost because a ring could not be allocated */
+    _Atomic uint64_t written;           /* Events written to the file */
+    atomic_int writeFailed;             /* A write failed; later events are drained and discarded */
+    pthread_t thread;                   /* Flush thread */
+    pthread_mutex_t lock;               /* Guards stopping */
+    pthread_cond_t wake;                /* Signalled to stop the flush thread */
+    int stopping;                       /* The log is being closed */
+    uint8_t buffer[TELEMETRY_RING_EVENTS * TELEMETRY_RECORD_SIZE];  /* Encoded records of one ring */
+};
+
+// Each thread keeps the ring it attached, tagged with the log's generation
+static _Thread_local TelemetryRing* threadRing = NULL;
+static _Thread_local uint64_t threadRingGeneration = 0;
+static _Atomic uint64_t nextGeneration = 1;
+
+static void put16(uint8_t* out, uint32_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+}
+
+static void put32(uint8_t* out, uint32_t value) {
+    put16(out, value);
+    put16(out + 2, value >> 16);
+}
+
+static void put64(uint8_t* out, uint64_t value) {
+    put32(out, (uint32_t)value);
+    put32(out + 4, (uint32_t)(value >> 32));
+}
+
+static uint16_t get16(const uint8_t* in) {
+    return (uint16_t)(in[0] | in[1] << 8);
+}
+
+static uint32_t get32(const uint8_t* in) {
+    return (uint32_t)get16(in) | (uint32_t)get16(in + 2) << 16;
+}
+
+static uint64_t get64(const uint8_t* in) {
+    return (uint64_t)get32(in) | (uint64_t)get32(in + 4) << 32;
+}
+
+static void encodeEvent(const TelemetryLog* log, const ChoiceEvent* event, uint8_t* out) {
+    put64(out, event->timestamp);
+    put64(out + 8, log->runId << 32 | event->session);
+    put32(out + 16, (uint32_t)event->node);
+    put32(out + 20, (uint32_t)event->next);
+    out[24] = event->choice;
+    out[25] = event->characterClass;
+    out[26] = event->flags;
+    out[27] = 0;
+    put16(out + 28, (uint16_t)event->health);
+    put16(out + 30, (uint16_t)event->strength);
+    put16(out + 32, (uint16_t)event->intelligence);
+    put16(out + 34, (uint16_t)event->charisma);
+}
+
+int checkTelemetryHeader(const uint8_t* header, size_t size) {
+    if (size < TELEMETRY_HEADER_SIZE || memcmp(header, TELEMETRY_FILE_MAGIC, 8) != 0) return -1;
+    if (get32(header + 8) != TELEMETRY_FILE_VERSION || get32(header + 12) != TELEMETRY_RECORD_SIZE) return -1;
+    return 0;
+}
+
+uint64_t decodeChoiceEvent(const uint8_t* record, ChoiceEvent* event) {
+    uint64_t session = get64(record + 8);
+    event->timestamp = get64(record);
+    event->session = (uint32_t)session;
+    event->node = (int32_t)get32(record + 16);
+    event->next = (int32_t)get32(record + 20);
+    event->choice = record[24];
+    event->characterClass = record[25];
+    event->flags = record[26];
+    event->health = (int16_t)get16(record + 28);
+    event->strength = (int16_t)get16(record + 30);
+    event->intelligence = (int16_t)get16(record + 32);
+    event->charisma = (int16_t)get16(record + 34);
+    return session;
+}
+
+static int16_t clampStat(int value) {
+    if (value > INT16_MAX) return INT16_MAX;
+    if (value < INT16_MIN) return INT16_MIN;
+    return (int16_t)value;
+}
+
+void describeChoice(ChoiceEvent* event, const GameState* game, int node, int choice) {
+    const Story* story = game->story;
+    const Character* player = game->player;
+    int next = game->currentScene;
+
+    event->node = node;
+    event->next = next == STORY_END ? -1 : story->nodes[next].id;
+    event->choice = (uint8_t)choice;
+    event->characterClass = (uint8_t)player->class;
+    int ended = next == STORY_END || (story->nodes[next].numChoices == 0 && !story->nodes[next].nextChapter);
+    event->flags = ended ? TELEMETRY_FLAG_ENDING : 0;
+    event->health = clampStat(player->health);
+    event->strength = clampStat(player->strength);
+    event->intelligence = clampStat(player->intelligence);
+    event->charisma = clampStat(player->charisma);
+}
+
+/**
+ * @brief Gives the calling thread a ring in the log
+ * @return Pointer to the ring, or NULL when out of memory
+ */
+static TelemetryRing* attachRing(TelemetryLog* log) {
+    TelemetryRing* ring = (TelemetryRing*)aligned_alloc(CACHE_LINE_SIZE, sizeof(TelemetryRing));
+    if (!ring) return NULL;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+
+    // Publish the ring to the flush thread with a lock-free push
+    ring->next = atomic_load_explicit(&log->rings, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&log->rings, &ring->next, ring, memory_order_release,
+                                                  memory_order_relaxed)) {
+    }
+
+    threadRing = ring;
+    threadRingGeneration = log->generation;
+    return ring;
+}
+
+void recordChoiceEvent(TelemetryLog* log, ChoiceEvent* event) {
+    TelemetryRing* ring = threadRing;
+    if (!ring || threadRingGeneration != log->generation) {
+        ring = attachRing(log);
+        if (!ring) {
+            atomic_fetch_add_explicit(&log->unattached, 1, memory_order_relaxed);
+            return;
+        }
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    event->timestamp = (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+
+    // A full ring drops the event; the game never waits for the flush thread
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail >= TELEMETRY_RING_EVENTS) {
+        uint64_t dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+        atomic_store_explicit(&ring->dropped, dropped + 1, memory_order_relaxed);
+        return;
+    }
+    ring->events[head & TELEMETRY_RING_MASK] = *event;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/**
+ * @brief Writes the events waiting in every ring to the file
+ */
+static void drainRings(TelemetryLog* log) {
+    int wrote = 0;
+    TelemetryRing* ring = atomic_load_explicit(&log->rings, memory_order_acquire);
+    for (; ring; ring = ring->next) {
+        uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        size_t count = (size_t)(head - tail);
+        if (!count) continue;
+
+        for (size_t i = 0; i < count; i++) {
+            encodeEvent(log, &ring->events[(tail + i) & TELEMETRY_RING_MASK],
+                        log->buffer + i * TELEMETRY_RECORD_SIZE);
+        }
+        // The slots are free once encoded, before the disk is touched
+        atomic_store_explicit(&ring->tail, head, memory_order_release);
+
+        if (atomic_load_explicit(&log->writeFailed, memory_order_relaxed)) continue;
+        if (fwrite(log->buffer, TELEMETRY_RECORD_SIZE, count, log->file) != count) {
+            atomic_store_explicit(&log->writeFailed, 1, memory_order_relaxed);
+            continue;
+        }
+        atomic_fetch_add_explicit(&log->written, count, memory_order_relaxed);
+        wrote = 1;
+    }
+
+    if (wrote && fflush(log->file) != 0) {
+        atomic_store_explicit(&log->writeFailed, 1, memory_order_relaxed);
+    }
+}
+
+static void* flushMain(void* argument) {
+    TelemetryLog* log = (TelemetryLog*)argument;
+
+    pthread_mutex_lock(&log->lock);
+    while (!log->stopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_nsec += TELEMETRY_FLUSH_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&log->wake, &log->lock, &deadline);
+
+        pthread_mutex_unlock(&log->lock);
+        drainRings(log);
+        pthread_mutex_lock(&log->lock);
+    }
+    pthread_mutex_unlock(&log->lock);
+
+    // Recording has stopped; write whatever is left
+    drainRings(log);
+    return NULL;
+}
+
+/**
+ * @brief Opens the log file, checking the header of an existing log
+ * @return The file positioned for appending, or NULL
+ */
+static FILE* openLogFile(const char* path) {
+    struct stat existing;
+    if (stat(path, &existing) == 0 && existing.st_size > 0) {
+        uint8_t header[TELEMETRY_HEADER_SIZE];
+        FILE* file = fopen(path, "rb");
+        if (!file) return NULL;
+        size_t got = fread(header, 1, sizeof(header), file);
+        fclose(file);
+        if (checkTelemetryHeader(header, got) < 0) return NULL;
+
+        // A record torn by a crash is cut off so new records stay aligned
+        off_t records = (existing.st_size - TELEMETRY_HEADER_SIZE) / TELEMETRY_RECORD_SIZE;
+        off_t whole = TELEMETRY_HEADER_SIZE + records * TELEMETRY_RECORD_SIZE;
+        if (whole != existing.st_size && truncate(path, whole) != 0) return NULL;
+        return fopen(path, "ab");
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (!file) return NULL;
+    uint8_t header[TELEMETRY_HEADER_SIZE] = {0};
+    memcpy(header, TELEMETRY_FILE_MAGIC, 8);
+    put32(header + 8, TELEMETRY_FILE_VERSION);
+    put32(header + 12, TELEMETRY_RECORD_SIZE);
+    if (fwrite(header, sizeof(header), 1, file) != 1 || fflush(file) != 0) {
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
+
+/**
+ * @brief Makes a run id that differs between runs and processes
+ */
+static uint64_t makeRunId(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t x = (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec + ((uint64_t)getpid() << 40);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return (x ^ (x >> 31)) & 0xFFFFFFFFu;
+}
+
+TelemetryLog* openTelemetryLog(const char* path) {
+    TelemetryLog* log = (TelemetryLog*)malloc(sizeof(TelemetryLog));
+    if (!log) return NULL;
+    log->file = openLogFile(path);
+    if (!log->file) {
+        free(log);
+        return NULL;
+    }
+
+    log->runId = makeRunId();
+    log->generation = atomic_fetch_add(&nextGeneration, 1);
+    atomic_init(&log->rings, NULL);
+    atomic_init(&log->unattached, 0);
+    atomic_init(&log->written, 0);
+    atomic_init(&log->writeFailed, 0);
+    log->stopping = 0;
+
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&log->wake, &attributes);
+    pthread_condattr_destroy(&attributes);
+    pthread_mutex_init(&log->lock, NULL);
+
+    // Signals such as SIGWINCH must keep going to the threads running the game
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    int failed = pthread_create(&log->thread, NULL, flushMain, log);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (failed) {
+        pthread_cond_destroy(&log->wake);
+        pthread_mutex_destroy(&log->lock);
+        fclose(log->file);
+        free(log);
+        return NULL;
+    }
+    return log;
+}
+
+void getTelemetryStats(TelemetryLog* log, TelemetryStats* stats) {
+    stats->recorded = 0;
+    stats->dropped = atomic_load_explicit(&log->unattached, memory_order_relaxed);
+    TelemetryRing* ring = atomic_load_explicit(&log->rings, memory_order_acquire);
+    for (; ring; ring = ring->next) {
+        stats->recorded += atomic_load_explicit(&ring->head, memory_order_relaxed);
+        stats->dropped += atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+    }
+    stats->written = atomic_load_explicit(&log->written, memory_order_relaxed);
+    stats->writeFailed = atomic_load_explicit(&log->writeFailed, memory_order_relaxed);
+}
+
+int closeTelemetryLog(TelemetryLog* log) {
+    if (!log) return 0;
+
+    pthread_mutex_lock(&log->lock);
+    log->stopping = 1;
+    pthread_cond_signal(&log->wake);
+    pthread_mutex_unlock(&log->lock);
+    pthread_join(log->thread, NULL);
+
+    TelemetryStats stats;
+    getTelemetryStats(log, &stats);
+    int failed = fclose(log->file) != 0 || stats.writeFailed || stats.dropped > 0;
+
+    TelemetryRing* ring = atomic_load(&log->rings);
+    while (ring) {
+        TelemetryRing* next = ring->next;
+        free(ring);
+        ring = next;
+    }
+    pthread_cond_destroy(&log->wake);
+    pthread_mutex_destroy(&log->lock);
+    free(log);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,101 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/textpool.h"
+
+#define EMPTY_SLOT UINT32_MAX
+#define INITIAL_SLOTS 256
+#define INITIAL_POOL_SIZE 4096
+
+static uint32_t hashText(const char* text, uint32_t length) {
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void initTextPool(TextPool* pool) {
+    memset(pool, 0, sizeof(TextPool));
+}
+
+static int growSlots(TextPool* pool) {
+    uint32_t capacity = pool->slotMask ? (pool->slotMask + 1) * 2 : INITIAL_SLOTS;
+    TextSpan* slots = (TextSpan*)malloc(sizeof(TextSpan) * capacity);
+    if (!slots) return -1;
+
+    for (uint32_t i = 0; i < capacity; i++) {
+        slots[i].length = EMPTY_SLOT;
+    }
+
+    // Re-insert existing spans; they are distinct, so no comparisons are needed
+    for (uint32_t i = 0; pool->slotMask && i <= pool->slotMask; i++) {
+        TextSpan span = pool->slots[i];
+        if (span.length == EMPTY_SLOT) continue;
+        uint32_t slot = hashText(pool->data + span.offset, span.length) & (capacity - 1);
+        while (slots[slot].length != EMPTY_SLOT) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        slots[slot] = span;
+    }
+
+    free(pool->slots);
+    pool->slots = slots;
+    pool->slotMask = capacity - 1;
+    return 0;
+}
+
+static int reserveData(TextPool* pool, uint32_t extra) {
+    if (pool->size + extra <= pool->capacity) return 0;
+
+    uint64_t capacity = pool->capacity ? pool->capacity : INITIAL_POOL_SIZE;
+    while (capacity < (uint64_t)pool->size + extra) capacity *= 2;
+    if (capacity > UINT32_MAX) return -1;
+
+    char* data = (char*)realloc(pool->data, (size_t)capacity);
+    if (!data) return -1;
+    pool->data = data;
+    pool->capacity = (uint32_t)capacity;
+    return 0;
+}
+
+int internText(TextPool* pool, const char* text, TextSpan* span) {
+    size_t textLength = strlen(text);
+    if (textLength >= EMPTY_SLOT) return -1;
+    uint32_t length = (uint32_t)textLength;
+
+    // Keep the table at most half full
+    if ((pool->count + 1) * 2 > pool->slotMask + 1 && growSlots(pool) < 0) {
+        return -1;
+    }
+
+    uint32_t slot = hashText(text, length) & pool->slotMask;
+    while (pool->slots[slot].length != EMPTY_SLOT) {
+        TextSpan existing = pool->slots[slot];
+        if (existing.length == length && memcmp(pool->data + existing.offset, text, length) == 0) {
+            *span = existing;
+            return 0;
+        }
+        slot = (slot + 1) & pool->slotMask;
+    }
+
+    if (reserveData(pool, length + 1) < 0) return -1;
+
+    span->offset = pool->size;
+    span->length = length;
+    memcpy(pool->data + pool->size, text, length + 1);
+    pool->size += length + 1;
+    pool->slots[slot] = *span;
+    pool->count++;
+    return 0;
+}
+
+const char* getPoolText(const TextPool* pool, TextSpan span) {
+    return pool->data + span.offset;
+}
+
+void freeTextPool(TextPool* pool) {
+    free(pool->data);
+    free(pool->slots);
+    initTextPool(pool);
+}
@@ -0,0 +1,572 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../include/engine.h"
+#include "../include/telemetry.h"
+
+/**
+ * @file analytics.c
+ * @brief Offline analytics over choice telemetry logs
+ * @details Maps one or more telemetry logs and reads them in a single pass
+ *          split across threads. The logs are cut into fixed-size chunks
+ *          handed out from a shared counter; each thread tallies its chunks
+ *          into its own counters and the tallies are merged at the end.
+ *          Memory is bounded by the story, not the logs: counters are per
+ *          node, drop-offs are the arrivals at a node minus the choices made
+ *          there, distinct sessions are estimated with HyperLogLog sketches,
+ *          and pages of a chunk are released as soon as it is tallied.
+ *
+ *          Reports per-node visits and choice shares, the nodes where
+ *          players most often stopped, and per-class ending rates. Sessions
+ *          cross chapters, so every built-in chapter is loaded unless the
+ *          stories are named with -f; chapter exits are left out since
+ *          events name the node entered in the next chapter instead.
+ */
+
+#define NUM_CLASSES 4
+#define MAX_THREADS 256
+#define DEFAULT_TOP 15
+#define MAX_STORIES 16
+#define CHUNK_RECORDS (1 << 20)             /* Records per work item, about 36 MB */
+#define SKETCH_BITS 14                      /* HyperLogLog registers per class, as a power of two */
+#define SKETCH_REGISTERS (1 << SKETCH_BITS)
+
+/**
+ * @struct LogFile
+ * @brief One mapped telemetry log
+ */
+typedef struct {
+    const char* path;               /**< Path given on the command line */
+    void* map;                      /**< Mapping of the whole file */
+    size_t mapSize;                 /**< Size of the mapping */
+    const uint8_t* records;         /**< First record */
+    size_t count;                   /**< Whole records in the file */
+} LogFile;
+
+/**
+ * @struct Chunk
+ * @brief Range of records handed to one thread at a time
+ */
+typedef struct {
+    int file;                       /**< Index of the log */
+    size_t first;                   /**< First record */
+    size_t count;                   /**< Number of records */
+} Chunk;
+
+/**
+ * @struct NodeTable
+ * @brief Open-addressing map from authored node ids to node indices
+ */
+typedef struct {
+    int32_t* ids;                   /**< Authored id in each slot */
+    int32_t* indices;               /**< Node index in each slot, or STORY_END for an empty slot */
+    uint32_t mask;                  /**< Slots minus one */
+} NodeTable;
+
+/**
+ * @struct Tally
+ * @brief Counters of one thread, merged into the first at the end
+ */
+typedef struct {
+    uint64_t* arrivals;             /**< Choices leading into each node */
+    uint64_t* departures;           /**< Choices made at each node */
+    uint64_t* choices;              /**< Choices made at each node, by choice index */
+    uint64_t* endings;              /**< Endings reached, by ending (STORY_END last) and class */
+    uint64_t events;                /**< Records read */
+    uint64_t unknown;               /**< Records naming a node or class the story does not have */
+    uint64_t firstTimestamp;        /**< Earliest event */
+    uint64_t lastTimestamp;         /**< Latest event */
+    uint8_t sessions[NUM_CLASSES][SKETCH_REGISTERS];  /**< Distinct session sketch of each class */
+} Tally;
+
+/**
+ * @struct Analysis
+ * @brief Shared, read-only state of a run plus the chunk counter
+ */
+typedef struct {
+    const StoryRecord** nodes;      /**< Nodes of the stories the logs were recorded with */
+    uint32_t nodeCount;             /**< Number of nodes */
+    NodeTable table;                /**< Node lookup */
+    LogFile* files;                 /**< Mapped logs */
+    Chunk* chunks;                  /**< Work items */
+    size_t chunkCount;              /**< Number of work items */
+    atomic_size_t nextChunk;        /**< Next work item to hand out */
+} Analysis;
+
+/**
+ * @struct Worker
+ * @brief One analysis thread
+ */
+typedef struct {
+    Analysis* analysis;             /**< Shared state */
+    Tally* tally;                   /**< This thread's counters */
+} Worker;
+
+static const char* classNames[NUM_CLASSES] = {"Warrior", "Scholar", "Diplomat", "Rogue"};
+
+static uint64_t mixBits(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static int buildNodeTable(NodeTable* table, const StoryRecord** nodes, uint32_t nodeCount) {
+    uint32_t slots = 16;
+    while (slots < nodeCount * 2) slots *= 2;
+
+    table->ids = (int32_t*)malloc(sizeof(int32_t) * slots);
+    table->indices = (int32_t*)malloc(sizeof(int32_t) * slots);
+    table->mask = slots - 1;
+    if (!table->ids || !table->indices) return -1;
+
+    for (uint32_t i = 0; i < slots; i++) {
+        table->indices[i] = STORY_END;
+    }
+    for (uint32_t n = 0; n < nodeCount; n++) {
+        uint32_t slot = (uint32_t)mixBits((uint32_t)nodes[n]->id) & table->mask;
+        while (table->indices[slot] != STORY_END) {
+            slot = (slot + 1) & table->mask;
+        }
+        table->ids[slot] = nodes[n]->id;
+        table->indices[slot] = (int32_t)n;
+    }
+    return 0;
+}
+
+static int findNode(const NodeTable* table, int32_t id) {
+    uint32_t slot = (uint32_t)mixBits((uint32_t)id) & table->mask;
+    while (table->indices[slot] != STORY_END) {
+        if (table->ids[slot] == id) return table->indices[slot];
+        slot = (slot + 1) & table->mask;
+    }
+    return STORY_END;
+}
+
+static void addToSketch(uint8_t* registers, uint64_t session) {
+    uint64_t hash = mixBits(session);
+    uint32_t index = (uint32_t)(hash >> (64 - SKETCH_BITS));
+    uint64_t rest = hash << SKETCH_BITS;
+    uint8_t rank = rest ? (uint8_t)(__builtin_clzll(rest) + 1) : (uint8_t)(64 - SKETCH_BITS + 1);
+    if (rank > registers[index]) registers[index] = rank;
+}
+
+static double estimateSketch(const uint8_t* registers) {
+    double sum = 0.0;
+    int zeros = 0;
+    for (int i = 0; i < SKETCH_REGISTERS; i++) {
+        sum += ldexp(1.0, -registers[i]);
+        if (!registers[i]) zeros++;
+    }
+    double m = SKETCH_REGISTERS;
+    double estimate = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+    // Few sessions: count empty registers instead
+    if (estimate <= 2.5 * m && zeros) estimate = m * log(m / zeros);
+    return estimate;
+}
+
+static Tally* createTally(uint32_t nodeCount) {
+    Tally* tally = (Tally*)calloc(1, sizeof(Tally));
+    if (!tally) return NULL;
+    tally->arrivals = (uint64_t*)calloc(nodeCount, sizeof(uint64_t));
+    tally->departures = (uint64_t*)calloc(nodeCount, sizeof(uint64_t));
+    tally->choices = (uint64_t*)calloc((size_t)nodeCount * MAX_CHOICES, sizeof(uint64_t));
+    tally->endings = (uint64_t*)calloc((size_t)(nodeCount + 1) * NUM_CLASSES, sizeof(uint64_t));
+    tally->firstTimestamp = UINT64_MAX;
+    if (!tally->arrivals || !tally->departures || !tally->choices || !tally->endings) {
+        free(tally->arrivals);
+        free(tally->departures);
+        free(tally->choices);
+        free(tally->endings);
+        free(tally);
+        return NULL;
+    }
+    return tally;
+}
+
+static void freeTally(Tally* tally) {
+    if (!tally) return;
+    free(tally->arrivals);
+    free(tally->departures);
+    free(tally->choices);
+    free(tally->endings);
+    free(tally);
+}
+
+static void mergeTally(Tally* into, const Tally* from, uint32_t nodeCount) {
+    for (uint32_t n = 0; n < nodeCount; n++) {
+        into->arrivals[n] += from->arrivals[n];
+        into->departures[n] += from->departures[n];
+    }
+    for (size_t i = 0; i < (size_t)nodeCount * MAX_CHOICES; i++) {
+        into->choices[i] += from->choices[i];
+    }
+    for (size_t i = 0; i < (size_t)(nodeCount + 1) * NUM_CLASSES; i++) {
+        into->endings[i] += from->endings[i];
+    }
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        for (int r = 0; r < SKETCH_REGISTERS; r++) {
+            if (from->sessions[c][r] > into->sessions[c][r]) into->sessions[c][r] = from->sessions[c][r];
+        }
+    }
+    into->events += from->events;
+    into->unknown += from->unknown;
+    if (from->firstTimestamp < into->firstTimestamp) into->firstTimestamp = from->firstTimestamp;
+    if (from->lastTimestamp > into->lastTimestamp) into->lastTimestamp = from->lastTimestamp;
+}
+
+static void tallyRecords(const Analysis* analysis, Tally* tally, const uint8_t* records, size_t count) {
+    uint32_t nodeCount = analysis->nodeCount;
+
+    for (size_t i = 0; i < count; i++) {
+        ChoiceEvent event;
+        uint64_t session = decodeChoiceEvent(records + i * TELEMETRY_RECORD_SIZE, &event);
+        tally->events++;
+        if (event.timestamp < tally->firstTimestamp) tally->firstTimestamp = event.timestamp;
+        if (event.timestamp > tally->lastTimestamp) tally->lastTimestamp = event.timestamp;
+
+        int node = findNode(&analysis->table, event.node);
+        int next = event.next == -1 ? STORY_END : findNode(&analysis->table, event.next);
+        if (node == STORY_END || (next == STORY_END && event.next != -1) ||
+            event.choice >= MAX_CHOICES || event.characterClass >= NUM_CLASSES) {
+            tally->unknown++;
+            continue;
+        }
+
+        tally->departures[node]++;
+        tally->choices[(size_t)node * MAX_CHOICES + event.choice]++;
+        if (next != STORY_END) tally->arrivals[next]++;
+        if (event.flags & TELEMETRY_FLAG_ENDING) {
+            size_t ending = next == STORY_END ? nodeCount : (uint32_t)next;
+            tally->endings[ending * NUM_CLASSES + event.characterClass]++;
+        }
+        addToSketch(tally->sessions[event.characterClass], session);
+    }
+}
+
+static void* workerMain(void* argument) {
+    Worker* worker = (Worker*)argument;
+    Analysis* analysis = worker->analysis;
+    long pageSize = sysconf(_SC_PAGESIZE);
+
+    for (;;) {
+        size_t index = atomic_fetch_add(&analysis->nextChunk, 1);
+        if (index >= analysis->chunkCount) break;
+
+        const Chunk* chunk = &analysis->chunks[index];
+        const LogFile* file = &analysis->files[chunk->file];
+        const uint8_t* start = file->records + chunk->first * TELEMETRY_RECORD_SIZE;
+        tallyRecords(analysis, worker->tally, start, chunk->count);
+
+        // Tallied pages are dropped so resident memory stays bounded by the chunk size
+        uintptr_t from = (uintptr_t)start & ~(uintptr_t)(pageSize - 1);
+        uintptr_t to = (uintptr_t)(start + chunk->count * TELEMETRY_RECORD_SIZE);
+        madvise((void*)from, to - from, MADV_DONTNEED);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Maps a telemetry log
+ * @return 0 on success, -1 if the file cannot be read or is not a telemetry log
+ */
+static int mapLog(LogFile* file, const char* path) {
+    file->path = path;
+    file->map = NULL;
+    file->mapSize = 0;
+    file->records = NULL;
+    file->count = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat info;
+    if (fstat(fd, &info) < 0 || info.st_size < TELEMETRY_HEADER_SIZE) {
+        close(fd);
+        return -1;
+    }
+
+    void* map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+    if (checkTelemetryHeader((const uint8_t*)map, (size_t)info.st_size) < 0) {
+        munmap(map, (size_t)info.st_size);
+        return -1;
+    }
+    madvise(map, (size_t)info.st_size, MADV_SEQUENTIAL);
+
+    // A record torn by a crash at the end of the file is ignored
+    file->map = map;
+    file->mapSize = (size_t)info.st_size;
+    file->records = (const uint8_t*)map + TELEMETRY_HEADER_SIZE;
+    file->count = (file->mapSize - TELEMETRY_HEADER_SIZE) / TELEMETRY_RECORD_SIZE;
+    return 0;
+}
+
+/**
+ * @brief Moves the nodes with the largest values to the front of a list
+ * @return Number of nodes moved to the front, at most top unless top is 0
+ */
+static int selectTop(int* order, int listed, const uint64_t* values, int top) {
+    int shown = top > 0 && top < listed ? top : listed;
+    for (int i = 0; i < shown; i++) {
+        int best = i;
+        for (int j = i + 1; j < listed; j++) {
+            if (values[order[j]] > values[order[best]]) best = j;
+        }
+        int swap = order[i];
+        order[i] = order[best];
+        order[best] = swap;
+    }
+    return shown;
+}
+
+static void printNodeTable(const Analysis* analysis, const Tally* tally, int top) {
+    uint32_t nodeCount = analysis->nodeCount;
+    int* order = (int*)malloc(sizeof(int) * nodeCount);
+    uint64_t* visits = (uint64_t*)malloc(sizeof(uint64_t) * nodeCount);
+    if (!order || !visits) {
+        free(order);
+        free(visits);
+        return;
+    }
+
+    // A node is visited by arriving at it or, at the start, by leaving it
+    int listed = 0;
+    for (uint32_t n = 0; n < nodeCount; n++) {
+        visits[n] = tally->arrivals[n] > tally->departures[n] ? tally->arrivals[n] : tally->departures[n];
+        if (visits[n]) order[listed++] = (int)n;
+    }
+    int shown = selectTop(order, listed, visits, top);
+
+    printf("\nMost visited nodes (share of each choice taken):\n");
+    for (int i = 0; i < shown; i++) {
+        int n = order[i];
+        const StoryRecord* node = analysis->nodes[n];
+        printf("  node %6d %10llu visits", node->id, (unsigned long long)visits[n]);
+        for (uint32_t c = 0; c < node->numChoices; c++) {
+            uint64_t taken = tally->choices[(size_t)n * MAX_CHOICES + c];
+            printf("  %u: %5.1f%%", c + 1,
+                   tally->departures[n] ? 100.0 * (double)taken / (double)tally->departures[n] : 0.0);
+        }
+        printf("%s\n", node->numChoices ? "" : "  (ending)");
+    }
+    if (!shown) printf("  (none)\n");
+
+    // Players who arrived at a node with choices and made none stopped there
+    listed = 0;
+    for (uint32_t n = 0; n < nodeCount; n++) {
+        uint64_t arrivals = tally->arrivals[n];
+        uint64_t departures = tally->departures[n];
+        visits[n] = analysis->nodes[n]->numChoices && arrivals > departures ? arrivals - departures : 0;
+        if (visits[n]) order[listed++] = (int)n;
+    }
+    shown = selectTop(order, listed, visits, top);
+
+    printf("\nDrop-off points (players who reached the node and chose nothing):\n");
+    for (int i = 0; i < shown; i++) {
+        int n = order[i];
+        printf("  node %6d %10llu of %10llu arrivals (%5.1f%%)\n", analysis->nodes[n]->id,
+               (unsigned long long)visits[n], (unsigned long long)tally->arrivals[n],
+               100.0 * (double)visits[n] / (double)tally->arrivals[n]);
+    }
+    if (!shown) printf("  (none)\n");
+
+    free(order);
+    free(visits);
+}
+
+static void printEndingRates(const Analysis* analysis, const Tally* tally) {
+    uint32_t nodeCount = analysis->nodeCount;
+
+    printf("\nEnding rates by class (sessions estimated):\n");
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        double sessions = estimateSketch(tally->sessions[c]);
+        uint64_t endings = 0;
+        uint64_t bestCount = 0;
+        size_t best = 0;
+        for (size_t e = 0; e <= nodeCount; e++) {
+            uint64_t count = tally->endings[e * NUM_CLASSES + (size_t)c];
+            endings += count;
+            if (count > bestCount) {
+                bestCount = count;
+                best = e;
+            }
+        }
+        printf("  %-8s ~%9.0f sessions %10llu endings (%5.1f%%)", classNames[c], sessions,
+               (unsigned long long)endings, sessions >= 1.0 ? 100.0 * (double)endings / sessions : 0.0);
+        if (bestCount) {
+            if (best == nodeCount) {
+                printf(", most often the story's end (%llu)", (unsigned long long)bestCount);
+            } else {
+                printf(", most often node %d (%llu)", analysis->nodes[best]->id, (unsigned long long)bestCount);
+            }
+        }
+        printf("\n");
+    }
+}
+
+static void formatTime(uint64_t nanoseconds, char* text, size_t size) {
+    time_t seconds = (time_t)(nanoseconds / 1000000000u);
+    struct tm utc;
+    gmtime_r(&seconds, &utc);
+    strftime(text, size, "%Y-%m-%d %H:%M:%S UTC", &utc);
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-t threads] [-n rows] [-f compiled-story]... telemetry-log...\n", program);
+}
+
+int main(int argc, char** argv) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threadCount = cpus > 0 ? (int)cpus : 1;
+    int top = DEFAULT_TOP;
+    Story* stories[MAX_STORIES];
+    int storyCount = 0;
+    int firstLog = argc;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threadCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            top = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc && storyCount < MAX_STORIES) {
+            stories[storyCount] = openStoryFile(argv[++i]);
+            if (!stories[storyCount++]) {
+                fprintf(stderr, "Failed to load %s.\n", argv[i]);
+                return 1;
+            }
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            firstLog = i;
+            break;
+        }
+    }
+    int fileCount = argc - firstLog;
+    if (fileCount < 1 || threadCount < 1 || threadCount > MAX_THREADS || top < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (!storyCount) {
+        for (int chapter = 1; chapter <= STORY_CHAPTERS; chapter++) {
+            stories[storyCount] = compileBuiltinChapter(chapter);
+            if (!stories[storyCount++]) {
+                fprintf(stderr, "Failed to load the story.\n");
+                return 1;
+            }
+        }
+    }
+
+    Analysis analysis;
+    memset(&analysis, 0, sizeof(analysis));
+    uint32_t storyNodes = 0;
+    for (int s = 0; s < storyCount; s++) {
+        storyNodes += stories[s]->header->nodeCount;
+    }
+    analysis.nodes = (const StoryRecord**)malloc(sizeof(StoryRecord*) * storyNodes);
+    for (int s = 0; analysis.nodes && s < storyCount; s++) {
+        for (uint32_t n = 0; n < stories[s]->header->nodeCount; n++) {
+            if (!stories[s]->nodes[n].nextChapter) analysis.nodes[analysis.nodeCount++] = &stories[s]->nodes[n];
+        }
+    }
+    analysis.files = (LogFile*)calloc((size_t)fileCount, sizeof(LogFile));
+    if (!analysis.nodes || !analysis.files || buildNodeTable(&analysis.table, analysis.nodes, analysis.nodeCount) < 0) {
+        fprintf(stderr, "Out of memory.\n");
+        return 1;
+    }
+
+    size_t totalRecords = 0;
+    for (int f = 0; f < fileCount; f++) {
+        if (mapLog(&analysis.files[f], argv[firstLog + f]) < 0) {
+            fprintf(stderr, "%s is not a readable telemetry log.\n", argv[firstLog + f]);
+            return 1;
+        }
+        totalRecords += analysis.files[f].count;
+        analysis.chunkCount += (analysis.files[f].count + CHUNK_RECORDS - 1) / CHUNK_RECORDS;
+    }
+
+    analysis.chunks = (Chunk*)malloc(sizeof(Chunk) * (analysis.chunkCount ? analysis.chunkCount : 1));
+    if (!analysis.chunks) {
+        fprintf(stderr, "Out of memory.\n");
+        return 1;
+    }
+    size_t chunk = 0;
+    for (int f = 0; f < fileCount; f++) {
+        for (size_t first = 0; first < analysis.files[f].count; first += CHUNK_RECORDS) {
+            size_t left = analysis.files[f].count - first;
+            analysis.chunks[chunk].file = f;
+            analysis.chunks[chunk].first = first;
+            analysis.chunks[chunk].count = left < CHUNK_RECORDS ? left : CHUNK_RECORDS;
+            chunk++;
+        }
+    }
+    atomic_init(&analysis.nextChunk, 0);
+
+    uint32_t nodeCount = analysis.nodeCount;
+    Worker workers[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    for (int t = 0; t < threadCount; t++) {
+        workers[t].analysis = &analysis;
+        workers[t].tally = createTally(nodeCount);
+        if (!workers[t].tally) {
+            fprintf(stderr, "Out of memory.\n");
+            return 1;
+        }
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int t = 0; t < threadCount; t++) {
+        pthread_create(&threads[t], NULL, workerMain, &workers[t]);
+    }
+    for (int t = 0; t < threadCount; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    Tally* total = workers[0].tally;
+    for (int t = 1; t < threadCount; t++) {
+        mergeTally(total, workers[t].tally, nodeCount);
+        freeTally(workers[t].tally);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+
+    double megabytes = (double)totalRecords * TELEMETRY_RECORD_SIZE / 1048576.0;
+    printf("Logs: %d files, %zu events (%.1f MB) in %.3f s (%.0f MB/s, %d threads)\n", fileCount,
+           totalRecords, megabytes, seconds, seconds > 0 ? megabytes / seconds : 0.0, threadCount);
+    if (total->events) {
+        char first[32], last[32];
+        formatTime(total->firstTimestamp, first, sizeof(first));
+        formatTime(total->lastTimestamp, last, sizeof(last));
+        printf("Span: %s to %s\n", first, last);
+    }
+    if (total->unknown) {
+        printf("%llu events name nodes or classes this story does not have; rerun with the story "
+               "they were recorded with (-f)\n", (unsigned long long)total->unknown);
+    }
+
+    printNodeTable(&analysis, total, top);
+    printEndingRates(&analysis, total);
+
+    freeTally(total);
+    for (int f = 0; f < fileCount; f++) {
+        munmap(analysis.files[f].map, analysis.files[f].mapSize);
+    }
+    free(analysis.files);
+    free(analysis.chunks);
+    free(analysis.table.ids);
+    free(analysis.table.indices);
+    free(analysis.nodes);
+    for (int s = 0; s < storyCount; s++) {
+        closeStory(stories[s]);
+    }
+    return 0;
+}
@@ -0,0 +1,576 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include "../include/engine.h"
+
+/**
+ * @file explore.c
+ * @brief Parallel state-space explorer for the story graph
+ * @details Enumerates every reachable (node, class, stats, inventory, traits,
+ *          flags) state from initializeStory() for each CharacterClass. Workers own
+ *          Chase-Lev work-stealing deques and share a lock-free set of state
+ *          fingerprints, so shared targets and back-edges are expanded once.
+ *          Reports reachable endings, dead ends, choices whose requirements are
+ *          never met, and nodes no class can reach.
+ */
+
+#define NUM_CLASSES 4
+#define DEFAULT_VISITED_BITS 22
+#define INITIAL_DEQUE_CAPACITY 256
+#define MAX_THREADS 256
+
+/**
+ * @struct ExploreState
+ * @brief One state of the search, self-contained so it can move between threads
+ */
+typedef struct {
+    GameState game;       /**< Game state; game.player points at player below */
+    Character player;     /**< Copy of the character for this state */
+} ExploreState;
+
+/**
+ * @struct DequeBuffer
+ * @brief Circular storage of a work deque; retired buffers stay chained until exit
+ */
+typedef struct DequeBuffer {
+    long capacity;                        /**< Number of slots, a power of two */
+    struct DequeBuffer* retired;          /**< Previous, smaller buffer */
+    _Atomic(ExploreState*) slots[];       /**< Work items */
+} DequeBuffer;
+
+/**
+ * @struct WorkDeque
+ * @brief Chase-Lev deque: the owner pushes and takes at the bottom, thieves steal at the top
+ */
+typedef struct {
+    atomic_long top;                      /**< Index thieves steal from */
+    atomic_long bottom;                   /**< Index the owner pushes to */
+    _Atomic(DequeBuffer*) buffer;         /**< Current storage */
+    char padding[64];                     /**< Keeps neighbouring deques off this cache line */
+} WorkDeque;
+
+/**
+ * @struct VisitedSet
+ * @brief Lock-free open-addressing set of non-zero 64-bit state fingerprints
+ */
+typedef struct {
+    _Atomic uint64_t* slots;              /**< Fingerprints, 0 marks an empty slot */
+    uint64_t mask;                        /**< Capacity minus one */
+    atomic_ulong count;                   /**< Number of stored fingerprints */
+} VisitedSet;
+
+/**
+ * @struct Explorer
+ * @brief Shared search context
+ */
+typedef struct {
+    const Story* story;                   /**< Compiled story being explored */
+    VisitedSet visited;                   /**< Fingerprints of discovered states */
+    WorkDeque* deques;                    /**< One deque per worker */
+    int threadCount;                      /**< Number of workers */
+    atomic_long pending;                  /**< States pushed but not yet expanded */
+    atomic_int overflow;                  /**< Set when the visited set fills up */
+    atomic_uint* reached;                 /**< Per node: bit c when class c reaches it */
+    atomic_uint* deadEnds;                /**< Per node: bit c when class c gets stuck there */
+    atomic_uint* satisfied;               /**< Per node: bit (choice * 4 + c) when class c can take the choice */
+    atomic_uint* endings;                 /**< Per node: bit (choice * 4 + c) when the choice ends the story for class c */
+} Explorer;
+
+/**
+ * @struct Worker
+ * @brief Per-thread state
+ */
+typedef struct {
+    Explorer* explorer;                   /**< Shared context */
+    int id;                               /**< Index of the worker's own deque */
+    unsigned long long rng;               /**< Victim selection generator */
+    unsigned long expanded;               /**< States expanded by this worker */
+    unsigned long stolen;                 /**< Successful steals by this worker */
+} Worker;
+
+static uint64_t mixBits(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t length) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+/* ---- Visited set ---- */
+
+static int initVisitedSet(VisitedSet* set, int bits) {
+    size_t capacity = (size_t)1 << bits;
+    set->slots = (_Atomic uint64_t*)calloc(capacity, sizeof(uint64_t));
+    set->mask = capacity - 1;
+    atomic_init(&set->count, 0);
+    return set->slots ? 0 : -1;
+}
+
+/**
+ * @brief Inserts a fingerprint
+ * @return 1 if newly inserted, 0 if already present, -1 if the set is full
+ */
+static int visitedInsert(VisitedSet* set, uint64_t fingerprint) {
+    uint64_t slot = fingerprint & set->mask;
+    for (uint64_t probe = 0; probe <= set->mask; probe++) {
+        uint64_t current = atomic_load_explicit(&set->slots[slot], memory_order_relaxed);
+        if (current == fingerprint) return 0;
+        if (current == 0) {
+            uint64_t expected = 0;
+            if (atomic_compare_exchange_strong_explicit(&set->slots[slot], &expected, fingerprint,
+                                                        memory_order_relaxed, memory_order_relaxed)) {
+                atomic_fetch_add_explicit(&set->count, 1, memory_order_relaxed);
+                return 1;
+            }
+            if (expected == fingerprint) return 0;
+        }
+        slot = (slot + 1) & set->mask;
+    }
+    return -1;
+}
+
+/* ---- Work-stealing deque ---- */
+
+static DequeBuffer* allocDequeBuffer(long capacity) {
+    DequeBuffer* buffer = (DequeBuffer*)malloc(sizeof(DequeBuffer) + sizeof(ExploreState*) * capacity);
+    if (!buffer) return NULL;
+    buffer->capacity = capacity;
+    buffer->retired = NULL;
+    return buffer;
+}
+
+static int initDeque(WorkDeque* deque) {
+    DequeBuffer* buffer = allocDequeBuffer(INITIAL_DEQUE_CAPACITY);
+    if (!buffer) return -1;
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->buffer, buffer);
+    return 0;
+}
+
+static void freeDeque(WorkDeque* deque) {
+    DequeBuffer* buffer = atomic_load(&deque->buffer);
+    while (buffer) {
+        DequeBuffer* retired = buffer->retired;
+        free(buffer);
+        buffer = retired;
+    }
+}
+
+static int dequePush(WorkDeque* deque, ExploreState* state) {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    DequeBuffer* buffer = atomic_load_explicit(&deque->buffer, memory_order_relaxed);
+
+    if (bottom - top > buffer->capacity - 1) {
+        // Thieves may still read the old buffer, so it is retired rather than freed
+        DequeBuffer* grown = allocDequeBuffer(buffer->capacity * 2);
+        if (!grown) return -1;
+        for (long i = top; i < bottom; i++) {
+            ExploreState* item = atomic_load_explicit(&buffer->slots[i & (buffer->capacity - 1)], memory_order_relaxed);
+            atomic_store_explicit(&grown->slots[i & (grown->capacity - 1)], item, memory_order_relaxed);
+        }
+        grown->retired = buffer;
+        atomic_store_explicit(&deque->buffer, grown, memory_order_release);
+        buffer = grown;
+    }
+
+    atomic_store_explicit(&buffer->slots[bottom & (buffer->capacity - 1)], state, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return 0;
+}
+
+static ExploreState* dequeTake(WorkDeque* deque) {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    DequeBuffer* buffer = atomic_load_explicit(&deque->buffer, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    ExploreState* state = NULL;
+    if (top <= bottom) {
+        state = atomic_load_explicit(&buffer->slots[bottom & (buffer->capacity - 1)], memory_order_relaxed);
+        if (top == bottom) {
+            // Last item: race any thief for it
+            if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                         memory_order_seq_cst, memory_order_relaxed)) {
+                state = NULL;
+            }
+            atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        }
+    } else {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return state;
+}
+
+static ExploreState* dequeSteal(WorkDeque* deque) {
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+    if (top >= bottom) return NULL;
+
+    DequeBuffer* buffer = atomic_load_explicit(&deque->buffer, memory_order_acquire);
+    ExploreState* state = atomic_load_explicit(&buffer->slots[top & (buffer->capacity - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed)) {
+        return NULL;
+    }
+    return state;
+}
+
+/* ---- Search ---- */
+
+static uint64_t fingerprintState(const ExploreState* state) {
+    const Character* player = &state->player;
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    // Everything a choice condition can read tells states apart
+    int stats[7] = {state->game.currentScene, (int)player->class, player->strength, player->intelligence,
+                    player->charisma, player->health, state->game.reputation};
+    uint64_t masks[2] = {player->traitMask, state->game.flags};
+
+    hash = hashBytes(hash, stats, sizeof(stats));
+    hash = hashBytes(hash, state->game.inventory, sizeof(state->game.inventory));
+    hash = hashBytes(hash, masks, sizeof(masks));
+
+    hash = mixBits(hash);
+    return hash ? hash : 1;
+}
+
+static int schedule(Worker* worker, const ExploreState* source) {
+    Explorer* explorer = worker->explorer;
+    int inserted = visitedInsert(&explorer->visited, fingerprintState(source));
+    if (inserted <= 0) {
+        if (inserted < 0) atomic_store(&explorer->overflow, 1);
+        return inserted;
+    }
+
+    ExploreState* state = (ExploreState*)malloc(sizeof(ExploreState));
+    if (!state) {
+        atomic_store(&explorer->overflow, 1);
+        return -1;
+    }
+    memcpy(state, source, sizeof(ExploreState));
+    state->game.player = &state->player;
+
+    atomic_fetch_add_explicit(&explorer->pending, 1, memory_order_relaxed);
+    if (dequePush(&explorer->deques[worker->id], state) < 0) {
+        atomic_fetch_sub_explicit(&explorer->pending, 1, memory_order_relaxed);
+        atomic_store(&explorer->overflow, 1);
+        free(state);
+        return -1;
+    }
+    return 1;
+}
+
+static void expandState(Worker* worker, ExploreState* state) {
+    Explorer* explorer = worker->explorer;
+    int nodeIndex = state->game.currentScene;
+    const StoryRecord* node = &explorer->story->nodes[nodeIndex];
+    unsigned int classBit = 1u << state->player.class;
+
+    atomic_fetch_or_explicit(&explorer->reached[nodeIndex], classBit, memory_order_relaxed);
+
+    unsigned int available = getAvailableChoices(&state->game);
+    if (node->numChoices > 0 && !available) {
+        atomic_fetch_or_explicit(&explorer->deadEnds[nodeIndex], classBit, memory_order_relaxed);
+        return;
+    }
+
+    ExploreState next;
+    int history[1];
+    for (int i = 0; i < (int)node->numChoices; i++) {
+        if (!(available & (1u << i))) continue;
+
+        unsigned int choiceBit = classBit << (i * NUM_CLASSES);
+        atomic_fetch_or_explicit(&explorer->satisfied[nodeIndex], choiceBit, memory_order_relaxed);
+
+        memcpy(&next, state, sizeof(ExploreState));
+        next.game.player = &next.player;
+        // History is not part of the state; a one-entry scratch keeps applyChoice() from allocating
+        next.game.choiceHistory = history;
+        next.game.choiceHistoryCount = 0;
+        next.game.choiceHistoryCapacity = 1;
+        applyChoice(&next.game, i);
+        next.game.choiceHistory = NULL;
+        next.game.choiceHistoryCount = 0;
+        next.game.choiceHistoryCapacity = 0;
+
+        if (isGameOver(&next.game)) {
+            atomic_fetch_or_explicit(&explorer->endings[nodeIndex], choiceBit, memory_order_relaxed);
+        } else {
+            schedule(worker, &next);
+        }
+    }
+}
+
+static void* workerMain(void* arg) {
+    Worker* worker = (Worker*)arg;
+    Explorer* explorer = worker->explorer;
+    WorkDeque* own = &explorer->deques[worker->id];
+
+    for (;;) {
+        ExploreState* state = dequeTake(own);
+
+        if (!state && explorer->threadCount > 1) {
+            int start = (int)(worker->rng % (unsigned long long)explorer->threadCount);
+            worker->rng = worker->rng * 6364136223846793005ULL + 1442695040888963407ULL;
+            for (int k = 0; k < explorer->threadCount && !state; k++) {
+                int victim = (start + k) % explorer->threadCount;
+                if (victim != worker->id) {
+                    state = dequeSteal(&explorer->deques[victim]);
+                }
+            }
+            if (state) worker->stolen++;
+        }
+
+        if (!state) {
+            if (atomic_load_explicit(&explorer->pending, memory_order_acquire) == 0) break;
+            sched_yield();
+            continue;
+        }
+
+        expandState(worker, state);
+        free(state);
+        worker->expanded++;
+        atomic_fetch_sub_explicit(&explorer->pending, 1, memory_order_acq_rel);
+    }
+    return NULL;
+}
+
+/* ---- Reporting ---- */
+
+static const char* classNames[NUM_CLASSES] = {"Warrior", "Scholar", "Diplomat", "Rogue"};
+
+static void printClassList(unsigned int classes) {
+    int first = 1;
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        if (classes & (1u << c)) {
+            printf("%s%s", first ? "" : ", ", classNames[c]);
+            first = 0;
+        }
+    }
+}
+
+static void printRequirements(const uint8_t* req) {
+    printf("(");
+    if (req[0] > 0) printf(" STR %d", req[0]);
+    if (req[1] > 0) printf(" INT %d", req[1]);
+    if (req[2] > 0) printf(" CHA %d", req[2]);
+    printf(" )");
+}
+
+static unsigned int classesForChoice(unsigned int bits, int choice) {
+    return (bits >> (choice * NUM_CLASSES)) & ((1u << NUM_CLASSES) - 1);
+}
+
+static void printReport(const Explorer* explorer) {
+    const Story* story = explorer->story;
+    int nodeCount = (int)story->header->nodeCount;
+    int count;
+
+    printf("\nReachable endings:\n");
+    count = 0;
+    for (int n = 0; n < nodeCount; n++) {
+        const StoryRecord* node = &story->nodes[n];
+        unsigned int reached = atomic_load(&explorer->reached[n]);
+        if (node->numChoices == 0 && reached) {
+            printf("  node %d: ", node->id);
+            printClassList(reached);
+            printf("\n");
+            count++;
+        }
+        unsigned int endings = atomic_load(&explorer->endings[n]);
+        for (int i = 0; i < (int)node->numChoices; i++) {
+            unsigned int classes = classesForChoice(endings, i);
+            if (classes) {
+                printf("  node %d choice %d \"%s\": ", node->id, i + 1, getChoiceText(story, n, i));
+                printClassList(classes);
+                printf("\n");
+                count++;
+            }
+        }
+    }
+    if (!count) printf("  (none)\n");
+
+    printf("\nDead ends (no available choice):\n");
+    count = 0;
+    for (int n = 0; n < nodeCount; n++) {
+        unsigned int stuck = atomic_load(&explorer->deadEnds[n]);
+        if (stuck) {
+            printf("  node %d: ", story->nodes[n].id);
+            printClassList(stuck);
+            printf("\n");
+            count++;
+        }
+    }
+    if (!count) printf("  (none)\n");
+
+    printf("\nChoices whose requirements are never met:\n");
+    count = 0;
+    for (int n = 0; n < nodeCount; n++) {
+        const StoryRecord* node = &story->nodes[n];
+        unsigned int reached = atomic_load(&explorer->reached[n]);
+        unsigned int satisfied = atomic_load(&explorer->satisfied[n]);
+        if (!reached) continue;
+        for (int i = 0; i < (int)node->numChoices; i++) {
+            if (!classesForChoice(satisfied, i)) {
+                printf("  node %d choice %d \"%s\" ", node->id, i + 1, getChoiceText(story, n, i));
+                printRequirements(node->requirements[i]);
+                printf("\n");
+                count++;
+            }
+        }
+    }
+    if (!count) printf("  (none)\n");
+
+    printf("\nNodes no class can reach:\n");
+    count = 0;
+    for (int n = 0; n < nodeCount; n++) {
+        if (!atomic_load(&explorer->reached[n])) {
+            printf("  node %d\n", story->nodes[n].id);
+            count++;
+        }
+    }
+    if (!count) printf("  (none)\n");
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-t threads] [-m log2 visited capacity] [-f compiled-story]\n", program);
+}
+
+int main(int argc, char** argv) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threadCount = cpus > 0 ? (int)cpus : 1;
+    int visitedBits = DEFAULT_VISITED_BITS;
+    const char* storyPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threadCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            visitedBits = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            storyPath = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (threadCount < 1 || threadCount > MAX_THREADS || visitedBits < 8 || visitedBits > 40) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Story* story = storyPath ? openStoryFile(storyPath) : compileBuiltinStory();
+    if (!story) {
+        fprintf(stderr, "Failed to load the story.\n");
+        return 1;
+    }
+
+    Explorer explorer;
+    memset(&explorer, 0, sizeof(explorer));
+    explorer.story = story;
+    explorer.threadCount = threadCount;
+    atomic_init(&explorer.pending, 0);
+    atomic_init(&explorer.overflow, 0);
+
+    if (initVisitedSet(&explorer.visited, visitedBits) < 0) {
+        fprintf(stderr, "Out of memory.\n");
+        return 1;
+    }
+
+    int nodeCount = (int)story->header->nodeCount;
+    explorer.reached = (atomic_uint*)calloc(nodeCount, sizeof(atomic_uint));
+    explorer.deadEnds = (atomic_uint*)calloc(nodeCount, sizeof(atomic_uint));
+    explorer.satisfied = (atomic_uint*)calloc(nodeCount, sizeof(atomic_uint));
+    explorer.endings = (atomic_uint*)calloc(nodeCount, sizeof(atomic_uint));
+    explorer.deques = (WorkDeque*)calloc(threadCount, sizeof(WorkDeque));
+    Worker* workers = (Worker*)calloc(threadCount, sizeof(Worker));
+    pthread_t* threads = (pthread_t*)calloc(threadCount, sizeof(pthread_t));
+    if (!explorer.reached || !explorer.deadEnds || !explorer.satisfied || !explorer.endings ||
+        !explorer.deques || !workers || !threads) {
+        fprintf(stderr, "Out of memory.\n");
+        return 1;
+    }
+
+    for (int t = 0; t < threadCount; t++) {
+        if (initDeque(&explorer.deques[t]) < 0) {
+            fprintf(stderr, "Out of memory.\n");
+            return 1;
+        }
+        workers[t].explorer = &explorer;
+        workers[t].id = t;
+        workers[t].rng = mixBits((uint64_t)t + 1);
+    }
+
+    // Seed one start state per class, spread across the workers
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        ExploreState start;
+        initializeCharacter(&start.player, classNames[c], (CharacterClass)c);
+        initializeGameState(&start.game, &start.player, story);
+        schedule(&workers[c % threadCount], &start);
+    }
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (int t = 0; t < threadCount; t++) {
+        pthread_create(&threads[t], NULL, workerMain, &workers[t]);
+    }
+    for (int t = 0; t < threadCount; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (double)(end.tv_sec - begin.tv_sec) + (double)(end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    unsigned long expanded = 0, stolen = 0;
+    for (int t = 0; t < threadCount; t++) {
+        expanded += workers[t].expanded;
+        stolen += workers[t].stolen;
+    }
+
+    printf("Story: %d nodes, %d classes, %d threads\n",
+           nodeCount, NUM_CLASSES, threadCount);
+    printf("States: %lu expanded, %lu stolen, %.3f ms\n", expanded, stolen, seconds * 1e3);
+
+    if (atomic_load(&explorer.overflow)) {
+        fprintf(stderr, "Visited set is full; rerun with a larger -m. Results are incomplete.\n");
+    }
+
+    printReport(&explorer);
+
+    for (int t = 0; t < threadCount; t++) {
+        freeDeque(&explorer.deques[t]);
+    }
+    free(explorer.visited.slots);
+    free(explorer.reached);
+    free(explorer.deadEnds);
+    free(explorer.satisfied);
+    free(explorer.endings);
+    free(explorer.deques);
+    free(workers);
+    free(threads);
+    closeStory(story);
+
+    return atomic_load(&explorer.overflow) ? 2 : 0;
+}
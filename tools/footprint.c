@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <time.h>
+#include "../include/engine.h"
+#include "../include/compact.h"
+
+/**
+ * @file footprint.c
+ * @brief Memory footprint of idle sessions
+ * @details Plays a population of games to random points, then keeps every
+ *          one of them both as a GameState with its own Character and choice
+ *          history, as the game front end allocates them, and as a CompactGame, measuring
+ *          the heap each layout takes from malloc's own accounting, so
+ *          allocator overhead is included. Every compact game is unpacked
+ *          and compared with the original, and packing and unpacking are
+ *          timed, since a server pays for both on every turn.
+ */
+
+#define DEFAULT_SESSIONS 100000
+
+/**
+ * @brief Advances a xorshift64 generator
+ * @param state Pointer to the generator state (must be non-zero)
+ * @return Next pseudo-random value
+ */
+static unsigned long long nextRandom(unsigned long long* state) {
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+/**
+ * @brief Picks one set bit of a mask uniformly at random
+ * @param mask Non-zero bitmask of available choices
+ * @param rng Pointer to the generator state
+ * @return Index of the picked bit
+ */
+static int pickChoice(unsigned int mask, unsigned long long* rng) {
+    int count = __builtin_popcount(mask);
+    int pick = (int)(nextRandom(rng) % (unsigned long long)count);
+    while (pick-- > 0) {
+        mask &= mask - 1;
+    }
+    return __builtin_ctz(mask);
+}
+
+/**
+ * @brief Plays a random number of random turns, stopping at a chapter exit
+ */
+static void playSomeTurns(GameState* game, unsigned long long* rng) {
+    int turns = (int)(nextRandom(rng) % PLAYTHROUGH_TURN_LIMIT);
+    for (int turn = 0; turn < turns && !isGameOver(game); turn++) {
+        unsigned int available = getAvailableChoices(game);
+        if (!available || game->story != game->startStory) break;
+        applyChoice(game, pickChoice(available, rng));
+    }
+}
+
+static int sameCharacter(const Character* a, const Character* b) {
+    if (strcmp(a->name, b->name) != 0 || a->class != b->class || a->strength != b->strength ||
+        a->intelligence != b->intelligence || a->charisma != b->charisma || a->health != b->health ||
+        a->traitCount != b->traitCount || a->traitMask != b->traitMask) {
+        return 0;
+    }
+    for (int i = 0; i < a->traitCount; i++) {
+        if (strcmp(a->traits[i], b->traits[i]) != 0) return 0;
+    }
+    return 1;
+}
+
+static int sameGame(const GameState* a, const GameState* b) {
+    if (a->story != b->story || a->startStory != b->startStory || a->currentScene != b->currentScene ||
+        a->currentChapter != b->currentChapter || a->reputation != b->reputation ||
+        a->isGameOver != b->isGameOver || a->inventoryCount != b->inventoryCount || a->flags != b->flags ||
+        a->choiceHistoryCount != b->choiceHistoryCount || a->saveLog != b->saveLog ||
+        memcmp(a->inventory, b->inventory, sizeof(a->inventory)) != 0) {
+        return 0;
+    }
+    for (int i = 0; i < a->choiceHistoryCount; i++) {
+        if (a->choiceHistory[i] != b->choiceHistory[i]) return 0;
+    }
+    return sameCharacter(a->player, b->player);
+}
+
+static size_t heapInUse(void) {
+    return mallinfo2().uordblks;
+}
+
+static double elapsedSince(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void printLayout(const char* name, size_t bytes, long sessions, int allocations) {
+    if (!bytes) {
+        // Allocators that replace malloc do not report to mallinfo2()
+        printf("%-32s %14s %14s %12d\n", name, "-", "-", allocations);
+        return;
+    }
+    double perSession = (double)bytes / (double)sessions;
+    printf("%-32s %14.1f %14.0f %12d\n", name, perSession, 1073741824.0 / perSession, allocations);
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-n sessions] [-s seed] [-f compiled-story]\n", program);
+}
+
+int main(int argc, char** argv) {
+    long sessions = DEFAULT_SESSIONS;
+    unsigned long long rng = 0x9E3779B97F4A7C15ULL;
+    const char* storyPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            sessions = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            rng = strtoull(argv[++i], NULL, 10) | 1;
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            storyPath = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (sessions <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Story* story = storyPath ? openStoryFile(storyPath) : compileBuiltinStory();
+    if (!story) {
+        fprintf(stderr, "Failed to load the story.\n");
+        return 1;
+    }
+
+    GameState** games = (GameState**)malloc(sizeof(GameState*) * (size_t)sessions);
+    CompactGame** packed = (CompactGame**)malloc(sizeof(CompactGame*) * (size_t)sessions);
+    if (!games || !packed) {
+        fprintf(stderr, "Out of memory.\n");
+        return 1;
+    }
+
+    // Each layout is allocated in one pass so its heap use can be read off
+    long long turns = 0;
+    size_t before = heapInUse();
+    for (long i = 0; i < sessions; i++) {
+        GameState* game = (GameState*)malloc(sizeof(GameState));
+        Character* player = (Character*)malloc(sizeof(Character));
+        if (!game || !player) {
+            fprintf(stderr, "Out of memory.\n");
+            return 1;
+        }
+        char name[MAX_NAME_LENGTH];
+        snprintf(name, sizeof(name), "Player %ld", i + 1);
+        initializeCharacter(player, name, (CharacterClass)(i % 4));
+        initializeGameState(game, player, story);
+        playSomeTurns(game, &rng);
+        turns += game->choiceHistoryCount;
+        games[i] = game;
+    }
+    size_t fullBytes = heapInUse() - before;
+
+    size_t compactRequested = 0;
+    before = heapInUse();
+    for (long i = 0; i < sessions; i++) {
+        packed[i] = packGame(games[i], NULL);
+        if (!packed[i]) {
+            fprintf(stderr, "Game %ld could not be packed.\n", i + 1);
+            return 1;
+        }
+        compactRequested += getCompactGameSize(packed[i]);
+    }
+    size_t compactBytes = heapInUse() - before;
+
+    long identical = 0;
+    GameState game = {0};
+    Character player;
+    for (long i = 0; i < sessions; i++) {
+        identical += unpackGame(packed[i], &game, &player) == 0 && sameGame(&game, games[i]);
+    }
+
+    // A server unpacks a session for each input and packs it again afterwards
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < sessions; i++) {
+        unpackGame(packed[i], &game, &player);
+        packed[i] = packGame(&game, packed[i]);
+    }
+    double seconds = elapsedSince(&start);
+
+    printf("Sessions: %ld, %.1f turns in on average\n\n", sessions, (double)turns / (double)sessions);
+    printf("%-32s %14s %14s %12s\n", "Layout", "Bytes/session", "Sessions/GB", "Allocations");
+    printLayout("GameState + Character + history", fullBytes, sessions, 3);
+    printLayout("CompactGame", compactBytes, sessions, 1);
+    printf("\nsizeof: GameState %zu, Character %zu, CompactGame %zu + name (%.1f bytes requested on average)\n",
+           sizeof(GameState), sizeof(Character), offsetof(CompactGame, name),
+           (double)compactRequested / (double)sessions);
+    printf("Round trip: %ld of %ld games unpacked identical; unpack and repack %.1f ns per session\n",
+           identical, sessions, seconds * 1e9 / (double)sessions);
+
+    for (long i = 0; i < sessions; i++) {
+        free(games[i]->player);
+        freeGameHistory(games[i]);
+        free(games[i]);
+        free(packed[i]);
+    }
+    free(games);
+    free(packed);
+    freeGameHistory(&game);
+    closeStory(story);
+    return identical == sessions ? 0 : 1;
+}
@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/**
+ * @file loadgen.c
+ * @brief Load generator for the game server
+ * @details Opens many client connections from one thread and drives them
+ *          through character creation and random choices as fast as the
+ *          server answers. Idle connections can be added on top to hold
+ *          sessions open without playing. Reports throughput and the
+ *          distribution of turn latency, measured from sending a line to
+ *          receiving the next prompt.
+ */
+
+#define DEFAULT_PORT 4000
+#define DEFAULT_CONNECTIONS 100
+#define DEFAULT_SECONDS 10
+#define MAX_TURNS_PER_SESSION 200
+#define RECEIVE_BUFFER 8192
+#define MAX_EVENTS 256
+
+/**
+ * @enum ClientPhase
+ * @brief What a client sends at the next prompt
+ */
+typedef enum {
+    CLIENT_NAME,        /**< Character name */
+    CLIENT_CLASS,       /**< Character class */
+    CLIENT_PLAYING,     /**< Choices */
+    CLIENT_IDLE         /**< Nothing; the connection only holds a session */
+} ClientPhase;
+
+/**
+ * @struct Client
+ * @brief One simulated player
+ */
+typedef struct {
+    int fd;                         /**< Socket, or -1 while disconnected */
+    int idle;                       /**< Holds a session without playing */
+    ClientPhase phase;              /**< Next thing to send */
+    int turns;                      /**< Turns played in this session */
+    int choices;                    /**< Choices offered at the last prompt */
+    struct timespec sentAt;         /**< When the last line was sent */
+    int waiting;                    /**< A line was sent and its prompt has not arrived */
+    char buffer[RECEIVE_BUFFER];    /**< Output since the last prompt */
+    size_t length;                  /**< Bytes in buffer */
+} Client;
+
+/**
+ * @struct Samples
+ * @brief Growable list of turn latencies
+ */
+typedef struct {
+    float* values;                  /**< Latencies in microseconds */
+    size_t count;                   /**< Number of samples */
+    size_t capacity;                /**< Size of values */
+} Samples;
+
+static const char* socketPath = NULL;
+static const char* host = "127.0.0.1";
+static int port = DEFAULT_PORT;
+static unsigned long long rng = 0x9E3779B97F4A7C15ULL;
+
+static unsigned long long nextRandom(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+static double elapsedMicros(const struct timespec* from, const struct timespec* to) {
+    return (double)(to->tv_sec - from->tv_sec) * 1e6 + (double)(to->tv_nsec - from->tv_nsec) / 1e3;
+}
+
+static void addSample(Samples* samples, double value) {
+    if (samples->count == samples->capacity) {
+        size_t capacity = samples->capacity ? samples->capacity * 2 : 65536;
+        float* values = (float*)realloc(samples->values, sizeof(float) * capacity);
+        if (!values) return;
+        samples->values = values;
+        samples->capacity = capacity;
+    }
+    samples->values[samples->count++] = (float)value;
+}
+
+static int compareFloats(const void* a, const void* b) {
+    float x = *(const float*)a;
+    float y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const Samples* samples, double fraction) {
+    if (!samples->count) return 0.0;
+    size_t index = (size_t)(fraction * (double)(samples->count - 1));
+    return samples->values[index];
+}
+
+static int connectClient(int epollFd, Client* client) {
+    int fd;
+    int result;
+
+    if (socketPath) {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        result = connect(fd, (struct sockaddr*)&address, sizeof(address));
+    } else {
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons((uint16_t)port);
+        inet_pton(AF_INET, host, &address.sin_addr);
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        result = connect(fd, (struct sockaddr*)&address, sizeof(address));
+    }
+
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = client};
+    if ((result < 0 && errno != EINPROGRESS) || epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    client->fd = fd;
+    client->phase = CLIENT_NAME;
+    client->turns = 0;
+    client->waiting = 0;
+    client->length = 0;
+    return 0;
+}
+
+static void disconnectClient(Client* client) {
+    close(client->fd);
+    client->fd = -1;
+}
+
+static int sendLine(Client* client, const char* line) {
+    size_t length = strlen(line);
+    // Lines are short, so a full socket buffer means the server has stopped reading
+    if (send(client->fd, line, length, MSG_NOSIGNAL) != (ssize_t)length) return -1;
+    clock_gettime(CLOCK_MONOTONIC, &client->sentAt);
+    client->waiting = 1;
+    return 0;
+}
+
+/**
+ * @brief Reacts to a complete prompt from the server
+ * @return 0 to keep the connection, -1 to close it
+ */
+static int answerPrompt(Client* client, int number) {
+    char line[32];
+
+    switch (client->phase) {
+        case CLIENT_NAME:
+            snprintf(line, sizeof(line), "Bot%d\n", number);
+            client->phase = CLIENT_CLASS;
+            return sendLine(client, line);
+
+        case CLIENT_CLASS:
+            snprintf(line, sizeof(line), "%d\n", (int)(nextRandom() % 4) + 1);
+            client->phase = client->idle ? CLIENT_IDLE : CLIENT_PLAYING;
+            return sendLine(client, line);
+
+        case CLIENT_PLAYING:
+            if (client->turns++ >= MAX_TURNS_PER_SESSION || client->choices <= 0) {
+                return sendLine(client, "quit\n");
+            }
+            snprintf(line, sizeof(line), "%d\n", (int)(nextRandom() % (unsigned)client->choices) + 1);
+            return sendLine(client, line);
+
+        case CLIENT_IDLE:
+            return 0;
+    }
+    return 0;
+}
+
+/**
+ * @brief Remembers how many choices the latest "(1-N)" in the output offered
+ */
+static void scanChoices(Client* client) {
+    const char* found = NULL;
+    for (const char* at = client->buffer; (at = strstr(at, "(1-")) != NULL; at += 3) {
+        found = at;
+    }
+    if (found) client->choices = atoi(found + 3);
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-c connections] [-i idle-connections] [-d seconds] "
+                    "[-h host] [-p port | -u socket-path]\n", program);
+}
+
+int main(int argc, char** argv) {
+    int connections = DEFAULT_CONNECTIONS;
+    int idleConnections = 0;
+    int seconds = DEFAULT_SECONDS;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            connections = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            idleConnections = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            seconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-h") == 0 && i + 1 < argc) {
+            host = argv[++i];
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-u") == 0 && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    int total = connections + idleConnections;
+    if (connections < 0 || idleConnections < 0 || total <= 0 || seconds <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Client* clients = (Client*)calloc((size_t)total, sizeof(Client));
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (!clients || epollFd < 0) {
+        perror("loadgen");
+        return 1;
+    }
+
+    // Idle connections go first so the measured ones play against a full server
+    int failedConnects = 0;
+    for (int i = 0; i < total; i++) {
+        clients[i].fd = -1;
+        clients[i].idle = i < idleConnections;
+        if (connectClient(epollFd, &clients[i]) < 0) failedConnects++;
+    }
+
+    Samples samples = {NULL, 0, 0};
+    long sessions = 0;
+    long errors = 0;
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    now = start;
+
+    struct epoll_event events[MAX_EVENTS];
+    while (elapsedMicros(&start, &now) < seconds * 1e6) {
+        int count = epoll_wait(epollFd, events, MAX_EVENTS, 100);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (count < 0 && errno != EINTR) break;
+
+        for (int e = 0; e < count; e++) {
+            Client* client = (Client*)events[e].data.ptr;
+            ssize_t received = recv(client->fd, client->buffer + client->length,
+                                    sizeof(client->buffer) - 1 - client->length, 0);
+            if (received < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+
+            if (received <= 0) {
+                // The server closes a session when its story ends
+                if (client->waiting) addSample(&samples, elapsedMicros(&client->sentAt, &now));
+                if (received < 0 || client->phase != CLIENT_PLAYING) errors++;
+                sessions++;
+                disconnectClient(client);
+                if (connectClient(epollFd, client) < 0) failedConnects++;
+                continue;
+            }
+
+            client->length += (size_t)received;
+            client->buffer[client->length] = '\0';
+            if (client->length < 3 || strcmp(client->buffer + client->length - 3, "\n> ") != 0) {
+                // Keep the tail of an oversized scene so the prompt can still be found
+                if (client->length >= sizeof(client->buffer) - 1) {
+                    memmove(client->buffer, client->buffer + client->length - 64, 64);
+                    client->length = 64;
+                }
+                continue;
+            }
+
+            if (client->waiting && client->phase == CLIENT_PLAYING) {
+                addSample(&samples, elapsedMicros(&client->sentAt, &now));
+            }
+            client->waiting = 0;
+            scanChoices(client);
+            client->length = 0;
+
+            if (answerPrompt(client, (int)(client - clients)) < 0) {
+                errors++;
+                disconnectClient(client);
+                if (connectClient(epollFd, client) < 0) failedConnects++;
+            }
+        }
+    }
+
+    double elapsed = elapsedMicros(&start, &now) / 1e6;
+    qsort(samples.values, samples.count, sizeof(float), compareFloats);
+
+    printf("%d playing + %d idle connections for %.1f s\n", connections, idleConnections, elapsed);
+    printf("%zu turns (%.0f turns/s), %ld sessions finished, %ld errors, %d failed connects\n",
+           samples.count, (double)samples.count / elapsed, sessions, errors, failedConnects);
+    printf("turn latency: p50 %.0f us, p90 %.0f us, p99 %.0f us, p99.9 %.0f us, max %.0f us\n",
+           percentile(&samples, 0.50), percentile(&samples, 0.90), percentile(&samples, 0.99),
+           percentile(&samples, 0.999), percentile(&samples, 1.0));
+
+    for (int i = 0; i < total; i++) {
+        if (clients[i].fd >= 0) close(clients[i].fd);
+    }
+    close(epollFd);
+    free(samples.values);
+    free(clients);
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/engine.h"
+#include "../include/requirements.h"
+
+/**
+ * @file population.c
+ * @brief Choice availability across a population of characters
+ * @details Generates characters of every class with random stat growth on
+ *          top of their starting stats and evaluates every node against the
+ *          whole population with the batch requirement API. Reports, for each
+ *          node with requirements, the share of characters able to take each
+ *          choice, checks the vector results against the scalar
+ *          hasRequiredStats(), and times the batch, per-character and scalar
+ *          evaluations. Choice conditions depend on more than stats and are
+ *          left out; only the requirement lanes are measured.
+ */
+
+#define DEFAULT_CHARACTERS 100000
+#define DEFAULT_GROWTH 4
+#define TIMING_ROUNDS 20
+
+// Keeps the timed loops from being optimized away
+static volatile unsigned long long sink;
+
+static unsigned long long nextRandom(unsigned long long* state) {
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static double elapsedSeconds(const struct timespec* from, const struct timespec* to) {
+    return (double)(to->tv_sec - from->tv_sec) + (double)(to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+static unsigned int scalarMask(const StoryRecord* node, const Character* character) {
+    unsigned int mask = 0;
+    for (uint32_t i = 0; i < node->numChoices; i++) {
+        const uint8_t* req = node->requirements[i];
+        if (hasRequiredStats(character, req[0], req[1], req[2])) mask |= 1u << i;
+    }
+    return mask;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-n characters] [-g stat-growth] [-s seed] [-f compiled-story]\n", program);
+}
+
+int main(int argc, char** argv) {
+    long count = DEFAULT_CHARACTERS;
+    int growth = DEFAULT_GROWTH;
+    unsigned long long rng = 0x9E3779B97F4A7C15ULL;
+    const char* storyPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            count = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            growth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            rng = strtoull(argv[++i], NULL, 10) | 1;
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            storyPath = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (count <= 0 || growth < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Story* story = storyPath ? openStoryFile(storyPath) : compileBuiltinStory();
+    Character* characters = (Character*)malloc(sizeof(Character) * (size_t)count);
+    StatVector* stats = (StatVector*)malloc(sizeof(StatVector) * (size_t)count);
+    uint8_t* masks = (uint8_t*)malloc((size_t)count);
+    if (!story) {
+        fprintf(stderr, "Failed to load the story.\n");
+        return 1;
+    }
+    if (!characters || !stats || !masks) {
+        fprintf(stderr, "Not enough memory for %ld characters.\n", count);
+        return 1;
+    }
+
+    for (long i = 0; i < count; i++) {
+        Character* character = &characters[i];
+        initializeCharacter(character, "Sampled", (CharacterClass)(i & 3));
+        character->strength += (int)(nextRandom(&rng) % (unsigned long long)(growth + 1));
+        character->intelligence += (int)(nextRandom(&rng) % (unsigned long long)(growth + 1));
+        character->charisma += (int)(nextRandom(&rng) % (unsigned long long)(growth + 1));
+        stats[i] = packStats(character);
+    }
+
+    uint32_t nodeCount = story->header->nodeCount;
+    long mismatches = 0;
+
+    printf("Share of %ld characters able to take each choice (stat growth 0-%d):\n\n", count, growth);
+    for (uint32_t n = 0; n < nodeCount; n++) {
+        const StoryRecord* node = &story->nodes[n];
+        long taken[MAX_CHOICES] = {0};
+
+        getChoiceMasks(node, stats, (size_t)count, masks);
+        for (long i = 0; i < count; i++) {
+            if (masks[i] != scalarMask(node, &characters[i])) mismatches++;
+            for (uint32_t c = 0; c < node->numChoices; c++) {
+                if (masks[i] & (1u << c)) taken[c]++;
+            }
+        }
+
+        int restricted = 0;
+        for (uint32_t c = 0; c < node->numChoices; c++) {
+            if (taken[c] != count) restricted = 1;
+        }
+        if (!restricted) continue;
+
+        printf("Node %d:", node->id);
+        for (uint32_t c = 0; c < node->numChoices; c++) {
+            printf("  %u: %5.1f%%", c + 1, 100.0 * (double)taken[c] / (double)count);
+        }
+        printf("\n");
+    }
+    printf("\n%ld mismatches against hasRequiredStats()\n", mismatches);
+
+    // Time each way of evaluating every node for every character
+    const char* methods[] = {"batch", "per character", "scalar"};
+    unsigned long long checksum = 0;
+    for (int method = 0; method < 3; method++) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int round = 0; round < TIMING_ROUNDS; round++) {
+            for (uint32_t n = 0; n < nodeCount; n++) {
+                const StoryRecord* node = &story->nodes[n];
+                if (method == 0) {
+                    getChoiceMasks(node, stats, (size_t)count, masks);
+                    checksum += masks[n % (uint32_t)count];
+                } else if (method == 1) {
+                    for (long i = 0; i < count; i++) checksum += getChoiceMask(node, stats[i]);
+                } else {
+                    for (long i = 0; i < count; i++) checksum += scalarMask(node, &characters[i]);
+                }
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double evaluations = (double)TIMING_ROUNDS * nodeCount * (double)count;
+        printf("%-14s %8.2f ns per node and character (%.0f M/s)\n", methods[method],
+               elapsedSeconds(&start, &end) * 1e9 / evaluations,
+               evaluations / elapsedSeconds(&start, &end) / 1e6);
+    }
+    sink = checksum;
+
+    free(masks);
+    free(stats);
+    free(characters);
+    closeStory(story);
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/engine.h"
+#include "../include/reach.h"
+
+/**
+ * @file reach.c
+ * @brief Ending reachability report
+ * @details Builds the reachability index of a story and reports, from the
+ *          start node, the minimal stats that reach each ending and which
+ *          classes can reach it with their starting stats. Optionally checks
+ *          the index against a breadth-first search for random start nodes
+ *          and stats.
+ */
+
+#define NUM_CLASSES 4
+#define MAX_LISTED_ENDINGS 64
+
+static unsigned long long nextRandom(unsigned long long* state) {
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static double elapsedSeconds(const struct timespec* from, const struct timespec* to) {
+    return (double)(to->tv_sec - from->tv_sec) + (double)(to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+static void printEnding(const Story* story, int ending) {
+    if (ending == STORY_END) {
+        printf("story end");
+    } else {
+        printf("node %d", story->nodes[ending].id);
+    }
+}
+
+/**
+ * @brief Marks the endings reachable with fixed stats by searching the graph
+ * @param reached Receives 1 for each node index reached, plus reached[nodeCount] for STORY_END
+ */
+static void searchEndings(const Story* story, int start, StatVector stats, uint8_t* reached, int* queue) {
+    uint32_t nodeCount = story->header->nodeCount;
+    int head = 0;
+    int tail = 0;
+
+    memset(reached, 0, nodeCount + 1);
+    reached[start] = 1;
+    queue[tail++] = start;
+
+    while (head < tail) {
+        int node = queue[head++];
+        unsigned int available = getChoiceMask(&story->nodes[node], stats);
+        for (int i = 0; i < MAX_CHOICES; i++) {
+            if (!(available & (1u << i))) continue;
+            int next = story->nodes[node].nextNodes[i];
+            if (next == STORY_END) {
+                reached[nodeCount] = 1;
+            } else if (!reached[next]) {
+                reached[next] = 1;
+                queue[tail++] = next;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Compares the index with a search for random start nodes and stats
+ * @return Number of disagreements
+ */
+static long verifyIndex(const ReachIndex* index, long samples, unsigned long long* rng) {
+    const Story* story = index->story;
+    uint32_t nodeCount = story->header->nodeCount;
+    uint8_t* reached = (uint8_t*)malloc(nodeCount + 1);
+    int* queue = (int*)malloc(sizeof(int) * nodeCount);
+    long mismatches = 0;
+
+    if (!reached || !queue) {
+        free(reached);
+        free(queue);
+        return -1;
+    }
+
+    for (long s = 0; s < samples; s++) {
+        int start = (int)(nextRandom(rng) % nodeCount);
+        StatVector stats = {{0, 0, 0, REQUIREMENT_PRESENT}};
+        for (int lane = 0; lane < 3; lane++) {
+            stats.lanes[lane] = (uint8_t)(nextRandom(rng) % 11);
+        }
+
+        searchEndings(story, start, stats, reached, queue);
+        for (int e = 0; e < index->endingCount; e++) {
+            int ending = index->endings[e];
+            int searched = reached[ending == STORY_END ? nodeCount : (uint32_t)ending];
+            if (searched != canReachEnding(index, start, ending, stats)) mismatches++;
+        }
+    }
+
+    free(reached);
+    free(queue);
+    return mismatches;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-f compiled-story] [-v samples] [-s seed]\n", program);
+}
+
+int main(int argc, char** argv) {
+    const char* storyPath = NULL;
+    long samples = 0;
+    unsigned long long rng = 0x9E3779B97F4A7C15ULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            storyPath = argv[++i];
+        } else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc) {
+            samples = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            rng = strtoull(argv[++i], NULL, 10) | 1;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    Story* story = storyPath ? openStoryFile(storyPath) : compileBuiltinStory();
+    if (!story) {
+        fprintf(stderr, "Failed to load the story.\n");
+        return 1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ReachIndex* index = buildReachIndex(story);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (!index) {
+        fprintf(stderr, "Not enough memory for the reachability index.\n");
+        closeStory(story);
+        return 1;
+    }
+
+    size_t bytes = sizeof(uint32_t) * (story->header->nodeCount + 1) + sizeof(ReachEntry) * index->entryCount +
+                   sizeof(StatVector) * index->pointCount;
+    printf("Story: %u nodes, %d endings\n", story->header->nodeCount, index->endingCount);
+    printf("Index: %zu frontiers, %zu points, %.1f MB, built in %.3f s\n\n", index->entryCount,
+           index->pointCount, (double)bytes / (1024.0 * 1024.0), elapsedSeconds(&start, &end));
+
+    // Each class's starting stats against the frontiers from the start node
+    const char* classNames[NUM_CLASSES] = {"Warrior", "Scholar", "Diplomat", "Rogue"};
+    StatVector classStats[NUM_CLASSES];
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        Character character;
+        initializeCharacter(&character, "Sample", (CharacterClass)c);
+        classStats[c] = packStats(&character);
+    }
+
+    int root = story->header->rootNode;
+    int listed = 0;
+    printf("Endings reachable from the start node:\n");
+    for (int e = 0; e < index->endingCount && listed < MAX_LISTED_ENDINGS; e++) {
+        uint32_t count;
+        const StatVector* frontier = getReachFrontier(index, root, index->endings[e], &count);
+        if (!frontier) continue;
+        listed++;
+
+        printf("  ");
+        printEnding(story, index->endings[e]);
+        printf(": needs");
+        for (uint32_t p = 0; p < count; p++) {
+            printf("%s STR %d INT %d CHA %d", p ? " or" : "", frontier[p].lanes[0], frontier[p].lanes[1],
+                   frontier[p].lanes[2]);
+        }
+        printf("; classes:");
+        int any = 0;
+        for (int c = 0; c < NUM_CLASSES; c++) {
+            if (canReachEnding(index, root, index->endings[e], classStats[c])) {
+                printf(" %s", classNames[c]);
+                any = 1;
+            }
+        }
+        printf("%s\n", any ? "" : " none");
+    }
+    if (!listed) printf("  none\n");
+
+    long mismatches = 0;
+    if (samples > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        mismatches = verifyIndex(index, samples, &rng);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (mismatches < 0) {
+            fprintf(stderr, "Not enough memory to verify the index.\n");
+        } else {
+            printf("\nChecked %ld random start nodes and stats against a graph search in %.3f s: "
+                   "%ld mismatches\n", samples, elapsedSeconds(&start, &end), mismatches);
+        }
+    }
+
+    freeReachIndex(index);
+    closeStory(story);
+    return mismatches ? 1 : 0;
+}
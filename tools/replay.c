@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/engine.h"
+#include "../include/replay.h"
+
+/**
+ * @file replay.c
+ * @brief Headless replay of a playthrough token
+ * @details Fast-forwards through the choices of a replay token without a
+ *          terminal, reports where the playthrough ended and how long the
+ *          fast-forward takes. Useful for reproducing bug reports.
+ */
+
+#define DEFAULT_REPETITIONS 100000
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-n repetitions] [-f compiled-story] token\n", program);
+}
+
+int main(int argc, char** argv) {
+    long repetitions = DEFAULT_REPETITIONS;
+    const char* storyPath = NULL;
+    const char* token = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            repetitions = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            storyPath = argv[++i];
+        } else if (!token && argv[i][0] != '-') {
+            token = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!token || repetitions <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    ReplayLog log;
+    if (parseReplayToken(token, &log) < 0) {
+        fprintf(stderr, "Malformed replay token.\n");
+        return 1;
+    }
+
+    Story* story = storyPath ? openStoryFile(storyPath) : compileBuiltinStory();
+    if (!story) {
+        fprintf(stderr, "Failed to load the story.\n");
+        freeReplayLog(&log);
+        return 1;
+    }
+
+    const char* classNames[] = {"Warrior", "Scholar", "Diplomat", "Rogue"};
+    Character player;
+    GameState game;
+
+    if (log.storyTag != getStoryTag(story)) {
+        fprintf(stderr, "The token was recorded in a different story (tag %08x, story %08x).\n",
+                (unsigned)log.storyTag, (unsigned)getStoryTag(story));
+        freeReplayLog(&log);
+        closeStory(story);
+        return 1;
+    }
+
+    // Replay once by hand to report where an invalid token diverges
+    initializeCharacter(&player, log.name, log.characterClass);
+    initializeGameState(&game, &player, story);
+    int applied = replayChoices(&game, log.choices, log.choiceCount);
+    if (applied < log.choiceCount) {
+        fprintf(stderr, "Choice %d of %d (%d) is not available at node %d.\n", applied + 1,
+                log.choiceCount, log.choices[applied],
+                game.currentScene == STORY_END ? STORY_END : game.story->nodes[game.currentScene].id);
+        releaseGameChapter(&game);
+        freeGameHistory(&game);
+        freeReplayLog(&log);
+        closeStory(story);
+        return 1;
+    }
+
+    printf("%s the %s: %d choices, ", log.name, classNames[log.characterClass], log.choiceCount);
+    if (isGameOver(&game)) {
+        printf("game over\n");
+    } else {
+        printf("at node %d of chapter %d\n", game.story->nodes[game.currentScene].id, game.currentChapter);
+    }
+
+    // Holding every built-in chapter keeps it compiled, so the loop times replaying alone
+    Story* chapters[STORY_CHAPTERS + 1] = {NULL};
+    for (int chapter = 1; chapter <= STORY_CHAPTERS; chapter++) {
+        chapters[chapter] = openBuiltinChapter(chapter);
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < repetitions; i++) {
+        releaseGameChapter(&game);
+        freeGameHistory(&game);
+        restoreReplay(&log, &game, &player, story);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    releaseGameChapter(&game);
+    freeGameHistory(&game);
+    for (int chapter = 1; chapter <= STORY_CHAPTERS; chapter++) {
+        closeStory(chapters[chapter]);
+    }
+
+    double seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%ld restores in %.3f s (%.2f us/restore, %.1f ns/choice)\n", repetitions, seconds,
+           seconds * 1e6 / (double)repetitions,
+           log.choiceCount ? seconds * 1e9 / ((double)repetitions * log.choiceCount) : 0.0);
+
+    freeReplayLog(&log);
+    closeStory(story);
+    return 0;
+}
@@ -0,0 +1,616 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "../include/engine.h"
+#include "../include/session.h"
+#include "../include/condition.h"
+#include "../include/compact.h"
+
+/**
+ * @file server.c
+ * @brief Multi-session game server
+ * @details Serves any number of players from one process and one thread.
+ *          Every session is a small heap object holding its game packed
+ *          into a CompactGame; the game is unpacked into one scratch state
+ *          for each input line and packed again afterwards, and buffers are
+ *          only held while a line is partly received or output is pending.
+ *          All sessions share the same read-only compiled story.
+ *          Sockets are non-blocking and driven by a level-triggered epoll
+ *          loop, and each complete input line is fed to the connection's
+ *          session state machine, whose frames are rendered as text.
+ *          Players connect with any line-based client (telnet, nc).
+ *          SIGUSR1 prints session and memory statistics; SIGINT and SIGTERM
+ *          print them and shut down. SIGHUP rereads the compiled story given
+ *          with -f and publishes it: each session moves onto it after its
+ *          current turn, and the old version is freed once none is left on it. With -t, every applied choice is
+ *          recorded in a telemetry log written by a background thread.
+ *          With -r, players can undo turns; each session then keeps a
+ *          snapshot per turn next to its compact game.
+ */
+
+#define DEFAULT_PORT 4000
+#define MAX_INPUT_LINE 128
+#define MAX_EVENTS 256
+#define INITIAL_OUTPUT_CAPACITY 2048
+#define MAX_PENDING_OUTPUT (256 * 1024)
+
+/**
+ * @struct Connection
+ * @brief One connected player
+ */
+typedef struct {
+    int fd;                         /**< Client socket */
+    int closing;                    /**< Close once the output has been sent */
+    int writeWatched;               /**< EPOLLOUT is registered */
+    Session session;                /**< Character creation and turn state machine, played on the server's scratch game */
+    CompactGame* game;              /**< Game and character between inputs, or NULL once the game was dropped */
+    char* input;                    /**< Partial input line, NULL unless a line was split across reads */
+    size_t inputLength;             /**< Bytes in input */
+    char* output;                   /**< Pending output, NULL while nothing is pending */
+    size_t outputLength;            /**< Bytes in output */
+    size_t outputSent;              /**< Bytes of output already sent */
+    size_t outputCapacity;          /**< Size of output */
+} Connection;
+
+/**
+ * @struct Server
+ * @brief Event loop state
+ */
+typedef struct {
+    int epollFd;                    /**< Event loop */
+    int listenFd;                   /**< Listening socket */
+    int signalFd;                   /**< Delivers SIGINT, SIGTERM, SIGUSR1 and SIGHUP */
+    LiveStory story;                /**< Published story; each session holds the version it plays */
+    const char* storyPath;          /**< Compiled story reread on SIGHUP, or NULL for the built-in one */
+    long sessions;                  /**< Connected sessions */
+    long peakSessions;              /**< Most sessions connected at once */
+    long totalSessions;             /**< Sessions accepted since start */
+    long long turns;                /**< Choices applied */
+    long long storyUpdates;         /**< Sessions moved onto a newer story version */
+    long baselineRss;               /**< Resident bytes before the first session */
+    TelemetryLog* telemetry;        /**< Log of applied choices, or NULL */
+    GameState game;                 /**< Unpacked game of the session being served */
+    Character player;               /**< Unpacked character of the session being served */
+} Server;
+
+static const char* classNames[] = {"Warrior", "Scholar", "Diplomat", "Rogue"};
+
+static long residentBytes(void) {
+    long pages = 0, resident = 0;
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (!file) return 0;
+    if (fscanf(file, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    fclose(file);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+static void printStats(const Server* server) {
+    long rss = residentBytes();
+    long perSession = server->sessions ? (rss - server->baselineRss) / server->sessions : 0;
+    printf("sessions %ld (peak %ld, total %ld), turns %lld, story version %u (%lld moves), "
+           "rss %.1f MB, %ld bytes/session",
+           server->sessions, server->peakSessions, server->totalSessions, server->turns,
+           getLiveStoryVersion(&server->story), server->storyUpdates, rss / 1048576.0, perSession);
+    if (perSession > 0) {
+        printf(", %.0f sessions/GB", 1073741824.0 / (double)perSession);
+    }
+    if (server->telemetry) {
+        TelemetryStats telemetry;
+        getTelemetryStats(server->telemetry, &telemetry);
+        printf(", telemetry %llu written, %llu dropped%s", (unsigned long long)telemetry.written,
+               (unsigned long long)telemetry.dropped, telemetry.writeFailed ? ", write failed" : "");
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+/**
+ * @brief Rereads the compiled story and publishes it to every session
+ */
+static void reloadStory(Server* server) {
+    if (!server->storyPath) {
+        printf("The built-in story cannot be reloaded; start the server with -f.\n");
+        fflush(stdout);
+        return;
+    }
+
+    Story* story = openStoryFile(server->storyPath);
+    Story* current = acquireLiveStory(&server->story, NULL);
+    if (story && story->header->chapter != current->header->chapter) {
+        closeStory(story);
+        story = NULL;
+    }
+    closeStory(current);
+
+    if (!story) {
+        printf("Could not reload %s; keeping story version %u.\n", server->storyPath,
+               getLiveStoryVersion(&server->story));
+    } else {
+        printf("Published story version %u from %s.\n", publishStory(&server->story, story),
+               server->storyPath);
+    }
+    fflush(stdout);
+}
+
+/**
+ * @brief Appends formatted text to a connection's pending output
+ */
+static void sendText(Connection* connection, const char* format, ...) {
+    va_list args;
+    for (;;) {
+        size_t space = connection->outputCapacity - connection->outputLength;
+        va_start(args, format);
+        int length = vsnprintf(connection->output ? connection->output + connection->outputLength : NULL,
+                               connection->output ? space : 0, format, args);
+        va_end(args);
+        if (length < 0) return;
+        if (connection->output && (size_t)length < space) {
+            connection->outputLength += (size_t)length;
+            return;
+        }
+
+        size_t capacity = connection->outputCapacity ? connection->outputCapacity : INITIAL_OUTPUT_CAPACITY;
+        while (capacity - connection->outputLength <= (size_t)length) {
+            capacity *= 2;
+        }
+
+        // A client that never reads is dropped rather than buffered without bound
+        char* output = capacity > MAX_PENDING_OUTPUT ? NULL : (char*)realloc(connection->output, capacity);
+        if (!output) {
+            connection->closing = 1;
+            return;
+        }
+        connection->output = output;
+        connection->outputCapacity = capacity;
+    }
+}
+
+static void sendScene(Connection* connection) {
+    const GameState* game = connection->session.game;
+    const Story* story = game->story;
+    const StoryRecord* scene = &story->nodes[game->currentScene];
+
+    sendText(connection, "\n=== Chapter %d ===\n\n%s\n\n", game->currentChapter,
+             getNodeDescription(story, game->currentScene));
+    for (uint32_t i = 0; i < scene->numChoices; i++) {
+        const uint8_t* req = scene->requirements[i];
+        sendText(connection, "%u. %s", i + 1, getChoiceText(story, game->currentScene, i));
+        if (req[0] > 0 || req[1] > 0 || req[2] > 0) {
+            sendText(connection, " (Requires:");
+            if (req[0] > 0) sendText(connection, " STR %d", req[0]);
+            if (req[1] > 0) sendText(connection, " INT %d", req[1]);
+            if (req[2] > 0) sendText(connection, " CHA %d", req[2]);
+            sendText(connection, ")");
+        }
+        const uint8_t* condition = getChoiceCondition(story, scene, (int)i);
+        char text[MAX_CONDITION_TEXT];
+        if (condition && formatCondition(condition, text, sizeof(text)) >= 0) {
+            sendText(connection, " (If: %s)", text);
+        }
+        sendText(connection, "\n");
+    }
+    sendText(connection, "\nWhat will you do? (1-%u)\n> ", scene->numChoices);
+}
+
+/**
+ * @brief Renders the frames of a session step as text
+ */
+static void sendFrames(Connection* connection, const SessionOutput* output) {
+    const Character* player = connection->session.game->player;
+
+    for (int i = 0; i < output->count; i++) {
+        switch (output->frames[i]) {
+            case FRAME_NAME_PROMPT:
+                sendText(connection, "Welcome to The Chronicles of Destiny\nEnter your character's name:\n> ");
+                break;
+            case FRAME_CLASS_PROMPT:
+                sendText(connection, "\nChoose your class:\n"
+                                     "1. Warrior - Excels in combat and feats of strength\n"
+                                     "2. Scholar - Masters of knowledge and magical arts\n"
+                                     "3. Diplomat - Skilled in persuasion and leadership\n"
+                                     "4. Rogue - Specializes in stealth and cunning\n"
+                                     "(1-4)\n> ");
+                break;
+            case FRAME_CLASS_INVALID:
+                sendText(connection, "Please enter a number from 1 to 4.\n> ");
+                break;
+            case FRAME_CHARACTER:
+                sendText(connection, "\n%s the %s - STR %d, INT %d, CHA %d, Health %d\n",
+                         player->name, classNames[player->class], player->strength,
+                         player->intelligence, player->charisma, player->health);
+                break;
+            case FRAME_SCENE:
+                sendScene(connection);
+                break;
+            case FRAME_CHOICE_INVALID:
+                sendText(connection, "Invalid choice.\n> ");
+                break;
+            case FRAME_CHOICE_LOCKED:
+                sendText(connection, "You don't meet the requirements for this choice.\n> ");
+                break;
+            case FRAME_PREVIEW: {
+                char text[MAX_PREVIEW_TEXT];
+                formatChoicePreview(&output->preview, connection->session.game, text, sizeof(text));
+                sendText(connection, "Choice %d: %s.\n> ", output->preview.choice + 1, text);
+                break;
+            }
+            case FRAME_UNDO_INVALID:
+                sendText(connection, "There are not that many turns to undo.\n> ");
+                break;
+            case FRAME_ENDING:
+                sendText(connection, "\n*** Your story has come to an end. Farewell, %s. ***\n", player->name);
+                break;
+            case FRAME_FAREWELL:
+                sendText(connection, "Farewell.\n");
+                break;
+        }
+    }
+
+    if (connection->session.phase == SESSION_OVER) {
+        connection->closing = 1;
+    }
+}
+
+/**
+ * @brief Packs the scratch game back into its connection after a step
+ * @details A game that cannot be packed is ended rather than kept, since the
+ *          scratch state is about to serve another session.
+ */
+static void storeGame(Server* server, Connection* connection) {
+    CompactGame* packed = packGame(&server->game, connection->game);
+    if (packed) {
+        connection->game = packed;
+        return;
+    }
+
+    endSession(&connection->session);
+    releaseGameChapter(&server->game);
+    closeStory(server->game.startStory);
+    free(connection->game);
+    connection->game = NULL;
+    sendText(connection, "\nThe server could not keep your game. Farewell.\n");
+    connection->closing = 1;
+}
+
+/**
+ * @brief Feeds one line of input to a connection's session
+ */
+static void handleLine(Server* server, Connection* connection, char* line) {
+    size_t length = strlen(line);
+    while (length > 0 && (line[length - 1] == '\r' || line[length - 1] == ' ')) {
+        line[--length] = '\0';
+    }
+
+    SessionOutput output;
+    if (unpackGame(connection->game, &server->game, &server->player) < 0) {
+        sendText(connection, "\nThe server could not load your game. Farewell.\n");
+        connection->closing = 1;
+        return;
+    }
+    feedSession(&connection->session, line, &output);
+    server->turns += output.applied;
+    server->storyUpdates += output.updated;
+    sendFrames(connection, &output);
+    storeGame(server, connection);
+}
+
+static void closeConnection(Server* server, Connection* connection) {
+    epoll_ctl(server->epollFd, EPOLL_CTL_DEL, connection->fd, NULL);
+    close(connection->fd);
+    endSession(&connection->session);
+    if (connection->game) {
+        // The packed game holds the same story references the game would
+        if (connection->game->story != connection->game->startStory) closeStory(connection->game->story);
+        closeStory(connection->game->startStory);
+        free(connection->game);
+    }
+    free(connection->input);
+    free(connection->output);
+    free(connection);
+    server->sessions--;
+}
+
+/**
+ * @brief Sends as much pending output as the socket takes
+ * @return 0 if the session stays open, -1 if it was closed
+ */
+static int flushConnection(Server* server, Connection* connection) {
+    while (connection->outputSent < connection->outputLength) {
+        ssize_t sent = send(connection->fd, connection->output + connection->outputSent,
+                            connection->outputLength - connection->outputSent, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            closeConnection(server, connection);
+            return -1;
+        }
+        connection->outputSent += (size_t)sent;
+    }
+
+    int pending = connection->outputSent < connection->outputLength;
+    if (!pending) {
+        // Idle sessions hold no output buffer
+        free(connection->output);
+        connection->output = NULL;
+        connection->outputLength = connection->outputSent = connection->outputCapacity = 0;
+        if (connection->closing) {
+            closeConnection(server, connection);
+            return -1;
+        }
+    }
+
+    if (pending != connection->writeWatched) {
+        struct epoll_event event = {.events = EPOLLIN | (pending ? EPOLLOUT : 0), .data.ptr = connection};
+        epoll_ctl(server->epollFd, EPOLL_CTL_MOD, connection->fd, &event);
+        connection->writeWatched = pending;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads what a client sent and handles every complete line
+ * @return 0 if the session stays open, -1 if it was closed
+ */
+static int readConnection(Server* server, Connection* connection) {
+    char buffer[4096];
+    ssize_t received = recv(connection->fd, buffer, sizeof(buffer), 0);
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return 0;
+    if (received <= 0) {
+        closeConnection(server, connection);
+        return -1;
+    }
+
+    char line[MAX_INPUT_LINE];
+    size_t length = connection->inputLength;
+    if (length) memcpy(line, connection->input, length);
+    for (ssize_t i = 0; i < received && !connection->closing; i++) {
+        if (buffer[i] == '\n') {
+            line[length] = '\0';
+            length = 0;
+            handleLine(server, connection, line);
+        } else if (length < MAX_INPUT_LINE - 1) {
+            line[length++] = buffer[i];
+        }
+    }
+
+    // Only a line split across reads keeps a buffer until the next one
+    if (length && !connection->closing && !connection->input) {
+        connection->input = (char*)malloc(MAX_INPUT_LINE);
+        if (!connection->input) connection->closing = 1;
+    }
+    if (length && connection->input) {
+        memcpy(connection->input, line, length);
+        connection->inputLength = length;
+    } else {
+        free(connection->input);
+        connection->input = NULL;
+        connection->inputLength = 0;
+    }
+    return flushConnection(server, connection);
+}
+
+static void acceptSessions(Server* server) {
+    for (;;) {
+        int fd = accept4(server->listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept");
+            return;
+        }
+
+        Connection* connection = (Connection*)calloc(1, sizeof(Connection));
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = connection};
+        if (!connection || epoll_ctl(server->epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            free(connection);
+            close(fd);
+            continue;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        connection->fd = fd;
+        server->sessions++;
+        server->totalSessions++;
+        if (server->sessions > server->peakSessions) {
+            server->peakSessions = server->sessions;
+        }
+
+        // startSession() starts the scratch game afresh, which would drop the history it reuses
+        SessionOutput output;
+        freeGameHistory(&server->game);
+        startSession(&connection->session, &server->game, &server->player,
+                     acquireLiveStory(&server->story, NULL), &output);
+        sendFrames(connection, &output);
+        storeGame(server, connection);
+        flushConnection(server, connection);
+    }
+}
+
+static int listenTcp(int port) {
+    int fd = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    int one = 1;
+    int zero = 0;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+
+    struct sockaddr_in6 address;
+    memset(&address, 0, sizeof(address));
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    address.sin6_port = htons((uint16_t)port);
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int listenUnix(const char* path) {
+    struct sockaddr_un address;
+    if (strlen(path) >= sizeof(address.sun_path)) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-p port | -u socket-path] [-f compiled-story] [-t telemetry-log] [-r]\n", program);
+}
+
+int main(int argc, char** argv) {
+    int port = DEFAULT_PORT;
+    const char* socketPath = NULL;
+    const char* storyPath = NULL;
+    const char* telemetryPath = NULL;
+    int undo = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-u") == 0 && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            storyPath = argv[++i];
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            telemetryPath = argv[++i];
+        } else if (strcmp(argv[i], "-r") == 0) {
+            undo = 1;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    Server server;
+    memset(&server, 0, sizeof(server));
+
+    Story* story = storyPath ? openStoryFile(storyPath) : compileBuiltinStory();
+    if (!story) {
+        fprintf(stderr, "Failed to load the story.\n");
+        return 1;
+    }
+    initLiveStory(&server.story, story);
+    server.storyPath = storyPath;
+    setSessionStory(&server.story);
+    setSessionRewind(undo);
+
+    server.listenFd = socketPath ? listenUnix(socketPath) : listenTcp(port);
+    if (server.listenFd < 0) {
+        perror(socketPath ? socketPath : "listen");
+        closeLiveStory(&server.story);
+        return 1;
+    }
+
+    if (telemetryPath) {
+        server.telemetry = openTelemetryLog(telemetryPath);
+        if (!server.telemetry) {
+            fprintf(stderr, "Could not open the telemetry log %s.\n", telemetryPath);
+            close(server.listenFd);
+            if (socketPath) unlink(socketPath);
+            closeLiveStory(&server.story);
+            return 1;
+        }
+        setSessionTelemetry(server.telemetry);
+    }
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGHUP);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    server.signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    server.epollFd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event listenEvent = {.events = EPOLLIN, .data.ptr = &server.listenFd};
+    struct epoll_event signalEvent = {.events = EPOLLIN, .data.ptr = &server.signalFd};
+    if (server.signalFd < 0 || server.epollFd < 0 ||
+        epoll_ctl(server.epollFd, EPOLL_CTL_ADD, server.listenFd, &listenEvent) < 0 ||
+        epoll_ctl(server.epollFd, EPOLL_CTL_ADD, server.signalFd, &signalEvent) < 0) {
+        perror("epoll");
+        return 1;
+    }
+
+    server.baselineRss = residentBytes();
+    if (socketPath) {
+        printf("Serving on %s\n", socketPath);
+    } else {
+        printf("Serving on port %d\n", port);
+    }
+    fflush(stdout);
+
+    int running = 1;
+    struct epoll_event events[MAX_EVENTS];
+    while (running) {
+        int count = epoll_wait(server.epollFd, events, MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            void* source = events[i].data.ptr;
+            if (source == &server.listenFd) {
+                acceptSessions(&server);
+            } else if (source == &server.signalFd) {
+                struct signalfd_siginfo info;
+                while (read(server.signalFd, &info, sizeof(info)) == sizeof(info)) {
+                    if (info.ssi_signo == SIGHUP) {
+                        reloadStory(&server);
+                        continue;
+                    }
+                    printStats(&server);
+                    if (info.ssi_signo != SIGUSR1) running = 0;
+                }
+            } else {
+                Connection* connection = (Connection*)source;
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    closeConnection(&server, connection);
+                } else if (events[i].events & EPOLLIN) {
+                    readConnection(&server, connection);
+                } else if (events[i].events & EPOLLOUT) {
+                    flushConnection(&server, connection);
+                }
+            }
+        }
+    }
+
+    // Sessions still connected are dropped with the process
+    close(server.listenFd);
+    if (socketPath) unlink(socketPath);
+    setSessionTelemetry(NULL);
+    if (closeTelemetryLog(server.telemetry) < 0) {
+        fprintf(stderr, "Some telemetry events were dropped or could not be written.\n");
+    }
+    setSessionStory(NULL);
+    closeLiveStory(&server.story);
+    freeGameHistory(&server.game);
+    return 0;
+}
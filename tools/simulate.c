@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/engine.h"
+
+/**
+ * @file simulate.c
+ * @brief Headless playthrough simulator for balance testing
+ * @details Plays random playthroughs through the headless engine without a
+ *          terminal and reports how they end along with the achieved rate.
+ */
+
+#define DEFAULT_PLAYTHROUGHS 1000000
+
+/**
+ * @brief Advances a xorshift64 generator
+ * @param state Pointer to the generator state (must be non-zero)
+ * @return Next pseudo-random value
+ */
+static unsigned long long nextRandom(unsigned long long* state) {
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+/**
+ * @brief Picks one set bit of a mask uniformly at random
+ * @param mask Non-zero bitmask of available choices
+ * @param rng Pointer to the generator state
+ * @return Index of the picked bit
+ */
+static int pickChoice(unsigned int mask, unsigned long long* rng) {
+    int count = __builtin_popcount(mask);
+    int pick = (int)(nextRandom(rng) % (unsigned long long)count);
+    while (pick-- > 0) {
+        mask &= mask - 1;
+    }
+    return __builtin_ctz(mask);
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-n playthroughs] [-c class 1-4] [-s seed] [-f compiled-story]\n", program);
+}
+
+int main(int argc, char** argv) {
+    long playthroughs = DEFAULT_PLAYTHROUGHS;
+    int classFilter = 0;
+    unsigned long long rng = 0x9E3779B97F4A7C15ULL;
+    const char* storyPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            playthroughs = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            classFilter = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            rng = strtoull(argv[++i], NULL, 10) | 1;
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            storyPath = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (playthroughs <= 0 || classFilter < 0 || classFilter > 4) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Story* story = storyPath ? openStoryFile(storyPath) : compileBuiltinStory();
+    if (!story) {
+        fprintf(stderr, "Failed to load the story.\n");
+        return 1;
+    }
+
+    const char* classNames[] = {"Warrior", "Scholar", "Diplomat", "Rogue"};
+    long endings[4] = {0};
+    long stuck[4] = {0};
+    long turnLimit[4] = {0};
+    long runs[4] = {0};
+    long long turns = 0;
+
+    Character player;
+    GameState game;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (long run = 0; run < playthroughs; run++) {
+        int cls = classFilter ? classFilter - 1 : (int)(run & 3);
+        initializeCharacter(&player, "Simulated", (CharacterClass)cls);
+        initializeGameState(&game, &player, story);
+        runs[cls]++;
+
+        while (!isGameOver(&game)) {
+            if (game.choiceHistoryCount >= PLAYTHROUGH_TURN_LIMIT) {
+                turnLimit[cls]++;
+                break;
+            }
+            unsigned int available = getAvailableChoices(&game);
+            if (!available) {
+                // A scene without choices is an authored ending
+                if (story->nodes[game.currentScene].numChoices == 0) {
+                    endings[cls]++;
+                } else {
+                    stuck[cls]++;
+                }
+                break;
+            }
+            applyChoice(&game, pickChoice(available, &rng));
+        }
+
+        if (isGameOver(&game)) {
+            endings[cls]++;
+        }
+        turns += game.choiceHistoryCount;
+        freeGameHistory(&game);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("%-10s %12s %12s %12s %12s\n", "Class", "Runs", "Endings", "Dead ends", "Turn limit");
+    for (int cls = 0; cls < 4; cls++) {
+        if (!runs[cls]) continue;
+        printf("%-10s %12ld %12ld %12ld %12ld\n", classNames[cls], runs[cls], endings[cls], stuck[cls], turnLimit[cls]);
+    }
+    printf("\n%ld playthroughs, %lld turns in %.3f s (%.0f playthroughs/s, %.1f ns/turn)\n",
+           playthroughs, turns, seconds, playthroughs / seconds,
+           turns ? seconds * 1e9 / (double)turns : 0.0);
+
+    closeStory(story);
+    return 0;
+}
@@ -0,0 +1,492 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/storyfile.h"
+#include "../include/condition.h"
+#include "../include/effect.h"
+
+/**
+ * @file storyc.c
+ * @brief Story compiler
+ * @details Turns an authored story source into a compiled story file that the
+ *          game maps in place. Without a source file a built-in chapter is
+ *          compiled; --dump prints it in source form as a starting point.
+ *
+ * Source format, one directive per line:
+ * @code
+ * # comment
+ * start <id>                                     (optional, defaults to the first node)
+ * chapter <number>                               (optional, defaults to 1)
+ * item <name>                                    (repeatable: declares an item the story uses)
+ * trait <name>                                   (repeatable: declares a character trait)
+ * flag <name>                                    (repeatable: declares a story flag)
+ * node <id>
+ * text <words>                                   (repeatable, joined with single spaces)
+ * choice <target id|end> <str> <int> <cha> <text>
+ * when <condition>                               (optional, after a choice: see condition.h)
+ * do <effects>                                   (optional, after a choice: see effect.h)
+ * exit <chapter>                                 (instead of choices: continue at node <id> of a built-in chapter)
+ * @endcode
+ */
+
+#define MAX_SOURCE_LINE 4096
+#define DUMP_WRAP_COLUMN 100
+
+/**
+ * @struct PendingChoice
+ * @brief Choice whose target is resolved once every node has been read
+ */
+typedef struct {
+    StoryNode* node;            /**< Node the choice belongs to */
+    int target;                 /**< Target node id, or STORY_END */
+    int requirements[3];        /**< Stat requirements */
+    char* text;                 /**< Choice text, owned */
+    char* condition;            /**< Condition text, owned, or NULL */
+    char* effects;              /**< Effect list, owned, or NULL */
+    int line;                   /**< Source line, for diagnostics */
+    int conditionLine;          /**< Source line of the condition */
+    int effectsLine;            /**< Source line of the effect list */
+} PendingChoice;
+
+/**
+ * @struct SourceStory
+ * @brief Nodes and choices read from a source file
+ */
+typedef struct {
+    StoryNode** nodes;          /**< Nodes in source order */
+    StoryNode** byId;           /**< Nodes sorted by id, built after reading */
+    int nodeCount;              /**< Number of nodes */
+    int nodeCapacity;           /**< Capacity of nodes */
+    PendingChoice* choices;     /**< Choices in source order */
+    int choiceCount;            /**< Number of choices */
+    int choiceCapacity;         /**< Capacity of choices */
+    int startId;                /**< Id of the start node, or -1 for the first node */
+    StoryBuilder builder;       /**< Storage for nodes and text */
+    char* description;          /**< Description of the node being read */
+    size_t descriptionLength;   /**< Bytes used in description */
+    size_t descriptionCapacity; /**< Bytes allocated for description */
+} SourceStory;
+
+static int compareNodeIds(const void* a, const void* b) {
+    int left = (*(StoryNode* const*)a)->id;
+    int right = (*(StoryNode* const*)b)->id;
+    return (left > right) - (left < right);
+}
+
+/**
+ * @brief Finds a node by id; source->byId must be sorted
+ */
+static StoryNode* findSourceNode(const SourceStory* source, int id) {
+    int low = 0;
+    int high = source->nodeCount - 1;
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        int midId = source->byId[mid]->id;
+        if (midId == id) return source->byId[mid];
+        if (midId < id) low = mid + 1;
+        else high = mid - 1;
+    }
+    return NULL;
+}
+
+static const char* nameDirectives[NAME_KINDS] = {"item", "trait", "flag"};
+static const int nameLimits[NAME_KINDS] = {MAX_ITEMS, MAX_TRAIT_IDS, MAX_FLAGS};
+
+/**
+ * @brief Gets the name kind a line declares
+ * @return NameKind of an item, trait or flag directive, -1 for any other line
+ */
+static int findNameDirective(const char* line) {
+    for (int kind = 0; kind < NAME_KINDS; kind++) {
+        size_t length = strlen(nameDirectives[kind]);
+        if (strncmp(line, nameDirectives[kind], length) == 0 && line[length] == ' ') return kind;
+    }
+    return -1;
+}
+
+static int growArray(void** items, int* capacity, size_t itemSize) {
+    int grown = *capacity ? *capacity * 2 : 64;
+    void* resized = realloc(*items, itemSize * grown);
+    if (!resized) return -1;
+    *items = resized;
+    *capacity = grown;
+    return 0;
+}
+
+static int appendDescription(SourceStory* source, const char* text) {
+    size_t length = strlen(text);
+    size_t needed = source->descriptionLength + length + 2;
+
+    if (needed > source->descriptionCapacity) {
+        size_t capacity = source->descriptionCapacity ? source->descriptionCapacity : 1024;
+        while (capacity < needed) capacity *= 2;
+        char* grown = (char*)realloc(source->description, capacity);
+        if (!grown) return -1;
+        source->description = grown;
+        source->descriptionCapacity = capacity;
+    }
+
+    if (source->descriptionLength) {
+        source->description[source->descriptionLength++] = ' ';
+    }
+    memcpy(source->description + source->descriptionLength, text, length + 1);
+    source->descriptionLength += length;
+    return 0;
+}
+
+/**
+ * @brief Stores the description collected for a node
+ */
+static int finishNode(SourceStory* source, StoryNode* node) {
+    if (!node) return 0;
+
+    const char* text = source->descriptionLength ? source->description : "";
+    source->descriptionLength = 0;
+    return internText(&source->builder.text, text, &node->description);
+}
+
+static int parseSource(FILE* file, const char* path, SourceStory* source) {
+    char line[MAX_SOURCE_LINE];
+    StoryNode* current = NULL;
+    int lineNumber = 0;
+
+    while (fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (line[0] == '\0' || line[0] == '#') continue;
+
+        if (strncmp(line, "node ", 5) == 0) {
+            int id;
+            if (sscanf(line + 5, "%d", &id) != 1) {
+                fprintf(stderr, "%s:%d: error: expected 'node <id>'\n", path, lineNumber);
+                return -1;
+            }
+            if (source->nodeCount == source->nodeCapacity &&
+                growArray((void**)&source->nodes, &source->nodeCapacity, sizeof(StoryNode*)) < 0) {
+                return -1;
+            }
+            if (finishNode(source, current) < 0) return -1;
+            current = createStoryNode(&source->builder, id, "");
+            if (!current) return -1;
+            source->nodes[source->nodeCount++] = current;
+        } else if (strncmp(line, "text ", 5) == 0) {
+            if (!current) {
+                fprintf(stderr, "%s:%d: error: 'text' before any 'node'\n", path, lineNumber);
+                return -1;
+            }
+            if (appendDescription(source, line + 5) < 0) return -1;
+        } else if (strncmp(line, "choice ", 7) == 0) {
+            char target[32];
+            int offset = 0;
+            PendingChoice choice;
+
+            if (!current) {
+                fprintf(stderr, "%s:%d: error: 'choice' before any 'node'\n", path, lineNumber);
+                return -1;
+            }
+            if (sscanf(line + 7, "%31s %d %d %d %n", target, &choice.requirements[0],
+                       &choice.requirements[1], &choice.requirements[2], &offset) != 4 || !line[7 + offset]) {
+                fprintf(stderr, "%s:%d: error: expected 'choice <target|end> <str> <int> <cha> <text>'\n",
+                        path, lineNumber);
+                return -1;
+            }
+            for (int stat = 0; stat < 3; stat++) {
+                if (choice.requirements[stat] < 0 || choice.requirements[stat] > MAX_REQUIREMENT) {
+                    fprintf(stderr, "%s:%d: error: requirement %d is outside 0..%d\n",
+                            path, lineNumber, choice.requirements[stat], MAX_REQUIREMENT);
+                    return -1;
+                }
+            }
+            if (strcmp(target, "end") == 0) {
+                choice.target = STORY_END;
+            } else {
+                char* end;
+                choice.target = (int)strtol(target, &end, 10);
+                if (*end != '\0') {
+                    fprintf(stderr, "%s:%d: error: bad choice target '%s'\n", path, lineNumber, target);
+                    return -1;
+                }
+            }
+            if (current->numChoices + 1 > MAX_CHOICES) {
+                fprintf(stderr, "%s:%d: error: node %d has more than %d choices\n",
+                        path, lineNumber, current->id, MAX_CHOICES);
+                return -1;
+            }
+            current->numChoices++;
+
+            choice.node = current;
+            choice.line = lineNumber;
+            choice.condition = NULL;
+            choice.effects = NULL;
+            choice.text = strdup(line + 7 + offset);
+            if (!choice.text) return -1;
+
+            if (source->choiceCount == source->choiceCapacity &&
+                growArray((void**)&source->choices, &source->choiceCapacity, sizeof(PendingChoice)) < 0) {
+                return -1;
+            }
+            source->choices[source->choiceCount++] = choice;
+        } else if (strncmp(line, "exit ", 5) == 0) {
+            if (!current) {
+                fprintf(stderr, "%s:%d: error: 'exit' before any 'node'\n", path, lineNumber);
+                return -1;
+            }
+            if (sscanf(line + 5, "%d", &current->nextChapter) != 1 || current->nextChapter < 1) {
+                fprintf(stderr, "%s:%d: error: expected 'exit <chapter>'\n", path, lineNumber);
+                return -1;
+            }
+        } else if (strncmp(line, "when ", 5) == 0) {
+            PendingChoice* choice = source->choiceCount ? &source->choices[source->choiceCount - 1] : NULL;
+            if (!choice || choice->node != current || choice->condition) {
+                fprintf(stderr, "%s:%d: error: 'when' must follow a choice, once\n", path, lineNumber);
+                return -1;
+            }
+            choice->conditionLine = lineNumber;
+            choice->condition = strdup(line + 5);
+            if (!choice->condition) return -1;
+        } else if (strncmp(line, "do ", 3) == 0) {
+            PendingChoice* choice = source->choiceCount ? &source->choices[source->choiceCount - 1] : NULL;
+            if (!choice || choice->node != current || choice->effects) {
+                fprintf(stderr, "%s:%d: error: 'do' must follow a choice, once\n", path, lineNumber);
+                return -1;
+            }
+            choice->effectsLine = lineNumber;
+            choice->effects = strdup(line + 3);
+            if (!choice->effects) return -1;
+        } else if (findNameDirective(line) >= 0) {
+            int kind = findNameDirective(line);
+            const char* name = line + strlen(nameDirectives[kind]) + 1;
+            if (addStoryName(&source->builder, (NameKind)kind, name) < 0) {
+                fprintf(stderr, "%s:%d: error: expected '%s <name>' of at most %d bytes, and at most %d of them\n",
+                        path, lineNumber, nameDirectives[kind], MAX_REGISTERED_NAME - 1, nameLimits[kind]);
+                return -1;
+            }
+        } else if (strncmp(line, "chapter ", 8) == 0) {
+            if (sscanf(line + 8, "%d", &source->builder.chapter) != 1 || source->builder.chapter < 1) {
+                fprintf(stderr, "%s:%d: error: expected 'chapter <number>'\n", path, lineNumber);
+                return -1;
+            }
+        } else if (strncmp(line, "start ", 6) == 0) {
+            if (sscanf(line + 6, "%d", &source->startId) != 1) {
+                fprintf(stderr, "%s:%d: error: expected 'start <id>'\n", path, lineNumber);
+                return -1;
+            }
+        } else {
+            fprintf(stderr, "%s:%d: error: unknown directive\n", path, lineNumber);
+            return -1;
+        }
+    }
+
+    if (source->nodeCount == 0) {
+        fprintf(stderr, "%s: error: no nodes\n", path);
+        return -1;
+    }
+    if (finishNode(source, current) < 0) return -1;
+
+    source->byId = (StoryNode**)malloc(sizeof(StoryNode*) * source->nodeCount);
+    if (!source->byId) return -1;
+    memcpy(source->byId, source->nodes, sizeof(StoryNode*) * source->nodeCount);
+    qsort(source->byId, source->nodeCount, sizeof(StoryNode*), compareNodeIds);
+    for (int i = 1; i < source->nodeCount; i++) {
+        if (source->byId[i]->id == source->byId[i - 1]->id) {
+            fprintf(stderr, "%s: error: duplicate node %d\n", path, source->byId[i]->id);
+            return -1;
+        }
+    }
+    for (int i = 0; i < source->nodeCount; i++) {
+        if (source->nodes[i]->nextChapter && source->nodes[i]->numChoices) {
+            fprintf(stderr, "%s: error: exit node %d has choices\n", path, source->nodes[i]->id);
+            return -1;
+        }
+    }
+
+    // Choice counts were reserved while reading; add the choices for real now
+    for (int i = 0; i < source->nodeCount; i++) {
+        source->nodes[i]->numChoices = 0;
+    }
+    for (int i = 0; i < source->choiceCount; i++) {
+        const PendingChoice* choice = &source->choices[i];
+        StoryNode* next = NULL;
+
+        if (choice->target != STORY_END) {
+            next = findSourceNode(source, choice->target);
+            if (!next) {
+                fprintf(stderr, "%s:%d: error: choice targets unknown node %d\n", path, choice->line, choice->target);
+                return -1;
+            }
+        }
+        if (addChoice(&source->builder, choice->node, choice->text, next,
+                      choice->requirements[0], choice->requirements[1], choice->requirements[2]) < 0) {
+            fprintf(stderr, "%s:%d: error: choice text does not fit in the story\n", path, choice->line);
+            return -1;
+        }
+
+        char error[256];
+        if (choice->condition && setChoiceCondition(&source->builder, choice->node, choice->node->numChoices - 1,
+                                                    choice->condition, error, sizeof(error)) < 0) {
+            fprintf(stderr, "%s:%d: error: %s\n", path, choice->conditionLine, error);
+            return -1;
+        }
+        if (choice->effects && setChoiceEffects(&source->builder, choice->node, choice->node->numChoices - 1,
+                                                choice->effects, error, sizeof(error)) < 0) {
+            fprintf(stderr, "%s:%d: error: %s\n", path, choice->effectsLine, error);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void dumpDescription(FILE* out, const char* text) {
+    const char* cursor = text;
+
+    // Break at single spaces only; the parser joins lines with one space
+    while (strlen(cursor) > DUMP_WRAP_COLUMN) {
+        const char* split = cursor + DUMP_WRAP_COLUMN;
+        while (split > cursor && *split != ' ') split--;
+        if (split == cursor) break;
+        fprintf(out, "text %.*s\n", (int)(split - cursor), cursor);
+        cursor = split + 1;
+    }
+    fprintf(out, "text %s\n", cursor);
+}
+
+static void dumpStory(FILE* out, const Story* story) {
+    fprintf(out, "# Compiled story source\n");
+    fprintf(out, "start %d\n", story->nodes[story->header->rootNode].id);
+    fprintf(out, "chapter %d\n", story->header->chapter);
+    for (int kind = 0; kind < NAME_KINDS; kind++) {
+        for (uint32_t i = 0; i < story->header->nameCount[kind]; i++) {
+            fprintf(out, "%s %s\n", nameDirectives[kind], getName((NameKind)kind, story->names[kind][i]));
+        }
+    }
+
+    for (uint32_t n = 0; n < story->header->nodeCount; n++) {
+        const StoryRecord* node = &story->nodes[n];
+
+        fprintf(out, "\nnode %d\n", node->id);
+        if (node->nextChapter) {
+            fprintf(out, "exit %d\n", node->nextChapter);
+            continue;
+        }
+        dumpDescription(out, getNodeDescription(story, (int)n));
+        for (uint32_t i = 0; i < node->numChoices; i++) {
+            const uint8_t* req = node->requirements[i];
+            if (node->nextNodes[i] == STORY_END) {
+                fprintf(out, "choice end");
+            } else {
+                fprintf(out, "choice %d", story->nodes[node->nextNodes[i]].id);
+            }
+            fprintf(out, " %d %d %d %s\n", req[0], req[1], req[2], getChoiceText(story, (int)n, (int)i));
+
+            const uint8_t* condition = getChoiceCondition(story, node, (int)i);
+            char text[MAX_CONDITION_TEXT];
+            if (condition && formatCondition(condition, text, sizeof(text)) >= 0) {
+                fprintf(out, "when %s\n", text);
+            }
+            const uint8_t* effects = getChoiceEffects(story, node, (int)i);
+            if (effects && formatEffects(effects, text, sizeof(text)) >= 0) {
+                fprintf(out, "do %s\n", text);
+            }
+        }
+    }
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-o output] [-c chapter] [source]\n", program);
+    fprintf(stderr, "       %s --dump [-c chapter] [compiled-story]\n", program);
+}
+
+int main(int argc, char** argv) {
+    const char* outputPath = "story.dat";
+    const char* sourcePath = NULL;
+    int chapter = 1;
+    int dump = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            chapter = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--dump") == 0) {
+            dump = 1;
+        } else if (argv[i][0] != '-' && !sourcePath) {
+            sourcePath = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (dump) {
+        Story* story = sourcePath ? openStoryFile(sourcePath) : compileBuiltinChapter(chapter);
+        if (!story) {
+            fprintf(stderr, "Failed to load the story.\n");
+            return 1;
+        }
+        dumpStory(stdout, story);
+        closeStory(story);
+        return 0;
+    }
+
+    const StoryNode* root;
+    SourceStory source;
+    memset(&source, 0, sizeof(source));
+    source.startId = -1;
+    initStoryBuilder(&source.builder);
+
+    if (sourcePath) {
+        FILE* file = fopen(sourcePath, "r");
+        if (!file) {
+            perror(sourcePath);
+            return 1;
+        }
+        int status = parseSource(file, sourcePath, &source);
+        fclose(file);
+        if (status < 0) return 1;
+
+        root = source.startId < 0 ? source.nodes[0] : findSourceNode(&source, source.startId);
+        if (!root) {
+            fprintf(stderr, "%s: error: start node %d not found\n", sourcePath, source.startId);
+            return 1;
+        }
+    } else {
+        root = createChapter(&source.builder, chapter);
+        if (!root) {
+            fprintf(stderr, "There is no chapter %d.\n", chapter);
+            return 1;
+        }
+    }
+
+    Story* story = compileStory(&source.builder, root);
+    cleanupStory(&source.builder);
+    if (!story) {
+        fprintf(stderr, "Failed to compile the story.\n");
+        return 1;
+    }
+
+    if (sourcePath && (int)story->header->nodeCount < source.nodeCount) {
+        fprintf(stderr, "%s: warning: %d nodes are unreachable from the start node and were dropped\n",
+                sourcePath, source.nodeCount - (int)story->header->nodeCount);
+    }
+    for (int i = 0; i < source.choiceCount; i++) {
+        free(source.choices[i].text);
+        free(source.choices[i].condition);
+        free(source.choices[i].effects);
+    }
+    free(source.nodes);
+    free(source.byId);
+    free(source.choices);
+    free(source.description);
+
+    if (writeStoryFile(story, outputPath) < 0) {
+        perror(outputPath);
+        closeStory(story);
+        return 1;
+    }
+
+    printf("%s: %u nodes, %u text spans, %u bytes\n", outputPath, story->header->nodeCount,
+           story->header->textCount, story->header->fileSize);
+    closeStory(story);
+    return 0;
+}
@@ -0,0 +1,730 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "../include/engine.h"
+
+/**
+ * @file tune.c
+ * @brief Parallel Monte Carlo balance tuner for choice requirements
+ * @details Plays randomized playthroughs of every class across all cores
+ *          and reports how they end, how often each gated choice is picked
+ *          and how often it is locked when its scene comes up. Players
+ *          follow one of several policy models: uniformly random, greedy
+ *          (takes a stat check whenever one is open) or cautious (takes a
+ *          stat check only when nothing else is open).
+ *
+ *          Given target reach rates for some nodes (-g), it then searches
+ *          the requirement values of the gated choices for the ones that
+ *          bring each class closest to its target. The search edits a
+ *          private copy of the image, one requirement at a time, in steps
+ *          of 4, 2 and 1, keeping a change when it lowers the squared error
+ *          summed over targets and classes. Every playthrough draws from a
+ *          generator seeded from its own number, so each candidate is scored
+ *          on the same random choices regardless of the thread count and
+ *          score differences come from the requirements alone.
+ *
+ *          Like simulate, it plays one compiled image and counts its chapter
+ *          exits as endings. -o writes the tuned image, which storyc --dump
+ *          turns back into source.
+ */
+
+#define NUM_CLASSES 4
+#define MAX_THREADS 256
+#define MAX_TARGETS 16
+#define STAT_LANES 3                        /* Requirement lanes that hold stats; the fourth is presence */
+#define DEFAULT_PLAYTHROUGHS 1000000
+#define DEFAULT_EVALUATION 40000            /* Playthroughs per candidate during the search */
+#define DEFAULT_BUDGET 1000                 /* Most candidates the search scores */
+
+struct Tuner;
+
+/**
+ * @brief Player policy model: picks one of the open choices of a scene
+ * @param tuner Shared tuner state
+ * @param scene Index of the current node
+ * @param mask Non-zero bitmask of open choices
+ * @param rng Pointer to the playthrough's generator state
+ * @return Index of the picked choice
+ */
+typedef int (*Policy)(const struct Tuner* tuner, int scene, unsigned int mask, uint64_t* rng);
+
+/**
+ * @struct Target
+ * @brief Wanted reach rate of one node, by class
+ */
+typedef struct {
+    int node;                       /**< Index of the node */
+    double rates[NUM_CLASSES];      /**< Share of each class's playthroughs that should visit it */
+} Target;
+
+/**
+ * @struct Lane
+ * @brief One tunable stat requirement of one choice
+ */
+typedef struct {
+    int node;                       /**< Index of the node */
+    int choice;                     /**< Zero-based index of the choice */
+    int stat;                       /**< Requirement lane: strength, intelligence or charisma */
+    uint8_t original;               /**< Value before tuning */
+} Lane;
+
+/**
+ * @struct Tally
+ * @brief Counters of one thread, merged into the first at the end
+ */
+typedef struct {
+    uint64_t runs[NUM_CLASSES];         /**< Playthroughs of each class */
+    uint64_t stuck[NUM_CLASSES];        /**< Playthroughs left with no open choice */
+    uint64_t turnLimit[NUM_CLASSES];    /**< Playthroughs cut off at PLAYTHROUGH_TURN_LIMIT */
+    uint64_t left[NUM_CLASSES];         /**< Playthroughs a chapter effect moved out of the image */
+    uint64_t turns;                     /**< Choices made */
+    uint64_t* reached;                  /**< Playthroughs that visited each node, by node and class */
+    uint64_t* ended;                    /**< Playthroughs that ended at each node (STORY_END last), by node and class */
+    uint64_t* visits;                   /**< Visits to each node with choices, by node and class */
+    uint64_t* picks;                    /**< Times each choice was taken, by node, class and choice */
+    uint64_t* locks;                    /**< Visits on which each choice was locked, by node, class and choice */
+    uint64_t* seen;                     /**< Playthrough number plus one that last visited each node */
+} Tally;
+
+/**
+ * @struct Tuner
+ * @brief Shared state of a run; read-only while threads play
+ */
+typedef struct Tuner {
+    Story* story;                   /**< Private copy of the image being tuned */
+    StoryRecord* nodes;             /**< Writable node records of the copy */
+    uint32_t nodeCount;             /**< Number of nodes */
+    uint8_t* gated;                 /**< Choices of each node that have a requirement or a condition */
+    uint8_t* visited;               /**< Nodes any playthrough chose at with the best requirements so far */
+    Policy policy;                  /**< Player model */
+    uint64_t seed;                  /**< Seed every playthrough's generator derives from */
+    int threadCount;                /**< Threads per run */
+    Tally* tallies[MAX_THREADS];    /**< Counters of each thread */
+} Tuner;
+
+/**
+ * @struct Worker
+ * @brief One simulation thread and its share of the playthroughs
+ */
+typedef struct {
+    const Tuner* tuner;             /**< Shared state */
+    Tally* tally;                   /**< This thread's counters */
+    long first;                     /**< Number of the first playthrough */
+    long count;                     /**< Number of playthroughs */
+} Worker;
+
+static const char* classNames[NUM_CLASSES] = {"Warrior", "Scholar", "Diplomat", "Rogue"};
+static const char* statNames[STAT_LANES] = {"STR", "INT", "CHA"};
+
+static uint64_t mixBits(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief Advances a xorshift64 generator
+ * @param state Pointer to the generator state (must be non-zero)
+ * @return Next pseudo-random value
+ */
+static uint64_t nextRandom(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+/**
+ * @brief Picks one set bit of a mask uniformly at random
+ * @param mask Non-zero bitmask of available choices
+ * @param rng Pointer to the generator state
+ * @return Index of the picked bit
+ */
+static int pickChoice(unsigned int mask, uint64_t* rng) {
+    int count = __builtin_popcount(mask);
+    int pick = (int)(nextRandom(rng) % (uint64_t)count);
+    while (pick-- > 0) {
+        mask &= mask - 1;
+    }
+    return __builtin_ctz(mask);
+}
+
+static int pickRandom(const Tuner* tuner, int scene, unsigned int mask, uint64_t* rng) {
+    (void)tuner;
+    (void)scene;
+    return pickChoice(mask, rng);
+}
+
+static int pickGreedy(const Tuner* tuner, int scene, unsigned int mask, uint64_t* rng) {
+    unsigned int gated = mask & tuner->gated[scene];
+    return pickChoice(gated ? gated : mask, rng);
+}
+
+static int pickCautious(const Tuner* tuner, int scene, unsigned int mask, uint64_t* rng) {
+    unsigned int open = mask & ~(unsigned int)tuner->gated[scene];
+    return pickChoice(open ? open : mask, rng);
+}
+
+static Tally* createTally(uint32_t nodeCount) {
+    Tally* tally = (Tally*)calloc(1, sizeof(Tally));
+    if (!tally) return NULL;
+    size_t slots = (size_t)nodeCount * NUM_CLASSES;
+    tally->reached = (uint64_t*)calloc(slots, sizeof(uint64_t));
+    tally->ended = (uint64_t*)calloc(slots + NUM_CLASSES, sizeof(uint64_t));
+    tally->visits = (uint64_t*)calloc(slots, sizeof(uint64_t));
+    tally->picks = (uint64_t*)calloc(slots * MAX_CHOICES, sizeof(uint64_t));
+    tally->locks = (uint64_t*)calloc(slots * MAX_CHOICES, sizeof(uint64_t));
+    tally->seen = (uint64_t*)calloc(nodeCount, sizeof(uint64_t));
+    if (!tally->reached || !tally->ended || !tally->visits || !tally->picks || !tally->locks || !tally->seen) {
+        free(tally->reached);
+        free(tally->ended);
+        free(tally->visits);
+        free(tally->picks);
+        free(tally->locks);
+        free(tally->seen);
+        free(tally);
+        return NULL;
+    }
+    return tally;
+}
+
+static void freeTally(Tally* tally) {
+    if (!tally) return;
+    free(tally->reached);
+    free(tally->ended);
+    free(tally->visits);
+    free(tally->picks);
+    free(tally->locks);
+    free(tally->seen);
+    free(tally);
+}
+
+static void clearTally(Tally* tally, uint32_t nodeCount) {
+    size_t slots = (size_t)nodeCount * NUM_CLASSES;
+    memset(tally->runs, 0, sizeof(tally->runs));
+    memset(tally->stuck, 0, sizeof(tally->stuck));
+    memset(tally->turnLimit, 0, sizeof(tally->turnLimit));
+    memset(tally->left, 0, sizeof(tally->left));
+    tally->turns = 0;
+    memset(tally->reached, 0, slots * sizeof(uint64_t));
+    memset(tally->ended, 0, (slots + NUM_CLASSES) * sizeof(uint64_t));
+    memset(tally->visits, 0, slots * sizeof(uint64_t));
+    memset(tally->picks, 0, slots * MAX_CHOICES * sizeof(uint64_t));
+    memset(tally->locks, 0, slots * MAX_CHOICES * sizeof(uint64_t));
+    memset(tally->seen, 0, nodeCount * sizeof(uint64_t));
+}
+
+static void mergeTally(Tally* into, const Tally* from, uint32_t nodeCount) {
+    size_t slots = (size_t)nodeCount * NUM_CLASSES;
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        into->runs[c] += from->runs[c];
+        into->stuck[c] += from->stuck[c];
+        into->turnLimit[c] += from->turnLimit[c];
+        into->left[c] += from->left[c];
+    }
+    into->turns += from->turns;
+    for (size_t i = 0; i < slots; i++) {
+        into->reached[i] += from->reached[i];
+        into->visits[i] += from->visits[i];
+    }
+    for (size_t i = 0; i < slots + NUM_CLASSES; i++) {
+        into->ended[i] += from->ended[i];
+    }
+    for (size_t i = 0; i < slots * MAX_CHOICES; i++) {
+        into->picks[i] += from->picks[i];
+        into->locks[i] += from->locks[i];
+    }
+}
+
+/**
+ * @brief Plays one playthrough into a tally
+ * @param run Number of the playthrough; picks its class and seeds its generator
+ */
+static void playThrough(const Tuner* tuner, Tally* tally, long run) {
+    const Story* story = tuner->story;
+    int cls = (int)(run % NUM_CLASSES);
+    uint64_t rng = mixBits(tuner->seed + (uint64_t)run) | 1;
+    uint64_t mark = (uint64_t)run + 1;
+
+    Character player;
+    GameState game;
+    initializeCharacter(&player, "Simulated", (CharacterClass)cls);
+    initializeGameState(&game, &player, tuner->story);
+    tally->runs[cls]++;
+
+    while (!isGameOver(&game)) {
+        if (game.story != story) {
+            tally->left[cls]++;
+            releaseGameChapter(&game);
+            break;
+        }
+        int scene = game.currentScene;
+        const StoryRecord* node = &story->nodes[scene];
+        size_t slot = (size_t)scene * NUM_CLASSES + (size_t)cls;
+        if (tally->seen[scene] != mark) {
+            tally->seen[scene] = mark;
+            tally->reached[slot]++;
+        }
+        // A scene without choices is an authored ending
+        if (!node->numChoices) {
+            tally->ended[slot]++;
+            break;
+        }
+        if (game.choiceHistoryCount >= PLAYTHROUGH_TURN_LIMIT) {
+            tally->turnLimit[cls]++;
+            break;
+        }
+
+        unsigned int available = getAvailableChoices(&game);
+        unsigned int locked = ((1u << node->numChoices) - 1) & ~available;
+        tally->visits[slot]++;
+        for (; locked; locked &= locked - 1) {
+            tally->locks[slot * MAX_CHOICES + (size_t)__builtin_ctz(locked)]++;
+        }
+        if (!available) {
+            tally->stuck[cls]++;
+            break;
+        }
+
+        int choice = tuner->policy(tuner, scene, available, &rng);
+        tally->picks[slot * MAX_CHOICES + (size_t)choice]++;
+        applyChoice(&game, choice);
+    }
+
+    if (isGameOver(&game) && game.currentScene == STORY_END) {
+        tally->ended[(size_t)tuner->nodeCount * NUM_CLASSES + (size_t)cls]++;
+    }
+    tally->turns += (uint64_t)game.choiceHistoryCount;
+    freeGameHistory(&game);
+}
+
+static void* workerMain(void* argument) {
+    Worker* worker = (Worker*)argument;
+    for (long run = worker->first; run < worker->first + worker->count; run++) {
+        playThrough(worker->tuner, worker->tally, run);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Plays a population across the tuner's threads
+ * @param tuner Tuner state
+ * @param playthroughs Number of playthroughs, spread over the classes
+ * @return Merged counters, owned by the tuner and valid until the next run
+ */
+static const Tally* runPopulation(Tuner* tuner, long playthroughs) {
+    Worker workers[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    long share = playthroughs / tuner->threadCount;
+    long extra = playthroughs % tuner->threadCount;
+    long first = 0;
+
+    for (int t = 0; t < tuner->threadCount; t++) {
+        clearTally(tuner->tallies[t], tuner->nodeCount);
+        workers[t].tuner = tuner;
+        workers[t].tally = tuner->tallies[t];
+        workers[t].first = first;
+        workers[t].count = share + (t < extra ? 1 : 0);
+        first += workers[t].count;
+    }
+    // The calling thread plays the first share itself
+    for (int t = 1; t < tuner->threadCount; t++) {
+        pthread_create(&threads[t], NULL, workerMain, &workers[t]);
+    }
+    workerMain(&workers[0]);
+    for (int t = 1; t < tuner->threadCount; t++) {
+        pthread_join(threads[t], NULL);
+        mergeTally(tuner->tallies[0], tuner->tallies[t], tuner->nodeCount);
+    }
+    return tuner->tallies[0];
+}
+
+static double getReachRate(const Tally* tally, int node, int cls) {
+    if (!tally->runs[cls]) return 0.0;
+    return (double)tally->reached[(size_t)node * NUM_CLASSES + (size_t)cls] / (double)tally->runs[cls];
+}
+
+/**
+ * @brief Scores how far a population is from the targets
+ * @return Squared reach rate error summed over targets and classes
+ */
+static double scoreTargets(const Tally* tally, const Target* targets, int targetCount) {
+    double error = 0.0;
+    for (int t = 0; t < targetCount; t++) {
+        for (int c = 0; c < NUM_CLASSES; c++) {
+            double delta = getReachRate(tally, targets[t].node, c) - targets[t].rates[c];
+            error += delta * delta;
+        }
+    }
+    return error;
+}
+
+/**
+ * @brief Lists the stat requirements of the image that can be tuned
+ * @return Number of lanes written to lanes
+ * @details Only requirements above zero are tuned, and the search keeps
+ *          them there, so the set of gated choices stays the same.
+ */
+static int collectLanes(const Tuner* tuner, Lane* lanes) {
+    int count = 0;
+    for (uint32_t n = 0; n < tuner->nodeCount; n++) {
+        const StoryRecord* node = &tuner->nodes[n];
+        for (int i = 0; i < node->numChoices; i++) {
+            for (int s = 0; s < STAT_LANES; s++) {
+                if (!node->requirements[i][s]) continue;
+                lanes[count].node = (int)n;
+                lanes[count].choice = i;
+                lanes[count].stat = s;
+                lanes[count].original = node->requirements[i][s];
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+static void markVisited(Tuner* tuner, const Tally* tally) {
+    for (uint32_t n = 0; n < tuner->nodeCount; n++) {
+        const uint64_t* visits = &tally->visits[(size_t)n * NUM_CLASSES];
+        tuner->visited[n] = (visits[0] | visits[1] | visits[2] | visits[3]) != 0;
+    }
+}
+
+/**
+ * @brief Searches requirement values that bring reach rates to their targets
+ * @return Squared error of the tuned requirements
+ * @details Candidates replay the same playthroughs, so a requirement at a
+ *          node none of them chose at cannot change the score and is
+ *          skipped until an accepted change leads players there.
+ */
+static double searchRequirements(Tuner* tuner, const Lane* lanes, int laneCount, const Target* targets,
+                                 int targetCount, long playthroughs, int budget, int* evaluations) {
+    const Tally* tally = runPopulation(tuner, playthroughs);
+    double best = scoreTargets(tally, targets, targetCount);
+    markVisited(tuner, tally);
+    *evaluations = 1;
+
+    for (int step = 4; step >= 1; step /= 2) {
+        int improved = 1;
+        while (improved && *evaluations < budget) {
+            improved = 0;
+            for (int l = 0; l < laneCount && *evaluations < budget; l++) {
+                if (!tuner->visited[lanes[l].node]) continue;
+                uint8_t* value = &tuner->nodes[lanes[l].node].requirements[lanes[l].choice][lanes[l].stat];
+                uint8_t current = *value;
+                for (int sign = 1; sign >= -1 && *evaluations < budget; sign -= 2) {
+                    int candidate = current + sign * step;
+                    if (candidate < 1 || candidate > 255) continue;
+                    *value = (uint8_t)candidate;
+                    tally = runPopulation(tuner, playthroughs);
+                    double error = scoreTargets(tally, targets, targetCount);
+                    (*evaluations)++;
+                    if (error < best - 1e-9) {
+                        best = error;
+                        markVisited(tuner, tally);
+                        improved = 1;
+                        break;
+                    }
+                    *value = current;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Parses a target such as 22=25 or 22=40,10,25,25
+ * @return 0 on success, -1 if the text is malformed or names no node
+ */
+static int parseTarget(const Story* story, const char* text, Target* target) {
+    char* end;
+    long id = strtol(text, &end, 10);
+    if (end == text || *end != '=') return -1;
+    target->node = findStoryNode(story, (int)id);
+    if (target->node == STORY_END) return -1;
+
+    int count = 0;
+    const char* cursor = end + 1;
+    while (count < NUM_CLASSES) {
+        double percent = strtod(cursor, &end);
+        if (end == cursor || percent < 0.0 || percent > 100.0) return -1;
+        target->rates[count++] = percent / 100.0;
+        if (*end != ',') break;
+        cursor = end + 1;
+    }
+    if (*end != '\0' || (count != 1 && count != NUM_CLASSES)) return -1;
+    for (int c = count; c < NUM_CLASSES; c++) {
+        target->rates[c] = target->rates[0];
+    }
+    return 0;
+}
+
+static double percentOf(uint64_t count, uint64_t total) {
+    return total ? 100.0 * (double)count / (double)total : 0.0;
+}
+
+static void printOutcomes(const Tuner* tuner, const Tally* tally) {
+    uint32_t nodeCount = tuner->nodeCount;
+
+    printf("%-10s %12s %10s %10s %10s %10s\n", "Class", "Runs", "Endings", "Dead ends", "Turn limit", "Left");
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        uint64_t endings = 0;
+        for (uint32_t e = 0; e <= nodeCount; e++) {
+            endings += tally->ended[(size_t)e * NUM_CLASSES + (size_t)c];
+        }
+        printf("%-10s %12llu %9.1f%% %9.1f%% %9.1f%% %9.1f%%\n", classNames[c], (unsigned long long)tally->runs[c],
+               percentOf(endings, tally->runs[c]), percentOf(tally->stuck[c], tally->runs[c]),
+               percentOf(tally->turnLimit[c], tally->runs[c]), percentOf(tally->left[c], tally->runs[c]));
+    }
+
+    printf("\nEnding distribution (%% of each class's playthroughs):\n  %-12s", "");
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        printf(" %9s", classNames[c]);
+    }
+    printf("\n");
+    for (uint32_t e = 0; e <= nodeCount; e++) {
+        const uint64_t* counts = &tally->ended[(size_t)e * NUM_CLASSES];
+        if (e < nodeCount && tuner->nodes[e].numChoices) continue;
+        if (e == nodeCount && !(counts[0] | counts[1] | counts[2] | counts[3])) continue;
+        if (e < nodeCount) {
+            printf("  node %-7d", tuner->nodes[e].id);
+        } else {
+            printf("  %-12s", "story's end");
+        }
+        for (int c = 0; c < NUM_CLASSES; c++) {
+            printf(" %8.1f%%", percentOf(counts[c], tally->runs[c]));
+        }
+        printf("\n");
+    }
+}
+
+static void printChoiceRates(const Tuner* tuner, const Tally* tally) {
+    printf("\nGated choices (%% of visits picked / locked, by class):\n  %-10s %-23s", "Choice", "Needs");
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        printf(" %14s", classNames[c]);
+    }
+    printf("\n");
+
+    int listed = 0;
+    for (uint32_t n = 0; n < tuner->nodeCount; n++) {
+        const StoryRecord* node = &tuner->nodes[n];
+        for (int i = 0; i < node->numChoices; i++) {
+            if (!((tuner->gated[n] >> i) & 1)) continue;
+            char label[16];
+            snprintf(label, sizeof(label), "%d.%d", node->id, i + 1);
+            printf("  %-10s STR %3d INT %3d CHA %3d", label, node->requirements[i][0], node->requirements[i][1],
+                   node->requirements[i][2]);
+            for (int c = 0; c < NUM_CLASSES; c++) {
+                size_t slot = (size_t)n * NUM_CLASSES + (size_t)c;
+                uint64_t visits = tally->visits[slot];
+                if (!visits) {
+                    printf(" %14s", "-");
+                    continue;
+                }
+                printf("  %5.1f / %5.1f", percentOf(tally->picks[slot * MAX_CHOICES + (size_t)i], visits),
+                       percentOf(tally->locks[slot * MAX_CHOICES + (size_t)i], visits));
+            }
+            printf("%s\n", (node->conditioned >> i) & 1 ? "  (has a condition)" : "");
+            listed++;
+        }
+    }
+    if (!listed) printf("  (none)\n");
+}
+
+static void printTuning(const Tuner* tuner, const Tally* tally, const Lane* lanes, int laneCount,
+                        const Target* targets, int targetCount) {
+    printf("\nSuggested requirements:\n");
+    int changed = 0;
+    for (int l = 0; l < laneCount; l++) {
+        const StoryRecord* node = &tuner->nodes[lanes[l].node];
+        uint8_t value = node->requirements[lanes[l].choice][lanes[l].stat];
+        if (value == lanes[l].original) continue;
+        printf("  node %d choice %d \"%s\": %s %d -> %d\n", node->id, lanes[l].choice + 1,
+               getChoiceText(tuner->story, lanes[l].node, lanes[l].choice), statNames[lanes[l].stat],
+               lanes[l].original, value);
+        changed++;
+    }
+    if (!changed) printf("  (no change brings the targets closer)\n");
+
+    printf("\nReach rates (achieved / target):\n");
+    for (int t = 0; t < targetCount; t++) {
+        printf("  node %-7d", tuner->nodes[targets[t].node].id);
+        for (int c = 0; c < NUM_CLASSES; c++) {
+            printf("  %s %5.1f%% / %5.1f%%", classNames[c], 100.0 * getReachRate(tally, targets[t].node, c),
+                   100.0 * targets[t].rates[c]);
+        }
+        printf("\n");
+    }
+}
+
+static double elapsedSince(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-t threads] [-n playthroughs] [-p random|greedy|cautious] [-s seed]\n"
+            "          [-g node-id=percent[,percent,percent,percent]]... [-e playthroughs per candidate]\n"
+            "          [-i candidates] [-o tuned-story] [-f compiled-story]\n", program);
+}
+
+int main(int argc, char** argv) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threadCount = cpus > 0 ? (int)cpus : 1;
+    long playthroughs = DEFAULT_PLAYTHROUGHS;
+    long evaluation = DEFAULT_EVALUATION;
+    int budget = DEFAULT_BUDGET;
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    Policy policy = pickRandom;
+    const char* policyName = "random";
+    const char* targetTexts[MAX_TARGETS];
+    int targetCount = 0;
+    const char* storyPath = NULL;
+    const char* outputPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threadCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            playthroughs = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            evaluation = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            budget = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            policyName = argv[++i];
+            if (strcmp(policyName, "random") == 0) {
+                policy = pickRandom;
+            } else if (strcmp(policyName, "greedy") == 0) {
+                policy = pickGreedy;
+            } else if (strcmp(policyName, "cautious") == 0) {
+                policy = pickCautious;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc && targetCount < MAX_TARGETS) {
+            targetTexts[targetCount++] = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            storyPath = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (threadCount < 1 || threadCount > MAX_THREADS || playthroughs <= 0 || evaluation <= 0 || budget < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Story* original = storyPath ? openStoryFile(storyPath) : compileBuiltinStory();
+    if (!original) {
+        fprintf(stderr, "Failed to load the story.\n");
+        return 1;
+    }
+
+    Tuner tuner;
+    memset(&tuner, 0, sizeof(tuner));
+    tuner.story = copyStory(original);
+    closeStory(original);
+    if (!tuner.story) {
+        fprintf(stderr, "Out of memory.\n");
+        return 1;
+    }
+    tuner.nodes = (StoryRecord*)((char*)tuner.story->image + tuner.story->header->nodesOffset);
+    tuner.nodeCount = tuner.story->header->nodeCount;
+    tuner.policy = policy;
+    tuner.seed = seed;
+    tuner.threadCount = threadCount;
+
+    tuner.gated = (uint8_t*)calloc(tuner.nodeCount, 1);
+    tuner.visited = (uint8_t*)calloc(tuner.nodeCount, 1);
+    Lane* lanes = (Lane*)malloc(sizeof(Lane) * ((size_t)tuner.nodeCount * MAX_CHOICES * STAT_LANES + 1));
+    if (!tuner.gated || !tuner.visited || !lanes) {
+        fprintf(stderr, "Out of memory.\n");
+        return 1;
+    }
+    for (uint32_t n = 0; n < tuner.nodeCount; n++) {
+        const StoryRecord* node = &tuner.nodes[n];
+        tuner.gated[n] = node->conditioned;
+        for (int i = 0; i < node->numChoices; i++) {
+            if (node->requirements[i][0] | node->requirements[i][1] | node->requirements[i][2]) {
+                tuner.gated[n] |= (uint8_t)(1u << i);
+            }
+        }
+    }
+    for (int t = 0; t < threadCount; t++) {
+        tuner.tallies[t] = createTally(tuner.nodeCount);
+        if (!tuner.tallies[t]) {
+            fprintf(stderr, "Out of memory.\n");
+            return 1;
+        }
+    }
+
+    Target targets[MAX_TARGETS];
+    for (int t = 0; t < targetCount; t++) {
+        if (parseTarget(tuner.story, targetTexts[t], &targets[t]) < 0) {
+            fprintf(stderr, "Bad target %s: expected node-id=percent or node-id=percent,percent,percent,percent "
+                    "naming a node of the story.\n", targetTexts[t]);
+            return 1;
+        }
+    }
+
+    printf("Story: %u nodes, %s players, %d threads\n", tuner.nodeCount, policyName, threadCount);
+
+    int laneCount = collectLanes(&tuner, lanes);
+    if (targetCount) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int evaluations = 0;
+        double error = searchRequirements(&tuner, lanes, laneCount, targets, targetCount, evaluation, budget,
+                                          &evaluations);
+        printf("Search: %d requirements, %d candidates of %ld playthroughs in %.3f s, squared error %.4f\n",
+               laneCount, evaluations, evaluation, elapsedSince(&start), error);
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    const Tally* tally = runPopulation(&tuner, playthroughs);
+    double seconds = elapsedSince(&start);
+
+    printf("\n");
+    printOutcomes(&tuner, tally);
+    printChoiceRates(&tuner, tally);
+    if (targetCount) {
+        printTuning(&tuner, tally, lanes, laneCount, targets, targetCount);
+    }
+    printf("\n%ld playthroughs, %llu turns in %.3f s (%.0f playthroughs/s)\n", playthroughs,
+           (unsigned long long)tally->turns, seconds, seconds > 0 ? (double)playthroughs / seconds : 0.0);
+
+    int status = 0;
+    if (outputPath) {
+        if (writeStoryFile(tuner.story, outputPath) < 0) {
+            fprintf(stderr, "Failed to write %s.\n", outputPath);
+            status = 1;
+        } else {
+            printf("Wrote the tuned story to %s\n", outputPath);
+        }
+    }
+
+    for (int t = 0; t < threadCount; t++) {
+        freeTally(tuner.tallies[t]);
+    }
+    free(lanes);
+    free(tuner.gated);
+    free(tuner.visited);
+    closeStory(tuner.story);
+    return status;
+}